@@ -1,88 +1,487 @@
+#include <algorithm>
+#include <cctype>
+#include <csignal>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 
+#include "ArchiveSearch.h"
+#include "Catalog.h"
+#include "Chunker.h"
+#include "CompressionOptions.h"
 #include "CompressorFactory.h"
+#include "DeltaPlanner.h"
+#include "Dictionary.h"
 #include "FileCompressor.h"
+#include "IO.h"
+#include "LineStore.h"
+#include "LogMerger.h"
+#include "LogQuery.h"
+#include "TimestampCodec.h"
+#ifdef HAVE_INOTIFY
+#include "Watcher.h"
+#endif
 
 using namespace compression;
 
 
+std::string toLower(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+
 std::string print_default_compressions()
 {
-    #ifdef HAVE_BROTLI
-    return "(default: brotli)";
-    #elif defined(HAVE_ZLIB)
-    return  "(default: zlib)";
-    #elif defined(HAVE_ZSTD)
-    return  "(default: zstd)";
-    #endif
-    return "";
+    return "(default: " + toLower(CompressionTypeToString(defaultCompressionType())) + ")";
 }
 
 
 std::string print_supported_compressions()
 {
-    bool first = true;
     std::string result = "";
-
-    #ifdef HAVE_BROTLI
-    result += "brotli";
-    first = false;
-    #endif
-    
-    #ifdef HAVE_ZLIB
-    if (!first) {
-        result += ", ";
-    }
-    result += "zlib";
-    first = false;
-    #endif
-        
-    #ifdef HAVE_ZSTD
-    if (!first) {
-        result += ", ";
+    for (auto type : availableCompressionTypes()) {
+        result += toLower(CompressionTypeToString(type)) + ", ";
     }
-    result += "zstd";
-    #endif
-    return result + "";
+    return result + "auto";
 }
 
 void print_usage(const char* program_name) {
     std::cout << "LogRescuer - A time machine log compression and archival tool.\n"
               << "\n"
               << "Usage: " << program_name << " <command> <dir> <archive_file> [options]\n"
+              << "       " << program_name << " extract <dir> <archive_file> [<file>...] [--since=TIME] [--until=TIME] [--dict-registry=DIR]\n"
+              << "       " << program_name << " train <dir> <registry_dir> [--dict=SIZE]\n"
+              << "       " << program_name << " search <pattern> <archive_file> [<file>...] [search options]\n"
+              << "       " << program_name << " merge <output_file> <archive_file> [<file>...] [merge options]\n"
+              << "       " << program_name << " query <archive_file> [<file>...] [query options]\n"
+              << "       " << program_name << " catalog <catalog_file> <archive_file|dir>...\n"
+              << "       " << program_name << " locate <catalog_file> [<file>|<dir>/] [--hash=HASH] [--since=TIME] [--until=TIME]\n"
+              << "       " << program_name << " watch <dir> <archive_prefix> [options] [watch options]\n"
               << "\n"
               << "Commands:\n"
               << "  compress    - Create a compressed archive.\n"
+              << "  append      - Add the new and changed files of a directory to an existing archive, compressing\n"
+              << "                only their data; an interrupted append is rolled back by the next one.\n"
               << "  decompress  - Extract an archive.\n"
+              << "  extract     - Extract selected files (paths relative to the archived directory), or with --since/--until\n"
+              << "                all files whose recorded time range overlaps the window.\n"
+              << "  train       - Train a dictionary per file family into a dictionary registry, replacing older ones.\n"
+              << "  search      - Print the lines of archived files matching a pattern as path:line:text, without extracting.\n"
+              << "  merge       - Write the records of archived files interleaved by timestamp into one file, '-' for stdout.\n"
+              << "  query       - Count log entries by level, component, template and time bucket, without extracting.\n"
+              << "  catalog     - Index the paths, hashes, sizes and time ranges of archives, or of all archives under a\n"
+              << "                directory, into a catalog file; only new or changed archives are read.\n"
+              << "  locate      - Find which cataloged archives hold a file, a directory's files, a content hash or a time window.\n"
+              << "  watch       - Keep running and append files finished under a directory, such as closed or rotated logs,\n"
+              << "                to one archive per day or hour named <archive_prefix>-YYYY-MM-DD[-HH], until interrupted.\n"
               << "\n"
               << "Options:\n"
               << "  -c, --compression    Optionally specify a compression algorithm: [" << print_supported_compressions() << "] " << print_default_compressions() << "\n"
+              << "      --codec          Alias for --compression. 'auto' samples each file family and picks a codec and level.\n"
+              << "  -l, --level          Compression level for the selected algorithm (default: algorithm default).\n"
+              << "      --throughput     Minimum compression speed in MB/s targeted by --codec=auto (default: 50).\n"
+              << "      --workers        zstd worker threads per file, 0 to disable (default: auto, sized to the thread pool).\n"
+              << "      --long[=N]       Enable zstd long-distance matching, optionally with a 2^N byte window (default: 27).\n"
+              << "      --window=N       Match window of 2^N bytes for zstd and brotli; brotli above 24 uses large-window mode.\n"
+              << "      --solid[=SIZE]   Pack smaller files into shared blocks of SIZE bytes, K/M/G suffixes allowed (default: 4M).\n"
+              << "      --cluster        Sketch files with MinHash and pack near-duplicates next to each other in solid blocks\n"
+              << "                       (implies --solid).\n"
+              << "      --chunk[=SIZE]   Deduplicate content-defined chunks of about SIZE bytes across the files solid mode leaves\n"
+              << "                       (default: 16K). Files sharing at least a quarter of their bytes are chunked and skip the\n"
+              << "                       other stages; cannot be combined with --delta.\n"
+              << "      --lines[=SIZE]   Store each long line repeated across files once in a shared line store, using up to\n"
+              << "                       SIZE bytes of memory for its hash table and lines (default: 256M).\n"
+              << "      --no-transcode   Compress UTF-16 text as it is instead of converting it to UTF-8 first.\n"
+              << "      --timestamps     Move leading [YYYY-MM-DD HH:MM:SS.mmm] timestamps into a delta-encoded column\n"
+              << "                       compressed apart from the rest of the lines.\n"
+              << "      --templates      Store files made of a few message templates as template ids plus integer,\n"
+              << "                       variable and timestamp columns (such files skip --lines and --timestamps).\n"
+              << "      --json           Store JSON-lines files as record shapes plus one column per key, restored\n"
+              << "                       byte for byte (such files skip --templates, --lines and --timestamps).\n"
+              << "      --filters        Store a Bloom filter of each file's 3-byte sequences so literal searches skip files\n"
+              << "                       that cannot contain the pattern.\n"
+              << "      --time-index     Record the range of leading [YYYY-MM-DD HH:MM:SS.mmm] line timestamps of each file\n"
+              << "                       so --since/--until skip files outside the window.\n"
+              << "      --delta[=DEPTH]  Delta encode rotated logs (x.log.1, x.log.2, ...) against their newer neighbour with zstd,\n"
+              << "                       in chains of at most DEPTH deltas to bound restore time (default: 4).\n"
+              << "      --dict[=SIZE]    Train a dictionary of SIZE bytes per family of small files and embed it (default: 110K).\n"
+              << "      --dict-registry=DIR  Reuse dictionaries from DIR and store new ones there; archives reference them by id.\n"
+              << "                       Pass the same option to decompress and extract.\n"
+              << "      --catalog=FILE   Register the new archive in a catalog file, creating it if needed.\n"
+              << "      --base=ARCHIVE   Make an incremental archive: files whose content ARCHIVE holds are referenced in it,\n"
+              << "                       found by size and modification time or by hash. Keep ARCHIVE in place to restore.\n"
+              << "      --base-depth=N   Base archives a reference may pass through; files deeper are stored again (default: 4).\n"
               << "  -h, --help           Print this help message.\n"
               << "\n"
+              << "Search options:\n"
+              << "  -E, --regex          Treat the pattern as an ECMAScript regular expression instead of literal text.\n"
+              << "  -i, --ignore-case    Match letters regardless of case.\n"
+              << "  -m, --max-count=N    Stop after N matching lines.\n"
+              << "      --since=TIME     Only lines timed at or after TIME (YYYY-MM-DD[ HH:MM[:SS[.mmm]]]); a line without a\n"
+              << "                       leading timestamp takes the one of the line before it. Also applies to extract.\n"
+              << "      --until=TIME     Only lines timed at or before TIME, missing fields counting to the end of the period.\n"
+              << "      --dict-registry=DIR  Locate dictionaries the archive references.\n"
+              << "\n"
+              << "Merge options:\n"
+              << "      --since=TIME, --until=TIME  Only records timed inside the window, as for search.\n"
+              << "      --label          Prefix every line with the path of its file and ':'.\n"
+              << "      --fan-in=N       Files decoded at once; more overlapping files are merged in rounds through temporary\n"
+              << "                       files (default: 64).\n"
+              << "      --dict-registry=DIR  Locate dictionaries the archive references.\n"
+              << "\n"
+              << "Query options:\n"
+              << "      --by=FIELDS      Count apart by a comma-separated list of level, component and template.\n"
+              << "      --per=UNIT       Count apart per minute, hour or day of the entries' timestamps.\n"
+              << "      --level=LEVELS   Only entries of these comma-separated levels, such as ERROR,CRITICAL.\n"
+              << "      --since=TIME, --until=TIME  Only entries timed inside the window, as for search.\n"
+              << "      --dict-registry=DIR  Locate dictionaries the archive references.\n"
+              << "\n"
+              << "Watch options:\n"
+              << "      --latency=SECONDS  Longest a finished file waits before its batch is archived (default: 60).\n"
+              << "      --segment=UNIT   Start a new archive every hour or day, in UTC (default: day).\n"
+              << "\n"
               << "Example:\n"
-              << "  " << program_name << " compress /var/logs logs_archive --compression=zlib\n\n";
+              << "  " << program_name << " compress /var/logs logs_archive --compression=zlib\n"
+              << "  " << program_name << " compress /var/logs logs_snapshot --compression=lz4\n"
+              << "  " << program_name << " compress /var/logs logs_archive --codec=auto --throughput=100\n"
+              << "  " << program_name << " compress /var/logs logs_archive --compression=zstd --long=30\n"
+              << "  " << program_name << " compress /var/logs logs_archive --solid=16M\n"
+              << "  " << program_name << " compress /var/fleet logs_archive --solid=16M --cluster\n"
+              << "  " << program_name << " compress /var/logs logs_archive --chunk\n"
+              << "  " << program_name << " compress /var/logs logs_archive --lines=1G\n"
+              << "  " << program_name << " compress /var/logs logs_archive --timestamps --lines\n"
+              << "  " << program_name << " compress /var/logs logs_archive --templates --compression=zstd\n"
+              << "  " << program_name << " compress /var/logs logs_archive --json --templates\n"
+              << "  " << program_name << " compress /var/logs logs_archive --filters --time-index\n"
+              << "  " << program_name << " compress /var/logs logs_archive --compression=zstd --delta=8\n"
+              << "  " << program_name << " compress /var/logs logs_tuesday --base=logs_monday --base-depth=7\n"
+              << "  " << program_name << " compress /var/logs logs_archive --compression=zstd --dict\n"
+              << "  " << program_name << " compress /var/logs/hourly logs_archive -c=zstd --dict-registry=/var/lib/logrescuer/dicts\n"
+              << "  " << program_name << " append /var/logs/hour-03 logs_archive --compression=zstd\n"
+              << "  " << program_name << " watch /var/logs /srv/archives/logs --segment=hour --latency=30 -c=zstd --catalog=/srv/archives/fleet.catalog\n"
+              << "  " << program_name << " extract restored logs_archive app/service.log\n"
+              << "  " << program_name << " extract restored logs_archive --since='2105-05-13 03:00' --until='2105-05-13 03:15'\n"
+              << "  " << program_name << " search 'Batch job [0-9]+ on unit' logs_archive -E --max-count=100\n"
+              << "  " << program_name << " merge - logs_archive --since='2105-05-13 03:00' --label | less\n"
+              << "  " << program_name << " query logs_archive --level=CRITICAL --by=component --per=hour\n"
+              << "  " << program_name << " catalog /var/lib/logrescuer/fleet.catalog /srv/archives\n"
+              << "  " << program_name << " locate /var/lib/logrescuer/fleet.catalog host01/app.log --since='2105-05-13 03:00'\n\n";
+}
+
+// Matches "--name=value" or "-n=value" and extracts the value
+bool parseOption(const std::string& arg, const std::string& longName, const std::string& shortName, std::string& value) {
+    for (const auto& prefix : {longName + "=", shortName + "="}) {
+        if (prefix.size() > 1 && arg.compare(0, prefix.size(), prefix) == 0) {
+            value = arg.substr(prefix.size());
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses a byte count with an optional K, M or G suffix
+uint64_t parseSize(const std::string& value) {
+    size_t suffixPos;
+    uint64_t size = std::stoull(value, &suffixPos);
+    std::string suffix = toLower(value.substr(suffixPos));
+    if (suffix == "k") {
+        size <<= 10;
+    } else if (suffix == "m") {
+        size <<= 20;
+    } else if (suffix == "g") {
+        size <<= 30;
+    } else if (!suffix.empty()) {
+        throw std::invalid_argument("Invalid size '" + value + "'");
+    }
+    if (size == 0) {
+        throw std::invalid_argument("Size must be positive");
+    }
+    return size;
+}
+
+int parseWindowLog(const std::string& value) {
+    int windowLog = std::stoi(value);
+    if (windowLog < 10 || windowLog > 31) {
+        throw std::invalid_argument("Window log must be between 10 and 31");
+    }
+    return windowLog;
+}
+
+compression::CompressionOptions parseCompressionOptions(int argc, char* argv[]) {
+    compression::CompressionOptions options;
+    for (int i = 4; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseOption(arg, "--compression", "-c", value) || parseOption(arg, "--codec", "", value)) {
+            if (toLower(value) == "auto") {
+                options.adaptive = true;
+                continue;
+            }
+            options.compType = CompressionTypeFromString(value);
+            if (options.compType == CompressionType::NONE || !isCompressionTypeAvailable(options.compType)) {
+                throw std::runtime_error("Invalid compression type");
+            }
+        } else if (parseOption(arg, "--level", "-l", value)) {
+            options.level = std::stoi(value);
+        } else if (parseOption(arg, "--throughput", "", value)) {
+            options.throughputTarget = std::stod(value);
+        } else if (parseOption(arg, "--workers", "", value)) {
+            options.workers = toLower(value) == "auto" ? AUTO_WORKERS : std::stoi(value);
+            if (options.workers < AUTO_WORKERS) {
+                throw std::invalid_argument("Worker count must not be negative");
+            }
+        } else if (arg == "--long" || parseOption(arg, "--long", "", value)) {
+            options.longDistance = true;
+            if (!value.empty()) {
+                options.windowLog = parseWindowLog(value);
+            }
+        } else if (parseOption(arg, "--window", "", value)) {
+            options.windowLog = parseWindowLog(value);
+        } else if (arg == "--solid" || parseOption(arg, "--solid", "", value)) {
+            options.solidBlockSize = value.empty() ? DEFAULT_SOLID_BLOCK_SIZE : parseSize(value);
+        } else if (arg == "--dict" || parseOption(arg, "--dict", "", value)) {
+            options.dictionarySize = value.empty() ? DEFAULT_DICTIONARY_SIZE : parseSize(value);
+        } else if (arg == "--cluster") {
+            options.clusterSimilar = true;
+        } else if (arg == "--chunk" || parseOption(arg, "--chunk", "", value)) {
+            uint64_t chunkSize = value.empty() ? chunking::DEFAULT_CHUNK_SIZE : parseSize(value);
+            if (chunkSize < 256 || chunkSize > (16 << 20)) {
+                throw std::invalid_argument("Average chunk size must be between 256 bytes and 16M");
+            }
+            options.chunkSize = static_cast<uint32_t>(chunkSize);
+        } else if (arg == "--lines" || parseOption(arg, "--lines", "", value)) {
+            options.lineMemory = value.empty() ? lines::DEFAULT_LINE_MEMORY : parseSize(value);
+        } else if (arg == "--no-transcode") {
+            options.transcodeUtf16 = false;
+        } else if (arg == "--timestamps") {
+            options.timestampColumns = true;
+        } else if (arg == "--templates") {
+            options.templateColumns = true;
+        } else if (arg == "--json") {
+            options.jsonColumns = true;
+        } else if (arg == "--filters") {
+            options.gramFilters = true;
+        } else if (arg == "--time-index") {
+            options.timeIndex = true;
+        } else if (arg == "--delta" || parseOption(arg, "--delta", "", value)) {
+            options.deltaDepth = value.empty() ? DEFAULT_DELTA_DEPTH : std::stoi(value);
+            if (options.deltaDepth < 1) {
+                throw std::invalid_argument("Delta chain depth must be at least 1");
+            }
+        } else if (parseOption(arg, "--dict-registry", "", value)) {
+            options.dictionaryRegistry = value;
+        } else if (parseOption(arg, "--catalog", "", value)) {
+            options.catalogFile = value;
+        } else if (parseOption(arg, "--base-depth", "", value)) {
+            options.baseDepth = std::stoi(value);
+            if (options.baseDepth < 1) {
+                throw std::invalid_argument("Base chain depth must be at least 1");
+            }
+        } else if (parseOption(arg, "--base", "", value)) {
+            options.baseArchive = value;
+        } else {
+            throw std::invalid_argument("Unknown option '" + arg + "'. Try '" + std::string(argv[0]) + " --help' for more information.");
+        }
+    }
+    if (options.clusterSimilar && options.solidBlockSize == 0) {
+        options.solidBlockSize = DEFAULT_SOLID_BLOCK_SIZE;  // Clustering orders solid blocks
+    }
+    if (!options.dictionaryRegistry.empty() && options.dictionarySize == 0) {
+        options.dictionarySize = DEFAULT_DICTIONARY_SIZE;  // A registry implies dictionary mode
+    }
+    if (options.chunkSize > 0 && options.deltaDepth > 0) {
+        throw std::invalid_argument("--chunk and --delta both store rotations against each other; choose one");
+    }
+    return options;
 }
 
-compression::CompressionType parseCompressionType(const std::string& compression) {
-    #ifdef HAVE_BROTLI
-    if (compression == "--compression=brotli" || compression == "-c=brotli") {
-        return compression::CompressionType::BROTLI;
+// Matches "--since=TIME" or "--until=TIME" and narrows the window to it
+bool parseTimeOption(const std::string& arg, timestamps::TimeWindow& window) {
+    std::string value;
+    if (parseOption(arg, "--since", "", value)) {
+        window.since = timestamps::parseTimeBound(value, false);
+    } else if (parseOption(arg, "--until", "", value)) {
+        window.until = timestamps::parseTimeBound(value, true);
+    } else {
+        return false;
     }
-    #endif
+    return true;
+}
 
-    #ifdef HAVE_ZLIB
-    if (compression == "--compression=zlib" || compression == "-c=zlib") {
-        return compression::CompressionType::ZLIB;
-    }    
-    #endif
-    
-    #ifdef HAVE_ZSTD
-    if (compression == "--compression=zstd" || compression == "-c=zstd") {
-        return compression::CompressionType::ZSTD;
+// Splits the trailing arguments of extract into file paths, a --dict-registry option and a time window
+std::vector<std::string> parseExtractArguments(int argc, char* argv[], std::string& registryDir,
+                                               timestamps::TimeWindow& window) {
+    std::vector<std::string> relativePaths;
+    for (int i = 4; i < argc; i++) {
+        std::string arg = argv[i];
+        if (!parseOption(arg, "--dict-registry", "", registryDir) && !parseTimeOption(arg, window)) {
+            relativePaths.push_back(arg);
+        }
     }
-    #endif
+    return relativePaths;
+}
 
-    throw std::runtime_error("Invalid compression type");
+// Parses the trailing arguments of search into file paths and search options
+search::SearchOptions parseSearchOptions(int argc, char* argv[]) {
+    search::SearchOptions options;
+    options.pattern = argv[2];
+    for (int i = 4; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        if (arg == "--regex" || arg == "-E") {
+            options.regex = true;
+        } else if (arg == "--ignore-case" || arg == "-i") {
+            options.ignoreCase = true;
+        } else if (parseOption(arg, "--max-count", "-m", value)) {
+            options.maxMatches = std::stoull(value);
+            if (options.maxMatches == 0) {
+                throw std::invalid_argument("Match limit must be positive");
+            }
+        } else if (!parseOption(arg, "--dict-registry", "", options.registryDir) && !parseTimeOption(arg, options.window)) {
+            if (arg.rfind("--", 0) == 0) {
+                throw std::invalid_argument("Unknown option '" + arg + "'. Try '" + std::string(argv[0]) + " --help' for more information.");
+            }
+            options.relativePaths.push_back(arg);
+        }
+    }
+    return options;
+}
+
+// Parses the trailing arguments of merge into file paths and merge options
+merge::MergeOptions parseMergeOptions(int argc, char* argv[]) {
+    merge::MergeOptions options;
+    for (int i = 4; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        if (arg == "--label") {
+            options.labelLines = true;
+        } else if (parseOption(arg, "--fan-in", "", value)) {
+            options.fanIn = std::stoull(value);
+        } else if (!parseOption(arg, "--dict-registry", "", options.registryDir) && !parseTimeOption(arg, options.window)) {
+            if (arg.rfind("--", 0) == 0) {
+                throw std::invalid_argument("Unknown option '" + arg + "'. Try '" + std::string(argv[0]) + " --help' for more information.");
+            }
+            options.relativePaths.push_back(arg);
+        }
+    }
+    return options;
+}
+
+// Splits a comma-separated list
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = std::min(list.find(',', start), list.size());
+        if (end > start) {
+            items.push_back(list.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return items;
+}
+
+// Parses the trailing arguments of query into file paths and query options
+query::QueryOptions parseQueryOptions(int argc, char* argv[]) {
+    query::QueryOptions options;
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseOption(arg, "--by", "", value)) {
+            for (const auto& field : splitList(value)) {
+                options.groupBy.push_back(query::parseField(field));
+            }
+        } else if (parseOption(arg, "--per", "", value)) {
+            if (value == "minute") {
+                options.bucketMillis = query::MINUTE_MILLIS;
+            } else if (value == "hour") {
+                options.bucketMillis = query::HOUR_MILLIS;
+            } else if (value == "day") {
+                options.bucketMillis = query::DAY_MILLIS;
+            } else {
+                throw std::invalid_argument("Unknown time bucket '" + value + "': expected minute, hour or day");
+            }
+        } else if (parseOption(arg, "--level", "", value)) {
+            options.levels = splitList(value);
+        } else if (!parseOption(arg, "--dict-registry", "", options.registryDir) && !parseTimeOption(arg, options.window)) {
+            if (arg.rfind("--", 0) == 0) {
+                throw std::invalid_argument("Unknown option '" + arg + "'. Try '" + std::string(argv[0]) + " --help' for more information.");
+            }
+            options.relativePaths.push_back(arg);
+        }
+    }
+    return options;
+}
+
+#ifdef HAVE_INOTIFY
+// Watch stopped by SIGINT and SIGTERM
+watch::Watcher* activeWatcher = nullptr;
+
+extern "C" void stopWatch(int) {
+    if (activeWatcher) {
+        activeWatcher->stop();
+    }
+}
+
+// Parses the trailing arguments of watch into watch options, the others being compression options
+watch::WatchOptions parseWatchOptions(int argc, char* argv[]) {
+    watch::WatchOptions options;
+    std::vector<char*> compressionArgs(argv, argv + 4);
+    for (int i = 4; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseOption(arg, "--latency", "", value)) {
+            double seconds = std::stod(value);
+            if (seconds < 0) {
+                throw std::invalid_argument("Watch latency must not be negative");
+            }
+            options.latencyMillis = static_cast<int64_t>(seconds * 1000);
+        } else if (parseOption(arg, "--segment", "", value)) {
+            options.segment = watch::parseSegment(value);
+        } else {
+            compressionArgs.push_back(argv[i]);
+        }
+    }
+    options.compression = parseCompressionOptions(static_cast<int>(compressionArgs.size()), compressionArgs.data());
+    if (!options.compression.baseArchive.empty()) {
+        throw std::invalid_argument("A watch cannot set a base archive; its batches are appended");
+    }
+    return options;
+}
+#endif
+
+// Formats a time range as its first and last timestamp, or '-' twice when unknown
+std::string formatRange(bool known, int64_t minTimestamp, int64_t maxTimestamp) {
+    if (!known) {
+        return "-\t-";
+    }
+    char first[timestamps::TIMESTAMP_LENGTH];
+    char last[timestamps::TIMESTAMP_LENGTH];
+    timestamps::formatTimestamp(minTimestamp, first);
+    timestamps::formatTimestamp(maxTimestamp, last);
+    return std::string(first + 1, timestamps::TIMESTAMP_LENGTH - 2) + "\t" +
+           std::string(last + 1, timestamps::TIMESTAMP_LENGTH - 2);
+}
+
+// Parses the trailing arguments of locate into a catalog query
+catalog::LocateQuery parseLocateQuery(int argc, char* argv[]) {
+    catalog::LocateQuery query;
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (!parseOption(arg, "--hash", "", query.hash) && !parseTimeOption(arg, query.window)) {
+            if (!query.path.empty()) {
+                throw std::invalid_argument("locate takes a single path");
+            }
+            query.path = arg;
+        }
+    }
+    if (query.path.empty() && query.hash.empty() && !query.window.bounded()) {
+        throw std::invalid_argument("Nothing to locate. Try '" + std::string(argv[0]) + " --help' for more information.");
+    }
+    return query;
 }
 
 int main(int argc, char* argv[]) {
@@ -92,30 +491,125 @@ int main(int argc, char* argv[]) {
     }
 
     try {
-        if (argc < 4) {
+        std::string command = argv[1];
+        if (argc < (command == "query" || command == "locate" ? 3 : 4)) {
             throw std::invalid_argument("Insufficient arguments. Try '" + std::string(argv[0]) + " --help' for more information.");
         }
 
-        std::string command = argv[1];
         if (command == "compress") {
-            compression::CompressionType compType = compression::CompressionType::NONE;
-            #ifdef HAVE_BROTLI
-            compType = compression::CompressionType::BROTLI;
-            #elif defined(HAVE_ZLIB)
-            compType = compression::CompressionType::ZLIB;
-            #elif defined(HAVE_ZSTD)
-            compType = compression::CompressionType::ZSTD;
-            #else
-            #error "No compression method available"
-            #endif
-
-            if (argc > 4) {
-                compType = parseCompressionType(argv[4]);
-            }
-            FileCompressor::compress(argv[2], argv[3], compType);
+            auto options = parseCompressionOptions(argc, argv);
+            FileCompressor::compress(argv[2], argv[3], options);
             std::cout << "Successfully compressed folder: " << argv[2] << " to archive file: " << argv[3] << "\n";
+        } else if (command == "append") {
+            auto options = parseCompressionOptions(argc, argv);
+            FileCompressor::append(argv[2], argv[3], options);
+            std::cout << "Successfully appended folder: " << argv[2] << " to archive file: " << argv[3] << "\n";
+        } else if (command == "extract") {
+            std::string registryDir;
+            timestamps::TimeWindow window;
+            auto relativePaths = parseExtractArguments(argc, argv, registryDir, window);
+            if (relativePaths.empty() && !window.bounded()) {
+                throw std::invalid_argument("No files to extract. Try '" + std::string(argv[0]) + " --help' for more information.");
+            }
+            size_t extracted = FileCompressor::extract(argv[3], argv[2], relativePaths, registryDir, window);
+            std::cout << "Successfully extracted " << extracted << " file(s) from archive file: " << argv[3] << "\n";
+        } else if (command == "train") {
+            auto options = parseCompressionOptions(argc, argv);
+            size_t dictionarySize = options.dictionarySize > 0 ? options.dictionarySize : DEFAULT_DICTIONARY_SIZE;
+            size_t trained = FileCompressor::train(argv[2], argv[3], dictionarySize);
+            std::cout << "Trained " << trained << " dictionaries from folder: " << argv[2] << " into registry: " << argv[3] << "\n";
+        } else if (command == "search") {
+            uint64_t matches = 0;
+            // Printed as the search reports them, while later files are still decoded
+            auto stats = search::searchArchive(argv[3], parseSearchOptions(argc, argv), [&matches](const auto& match) {
+                std::cout << match.relativePath << ":" << match.lineNumber << ":" << match.line << "\n";
+                matches++;
+            });
+            if (stats.skipped > 0) {  // Kept off stdout, which holds only matches
+                std::cerr << "Skipped " << stats.skipped << " of " << stats.skipped + stats.searched
+                          << " files by their n-gram filters or time ranges\n";
+            }
+            return matches == 0 ? 1 : 0;  // Like grep, no match is a failure for scripts
+        } else if (command == "merge") {
+            auto options = parseMergeOptions(argc, argv);
+            std::string outputFile = argv[2];
+            merge::MergeStats stats;
+            if (outputFile == "-") {
+                std::ios::sync_with_stdio(false);
+                stats = merge::mergeArchive(argv[3], std::cout, options);
+            } else {
+                std::ofstream output(outputFile, std::ios::binary);
+                io::checkOpen(output, outputFile, "Merge output creation");
+                stats = merge::mergeArchive(argv[3], output, options);
+            }
+            // Kept off stdout when it holds the records
+            std::ostream& report = outputFile == "-" ? std::cerr : std::cout;
+            report << "Merged " << stats.records << " records from " << stats.files << " file(s) of archive file: "
+                   << argv[3] << (stats.runs > 0 ? " through " + std::to_string(stats.runs) + " temporary runs" : "")
+                   << "\n";
+            if (stats.skipped > 0) {
+                report << "Outside the time window: " << stats.skipped << " files\n";
+            }
+        } else if (command == "query") {
+            query::QueryStats stats;
+            auto result = query::queryArchive(argv[2], parseQueryOptions(argc, argv), &stats);
+            std::cout << "count";
+            for (const auto& column : result.columns) {
+                std::cout << "\t" << column;
+            }
+            std::cout << "\n";
+            for (const auto& [key, count] : result.counts) {
+                std::cout << count;
+                for (const auto& value : key) {
+                    std::cout << "\t" << value;
+                }
+                std::cout << "\n";
+            }
+            // Kept off stdout, which holds only the table
+            std::cerr << "Read " << stats.queried << " files, " << stats.columnar << " of them from their template columns";
+            if (stats.skipped > 0) {
+                std::cerr << "; skipped " << stats.skipped << " by their time ranges";
+            }
+            std::cerr << "\n";
+        } else if (command == "catalog") {
+            auto stats = catalog::updateCatalog(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+            std::cout << "Catalog " << argv[2] << ": " << stats.added << " archives added, " << stats.refreshed
+                      << " refreshed, " << stats.unchanged << " unchanged, " << stats.removed << " removed";
+            if (stats.skipped > 0) {
+                std::cout << ", " << stats.skipped << " other files skipped";
+            }
+            std::cout << "\n";
+        } else if (command == "locate") {
+            catalog::CatalogReader reader(argv[2]);
+            auto found = reader.locate(parseLocateQuery(argc, argv));
+            for (const auto& location : found) {
+                std::cout << location.archive << "\t" << location.relativePath << "\t" << location.originalSize << "\t"
+                          << formatRange(location.hasTimeRange(), location.minTimestamp, location.maxTimestamp) << "\t"
+                          << location.hash << "\n";
+            }
+            return found.empty() ? 1 : 0;  // Like search, nothing found is a failure for scripts
+        } else if (command == "watch") {
+#ifdef HAVE_INOTIFY
+            watch::Watcher watcher(argv[2], argv[3], parseWatchOptions(argc, argv));
+            activeWatcher = &watcher;
+            std::signal(SIGINT, stopWatch);
+            std::signal(SIGTERM, stopWatch);
+            std::cout << "Watching folder: " << argv[2] << " for archives: " << argv[3] << "-*\n" << std::flush;
+            watcher.run();
+            activeWatcher = nullptr;
+            const auto& stats = watcher.stats();
+            std::cout << "Stopped watching folder: " << argv[2] << ": " << stats.files << " files archived in "
+                      << stats.batches << " batches, " << stats.archives << " archives created";
+            if (stats.failures > 0) {
+                std::cout << ", " << stats.failures << " failed batches retried";
+            }
+            std::cout << "\n";
+#else
+            throw std::runtime_error("Watch mode needs inotify, which this platform lacks");
+#endif
         } else if (command == "decompress") {
-            FileCompressor::decompress(argv[3], argv[2]);
+            auto options = parseCompressionOptions(argc, argv);
+            FileCompressor::decompress(argv[3], argv[2], options.dictionaryRegistry);
             std::cout << "Successfully decompressed archive file: " << argv[3] << " to folder: " << argv[2] << "\n";
         } else {
             throw std::invalid_argument("Unknown command '" + command + "'. Try '" + std::string(argv[0]) + " --help' for more information.");
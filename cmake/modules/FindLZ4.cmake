@@ -0,0 +1,59 @@
+# Find LZ4 library and include files
+#
+# LZ4_INCLUDE_DIRS - where to find lz4frame.h, etc.
+# LZ4_LIBRARIES - List of libraries to link against when using LZ4
+# LZ4_FOUND - True if LZ4 was found
+
+find_path(LZ4_INCLUDE_DIR
+    NAMES lz4frame.h
+    PATHS
+        ${LZ4_ROOT}/include
+        /usr/local/include
+        /usr/include
+)
+
+find_library(LZ4_LIBRARY
+    NAMES lz4
+    PATHS
+        ${LZ4_ROOT}/lib
+        /usr/local/lib
+        /usr/lib
+        /usr/lib/x86_64-linux-gnu
+)
+
+# Extract version from header
+if(LZ4_INCLUDE_DIR AND EXISTS "${LZ4_INCLUDE_DIR}/lz4.h")
+    file(STRINGS "${LZ4_INCLUDE_DIR}/lz4.h" LZ4_VERSION_MAJOR_LINE REGEX "^#define LZ4_VERSION_MAJOR[ \t]+[0-9]+")
+    file(STRINGS "${LZ4_INCLUDE_DIR}/lz4.h" LZ4_VERSION_MINOR_LINE REGEX "^#define LZ4_VERSION_MINOR[ \t]+[0-9]+")
+    file(STRINGS "${LZ4_INCLUDE_DIR}/lz4.h" LZ4_VERSION_RELEASE_LINE REGEX "^#define LZ4_VERSION_RELEASE[ \t]+[0-9]+")
+
+    if(LZ4_VERSION_MAJOR_LINE AND LZ4_VERSION_MINOR_LINE AND LZ4_VERSION_RELEASE_LINE)
+        string(REGEX REPLACE "^#define LZ4_VERSION_MAJOR[ \t]+([0-9]+).*" "\\1" LZ4_VERSION_MAJOR "${LZ4_VERSION_MAJOR_LINE}")
+        string(REGEX REPLACE "^#define LZ4_VERSION_MINOR[ \t]+([0-9]+).*" "\\1" LZ4_VERSION_MINOR "${LZ4_VERSION_MINOR_LINE}")
+        string(REGEX REPLACE "^#define LZ4_VERSION_RELEASE[ \t]+([0-9]+).*" "\\1" LZ4_VERSION_PATCH "${LZ4_VERSION_RELEASE_LINE}")
+        set(LZ4_VERSION "${LZ4_VERSION_MAJOR}.${LZ4_VERSION_MINOR}.${LZ4_VERSION_PATCH}")
+    endif()
+endif()
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LZ4
+    REQUIRED_VARS 
+        LZ4_INCLUDE_DIR 
+        LZ4_LIBRARY
+    VERSION_VAR LZ4_VERSION
+)
+
+if(LZ4_FOUND)
+    set(LZ4_INCLUDE_DIRS ${LZ4_INCLUDE_DIR})
+    set(LZ4_LIBRARIES ${LZ4_LIBRARY})
+    # Create the LZ4::lz4 target for compatibility with Conan
+    if(NOT TARGET LZ4::lz4)
+        add_library(LZ4::lz4 UNKNOWN IMPORTED)
+        set_target_properties(LZ4::lz4 PROPERTIES
+            IMPORTED_LOCATION "${LZ4_LIBRARY}"
+            INTERFACE_INCLUDE_DIRECTORIES "${LZ4_INCLUDE_DIR}"
+        )
+    endif()
+endif()
+
+mark_as_advanced(LZ4_INCLUDE_DIR LZ4_LIBRARY)
@@ -19,6 +19,7 @@ class LogRescuerConan(ConanFile):
         "with_brotli": [True, False],
         "with_zlib": [True, False],
         "with_zstd": [True, False],
+        "with_lz4": [True, False],
         "build_tests": [True, False],
     }
     default_options = {
@@ -27,11 +28,13 @@ class LogRescuerConan(ConanFile):
         "with_brotli": True,
         "with_zlib": True,
         "with_zstd": True,
+        "with_lz4": True,
         "build_tests": True,
         "openssl/*:shared": False,
         "zlib/*:shared": False,
         "brotli/*:shared": False,
         "zstd/*:shared": False,
+        "lz4/*:shared": False,
     }
     generators = "CMakeDeps", "CMakeToolchain"
     exports_sources = "CMakeLists.txt", "src/*", "include/*", "apps/*", "cmake/*", "README.md", "tests/*"
@@ -39,7 +42,7 @@ class LogRescuerConan(ConanFile):
 
     def validate(self):
         # Ensure we have at least one compression algorithm enabled
-        if not any([self.options.with_brotli, self.options.with_zlib, self.options.with_zstd]):
+        if not any([self.options.with_brotli, self.options.with_zlib, self.options.with_zstd, self.options.with_lz4]):
             raise ValueError("At least one compression algorithm must be enabled")
         check_min_cppstd(self, "17")
 
@@ -61,6 +64,8 @@ class LogRescuerConan(ConanFile):
             self.requires("zlib/1.3")
         if self.options.with_zstd:
             self.requires("zstd/1.5.5")
+        if self.options.with_lz4:
+            self.requires("lz4/1.9.4")
     
     def build_requirements(self):
         # Add gtest as a build requirement if tests are enabled
@@ -75,6 +80,7 @@ class LogRescuerConan(ConanFile):
             "WITH_BROTLI": self.options.with_brotli,
             "WITH_ZLIB": self.options.with_zlib,
             "WITH_ZSTD": self.options.with_zstd,
+            "WITH_LZ4": self.options.with_lz4,
             "BUILD_TESTS": self.options.build_tests
         }
         
@@ -110,3 +116,5 @@ class LogRescuerConan(ConanFile):
             self.cpp_info.defines.append("HAVE_ZLIB")
         if self.options.with_zstd:
             self.cpp_info.defines.append("HAVE_ZSTD")
+        if self.options.with_lz4:
+            self.cpp_info.defines.append("HAVE_LZ4")
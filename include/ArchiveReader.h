@@ -0,0 +1,142 @@
+#ifndef ARCHIVEREADER_H
+#define ARCHIVEREADER_H
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Compressor.h"
+#include "CompressorFactory.h"
+#include "Dictionary.h"
+#include "FileMeta.h"
+#include "IO.h"
+#include "LineStore.h"
+
+namespace compression {
+
+// Base archives a read may pass through before the data, whatever the depth incremental archives were
+// written with; guards against archives that reference each other
+constexpr size_t MAX_BASE_CHAIN = 64;
+
+// Archive section naming the base archive of an incremental archive
+io::Attribute baseArchiveSection(const std::string& baseArchive);
+
+// Base archive named by the sections of an archive, empty for none
+std::string readBaseArchiveSection(const std::vector<io::Attribute>& sections);
+
+// Codec settings needed to decode an entry the way it was written. Dictionaries not embedded in the
+// archive are loaded from the registry, if one is given.
+CompressorSettings decoderSettings(const meta::FileMeta& entry, const DictionaryMap& dictionaries,
+                                   DictionaryRegistry* registry = nullptr);
+
+// Decompresses a standalone stream at the current archive position into output, undoing the line
+// store, timestamp, template, JSON and transcoding stages the entry records. Returns the number of bytes written.
+uint64_t decodeStream(const meta::FileMeta& entry, const Compressor& decompressor, std::istream& archive,
+                      std::ostream& output, const lines::LineDictionary* lineDictionary);
+
+// Decodes the line store of an archive
+lines::LineDictionary readLineStore(std::istream& archive, const lines::LineStoreLocation& location,
+                                    DecompressorCache& decompressors);
+
+// Random access to the entries of an archive: reads the metadata once and decodes single files on
+// demand. A file stored in a solid block costs one decode of that block, not of the whole archive.
+class ArchiveReader {
+public:
+    // registryDir locates dictionaries the archive references instead of embedding, empty for none
+    explicit ArchiveReader(const std::string& archiveFile, const std::string& registryDir = "");
+
+    // All entries in metadata order
+    const std::vector<meta::FileMeta>& entries() const { return metadata; }
+
+    // Archive default codec recorded in the footer
+    CompressionType compressionType() const { return compType; }
+
+    // Finds an entry by its relative path, nullptr if the archive has no such file
+    const meta::FileMeta* find(const std::string& relativePath) const;
+
+    // Decompresses the content of an entry (following duplicates to their original) into output
+    // and returns the number of bytes written
+    uint64_t read(const meta::FileMeta& entry, std::ostream& output);
+
+    // Decompresses the whole solid block holding an entry into output and returns its size, so that
+    // callers visiting many files of one block decode it once
+    uint64_t readBlock(const meta::FileMeta& entry, std::ostream& output);
+
+    // Decompresses a template-encoded entry without restoring its lines, writing its columnar blocks
+    // (in UTF-8 for a transcoded file) to output for a templates::ColumnReader. Returns their size.
+    uint64_t readColumns(const meta::FileMeta& entry, std::ostream& output);
+
+    // Returns the unique entry holding the data of a duplicate, or the entry itself
+    const meta::FileMeta& resolve(const meta::FileMeta& entry) const;
+
+    // Base archive holding the data of base references, empty when the archive is not incremental
+    const std::string& baseArchive() const { return basePath; }
+
+    // Returns the unique entry of this archive holding the data a base reference of an incremental
+    // archive built on it points at; throws when the archive no longer holds that content
+    const meta::FileMeta& findReferenced(const meta::FileMeta& reference) const;
+
+    // Number of base archives a read of the entry passes through before reaching its data
+    size_t referenceDepth(const meta::FileMeta& entry);
+
+private:
+
+    // Decodes a unique entry, first rebuilding the entries a delta chain depends on
+    uint64_t readEntry(const meta::FileMeta& source, std::ostream& output, size_t chainDepth);
+
+    // Returns the reader of the base archive, opening it on first use
+    ArchiveReader& base();
+
+    // Returns the archive's line store, decoding it on first use
+    const lines::LineDictionary& lineStore();
+
+    // Rebuilds a chunked file from the chunk list at the current archive position
+    uint64_t readChunks(const meta::FileMeta& entry, const Compressor& decompressor, std::ostream& output);
+
+
+    std::ifstream archive;
+    CompressionType compType;
+    std::vector<meta::FileMeta> metadata;
+    std::unordered_map<std::string, size_t> pathIndex;  // Relative path to position in metadata
+    std::vector<meta::FileMeta> retainedEntries;  // Replaced entries kept for the delta streams referencing them
+    std::map<std::pair<int64_t, uint64_t>, const meta::FileMeta*> dataIndex;  // Data location to the unique entry holding it
+    DictionaryMap dictionaries;        // Dictionaries embedded in the archive
+    std::unique_ptr<DictionaryRegistry> registry;  // Source of referenced dictionaries, loaded on first use
+    DecompressorCache decompressors;   // One decompressor per codec, window and dictionary
+    std::optional<lines::LineStoreLocation> lineStoreLocation;  // Where the archive keeps its line store, if anywhere
+    std::unique_ptr<lines::LineDictionary> lineDictionary;      // Line store, decoded by the first line-encoded read
+    std::set<int64_t> rawChunkBlocks;       // Offsets of chunk blocks stored without compression
+    std::string registryDir;                // Passed on to the base archive
+    std::string basePath;                   // Base archive of an incremental archive, empty for none
+    std::unique_ptr<ArchiveReader> baseReader;  // Opened by the first read of a base reference
+    size_t chainLevel = 0;                  // Base archives passed through to reach this one
+};
+
+// Readers lent to workers, one archive handle each, created as workers first need them
+class ReaderPool {
+public:
+    ReaderPool(const std::string& archiveFile, const std::string& registryDir)
+        : archiveFile(archiveFile), registryDir(registryDir) {}
+
+    std::unique_ptr<ArchiveReader> acquire();
+
+    void release(std::unique_ptr<ArchiveReader> reader);
+
+private:
+    const std::string archiveFile;
+    const std::string registryDir;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ArchiveReader>> idle;
+};
+
+}  // End of compression namespace
+
+#endif // ARCHIVEREADER_H
@@ -0,0 +1,103 @@
+#ifndef ARCHIVESEARCH_H
+#define ARCHIVESEARCH_H
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LineSplitter.h"
+#include "TimestampCodec.h"
+#include "Transcoder.h"
+
+namespace search {
+
+// What to look for in an archive and where
+struct SearchOptions {
+    std::string pattern;                     // Literal text, or an ECMAScript regex with regex set
+    bool regex = false;
+    bool ignoreCase = false;                 // ASCII case folding for literals, icase for regexes
+    uint64_t maxMatches = 0;                 // Stop after this many matches, 0 for no limit
+    std::vector<std::string> relativePaths;  // Files to search, all of the archive when empty
+    std::string registryDir;                 // Locates dictionaries the archive references, empty for none
+    timestamps::TimeWindow window;           // Lines timed inside this window only, when bounded
+};
+
+// A matching line of an archived file
+struct SearchMatch {
+    std::string relativePath;
+    uint64_t lineNumber;  // 1 for the first line
+    std::string line;     // Without its line break
+};
+
+// Compiled form of a search pattern; safe to share between threads
+class LineMatcher {
+public:
+    explicit LineMatcher(const SearchOptions& options);
+
+    bool matches(std::string_view line) const;
+
+    const timestamps::TimeWindow& window() const { return timeWindow; }
+
+private:
+    std::string literal;  // Lower-cased when ignoring case
+    bool ignoreCase;
+    std::optional<std::regex> expression;
+    timestamps::TimeWindow timeWindow;
+};
+
+// Output stream buffer reporting the lines written to it that match. With a bounded time window, lines
+// are timed by a LineClock and those timed outside the window or not at all are passed over. UTF-16 text
+// is matched in its UTF-8 form. onMatch gets the line number and the line without its break and returns
+// false to stop the search; the buffer then throws SearchStopped, which ends the decode writing to it.
+class MatchingBuffer : public lines::LineSplitter {
+public:
+    using MatchCallback = std::function<bool(uint64_t lineNumber, std::string_view line)>;
+
+    MatchingBuffer(const LineMatcher& matcher, MatchCallback onMatch,
+                   transcoding::Encoding encoding = transcoding::Encoding::NONE);
+
+protected:
+    void onLine(std::string_view line) override;
+
+private:
+    const LineMatcher& matcher;
+    MatchCallback onMatch;
+    uint64_t lineNumber = 0;
+    timestamps::LineClock clock;
+};
+
+// Thrown by MatchingBuffer when the search has found enough
+struct SearchStopped {};
+
+// How much of an archive a search decoded
+struct SearchStats {
+    uint64_t searched = 0;  // Unique files decoded and matched
+    uint64_t skipped = 0;   // Unique files their n-gram filter or time range ruled out
+};
+
+// Receives the matches of a search; called from one thread at a time
+using MatchSink = std::function<void(const SearchMatch& match)>;
+
+// Streams the selected files of an archive through the matcher in parallel on the thread pool, without
+// writing them anywhere. Each solid block and each other stream is decoded once, with duplicates
+// reported under every path holding the content. Literal searches skip files whose n-gram filter
+// rules the pattern out, and time-bounded searches files whose time range misses the window. UTF-16
+// files are matched as UTF-8, whether transcoded when compressed or detected when searched.
+// Streams are searched in archive order, the files of a solid block where its first file is, and the
+// matches of a file reach onMatch once it and the streams before it are searched, ordered by path and
+// line. Matches found ahead are held, up to a bound after which no further stream is started, so
+// results arrive while later files are still decoded. When maxMatches cuts the search short, which
+// matches are kept depends on decoding order.
+SearchStats searchArchive(const std::string& archiveFile, const SearchOptions& options, const MatchSink& onMatch);
+
+// Collects the matches of the search above
+std::vector<SearchMatch> searchArchive(const std::string& archiveFile, const SearchOptions& options,
+                                       SearchStats* stats = nullptr);
+
+}  // namespace search
+
+#endif // ARCHIVESEARCH_H
@@ -0,0 +1,109 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "TimestampCodec.h"
+
+namespace catalog {
+
+// Magic number opening every catalog ("LRCT" in little-endian byte order) and its layout version
+constexpr uint32_t CATALOG_MAGIC = 0x5443524C;
+constexpr uint16_t CATALOG_VERSION = 1;
+
+// An archive the catalog indexes
+struct ArchiveInfo {
+    std::string path;       // Absolute path of the archive
+    uint64_t size = 0;      // Archive size and modification time when indexed, to notice rewritten archives
+    int64_t modified = 0;
+    uint64_t files = 0;     // Entries of the archive
+    int64_t minTimestamp = std::numeric_limits<int64_t>::max();  // Range over its files' time ranges, empty when one has none
+    int64_t maxTimestamp = std::numeric_limits<int64_t>::min();
+};
+
+// An archived file found through the catalog
+struct Location {
+    std::string archive;       // Absolute path of the archive holding it
+    std::string relativePath;
+    std::string hash;          // Content hash, that of the original for a duplicate
+    uint64_t originalSize = 0;
+    int64_t minTimestamp = std::numeric_limits<int64_t>::max();  // Range of its line timestamps, empty when unknown
+    int64_t maxTimestamp = std::numeric_limits<int64_t>::min();
+
+    bool hasTimeRange() const { return minTimestamp <= maxTimestamp; }
+};
+
+// What to look for; criteria given together must all match
+struct LocateQuery {
+    std::string path;               // Relative path, or every path below it when it ends with '/'; empty for any
+    std::string hash;               // Content hash, empty for any
+    timestamps::TimeWindow window;  // Files whose time range may overlap the window, when bounded
+};
+
+// What an update changed
+struct UpdateStats {
+    uint64_t added = 0;      // Archives indexed for the first time
+    uint64_t refreshed = 0;  // Archives indexed again because their size or modification time changed
+    uint64_t unchanged = 0;  // Archives passed in and found as indexed
+    uint64_t removed = 0;    // Archives dropped because their file is gone
+    uint64_t skipped = 0;    // Files under a passed directory that are not archives
+};
+
+// Adds archives to the catalog at catalogFile, creating it when missing. Each path is an archive or a
+// directory searched recursively for archives. Only the footer and metadata of archives that are new
+// or changed are read; archives no longer on disk are dropped. The catalog is rewritten through a
+// temporary file renamed over it, so readers see the old or the new catalog, never a partial one. A
+// lock on <catalogFile>.lock serializes concurrent updates, so none of them is lost.
+UpdateStats updateCatalog(const std::string& catalogFile, const std::vector<std::string>& archivePaths);
+
+// Answers queries from a catalog without loading it: the archive table is read up front, and path and
+// hash lookups binary search sorted indexes on disk, reading a few dozen small records. Time window
+// lookups read the files of archives whose range may overlap the window.
+class CatalogReader {
+public:
+    explicit CatalogReader(const std::string& catalogFile);
+
+    const std::vector<ArchiveInfo>& archives() const { return archiveTable; }
+
+    uint64_t fileCount() const { return entryCount; }
+
+    // Files matching the query, ordered by path and archive for path lookups, by archive otherwise
+    std::vector<Location> locate(const LocateQuery& query);
+
+private:
+    struct Entry;
+
+    Entry readEntry(uint64_t index);
+
+    // Reads count consecutive entries at once
+    std::vector<Entry> readEntries(uint64_t first, uint64_t count);
+
+    // Entry at a position of a sorted index
+    uint64_t readOrder(uint64_t indexOffset, uint64_t position);
+
+    std::string readString(uint64_t offset, uint32_t length);
+
+    Location toLocation(const Entry& entry);
+
+    bool matches(const Entry& entry, const LocateQuery& query);
+
+    // Positions [first, last) of a sorted index whose key equals value, or starts with it when prefix is set
+    std::pair<uint64_t, uint64_t> equalRange(uint64_t indexOffset, const std::string& value, bool byHash, bool prefix);
+
+    std::ifstream catalog;
+    std::vector<ArchiveInfo> archiveTable;
+    std::vector<uint64_t> firstEntries;  // First entry of each archive; entries are grouped by archive
+    uint64_t entryCount = 0;
+    uint64_t entriesOffset = 0;
+    uint64_t pathOrderOffset = 0;
+    uint64_t hashOrderOffset = 0;
+    uint64_t stringsOffset = 0;
+};
+
+}  // namespace catalog
+
+#endif // CATALOG_H
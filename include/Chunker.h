@@ -0,0 +1,75 @@
+#ifndef CHUNKER_H
+#define CHUNKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "IO.h"
+
+namespace chunking {
+
+// Average chunk size used when chunking is requested without a size
+constexpr uint32_t DEFAULT_CHUNK_SIZE = 16 << 10;  // 16KB
+
+// Unique chunks are concatenated into blocks of about this size, each compressed as one stream
+constexpr uint64_t CHUNK_BLOCK_SIZE = 4 << 20;  // 4MB
+
+// Share of a file's bytes that must also occur in the other chunked files for the file to be chunked;
+// the rest keep their own streams and every mode that applies to them
+constexpr double MIN_SHARED_RATIO = 0.25;
+
+// Bounds of a content-defined chunk. Cut points are searched between minSize and maxSize, with a
+// stricter mask before avgSize and a looser one after it so chunk sizes cluster around the average.
+struct ChunkParams {
+    uint32_t minSize;
+    uint32_t avgSize;
+    uint32_t maxSize;
+
+    // Bounds of a quarter and four times the average, the usual FastCDC setting
+    static ChunkParams forAverage(uint32_t avgSize);
+};
+
+// Returns the length of the first chunk of a buffer using FastCDC over a Gear rolling hash. The
+// buffer must hold at least maxSize bytes unless it is the tail of the input.
+size_t cutPoint(const uint8_t* data, size_t size, const ChunkParams& params);
+
+// Splits a stream into content-defined chunks, calling onChunk with each chunk's bytes in order
+void splitStream(std::istream& input, const ChunkParams& params,
+                 const std::function<void(const char* data, size_t size)>& onChunk);
+
+// Location of a chunk inside the archive's chunk store
+struct ChunkRef {
+    int64_t dataOffset;    // Start of the compressed block holding the chunk
+    uint64_t blockOffset;  // Position of the chunk inside the decompressed block
+    uint64_t length;       // Chunk size in bytes
+};
+
+// SHA-256 hash and length of each chunk of a file, in file order
+using FileChunks = std::vector<std::pair<std::string, uint64_t>>;
+
+// Indices of the files worth chunking: those with at least MIN_SHARED_RATIO of their bytes in chunks
+// that other selected files hold too. Files are dropped until every remaining one qualifies.
+std::vector<size_t> selectSharingFiles(const std::vector<FileChunks>& files);
+
+// Archive section marking the chunk block at a data offset as stored without compression
+io::Attribute rawBlockSection(int64_t dataOffset);
+
+// Data offsets of the chunk blocks stored without compression
+std::set<int64_t> readRawBlockSections(const std::vector<io::Attribute>& sections);
+
+// A chunked file is stored as the list of its chunks in file order
+void writeRecipe(std::ostream& stream, const std::vector<ChunkRef>& chunks);
+
+// Reads a chunk list written by writeRecipe
+std::vector<ChunkRef> readRecipe(std::istream& stream);
+
+}  // namespace chunking
+
+#endif // CHUNKER_H
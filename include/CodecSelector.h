@@ -0,0 +1,53 @@
+#ifndef CODECSELECTOR_H
+#define CODECSELECTOR_H
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CompressorFactory.h"
+
+namespace compression {
+
+// Codec and level picked for a file
+struct CodecChoice {
+    CompressionType type;
+    int level;
+};
+
+// Chooses a codec and level per file family by trial-compressing a sample of the
+// first file seen in each family. The choice with the best ratio that still meets
+// the throughput target wins; if nothing is fast enough the fastest candidate is used.
+class CodecSelector {
+public:
+    // throughputTarget is the minimum acceptable compression speed in MB/s
+    explicit CodecSelector(double throughputTarget);
+
+    // Returns the codec to use for a file, evaluating its family on first use
+    CodecChoice select(const std::filesystem::path& filePath, const std::string& relativePath);
+
+    // Trial-compresses a sample with every candidate and returns the best choice
+    CodecChoice evaluate(const std::vector<char>& sample) const;
+
+    // Groups files that are likely to compress alike: same directory, same name with digits
+    // masked, and same order of magnitude in size
+    static std::string familyKey(const std::string& relativePath, uint64_t fileSize);
+
+    // Relative path with digit runs masked, so rotated and per-host files share a pattern
+    static std::string pathPattern(const std::string& relativePath);
+
+    // Bytes read from the head of a file for trial compression
+    static constexpr size_t SAMPLE_SIZE = 1 << 20;  // 1MB
+
+private:
+    const double throughputTarget;
+    std::mutex cacheMutex;                                       // Protects familyChoices
+    std::unordered_map<std::string, CodecChoice> familyChoices;  // Decisions cached per family
+};
+
+}  // End of compression namespace
+
+#endif // CODECSELECTOR_H
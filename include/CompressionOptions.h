@@ -0,0 +1,51 @@
+#ifndef COMPRESSIONOPTIONS_H
+#define COMPRESSIONOPTIONS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CompressorFactory.h"
+
+namespace compression {
+
+// Sentinel worker count sizing codec threads from the thread pool
+constexpr int AUTO_WORKERS = -1;
+
+// Base archives an incremental archive's entries may be resolved through, unless set otherwise
+constexpr int DEFAULT_BASE_DEPTH = 4;
+
+// Solid block size used when solid mode is requested without a size
+constexpr uint64_t DEFAULT_SOLID_BLOCK_SIZE = 4 << 20;  // 4MB
+
+// Settings controlling how an archive is built
+struct CompressionOptions {
+    CompressionType compType = defaultCompressionType();  // Codec used for every file unless adaptive
+    int level = DEFAULT_LEVEL;                             // Codec level, DEFAULT_LEVEL for the codec's default
+    bool adaptive = false;                                 // Pick codec and level per file family by sampling
+    double throughputTarget = 50.0;                        // Minimum compression speed in MB/s for adaptive mode
+    int workers = AUTO_WORKERS;                            // zstd worker threads, 0 to compress on pool threads only
+    bool longDistance = false;                             // zstd long-distance matching
+    int windowLog = 0;                                     // Log2 of the match window, 0 for the codec default
+    uint64_t solidBlockSize = 0;                           // Pack smaller files into shared blocks of this size, 0 disables
+    bool clusterSimilar = false;                           // Order solid blocks by content similarity, not only by name
+    size_t dictionarySize = 0;                             // Train per-family dictionaries of this size, 0 disables
+    std::string dictionaryRegistry;                        // Reuse and store dictionaries here instead of embedding them
+    uint32_t chunkSize = 0;                                // Deduplicate content-defined chunks of this average size, 0 disables
+    uint64_t lineMemory = 0;                               // Deduplicate repeated long lines within this much memory, 0 disables
+    bool transcodeUtf16 = true;                            // Convert UTF-16 text to UTF-8 before compression
+    bool timestampColumns = false;                         // Move leading line timestamps to a delta-encoded column
+    bool templateColumns = false;                          // Store lines as template ids and typed variable columns
+    bool jsonColumns = false;                              // Store JSON-lines records as shapes and per-key columns
+    bool gramFilters = false;                              // Store an n-gram Bloom filter per file so search can skip it
+    bool timeIndex = false;                                // Record each file's range of line timestamps for time-bounded reads
+    int deltaDepth = 0;                                    // Delta encode rotation families in chains this deep, 0 disables
+    std::string catalogFile;                               // Catalog to register the finished archive in, empty for none
+    std::string baseArchive;                               // Reference files found in this archive instead of storing them, empty for none
+    int baseDepth = DEFAULT_BASE_DEPTH;                    // Base archives a reference may pass through before the data
+    std::vector<std::string> files;                        // Files to archive, relative to the input directory; all when empty
+};
+
+}  // End of compression namespace
+
+#endif // COMPRESSIONOPTIONS_H
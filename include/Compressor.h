@@ -1,10 +1,40 @@
 #ifndef COMPRESSOR_H
 #define COMPRESSOR_H
 
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
 
 namespace compression {
 
+// Codec tuning beyond the compression level; codecs ignore settings they do not support
+struct CompressorSettings {
+    int workers = 0;            // Codec-internal worker threads (zstd), 0 compresses on the calling thread
+    bool longDistance = false;  // Long-distance matching for repeats far apart (zstd)
+    int windowLog = 0;          // Log2 of the match window size, 0 for the codec default
+    std::shared_ptr<const std::string> dictionary;  // Trained content primed into the match window, null for none
+};
+
+// Facts about a single input the caller already knows; codecs may use them to tune the stream
+struct StreamHints {
+    uint64_t sizeHint = 0;  // Expected input size in bytes, 0 when unknown (may be stale for growing logs)
+    bool text = false;      // Input is known to be ASCII / UTF-8 text
+};
+
+// Largest window a delta frame may use; reference plus input must fit in it
+constexpr int MAX_DELTA_WINDOW_LOG = 30;  // 1GB
+
+// Smallest window log whose window covers a delta reference followed by the input
+inline int deltaWindowLog(uint64_t referenceSize, uint64_t inputSize) {
+    int windowLog = 10;
+    while (windowLog < MAX_DELTA_WINDOW_LOG && (uint64_t(1) << windowLog) < referenceSize + inputSize) {
+        windowLog++;
+    }
+    return windowLog;
+}
+
 // Interface defining compression operations that concrete compressors must implement
 class Compressor {
 public:
@@ -13,6 +43,25 @@ public:
     // Stream-based compression methods
     virtual void compressStream(std::istream& input, std::ostream& output) const = 0;            
     virtual size_t decompressStream(std::istream& input, std::ostream& output) const = 0;
+
+    // Compression with caller-supplied hints; codecs that cannot use them ignore them
+    virtual void compressStream(std::istream& input, std::ostream& output, const StreamHints& /*hints*/) const {
+        compressStream(input, output);
+    }
+
+    // Delta compression: matches may point into reference, which must be passed again to decode.
+    // Only codecs that can reference external content implement it.
+    virtual bool supportsDelta() const { return false; }
+
+    virtual void compressDelta(std::istream& /*input*/, std::ostream& /*output*/, const std::string& /*reference*/,
+                               const StreamHints& /*hints*/) const {
+        throw std::runtime_error("Delta compression is not supported by this codec");
+    }
+
+    virtual size_t decompressDelta(std::istream& /*input*/, std::ostream& /*output*/,
+                                   const std::string& /*reference*/) const {
+        throw std::runtime_error("Delta decompression is not supported by this codec");
+    }
 };
 
 } // namespace compression
@@ -1,33 +1,87 @@
 #ifndef COMPRESSORFACTORY_H
 #define COMPRESSORFACTORY_H
 
+#include <cstdint>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #include "Compressor.h"
 
 namespace compression {
-    
-// Enumeration of supported compression algorithms
-enum class CompressionType {    
-    #ifdef HAVE_BROTLI  // Conditionally include Brotli if the library is available
-    BROTLI,            // Google's Brotli compression algorithm
-    #endif
-    #ifdef HAVE_ZSTD   // Conditionally include ZStandard if the library is available
-    ZSTD,              // Facebook's ZStandard compression algorithm
-    #endif
-    #ifdef HAVE_ZLIB   // Conditionally include zlib if the library is available
-    ZLIB,              // DEFLATE algorithm implementation
-    #endif
-    NONE              // No compression option
+
+// Enumeration of supported compression algorithms.
+// The numeric values are stored in archives and must stay stable across builds
+// and releases; whether a codec is usable depends on the libraries compiled in.
+enum class CompressionType : uint8_t {
+    NONE = 0,          // No compression, data is stored as-is
+    ZLIB = 1,          // DEFLATE algorithm implementation
+    BROTLI = 2,        // Google's Brotli compression algorithm
+    ZSTD = 3,          // Facebook's ZStandard compression algorithm
+    LZ4 = 4            // LZ4 frame format, favours speed over ratio
 };
 
+// Sentinel level requesting the codec's own default
+constexpr int DEFAULT_LEVEL = std::numeric_limits<int>::min();
+
 // Factory function that creates and returns a compressor instance based on the specified type
-std::unique_ptr<Compressor> createCompressor(CompressionType type);
+std::unique_ptr<Compressor> createCompressor(CompressionType type, int level = DEFAULT_LEVEL,
+                                             const CompressorSettings& settings = {});
+
+// Returns true if the codec was compiled into this build
+bool isCompressionTypeAvailable(CompressionType type);
+
+// Returns all codecs compiled into this build, excluding NONE
+std::vector<CompressionType> availableCompressionTypes();
+
+// Returns true if the codec can be primed with a trained dictionary in this build
+bool supportsDictionary(CompressionType type);
+
+// Returns the codec used when none is requested explicitly (Brotli, then zlib, then zstd, then LZ4)
+CompressionType defaultCompressionType();
+
+// Returns the level a codec uses when DEFAULT_LEVEL is requested
+int defaultCompressionLevel(CompressionType type);
+
+// Returns the inclusive range of valid levels for a codec
+std::pair<int, int> compressionLevelRange(CompressionType type);
 
 // Convert CompressionType to string representation
 std::string CompressionTypeToString(CompressionType type);
 
+// Parse a case-insensitive codec name ("brotli", "zlib", "zstd", "lz4", "none")
+CompressionType CompressionTypeFromString(const std::string& name);
+
+// Thread-safe cache handing out one shared compressor instance per codec, level and dictionary,
+// all created with the same codec settings
+class CompressorCache {
+public:
+    explicit CompressorCache(const CompressorSettings& settings = {}) : settings(settings) {}
+
+    const Compressor& get(CompressionType type, int level = DEFAULT_LEVEL,
+                          const std::shared_ptr<const std::string>& dictionary = nullptr);
+
+private:
+    const CompressorSettings settings;
+    std::mutex cacheMutex;
+    std::map<std::tuple<CompressionType, int, const std::string*>, std::unique_ptr<Compressor>> compressors;
+};
+
+// Thread-safe cache handing out one shared decompressor per codec, window and dictionary
+class DecompressorCache {
+public:
+    const Compressor& get(CompressionType type, const CompressorSettings& settings);
+
+private:
+    std::mutex cacheMutex;
+    std::map<std::tuple<CompressionType, int, const std::string*>, std::unique_ptr<Compressor>> decompressors;
+};
+
 }  // End of compression namespace
 
 #endif // COMPRESSORFACTORY_H
@@ -0,0 +1,60 @@
+#ifndef CONTENTPROBE_H
+#define CONTENTPROBE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace probe {
+
+// Already-compressed container formats recognised by their leading magic bytes
+enum class KnownFormat {
+    UNKNOWN,    // No known signature found
+    GZIP,       // gzip / zlib-wrapped DEFLATE (.gz)
+    ZSTD,       // ZStandard frame (.zst)
+    BZIP2,      // bzip2 stream (.bz2)
+    XZ,         // xz / LZMA2 container (.xz)
+    LZ4,        // LZ4 frame (.lz4)
+    ZIP,        // PKZIP archive (.zip, .jar)
+    SEVEN_ZIP   // 7-Zip archive (.7z)
+};
+
+// Number of leading bytes sampled when probing a file
+constexpr size_t SAMPLE_SIZE = 65536;
+
+// Shannon entropy (bits per byte) above which data is treated as incompressible
+constexpr double ENTROPY_THRESHOLD = 7.5;
+
+// Fraction of control bytes tolerated in text (stray escape codes, form feeds)
+constexpr double TEXT_CONTROL_RATIO = 0.01;
+
+// What a sample of a file says about how to compress it
+struct FileProfile {
+    bool incompressible = false;  // Already compressed or random-looking
+    bool text = false;            // Plain text (ASCII / UTF-8), no NUL bytes
+};
+
+// Identifies a compressed container format from the first bytes of a file
+KnownFormat detectFormat(const uint8_t* data, size_t size);
+
+// Estimates the order-0 Shannon entropy of a buffer in bits per byte (0.0 - 8.0)
+double estimateEntropy(const uint8_t* data, size_t size);
+
+// Returns true if a buffer is unlikely to shrink under a general purpose codec
+bool isIncompressible(const uint8_t* data, size_t size);
+
+// Returns true if a buffer looks like ASCII or UTF-8 text
+bool isText(const uint8_t* data, size_t size);
+
+// Samples the beginning of a file and classifies its content
+FileProfile probeFile(const std::string& filePath);
+
+// Samples the beginning of a file and returns true if compressing it would be wasted effort
+bool isIncompressibleFile(const std::string& filePath);
+
+// Convert KnownFormat to string representation
+std::string KnownFormatToString(KnownFormat format);
+
+} // namespace probe
+
+#endif // CONTENTPROBE_H
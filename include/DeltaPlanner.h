@@ -0,0 +1,38 @@
+#ifndef DELTAPLANNER_H
+#define DELTAPLANNER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace compression {
+
+// Chain depth used when delta mode is requested without a depth
+constexpr int DEFAULT_DELTA_DEPTH = 4;
+
+// Share of a file's content that must also appear in its neighbour before it is delta encoded
+constexpr double MIN_DELTA_OVERLAP = 0.25;
+
+// Average chunk size used to compare rotation neighbours
+constexpr uint32_t OVERLAP_CHUNK_SIZE = 4 << 10;  // 4KB
+
+// Splits a rotated log name into its family and generation: "app.log.3" is generation 3 of "app.log",
+// while a name without a numeric suffix is generation 0 of its own family
+std::pair<std::string, unsigned> rotationFamily(const std::string& relativePath);
+
+// Share of the bytes of a file found, as content-defined chunks, in a reference file (0.0 - 1.0)
+double contentOverlap(const std::filesystem::path& filePath, const std::filesystem::path& referencePath);
+
+// Plans delta chains through rotation families. Members are ordered from the newest generation down,
+// so the live log stays a plain stream, and each member is encoded against its newer neighbour when
+// enough of its content overlaps. A member that would exceed maxDepth starts a new chain. Returns the
+// reference of every delta-encoded file, both as relative paths.
+std::unordered_map<std::string, std::string>
+planDeltaChains(const std::vector<std::pair<std::filesystem::path, std::string>>& files, int maxDepth);
+
+}  // End of compression namespace
+
+#endif // DELTAPLANNER_H
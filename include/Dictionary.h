@@ -0,0 +1,88 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "IO.h"
+
+namespace compression {
+
+// Dictionaries keyed by id, shared with the compressors that use them
+using DictionaryMap = std::unordered_map<uint32_t, std::shared_ptr<const std::string>>;
+
+// Size of a trained dictionary unless configured otherwise (the zstd default)
+constexpr size_t DEFAULT_DICTIONARY_SIZE = 110 << 10;  // 110KB
+
+// A path family needs at least this many files before a dictionary is trained for it
+constexpr size_t MIN_DICTIONARY_SAMPLES = 8;
+
+// At most this many files of a family are sampled, reading this many leading bytes from each
+constexpr size_t MAX_DICTIONARY_SAMPLES = 1000;
+constexpr size_t DICTIONARY_SAMPLE_SIZE = 128 << 10;  // 128KB
+
+// A dictionary is kept at most this fraction of the sampled bytes, so it costs less than it saves
+constexpr size_t DICTIONARY_SAMPLE_RATIO = 100;
+
+// Files at least this large fill a window on their own and are compressed without a dictionary
+constexpr uint64_t MAX_DICTIONARY_FILE_SIZE = 1 << 20;  // 1MB
+
+// Trains a dictionary of at most maxSize bytes (and at most 1/DICTIONARY_SAMPLE_RATIO of the samples) from samples of one file family; returns an empty
+// string if the samples are unsuitable. Uses ZDICT when zstd is available, otherwise keeps the
+// heads of the samples, which still primes zlib and Brotli windows with typical content.
+std::string trainDictionary(const std::vector<std::string>& samples, size_t maxSize);
+
+// Content-derived dictionary id (leading 32 bits of its SHA-256), never 0 which means no dictionary
+uint32_t dictionaryId(const std::string& content);
+
+// Dictionary id as eight hex digits, used for registry file names and messages
+std::string dictionaryName(uint32_t id);
+
+// Archive section embedding a dictionary
+io::Attribute dictionarySection(uint32_t id, const std::string& content);
+
+// Archive section referencing a dictionary kept in a registry instead of embedding it
+io::Attribute dictionaryReferenceSection(uint32_t id);
+
+// Collects the dictionaries embedded in an archive's sections
+DictionaryMap readDictionarySections(const std::vector<io::Attribute>& sections);
+
+// Local store of dictionaries shared across runs. Each dictionary is a file named after its
+// content-derived id, so identical dictionaries are stored once, and an index maps every path
+// family to the dictionary last trained for it. Dictionaries are read from disk on first use.
+class DictionaryRegistry {
+public:
+    // Opens the registry in directory; the directory is created on the first add
+    explicit DictionaryRegistry(const std::filesystem::path& directory);
+
+    // Id of the dictionary assigned to a path family, 0 if the family has none
+    uint32_t familyDictionary(const std::string& pattern) const;
+
+    // Stores a dictionary unless already present, assigns it to a path family and returns its id
+    uint32_t add(const std::string& pattern, const std::string& content);
+
+    // Returns a dictionary, loading and verifying it on first use; throws if it is missing or corrupt
+    std::shared_ptr<const std::string> load(uint32_t id);
+
+    // Writes the family index back to the registry
+    void save() const;
+
+    const std::filesystem::path& path() const { return directory; }
+
+private:
+    const std::filesystem::path directory;
+    mutable std::mutex registryMutex;         // Protects families and loaded
+    std::map<std::string, uint32_t> families; // Path family pattern to dictionary id
+    DictionaryMap loaded;                     // Dictionaries read or added in this run
+};
+
+}  // End of compression namespace
+
+#endif // DICTIONARY_H
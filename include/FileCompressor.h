@@ -1,30 +1,62 @@
 #ifndef FILECOMPRESSOR_H
 #define FILECOMPRESSOR_H
 
+#include <cstdint>
 #include <string>
 #include <filesystem>
 #include <fstream>
 #include <unordered_map>
 #include <vector>
 
-// forward declarations
-namespace meta {
-class FileMeta;
-}
+#include "FileMeta.h"
+#include "IO.h"
+#include "TimestampCodec.h"
 
 namespace compression {
     
-enum class CompressionType;
+enum class CompressionType : uint8_t;
+struct CompressionOptions;
+struct CompressorSettings;
 class Compressor;
 
+// The existing archive an append adds files to
+struct AppendBase {
+    std::vector<meta::FileMeta> metadata;  // Entries as read from the archive
+    std::vector<io::Attribute> sections;   // Archive-level sections, carried over to the new metadata
+    CompressionType compType;              // Archive default codec recorded in its footer
+};
+
 // Class responsible for compressing and decompressing files
 class FileCompressor {
 public:
     // Compress files from a directory into a single archive file
     static void compress(const std::string& rootDir, const std::string& outputFile, CompressionType compType);
+
+    // Compress files from a directory into a single archive file using the given options
+    static void compress(const std::string& rootDir, const std::string& outputFile, const CompressionOptions& options);
     
-    // Extract files from an archive to the specified output directory
-    static void decompress(const std::string& archiveFile, const std::string& outputDir);
+    // Add the files of a directory to an existing archive without rewriting it. Files whose content is
+    // already archived are stored as duplicates of it, files unchanged under their path are skipped and
+    // changed ones replace their entry; only new data is compressed. It is written past the current
+    // footer, followed by a new metadata section and footer, while a journal keeps readers on the old
+    // footer; an append interrupted by a crash is rolled back by the next one.
+    static void append(const std::string& rootDir, const std::string& archiveFile, const CompressionOptions& options);
+
+    // Extract files from an archive to the specified output directory. registryDir locates
+    // dictionaries the archive references instead of embedding.
+    static void decompress(const std::string& archiveFile, const std::string& outputDir,
+                           const std::string& registryDir = "");
+
+    // Extract selected files from an archive, decoding only the streams that hold them. With a bounded
+    // time window, all files are selected when none are named, and files whose recorded time range misses
+    // the window are skipped; files without a range are extracted. Returns the number of files extracted.
+    static size_t extract(const std::string& archiveFile, const std::string& outputDir,
+                          const std::vector<std::string>& relativePaths, const std::string& registryDir = "",
+                          const timestamps::TimeWindow& window = {});
+
+    // Train a dictionary for every path family of small files in a directory into a dictionary
+    // registry, replacing the family's previous dictionary; returns the number trained
+    static size_t train(const std::string& rootDir, const std::string& registryDir, size_t dictionarySize);
 
     // Calculate hashes for all files and return maps for lookup
     static std::pair<std::unordered_map<std::string, std::string>, std::unordered_map<std::string, std::string>> 
@@ -33,10 +65,20 @@ public:
 
     static std::vector<meta::FileMeta> compressFiles(const std::string& inputDir, std::ofstream& archive,
                                                      CompressionType compType);
+
+    // Compress files into an open archive stream and write the metadata section. With a base, the
+    // stream is positioned past its footer and the metadata also lists the base entries kept.
+    static std::vector<meta::FileMeta> compressFiles(const std::string& inputDir, std::ofstream& archive,
+                                                     const CompressionOptions& options, AppendBase* base = nullptr);
     
-    // Extract files from the archive to the output directory
-    static std::vector<meta::FileMeta>  decompressFiles(const std::string& outputDir, std::ifstream& archive);
+    // Extract files from the archive to the output directory; archiveEnd is the committed archive size,
+    // 0 for the end of the stream
+    static std::vector<meta::FileMeta>  decompressFiles(const std::string& outputDir, std::ifstream& archive,
+                                                        const std::string& registryDir = "", uint64_t archiveEnd = 0);
                         
+    // Resolve codec settings for an archive, sizing codec worker threads against the thread pool
+    static CompressorSettings codecSettings(const CompressionOptions& options, size_t poolThreads);
+
     // Display statistics about the compressed files
     static void displayStats(const std::vector<meta::FileMeta>& metadata);
 };
@@ -1,9 +1,12 @@
 #ifndef FILEMETA_H
 #define FILEMETA_H
 
+#include <limits>
 #include <string>
 #include <cstdint>
 
+#include "CompressorFactory.h"
+
 namespace meta {
 
     // Structure to store file metadata information
@@ -11,15 +14,99 @@ struct FileMeta {
     const int64_t dataOffset;      // Position in the archive where file data begins
     const std::string hash;         // Hash value for data integrity verification
     const std::string relativePath; // Path to the file relative to a base directory
+    const compression::CompressionType codec;  // Codec used for this file's data (NONE when stored as-is)
+    const int32_t level;            // Compression level the codec was run at
+    const uint64_t originalSize;    // Size of the file before compression
+
+    // Optional fields, stored as entry attributes and left at their defaults when absent
+    int32_t windowLog = 0;          // Log2 match window the codec ran with, 0 for its default
+    int64_t blockId = -1;           // Solid block holding the data, -1 when the file is its own stream
+    uint64_t blockOffset = 0;       // Position of the file inside its decompressed solid block
+    uint32_t dictionaryId = 0;      // Dictionary the data was compressed with, 0 for none
+    bool chunked = false;           // Data offset points at a list of deduplicated chunks
+    int64_t deltaReference = -1;    // Data offset of the entry this stream is a delta against, -1 for none
+    bool lineEncoded = false;       // Stream holds references into the line store and literal lines
+    uint8_t textEncoding = 0;       // Encoding the file was transcoded to UTF-8 from, 0 when kept as it is
+    bool timestampEncoded = false;  // Leading timestamps of the lines were moved to a delta-encoded column
+    bool templateEncoded = false;   // Lines were split into template ids and variable columns
+    bool jsonEncoded = false;       // JSON-lines records were split into shapes and per-key columns
+    std::string gramFilter;         // Serialized n-gram Bloom filter of the text, empty for none
+    int64_t minTimestamp = std::numeric_limits<int64_t>::max();  // Earliest leading line timestamp in ms, max when unknown
+    int64_t maxTimestamp = std::numeric_limits<int64_t>::min();  // Latest leading line timestamp in ms, min when unknown
+    int64_t modifiedTime = 0;       // Last write time of the file when archived, 0 when unknown
+    std::string baseEntry;          // Path of the base archive entry holding the data, empty when this archive holds it
 
     // Returns true if this file is duplicate (has no hash stored in archive)
     bool isDuplicate() const {
         return hash.empty();
     }
 
+    // Returns true if the data shares a solid block with other files
+    bool isSolid() const {
+        return blockId >= 0;
+    }
+
+    // Returns true if the file is stored as a list of chunks in the chunk store
+    bool isChunked() const {
+        return chunked;
+    }
+
+    // Returns true if decoding the stream needs the content of another entry
+    bool isDelta() const {
+        return deltaReference >= 0;
+    }
+
+    // Returns true if the decoded stream must be expanded through the archive's line store
+    bool isLineEncoded() const {
+        return lineEncoded;
+    }
+
+    // Returns true if the decoded stream is UTF-8 to be converted back to the file's own encoding
+    bool isTranscoded() const {
+        return textEncoding != 0;
+    }
+
+    // Returns true if the decoded stream holds text and timestamp columns to be joined back into lines
+    bool isTimestampEncoded() const {
+        return timestampEncoded;
+    }
+
+    // Returns true if the decoded stream holds template and variable columns to be joined back into lines
+    bool isTemplateEncoded() const {
+        return templateEncoded;
+    }
+
+    // Returns true if the decoded stream holds shape and key columns to be joined back into JSON lines
+    bool isJsonEncoded() const {
+        return jsonEncoded;
+    }
+
+    // Returns true if search can rule the file out through its n-gram filter
+    bool hasGramFilter() const {
+        return !gramFilter.empty();
+    }
+
+    // Returns true if the data is held by the base archive of an incremental archive
+    bool isBaseReference() const {
+        return !baseEntry.empty();
+    }
+
+    // Returns true if the range of the file's line timestamps is known
+    bool hasTimeRange() const {
+        return minTimestamp <= maxTimestamp;
+    }
+
+    // Returns true if some line timestamp of the file may lie in [since, until], always when the range is unknown
+    bool mayOverlap(int64_t since, int64_t until) const {
+        return !hasTimeRange() || (minTimestamp <= until && maxTimestamp >= since);
+    }
+
     FileMeta() = delete;  // Deleted constructor
-    explicit FileMeta(const uint64_t dataOffset, const std::string& hash, const std::string& path) :
-        dataOffset(dataOffset), hash(hash), relativePath(path) {}  // Constructor initializing all fields
+    explicit FileMeta(const uint64_t dataOffset, const std::string& hash, const std::string& path,
+                      compression::CompressionType codec = compression::CompressionType::NONE,
+                      int32_t level = 0, uint64_t originalSize = 0) :
+        dataOffset(dataOffset), hash(hash), relativePath(path), codec(codec),
+        level(level), originalSize(originalSize) {}  // Constructor initializing all fields
 };
 
 }  // End of meta namespace
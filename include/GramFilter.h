@@ -0,0 +1,63 @@
+#ifndef GRAMFILTER_H
+#define GRAMFILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace grams {
+
+// Bytes per n-gram; a literal shorter than this cannot be checked against a filter
+constexpr size_t GRAM_LENGTH = 3;
+
+// Filter bits per distinct n-gram and bit positions set per n-gram, about 1% false positives per n-gram
+constexpr size_t BITS_PER_GRAM = 10;
+constexpr uint8_t HASH_COUNT = 4;
+
+// Bounds of a filter's bit array in bytes; text with more n-grams than the largest filter holds well
+// just gets a less selective filter
+constexpr size_t MIN_FILTER_SIZE = 64;
+constexpr size_t MAX_FILTER_SIZE = 1 << 20;  // 1MB
+
+// Exact set of the n-grams of a text, ASCII letters folded to lower case. N-grams never span a line
+// break, since search matches single lines.
+class GramSet {
+public:
+    GramSet();
+
+    // Adds the n-grams of the next bytes of the text
+    void add(const char* data, size_t size);
+
+    // Number of distinct n-grams seen
+    size_t count() const;
+
+    bool contains(uint32_t gram) const { return (bits[gram >> 6] >> (gram & 63)) & 1; }
+
+    // Calls visit with each n-gram of the set, packed big-endian into the low bytes
+    template<typename Visitor>
+    void forEach(Visitor visit) const {
+        for (size_t word = 0; word < bits.size(); word++) {
+            for (uint64_t rest = bits[word]; rest != 0; rest &= rest - 1) {
+                visit(static_cast<uint32_t>(word * 64 + static_cast<size_t>(__builtin_ctzll(rest))));
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t> bits;  // One bit per possible n-gram
+    uint32_t window = 0;         // Last GRAM_LENGTH bytes
+    size_t run = 0;              // Bytes since the last line break
+};
+
+// Builds a Bloom filter over a set of n-grams, serialized as a uint8 hash count followed by the bit array
+std::string buildFilter(const GramSet& grams);
+
+// Returns false only if text with this filter cannot contain the literal in any line, matching letters
+// with or without case. Literals too short to check and empty or malformed filters give true.
+bool mayContain(std::string_view filter, std::string_view literal);
+
+}  // namespace grams
+
+#endif // GRAMFILTER_H
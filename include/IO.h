@@ -1,9 +1,13 @@
 #ifndef IO_H
 #define IO_H
 
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <stdexcept>
 #include <fstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 // Forward declarations
@@ -12,11 +16,95 @@ class FileMeta;
 }
 
 namespace compression {
-enum class CompressionType;
+enum class CompressionType : uint8_t;
 }
 
 namespace io {
 
+    // Magic number closing every archive ("LRSC" in little-endian byte order)
+    constexpr uint32_t ARCHIVE_MAGIC = 0x4353524C;
+
+    // Current archive layout version; version 1 was the original unversioned layout, and version 3 marks
+    // must-understand attribute tags, which version 2 readers would have skipped
+    constexpr uint16_t FORMAT_VERSION = 3;
+
+    // Magic number opening an append journal ("LRJN" in little-endian byte order)
+    constexpr uint32_t JOURNAL_MAGIC = 0x4E4A524C;
+
+    // Tagged extension record: archive sections and per-entry attributes are stored as
+    // (tag, payload) pairs so readers can skip records they do not understand
+    using Attribute = std::pair<uint16_t, std::string>;
+
+    // Bit set on the stored tag of a record that changes how data must be decoded. Readers skip unknown
+    // records without it and reject archives holding unknown records with it, instead of writing wrong
+    // output; new tags that change decoding set it rather than bumping FORMAT_VERSION.
+    constexpr uint16_t TAG_MUST_UNDERSTAND = 0x8000;
+
+    // Attribute tags understood by this version
+    enum AttributeTag : uint16_t {
+        TAG_WINDOW_LOG = 1,    // Entry: int32 log2 window size the codec was configured with
+        TAG_BLOCK_ID = 2,      // Entry: uint32 id of the solid block holding the data
+        TAG_BLOCK_OFFSET = 3,  // Entry: uint64 position of the data inside its decompressed block
+        TAG_DICTIONARY_ID = 4, // Entry: uint32 id of the dictionary the data was compressed with
+        TAG_DICTIONARY = 5,    // Archive: uint32 dictionary id followed by the dictionary content
+        TAG_DICTIONARY_REF = 6,// Archive: uint32 id of a dictionary kept in a dictionary registry
+        TAG_CHUNKED = 7,       // Entry: no payload; the data offset points at a chunk list instead of a stream
+        TAG_DELTA_REFERENCE = 8,// Entry: int64 data offset of the entry the stream was delta encoded against
+        TAG_LINE_STORE = 9,    // Archive: int64 offset, uint64 size, uint8 codec and int32 window log of the line store
+        TAG_LINE_ENCODED = 10, // Entry: no payload; the stream decodes to line store records instead of the file
+        TAG_TEXT_ENCODING = 11,// Entry: uint8 encoding the file was transcoded to UTF-8 from before compression
+        TAG_TIMESTAMP_ENCODED = 12,// Entry: no payload; leading timestamps were split into a delta-encoded column
+        TAG_TEMPLATE_ENCODED = 13,// Entry: no payload; lines were split into template ids and variable columns
+        TAG_JSON_ENCODED = 14, // Entry: no payload; JSON-lines records were split into shapes and per-key columns
+        TAG_GRAM_FILTER = 15,  // Entry: uint8 hash count and the bit array of a Bloom filter over the text's n-grams
+        TAG_TIME_RANGE = 16,   // Entry: int64 earliest and int64 latest leading line timestamp in milliseconds
+        TAG_MODIFIED_TIME = 17,// Entry: int64 last write time of the file when archived, in file clock ticks
+        TAG_BASE_ENTRY = 18,   // Entry: path of the entry of the base archive holding the data
+        TAG_BASE_ARCHIVE = 19, // Archive: absolute path of the base archive base entries point into
+        TAG_RETAINED_ENTRY = 20,// Archive: an entry an append replaced, written as in the metadata, kept because
+                               // delta streams still reference its data
+        TAG_RAW_CHUNK_BLOCK = 21,// Archive: int64 data offset of a chunk block stored without compression
+        TAG_LAST = TAG_RAW_CHUNK_BLOCK
+    };
+
+    // Whether a tag of this version changes decoding, so it is stored with TAG_MUST_UNDERSTAND. Only
+    // n-gram filters, time ranges and modification times can be ignored: they only let readers skip work.
+    inline bool mustUnderstand(uint16_t tag) {
+        return tag != TAG_GRAM_FILTER && tag != TAG_TIME_RANGE && tag != TAG_MODIFIED_TIME;
+    }
+
+    // Packs a POD value into an attribute payload
+    template<typename T>
+    std::string encodeValue(const T& value) {
+        return std::string(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // Unpacks a POD value from an attribute payload
+    template<typename T>
+    T decodeValue(const std::string& payload) {
+        if (payload.size() != sizeof(T)) {
+            throw std::runtime_error("Invalid archive: malformed attribute payload");
+        }
+        T value;
+        std::memcpy(&value, payload.data(), sizeof(T));
+        return value;
+    }
+
+    // Appends a value as a little-endian base-128 varint
+    void appendVarint(std::string& output, uint64_t value);
+
+    // Reads a varint from [pos, end) and advances pos past it; returns false if it is cut short or overlong
+    bool readVarint(const char*& pos, const char* end, uint64_t& value);
+
+    // Maps signed values to unsigned ones so that values near zero make short varints
+    inline uint64_t zigzagEncode(int64_t value) {
+        return static_cast<uint64_t>(value) << 1 ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    inline int64_t zigzagDecode(uint64_t value) {
+        return static_cast<int64_t>(value >> 1 ^ (~(value & 1) + 1));
+    }
+
     // Checks for stream errors and throws exceptions when necessary
     void checkErrors(const std::ios& stream, const std::string& operation);
 
@@ -36,7 +124,7 @@ namespace io {
     // Safely reads a Plain Old Data type from an input stream
     template<typename T>
     typename std::enable_if<!std::is_const<T>::value>::type
-    read(std::ifstream& stream, T& data) {
+    read(std::istream& stream, T& data) {
         stream.read(reinterpret_cast<char*>(&data), sizeof(T));
         checkErrors(stream, "Read");
         checkReadSize(sizeof(T), stream.gcount());
@@ -44,14 +132,14 @@ namespace io {
 
     // Safely writes a POD type to an output stream
     template<typename T>
-    void write(std::ofstream& stream, const T& data) {
+    void write(std::ostream& stream, const T& data) {
         stream.write(reinterpret_cast<const char*>(&data), sizeof(T));
         checkErrors(stream, "Write");
     }
 
     // Reads a block of POD data into a pre-allocated buffer
     template<typename T>
-    void readBuffer(std::ifstream& stream, T* data, uint64_t size) {
+    void readBuffer(std::istream& stream, T* data, uint64_t size) {
         stream.read(reinterpret_cast<char*>(data), size);
         checkErrors(stream, "Read");
         checkReadSize(size, stream.gcount());
@@ -59,31 +147,64 @@ namespace io {
 
     // Writes a block of POD data from a buffer to an output stream
     template<typename T>
-    void writeBuffer(std::ofstream& stream, const T* data, uint64_t size) {
+    void writeBuffer(std::ostream& stream, const T* data, uint64_t size) {
         stream.write(reinterpret_cast<const char*>(data), size);
         checkErrors(stream, "Write");
     }
 
     // Writes a string to an output stream
-    void write(std::ofstream &stream, const std::string &str);
+    void write(std::ostream &stream, const std::string &str);
 
     // Reads a string from an input stream
-    void read(std::ifstream &stream, std::string &str);
-    
+    void read(std::istream &stream, std::string &str);
+
+    // Writes a list of tagged extension records
+    void writeAttributes(std::ostream& stream, const std::vector<Attribute>& attributes);
+
+    // Reads a list of tagged extension records, returning known tags without TAG_MUST_UNDERSTAND;
+    // throws when a record this version does not know is marked must-understand
+    std::vector<Attribute> readAttributes(std::istream& stream);
+
     // Writes footer to the stream
-    void writeFooter(std::ofstream& stream, compression::CompressionType compType, uint64_t uniqueCount, uint64_t duplicateCount, uint64_t metaOffset);
-
-    // Reads footer from the stream
-    void readFooter(std::ifstream& stream, compression::CompressionType& compType, uint64_t& uniqueCount, uint64_t& duplicateCount, uint64_t& metaOffset);
-
-    // Reads file metadata from an input stream
-    meta::FileMeta read(std::ifstream &archive);
-    
-    // Writes metadata to the stream
-    void writeMetadata(std::ofstream& archive, const std::vector<meta::FileMeta>& metadata, compression::CompressionType compType);
-    
-    // Reads metadata from the stream
-    std::vector<meta::FileMeta> readMetadata(std::ifstream& archive, compression::CompressionType& compType);
+    void writeFooter(std::ostream& stream, compression::CompressionType compType, uint64_t uniqueCount, uint64_t duplicateCount, uint64_t metaOffset);
+
+    // Reads footer from the stream, rejecting foreign files and unsupported format versions. The footer
+    // ends at archiveEnd, or at the end of the stream when it is 0.
+    void readFooter(std::istream& stream, compression::CompressionType& compType, uint64_t& uniqueCount, uint64_t& duplicateCount, uint64_t& metaOffset,
+                    uint64_t archiveEnd = 0);
+
+    // Writes metadata to the stream, preceded by archive-level sections
+    void writeMetadata(std::ostream& archive, const std::vector<meta::FileMeta>& metadata, compression::CompressionType compType,
+                       const std::vector<Attribute>& sections = {});
+
+    // Reads metadata from the stream, optionally returning the archive-level sections. archiveEnd is
+    // passed on to readFooter.
+    std::vector<meta::FileMeta> readMetadata(std::istream& archive, compression::CompressionType& compType,
+                                             std::vector<Attribute>* sections = nullptr, uint64_t archiveEnd = 0);
+
+    // Section keeping a replaced entry whose data delta streams still reference
+    Attribute retainedEntrySection(const meta::FileMeta& meta);
+
+    // Entries kept by retained entry sections, in section order
+    std::vector<meta::FileMeta> readRetainedEntries(const std::vector<Attribute>& sections);
+
+    // Path of the journal kept next to an archive while an append writes past its footer
+    std::string journalPath(const std::string& archiveFile);
+
+    // Records that the archive is complete up to committedSize before an append writes past it. The
+    // journal is written to a temporary file renamed into place, so it is either absent or whole.
+    void writeJournal(const std::string& archiveFile, uint64_t committedSize);
+
+    // Size of the archive as of its last complete write: the size a pending append journal records, or
+    // the file size. Readers end the archive there, so they see the footer an unfinished append left valid.
+    uint64_t committedSize(const std::string& archiveFile);
+
+    // Undoes an unfinished append, cutting the archive back to its committed size and removing the
+    // journal; returns true when there was one
+    bool rollBackAppend(const std::string& archiveFile);
+
+    // Last write time of a file in file clock ticks, to tell whether it changed since it was archived
+    int64_t modificationTime(const std::filesystem::path& path);
 
     // Recursively scan a directory and return all file paths
     std::vector<std::filesystem::path> scanDirectory(const std::string& rootDir, bool skipEmptyFiles = true);
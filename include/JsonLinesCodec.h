@@ -0,0 +1,128 @@
+#ifndef JSONLINESCODEC_H
+#define JSONLINESCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace jsonlines {
+
+// Input bytes per encoded block; each block stores its columns one after another
+constexpr size_t JSON_BLOCK_SIZE = 1 << 20;  // 1MB
+
+// Shapes and keys a stream may define; records needing more are stored raw
+constexpr uint32_t MAX_SHAPES = 1 << 16;
+constexpr uint32_t MAX_KEYS = 1 << 16;
+
+// Longest shape and most fields kept; larger records are stored raw
+constexpr size_t MAX_SHAPE_LENGTH = 4096;
+constexpr size_t MAX_FIELDS = 256;
+
+// Shape id of a line stored raw
+constexpr uint32_t RAW_LINE = 0;
+
+// Placeholders standing for the values of a record in its shape. Control bytes cannot occur unescaped
+// in JSON text, so they never clash with the bytes kept in a shape.
+constexpr char STRING_PLACEHOLDER = '\x11';   // Bytes between the quotes of a string value
+constexpr char INTEGER_PLACEHOLDER = '\x12';  // Decimal integer, delta encoded against the key's last one
+constexpr char LITERAL_PLACEHOLDER = '\x13';  // Any other value: number, true, false, null, object or array
+
+// Sections of a block stored ahead of its key columns
+enum Column : size_t {
+    COLUMN_KEYS,       // Keys first used in this block: varint length and bytes each
+    COLUMN_SHAPES,     // Shapes first used in this block: varint length, bytes and key id per value each
+    COLUMN_SHAPE_IDS,  // Varint shape id per line, RAW_LINE for a raw line
+    COLUMN_RAW,        // Varint length and bytes per raw line
+    COLUMN_COUNT
+};
+
+// A value of a record and the key it belongs to
+struct Field {
+    std::string_view key;   // Key bytes between the quotes, escapes kept as they are
+    char type;              // Placeholder of the value in the shape
+    std::string_view text;  // Value bytes, without the quotes of a string
+    int64_t integer = 0;    // Value of an integer
+};
+
+// A line split into its shape and values
+struct ParsedRecord {
+    std::string shape;          // Line with placeholders for the values
+    std::vector<Field> fields;  // Values in line order
+};
+
+// Splits a line holding one JSON object into its shape and the values of its top-level keys. The
+// shape keeps the braces, keys, separators and whitespace byte for byte, so joining it with the values
+// gives back the line. Returns false for a line that is not such an object and is stored raw.
+bool parseRecord(std::string_view line, ParsedRecord& parsed);
+
+// Returns true if the lines of a sample are mostly JSON objects of a few shapes
+bool hasJsonLines(const char* data, size_t size);
+
+// Input stream buffer yielding the columnar form of a source stream. Each block starts with a uint32
+// line count, the uint32 size of each Column and the uint32 number of key columns, then a uint32 key
+// id and size per key column, followed by the Columns in order and the key columns in order. A key
+// column holds the values of its key in line order: varint length and bytes for strings and literals,
+// zigzag varint difference to the key's previous integer in the block for integers.
+class EncodingBuffer : public std::streambuf {
+public:
+    explicit EncodingBuffer(std::istream& source);
+
+protected:
+    int_type underflow() override;
+
+private:
+    struct ShapeEntry {
+        uint32_t id;
+        std::vector<uint32_t> keyIds;  // Key of each value in line order
+    };
+
+    std::istream& source;
+    std::vector<char> input;  // Source bytes, a partial line carried over from the last block first
+    size_t buffered = 0;
+    std::unordered_map<std::string, uint32_t> keyIds;    // Keys defined so far
+    std::unordered_map<std::string, ShapeEntry> shapes;  // Shapes defined so far
+    std::string encoded;      // Block handed out to the reader
+};
+
+// Output stream buffer restoring the lines of a columnar stream into a target stream. Throws on a
+// malformed block; finish checks that the stream did not end inside one.
+class DecodingBuffer : public std::streambuf {
+public:
+    explicit DecodingBuffer(std::ostream& target);
+
+    // Throws if a block was cut short
+    void finish() const;
+
+    // Bytes written to the target
+    uint64_t written() const { return restored; }
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* data, std::streamsize size) override;
+
+private:
+    struct Shape {
+        std::string text;
+        std::vector<uint32_t> keyIds;  // Key of each placeholder in text
+    };
+
+    // Restores every complete block in pending
+    void decodeBlocks();
+
+    std::ostream& target;
+    std::string pending;         // Bytes of a block not yet complete
+    uint32_t keyCount = 0;       // Keys defined so far
+    std::vector<Shape> shapes;   // Shapes defined so far, id 1 first
+    std::string decoded;         // Lines of the block being restored
+    uint64_t restored = 0;
+};
+
+}  // namespace jsonlines
+
+#endif // JSONLINESCODEC_H
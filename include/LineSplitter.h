@@ -0,0 +1,48 @@
+#ifndef LINESPLITTER_H
+#define LINESPLITTER_H
+
+#include <cstdint>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+#include "Transcoder.h"
+
+namespace lines {
+
+// Output stream buffer cutting the bytes written to it into lines, each handed to onLine without its
+// break. UTF-16 text is cut in its UTF-8 form, with the encoding given or detected from the first bytes.
+class LineSplitter : public std::streambuf {
+public:
+    explicit LineSplitter(transcoding::Encoding encoding = transcoding::Encoding::NONE);
+
+    // Detects UTF-16 from the first bytes written, as compression does for a file of this size, instead
+    // of taking the encoding given at construction
+    void detectEncoding(uint64_t fileSize);
+
+    // Hands over a last line that has no line break
+    void finish();
+
+protected:
+    virtual void onLine(std::string_view line) = 0;
+
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* data, std::streamsize size) override;
+
+private:
+    // Converts the carried bytes to UTF-8 and cuts them, keeping a split code unit unless final
+    void convertCarried(bool final);
+
+    // Cuts the complete lines of UTF-8 text, keeping the start of an unfinished one
+    void scan(const char* data, size_t size);
+
+    transcoding::Encoding encoding;
+    bool detecting = false;  // Collecting the sample to detect the encoding from
+    std::string carried;     // Sample bytes, or UTF-16 bytes of a code unit or surrogate pair split across writes
+    std::string converted;   // UTF-8 form of the last write
+    std::string partial;     // Start of a line whose break is still to come
+};
+
+}  // namespace lines
+
+#endif // LINESPLITTER_H
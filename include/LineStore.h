@@ -0,0 +1,192 @@
+#ifndef LINESTORE_H
+#define LINESTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CompressorFactory.h"
+#include "IO.h"
+
+namespace lines {
+
+// Shortest line worth storing once; a reference costs five bytes
+constexpr size_t MIN_LINE_LENGTH = 32;
+
+// Longest line kept in the store; longer lines pass through as literals in pieces of this size
+constexpr size_t MAX_LINE_LENGTH = 64 << 10;  // 64KB
+
+// Memory for the line table and the stored lines when line mode is requested without a limit
+constexpr uint64_t DEFAULT_LINE_MEMORY = 256 << 20;  // 256MB
+
+// Longest literal record; consecutive unmatched lines are merged up to this size
+constexpr uint32_t MAX_LITERAL_SIZE = 1 << 20;  // 1MB
+
+// Record kinds of a line-encoded stream. A literal is a uint32 length and that many bytes, a
+// reference is the uint32 id of a stored line.
+enum RecordKind : uint8_t {
+    RECORD_LITERAL = 0,
+    RECORD_REFERENCE = 1,
+};
+
+// Splits a stream into lines including their newline. A line longer than MAX_LINE_LENGTH is
+// returned in pieces, and the last line may lack a newline.
+class LineReader {
+public:
+    explicit LineReader(std::istream& input);
+
+    // Sets line to the next line, valid until the next call; false at the end of the stream
+    bool next(std::string_view& line);
+
+private:
+    std::istream& input;
+    std::vector<char> buffer;
+    size_t start = 0;
+    size_t end = 0;
+    bool eof = false;
+};
+
+// Open-addressing hash table of line hashes with linear probing. Slots are 16 bytes, four to a
+// cache line, and the table never grows: it takes the largest power of two of slots that fits its
+// memory budget and stops accepting new hashes at three quarters full.
+class LineTable {
+public:
+    static constexpr uint32_t NO_LINE = UINT32_MAX;
+
+    struct Slot {
+        uint64_t hash = 0;          // Line hash, 0 for an empty slot
+        uint32_t count = 0;         // Times the line was seen, saturating
+        uint32_t lineId = NO_LINE;  // Id in the line store, NO_LINE while not stored
+    };
+
+    explicit LineTable(uint64_t memoryLimit);
+
+    // Returns the slot of a hash, claiming an empty one for a new hash; nullptr once the table is full
+    Slot* insert(uint64_t hash);
+
+    // Returns the slot of a hash, nullptr if the table does not hold it
+    const Slot* find(uint64_t hash) const;
+
+    size_t size() const { return used; }
+    size_t capacity() const { return slots.size(); }
+
+private:
+    std::vector<Slot> slots;
+    size_t mask;
+    size_t used = 0;
+};
+
+// Lines of a line store by id. Every stored line ends in a newline, so the concatenated content is
+// all a reader needs to rebuild the ids.
+class LineDictionary {
+public:
+    LineDictionary() = default;
+
+    // Splits stored content into its lines; throws if the content does not end in a newline
+    explicit LineDictionary(std::string content);
+
+    std::string_view line(uint32_t id) const {
+        return std::string_view(content.data() + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+    // Concatenated lines in id order
+    const std::string& data() const { return content; }
+
+protected:
+    // Appends a line, which must end in a newline, and returns its id
+    uint32_t append(std::string_view line);
+
+private:
+    std::string content;
+    std::vector<uint64_t> offsets;  // Start of each line, followed by the end of the last
+};
+
+// Shared store of long lines repeated across files, built in one pass over them. A line is counted
+// the first time it is seen and stored the second time, so lines that occur once cost a table slot
+// but no store space. Table and stored lines together stay within the memory limit; once either is
+// full, further lines are simply not deduplicated.
+class LineStore : public LineDictionary {
+public:
+    explicit LineStore(uint64_t memoryLimit);
+
+    // Counts the lines of a stream, storing those seen for the second time
+    void scan(std::istream& input);
+
+    // Id of a stored line, LineTable::NO_LINE if it is not in the store
+    uint32_t find(std::string_view line) const;
+
+    const LineTable& table() const { return lineTable; }
+
+private:
+    LineTable lineTable;
+    uint64_t storeLimit;  // Bytes left for stored lines and their offsets
+    uint64_t storeUsed = 0;
+};
+
+// Input stream buffer yielding the line-encoded form of a source stream: runs of lines not in the
+// store become literal records and stored lines become references
+class EncodingBuffer : public std::streambuf {
+public:
+    EncodingBuffer(std::istream& source, const LineStore& store);
+
+protected:
+    int_type underflow() override;
+
+private:
+    LineReader reader;
+    const LineStore& store;
+    std::string literal;  // Unmatched lines waiting for a literal record
+    std::string encoded;  // Records handed out to the reader
+};
+
+// Output stream buffer expanding a line-encoded stream into a target stream. Throws on a malformed
+// record; finish checks that the stream did not end inside one.
+class DecodingBuffer : public std::streambuf {
+public:
+    DecodingBuffer(std::ostream& target, const LineDictionary& dictionary);
+
+    // Throws if a record was cut short
+    void finish() const;
+
+    // Bytes written to the target
+    uint64_t written() const { return expanded; }
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* data, std::streamsize size) override;
+
+private:
+    // Expands every complete record in pending
+    void decodeRecords();
+
+    std::ostream& target;
+    const LineDictionary& dictionary;
+    std::string pending;  // Bytes of records not yet complete
+    uint64_t expanded = 0;
+};
+
+// Where the line store of an archive is kept: a compressed stream in the data area
+struct LineStoreLocation {
+    int64_t dataOffset;                  // Position of the compressed store
+    uint64_t size;                       // Size of the decompressed store
+    compression::CompressionType codec;  // Codec the store was compressed with
+    int32_t windowLog;                   // Window the codec ran with, 0 for its default
+};
+
+// Archive section locating the line store
+io::Attribute lineStoreSection(const LineStoreLocation& location);
+
+// Finds the line store section among an archive's sections
+std::optional<LineStoreLocation> readLineStoreSection(const std::vector<io::Attribute>& sections);
+
+}  // namespace lines
+
+#endif // LINESTORE_H
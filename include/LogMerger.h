@@ -0,0 +1,115 @@
+#ifndef LOGMERGER_H
+#define LOGMERGER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "TimestampCodec.h"
+
+namespace merge {
+
+// Inputs decoded at once by default; when more of them overlap in time, they are merged in rounds
+// through temporary run files
+constexpr size_t DEFAULT_FAN_IN = 64;
+
+// Bytes of records an input hands to the merge at a time, and batches it decodes ahead of it
+constexpr size_t MERGE_BATCH_SIZE = 256 << 10;  // 256KB
+constexpr size_t MERGE_QUEUE_DEPTH = 4;
+
+// What to merge and how
+struct MergeOptions {
+    std::vector<std::string> relativePaths;  // Files to merge, all of the archive when empty
+    std::string registryDir;                 // Locates dictionaries the archive references, empty for none
+    timestamps::TimeWindow window;           // Records timed inside this window only, when bounded
+    bool labelLines = false;                 // Prefix every line with the path of its file and ':'
+    size_t fanIn = DEFAULT_FAN_IN;           // Inputs decoded at once, at least 2
+    std::filesystem::path tempDir;           // Where run files go, the system temporary directory when empty
+};
+
+// What a merge read and wrote
+struct MergeStats {
+    uint64_t files = 0;    // Archived files merged
+    uint64_t skipped = 0;  // Files whose time range missed the window
+    uint64_t records = 0;  // Records written
+    uint64_t runs = 0;     // Temporary runs written by earlier rounds
+};
+
+// Records of one input: a timestamped line with the lines that follow it up to the next timestamp. A
+// producer fills them on a thread of its own, at most MERGE_QUEUE_DEPTH batches ahead of the reader.
+class RecordStream {
+public:
+    // Adds the records of an input through add; stops early when add throws Cancelled
+    using Producer = std::function<void(RecordStream&)>;
+
+    // Thrown by add when the reader is gone
+    struct Cancelled {};
+
+    explicit RecordStream(Producer producer);
+
+    // Cancels the producer and waits for it
+    ~RecordStream();
+
+    RecordStream(const RecordStream&) = delete;
+    RecordStream& operator=(const RecordStream&) = delete;
+
+    // Producer side: appends a record of the file at position order among the merged files, waiting
+    // while the queue is full
+    void add(int64_t time, size_t order, std::string_view text);
+
+    // Reader side: moves to the next record, false at the end. Rethrows an error of the producer.
+    bool next();
+
+    int64_t time() const { return current.times[position]; }
+    size_t order() const { return current.orders[position]; }
+    std::string_view text() const;
+
+private:
+    // Records handed over together
+    struct Batch {
+        std::string text;
+        std::vector<int64_t> times;
+        std::vector<size_t> orders;  // Position of each record's file, which breaks ties between equal times
+        std::vector<size_t> ends;  // End of each record in text
+    };
+
+    void produce(const Producer& producer);
+
+    // Queues the batch being filled, waiting for room
+    void flush();
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Batch> queue;
+    bool done = false;       // The producer added its last record
+    bool cancelled = false;  // The reader is gone
+    std::exception_ptr error;
+    Batch filling;           // Producer side
+    Batch current;           // Reader side
+    size_t position = 0;     // Current record in current, one past it before the first next
+    bool started = false;
+    std::thread producerThread;
+};
+
+// Writes the records of the selected files of an archive to output in timestamp order, ties kept in
+// archive order, or in the order the files were named when relativePaths is set. Each line is timed by a LineClock, so multi-line records stay whole; lines ahead of a
+// file's first timestamp go with the start of its recorded time range, or first when it has none.
+// Files are decoded in parallel, each on a thread of its own and only when the merge reaches the
+// start of its time range, so rotated logs recorded by the time index are decoded a few at a time.
+// When more than fanIn files may overlap, groups of fanIn files are first merged into temporary runs.
+// UTF-16 files are merged in their UTF-8 form.
+MergeStats mergeArchive(const std::string& archiveFile, std::ostream& output, const MergeOptions& options);
+
+}  // namespace merge
+
+#endif // LOGMERGER_H
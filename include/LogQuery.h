@@ -0,0 +1,81 @@
+#ifndef LOGQUERY_H
+#define LOGQUERY_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "TimestampCodec.h"
+
+namespace query {
+
+// What entries can be grouped by besides time
+enum class Field {
+    LEVEL,      // Severity word such as INFO or ERROR among the first words after the timestamp
+    COMPONENT,  // First bracketed name after the timestamp that is not a level
+    TEMPLATE    // The line with its variables replaced, as template mode stores it
+};
+
+// Parses "level", "component" or "template"; throws std::invalid_argument otherwise
+Field parseField(const std::string& name);
+
+// Column heading of a field
+std::string fieldName(Field field);
+
+// Histogram bucket widths
+constexpr int64_t MINUTE_MILLIS = 60 * 1000;
+constexpr int64_t HOUR_MILLIS = 60 * MINUTE_MILLIS;
+constexpr int64_t DAY_MILLIS = 24 * HOUR_MILLIS;
+
+// Value of a field or time bucket an entry does not have
+constexpr const char* NO_VALUE = "-";
+
+// What to count and where
+struct QueryOptions {
+    std::vector<Field> groupBy;              // Fields counted apart, in column order
+    int64_t bucketMillis = 0;                // Width of the time buckets counted apart: a minute, hour or day; 0 for none
+    std::vector<std::string> levels;         // Entries of these levels only, all when empty
+    std::vector<std::string> relativePaths;  // Files to count, all of the archive when empty
+    std::string registryDir;                 // Locates dictionaries the archive references, empty for none
+    timestamps::TimeWindow window;           // Entries timed inside this window only, when bounded
+};
+
+// Entry counts per group
+struct QueryResult {
+    std::vector<std::string> columns;                     // Headings of the key values: time bucket, then the fields
+    std::map<std::vector<std::string>, uint64_t> counts;  // Entries per key, in key order
+};
+
+// How an archive was read to answer a query
+struct QueryStats {
+    uint64_t queried = 0;   // Unique files read
+    uint64_t columnar = 0;  // Of those, template-encoded files read from their columns without restoring lines
+    uint64_t skipped = 0;   // Unique files whose time range missed the window
+};
+
+// The fields of a line, from the template its variables leave when it parses into one or from the line
+// itself otherwise, so template-encoded and plain files give the same answers. The component keeps the
+// line's own bytes, so [worker-3] and [worker-4] are told apart.
+struct LineFields {
+    std::string level;
+    std::string component;
+    std::string templateText;  // Placeholders shown as <time>, <int> and <var>, without the line break
+};
+
+// Fields of a line, with its line break
+LineFields describeLine(std::string_view line);
+
+// Counts the entries of the selected files of an archive in parallel on the thread pool, without
+// writing them anywhere. An entry is a line with a leading timestamp plus the lines after it without
+// one, or a single line ahead of a file's first timestamp; it is timed by its first line. Each solid
+// block and each other stream is decoded once, duplicates counted under every path holding the
+// content. Template-encoded files are read from their template id and timestamp columns alone, and
+// time-bounded queries skip files whose recorded time range misses the window. UTF-16 files are read
+// in their UTF-8 form.
+QueryResult queryArchive(const std::string& archiveFile, const QueryOptions& options, QueryStats* stats = nullptr);
+
+}  // namespace query
+
+#endif // LOGQUERY_H
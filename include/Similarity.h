@@ -0,0 +1,43 @@
+#ifndef SIMILARITY_H
+#define SIMILARITY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace similarity {
+
+// Number of MinHash values kept per file
+constexpr size_t SKETCH_SIZE = 64;
+
+// Locality-sensitive hashing splits a sketch into bands; files agreeing on every value of any band
+// become candidates. 16 bands of 4 rows pair files above roughly 50% estimated similarity.
+constexpr size_t SKETCH_BANDS = 16;
+
+// Bytes read from the head of a file to sketch it
+constexpr size_t SKETCH_SAMPLE_SIZE = 256 << 10;  // 256KB
+
+// Longest piece of a line hashed as one shingle, so binary data without newlines still yields many
+constexpr size_t MAX_SHINGLE_SIZE = 256;
+
+// Smallest hash of each of SKETCH_SIZE independent hash functions over a file's shingles
+using Sketch = std::array<uint64_t, SKETCH_SIZE>;
+
+// Sketches a buffer. Shingles are lines with digit runs masked, so logs that differ only in
+// timestamps, ids and counters sketch alike.
+Sketch sketchBuffer(const char* data, size_t size);
+
+// Sketches the head of a file
+Sketch sketchFile(const std::filesystem::path& filePath);
+
+// Estimated Jaccard similarity of the shingle sets behind two sketches (0.0 - 1.0)
+double estimateSimilarity(const Sketch& a, const Sketch& b);
+
+// Groups near-duplicate sketches; returns a cluster id per sketch, the index of the cluster's first member
+std::vector<size_t> clusterSketches(const std::vector<Sketch>& sketches);
+
+}  // namespace similarity
+
+#endif // SIMILARITY_H
@@ -0,0 +1,151 @@
+#ifndef TEMPLATECODEC_H
+#define TEMPLATECODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace templates {
+
+// Input bytes per encoded block; each block stores its columns one after another
+constexpr size_t TEMPLATE_BLOCK_SIZE = 1 << 20;  // 1MB
+
+// Templates a stream may define; lines needing more are stored raw
+constexpr uint32_t MAX_TEMPLATES = 1 << 16;
+
+// Longest template kept; longer lines are stored raw
+constexpr size_t MAX_TEMPLATE_LENGTH = 1024;
+
+// Template id of a line stored raw
+constexpr uint32_t RAW_LINE = 0;
+
+// Placeholders standing for the variables of a line in its template. A line holding one of these bytes
+// is stored raw.
+constexpr char TIMESTAMP_PLACEHOLDER = '\x11';  // Leading timestamp, from the timestamp column
+constexpr char INTEGER_PLACEHOLDER = '\x12';    // Decimal integer, from the integer column
+constexpr char VARIABLE_PLACEHOLDER = '\x13';   // Other token with a digit, from the block's variable dictionary
+
+// Sections of a block, each stored as one column after the block header
+enum Column : size_t {
+    COLUMN_TEMPLATES,     // Templates first used in this block: varint length and bytes each
+    COLUMN_TEMPLATE_IDS,  // Varint template id per line, RAW_LINE for a raw line
+    COLUMN_TIMESTAMPS,    // Zigzag varint difference to the previous timestamp, per timestamped line
+    COLUMN_INTEGERS,      // Varint per integer variable
+    COLUMN_VARIABLES,     // Distinct other variables of the block: varint length and bytes each
+    COLUMN_VARIABLE_IDS,  // Varint index into the block's variables, per other variable
+    COLUMN_RAW,           // Varint length and bytes per raw line
+    COLUMN_COUNT
+};
+
+// A line split into its template and variables
+struct ParsedLine {
+    std::string text;                       // Template, with placeholders for the variables
+    bool timestamped = false;
+    int64_t timestamp = 0;                  // Milliseconds since 1970-01-01
+    std::vector<uint64_t> integers;         // Integer variables in line order
+    std::vector<std::string_view> variables;  // Other variables in line order
+};
+
+// Splits a line into its template and variables as the encoder does: tokens between delimiters that
+// hold a digit become variables, a leading timestamp goes to the timestamp column and everything else
+// stays in the template. Returns false for a line that cannot be templated and is stored raw.
+bool parseLine(std::string_view line, ParsedLine& parsed);
+
+// Returns true if the lines of a sample mostly share templates, so templating pays off
+bool hasTemplates(const char* data, size_t size);
+
+// Input stream buffer yielding the columnar form of a source stream. Each block starts with a uint32
+// line count and the uint32 size of each column, followed by the columns in Column order.
+class EncodingBuffer : public std::streambuf {
+public:
+    explicit EncodingBuffer(std::istream& source);
+
+protected:
+    int_type underflow() override;
+
+private:
+    std::istream& source;
+    std::vector<char> input;  // Source bytes, a partial line carried over from the last block first
+    size_t buffered = 0;
+    std::unordered_map<std::string, uint32_t> templateIds;  // Templates defined so far
+    int64_t previous = 0;     // Last timestamp, the base of the next delta
+    std::string encoded;      // Block handed out to the reader
+};
+
+// Output stream buffer restoring the lines of a columnar stream into a target stream. Throws on a
+// malformed block; finish checks that the stream did not end inside one.
+class DecodingBuffer : public std::streambuf {
+public:
+    explicit DecodingBuffer(std::ostream& target);
+
+    // Throws if a block was cut short
+    void finish() const;
+
+    // Bytes written to the target
+    uint64_t written() const { return restored; }
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* data, std::streamsize size) override;
+
+private:
+    // Restores every complete block in pending
+    void decodeBlocks();
+
+    std::ostream& target;
+    std::string pending;                 // Bytes of a block not yet complete
+    std::vector<std::string> templates;  // Templates defined so far, id 1 first
+    std::string decoded;                 // Lines of the block being restored
+    int64_t previous = 0;
+    uint64_t restored = 0;
+};
+
+// A line of a columnar stream as ColumnReader hands it out
+struct ColumnLine {
+    uint32_t templateId = RAW_LINE;
+    std::string_view text;     // Template with placeholders, or the line itself when raw
+    bool timestamped = false;  // Starts with a timestamp, taken from the timestamp column or the raw line
+    int64_t timestamp = 0;
+    std::vector<uint64_t> integers;           // Integer variables in line order, when the reader reads them
+    std::vector<std::string_view> variables;  // Other variables in line order, when the reader reads them
+};
+
+// Output stream buffer reading the lines of a columnar stream without restoring them: only the
+// template, template id, timestamp and raw columns are read, so counting lines by template or time
+// skips the variables entirely unless they are asked for. Throws on a malformed block; finish checks
+// that the stream did not end inside one.
+class ColumnReader : public std::streambuf {
+public:
+    using LineCallback = std::function<void(const ColumnLine& line)>;
+
+    // With variables, each templated line also carries its integer and other variables
+    explicit ColumnReader(LineCallback onLine, bool withVariables = false);
+
+    // Throws if a block was cut short
+    void finish() const;
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* data, std::streamsize size) override;
+
+private:
+    // Hands out the lines of every complete block in pending
+    void readBlocks();
+
+    LineCallback onLine;
+    const bool withVariables;
+    std::string pending;                 // Bytes of a block not yet complete
+    std::vector<std::string> templates;  // Templates defined so far, id 1 first
+    int64_t previous = 0;
+};
+
+}  // namespace templates
+
+#endif // TEMPLATECODEC_H
@@ -32,7 +32,10 @@ public:
     ThreadPool& operator=(ThreadPool&&) = delete;
 
     // Get or create the singleton instance with specified thread count
-    static ThreadPool& getInstance(size_t numThreads = std::thread::hardware_concurrency() - 1);
+    static ThreadPool& getInstance(size_t numThreads = defaultThreadCount());
+
+    // Default worker count: one less than the hardware concurrency, but never zero
+    static size_t defaultThreadCount();
 
     // Submit a task to the thread pool and receive a future for the result
     template<class F, class... Args>
@@ -0,0 +1,144 @@
+#ifndef TIMESTAMPCODEC_H
+#define TIMESTAMPCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace timestamps {
+
+// Length of a leading "[YYYY-MM-DD HH:MM:SS.mmm]" timestamp
+constexpr size_t TIMESTAMP_LENGTH = 25;
+
+// Input bytes per encoded block; each block holds its text and its timestamps as separate columns
+constexpr size_t TIMESTAMP_BLOCK_SIZE = 1 << 20;  // 1MB
+
+// Range of timestamps with a four-digit year, 0000-01-01 to 9999-12-31, in milliseconds since 1970-01-01
+constexpr int64_t MIN_TIMESTAMP = -719528LL * 86400000;
+constexpr int64_t MAX_TIMESTAMP = 2932897LL * 86400000 - 1;
+
+// Share of sampled lines that must start with a timestamp before a file is transformed
+constexpr double MIN_TIMESTAMP_LINE_RATIO = 0.5;
+
+// Parses a leading timestamp into milliseconds since 1970-01-01. Only timestamps that format back
+// to exactly the same bytes are accepted, so replacing them is always reversible.
+bool parseTimestamp(const char* data, size_t size, int64_t& millis);
+
+// Writes the TIMESTAMP_LENGTH bytes of a timestamp
+void formatTimestamp(int64_t millis, char* output);
+
+// Returns true if enough lines of a sample start with a timestamp to be worth transforming
+bool hasTimestamps(const char* data, size_t size);
+
+// Closed window of timestamps in milliseconds since 1970-01-01; the default covers every timestamp
+struct TimeWindow {
+    int64_t since = MIN_TIMESTAMP;
+    int64_t until = MAX_TIMESTAMP;
+
+    bool bounded() const { return since > MIN_TIMESTAMP || until < MAX_TIMESTAMP; }
+    bool contains(int64_t millis) const { return millis >= since && millis <= until; }
+};
+
+// Parses a window bound written as "YYYY-MM-DD", optionally followed by " HH:MM", ":SS" and ".mmm",
+// with 'T' also accepted before the time. Missing fields start the period for a lower bound and end
+// it for an upper one, so --until=2105-05-13 takes in the whole day. Throws std::invalid_argument.
+int64_t parseTimeBound(const std::string& text, bool upper);
+
+// UTF-8 byte order mark, which a timestamp on the first line of a text may follow
+constexpr char UTF8_BOM[] = "\xEF\xBB\xBF";
+constexpr size_t UTF8_BOM_LENGTH = 3;
+
+// Times the lines of a text in order: a line by its leading timestamp, after a byte order mark on the
+// first line, or else by the last timestamp before it, so continuation lines follow their record
+class LineClock {
+public:
+    // Times the next line; returns false while no line so far had a timestamp
+    bool advance(std::string_view line, int64_t& millis);
+
+    // Returns true if the last line timed had a timestamp of its own
+    bool stamped() const { return ownTimestamp; }
+
+private:
+    bool firstLine = true;
+    bool timed = false;
+    bool ownTimestamp = false;
+    int64_t last = 0;
+};
+
+// Earliest and latest leading timestamp of the lines of a text fed in pieces; a byte order mark at the
+// start of the text is passed over
+class TimeRangeScanner {
+public:
+    // Scans the next bytes of the text
+    void add(const char* data, size_t size);
+
+    // Returns true if some line started with a timestamp
+    bool found() const { return earliest <= latest; }
+
+    int64_t minTimestamp() const { return earliest; }
+    int64_t maxTimestamp() const { return latest; }
+
+private:
+    void record(const char* line, size_t size);
+
+    std::string head;          // Start of a line cut off by the end of a piece
+    bool inLine = false;       // Inside a line whose start was already checked
+    bool firstLine = true;     // Still on the line a byte order mark may start
+    int64_t earliest = MAX_TIMESTAMP + 1;
+    int64_t latest = MIN_TIMESTAMP - 1;
+};
+
+// Input stream buffer yielding the transformed form of a source stream. Each block is a header of
+// uint32 line count, text size and timestamp column size, then the lines with their leading
+// timestamp removed, then per line a varint: 0 when the line kept its text, else the zigzag
+// encoded difference to the previous timestamp shifted left with the low bit set.
+class EncodingBuffer : public std::streambuf {
+public:
+    explicit EncodingBuffer(std::istream& source);
+
+protected:
+    int_type underflow() override;
+
+private:
+    std::istream& source;
+    std::vector<char> input;  // Source bytes, a partial line carried over from the last block first
+    size_t buffered = 0;
+    int64_t previous = 0;     // Last timestamp, the base of the next delta
+    std::string encoded;      // Block handed out to the reader
+};
+
+// Output stream buffer restoring the original lines of a transformed stream into a target stream.
+// Throws on a malformed block; finish checks that the stream did not end inside one.
+class DecodingBuffer : public std::streambuf {
+public:
+    explicit DecodingBuffer(std::ostream& target);
+
+    // Throws if a block was cut short
+    void finish() const;
+
+    // Bytes written to the target
+    uint64_t written() const { return restored; }
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* data, std::streamsize size) override;
+
+private:
+    // Restores every complete block in pending
+    void decodeBlocks();
+
+    std::ostream& target;
+    std::string pending;  // Bytes of a block not yet complete
+    std::string decoded;  // Lines of the block being restored
+    int64_t previous = 0;
+    uint64_t restored = 0;
+};
+
+}  // namespace timestamps
+
+#endif // TIMESTAMPCODEC_H
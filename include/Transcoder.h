@@ -0,0 +1,87 @@
+#ifndef TRANSCODER_H
+#define TRANSCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace transcoding {
+
+// Text encodings a file can be transcoded from; the value is recorded in the entry
+enum class Encoding : uint8_t {
+    NONE = 0,     // Stored as it is
+    UTF16LE = 1,  // UTF-16 little endian, the usual encoding of Windows logs
+    UTF16BE = 2,  // UTF-16 big endian
+};
+
+// Share of code units with a zero high byte needed to take text without a byte order mark for UTF-16
+constexpr double MIN_UTF16_ASCII_RATIO = 0.9;
+
+// Detects UTF-16 text in a sample from the head of a file, by its byte order mark or, failing that, by
+// the zero high bytes of mostly ASCII text. Returns NONE unless the UTF-8 form would be smaller.
+Encoding detectUtf16(const uint8_t* data, size_t size);
+
+// Samples the head of a file to detect UTF-16 text. A file of odd size is not UTF-16 and stays raw.
+Encoding detectFileEncoding(const std::filesystem::path& filePath);
+
+// Appends the UTF-8 form of UTF-16 code units to output. Unpaired surrogates are written as three-byte
+// sequences (WTF-8), so every even-sized input round-trips exactly. Unless final is set, a high
+// surrogate at the end of data is left for the next call; an odd trailing byte always is. Returns the
+// number of bytes consumed.
+size_t utf16ToUtf8(const uint8_t* data, size_t size, Encoding encoding, bool final, std::string& output);
+
+// Appends the UTF-16 form of UTF-8 (including WTF-8 surrogates) to output. A sequence cut off at the
+// end of data is left for the next call. Returns the number of bytes consumed; throws on bytes that
+// utf16ToUtf8 never produces, so the restored bytes are exactly the original ones.
+size_t utf8ToUtf16(const uint8_t* data, size_t size, Encoding encoding, std::string& output);
+
+// Input stream buffer yielding the UTF-8 form of the first size bytes of a UTF-16 source stream.
+// Throws if the source ends inside a code unit.
+class ToUtf8Buffer : public std::streambuf {
+public:
+    ToUtf8Buffer(std::istream& source, Encoding encoding, uint64_t size);
+
+protected:
+    int_type underflow() override;
+
+private:
+    std::istream& source;
+    const Encoding encoding;
+    uint64_t remaining;       // Bytes still to read from the source
+    std::vector<char> input;  // Read from the source, the first carried bytes left from the last read
+    size_t carried = 0;
+    std::string converted;    // UTF-8 handed out to the reader
+};
+
+// Output stream buffer writing the UTF-16 form of the UTF-8 written to it into a target stream.
+// finish checks that the stream did not end inside a sequence.
+class FromUtf8Buffer : public std::streambuf {
+public:
+    FromUtf8Buffer(std::ostream& target, Encoding encoding);
+
+    // Throws if a sequence was cut short
+    void finish() const;
+
+    // Bytes written to the target
+    uint64_t written() const { return restored; }
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* data, std::streamsize size) override;
+
+private:
+    std::ostream& target;
+    const Encoding encoding;
+    std::string pending;    // Start of a sequence split across writes
+    std::string converted;  // UTF-16 ready for the target
+    uint64_t restored = 0;
+};
+
+}  // namespace transcoding
+
+#endif // TRANSCODER_H
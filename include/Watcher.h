@@ -0,0 +1,101 @@
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "CompressionOptions.h"
+
+namespace watch {
+
+// Longest a finished file waits for its batch to be archived, unless set otherwise
+constexpr int64_t DEFAULT_LATENCY_MILLIS = 60 * 1000;
+
+// Span of time each archive of a watch collects the batches of
+enum class Segment {
+    HOUR,
+    DAY
+};
+
+// Parses "hour" or "day"; throws std::invalid_argument otherwise
+Segment parseSegment(const std::string& name);
+
+// Archive of the segment holding a time: the prefix followed by the segment's start in UTC, as
+// -YYYY-MM-DD for a day or -YYYY-MM-DD-HH for an hour
+std::string segmentArchive(const std::string& archivePrefix, int64_t millis, Segment segment);
+
+// How a watch batches and archives files
+struct WatchOptions {
+    compression::CompressionOptions compression;     // Settings of every archive; the watch sets its file list
+    int64_t latencyMillis = DEFAULT_LATENCY_MILLIS;  // Longest a finished file waits before its batch is archived
+    Segment segment = Segment::DAY;                  // Span of time each archive covers
+};
+
+// What a watch archived
+struct WatchStats {
+    uint64_t batches = 0;   // Batches archived
+    uint64_t files = 0;     // Files in them, counted again when archived again after a change
+    uint64_t archives = 0;  // Segment archives created
+    uint64_t failures = 0;  // Batches that failed and were retried with the next
+    uint64_t rescans = 0;   // Times events were lost and every file under the directory was queued
+};
+
+// Archives the files of a directory tree as they are finished, without rescanning it. inotify reports
+// files closed after writing and files moved in, such as rotated logs; they are queued, and once the
+// first queued file has waited the latency the batch is appended to the archive of the current segment,
+// which the first batch creates. Only queued files are read and hashed, so the work follows the rate of
+// new log data rather than the size of the tree. Files present when the watch starts are not archived.
+class Watcher {
+public:
+    // Watches rootDir and every directory below it; throws std::runtime_error when inotify is unavailable
+    // or its watch limit is reached
+    Watcher(const std::string& rootDir, const std::string& archivePrefix, const WatchOptions& options);
+    ~Watcher();
+
+    Watcher(const Watcher&) = delete;
+    Watcher& operator=(const Watcher&) = delete;
+
+    // Archives batches until stop() is called, then archives the files still queued
+    void run();
+
+    // Makes run() return; safe to call from another thread or from a signal handler
+    void stop();
+
+    const WatchStats& stats() const { return watchStats; }
+
+private:
+    // Watches a directory and the directories below it, queueing the files found in them when they
+    // appeared after the watch started
+    void addWatches(const std::filesystem::path& dir, bool queueFiles);
+
+    // Handles the events inotify has ready
+    void readEvents();
+
+    void queue(const std::filesystem::path& path);
+
+    // Whether a file is one the watch writes itself: a segment archive, its partial or journal files,
+    // or the catalog and its lock and temporary files
+    bool isOwnFile(const std::string& path) const;
+
+    // Appends the queued files still on disk to the archive of the current segment
+    void archiveBatch();
+
+    const std::filesystem::path root;  // Absolute, so event paths are relative to it
+    const std::string archivePrefix;   // Absolute, so the watch's own archives are told from event paths
+    const std::string catalogFile;     // Absolute, or empty without a catalog
+    const WatchOptions options;
+    int notifyFd = -1;
+    int stopPipe[2] = {-1, -1};                                  // Written by stop() to wake run()
+    std::unordered_map<int, std::filesystem::path> watchedDirs;  // Watch descriptor to its directory
+    std::set<std::string> pending;                               // Relative paths of the queued files
+    std::chrono::steady_clock::time_point batchStart;            // When the first queued file was queued
+    WatchStats watchStats;
+};
+
+}  // namespace watch
+
+#endif // WATCHER_H
@@ -0,0 +1,345 @@
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+#include "ArchiveReader.h"
+#include "Chunker.h"
+#include "IO.h"
+#include "JsonLinesCodec.h"
+#include "TemplateCodec.h"
+#include "TimestampCodec.h"
+#include "Transcoder.h"
+
+namespace compression {
+
+CompressorSettings decoderSettings(const meta::FileMeta& entry, const DictionaryMap& dictionaries,
+                                   DictionaryRegistry* registry) {
+    CompressorSettings settings;
+    settings.windowLog = entry.windowLog;  // Decoder must accept the window the entry was written with
+    if (entry.dictionaryId != 0) {
+        auto it = dictionaries.find(entry.dictionaryId);
+        if (it != dictionaries.end()) {
+            settings.dictionary = it->second;
+        } else if (registry) {
+            settings.dictionary = registry->load(entry.dictionaryId);
+        } else {
+            throw std::runtime_error("Dictionary " + dictionaryName(entry.dictionaryId) + " for " + entry.relativePath +
+                                     " is not embedded in the archive; a dictionary registry is required");
+        }
+    }
+    return settings;
+}
+
+uint64_t decodeStream(const meta::FileMeta& entry, const Compressor& decompressor, std::istream& archive,
+                      std::ostream& output, const lines::LineDictionary* lineDictionary) {
+    if (!entry.isLineEncoded() && !entry.isTranscoded() && !entry.isTimestampEncoded() && !entry.isTemplateEncoded() &&
+        !entry.isJsonEncoded()) {
+        return decompressor.decompressStream(archive, output);
+    }
+
+    // Stages are undone in reverse: line records expand into the timestamp columns, or template or JSON
+    // columns are read, which join back into UTF-8 lines, which go back to the file's encoding
+    std::ostream* stage = &output;
+    std::optional<transcoding::FromUtf8Buffer> transcoder;
+    std::optional<std::ostream> transcodedOutput;
+    if (entry.isTranscoded()) {
+        auto encoding = static_cast<transcoding::Encoding>(entry.textEncoding);
+        if (encoding != transcoding::Encoding::UTF16LE && encoding != transcoding::Encoding::UTF16BE) {
+            throw std::runtime_error("Invalid archive: unknown text encoding " + std::to_string(entry.textEncoding) +
+                                     " for " + entry.relativePath);
+        }
+        transcoder.emplace(*stage, encoding);
+        transcodedOutput.emplace(&*transcoder);
+        transcodedOutput->exceptions(std::ios::badbit);  // Rethrows decoding errors
+        stage = &*transcodedOutput;
+    }
+    std::optional<templates::DecodingBuffer> templateDecoder;
+    std::optional<std::ostream> templatedOutput;
+    if (entry.isTemplateEncoded()) {
+        templateDecoder.emplace(*stage);
+        templatedOutput.emplace(&*templateDecoder);
+        templatedOutput->exceptions(std::ios::badbit);
+        stage = &*templatedOutput;
+    }
+    std::optional<jsonlines::DecodingBuffer> jsonDecoder;
+    std::optional<std::ostream> jsonOutput;
+    if (entry.isJsonEncoded()) {
+        jsonDecoder.emplace(*stage);
+        jsonOutput.emplace(&*jsonDecoder);
+        jsonOutput->exceptions(std::ios::badbit);
+        stage = &*jsonOutput;
+    }
+    std::optional<timestamps::DecodingBuffer> timestampDecoder;
+    std::optional<std::ostream> joinedOutput;
+    if (entry.isTimestampEncoded()) {
+        timestampDecoder.emplace(*stage);
+        joinedOutput.emplace(&*timestampDecoder);
+        joinedOutput->exceptions(std::ios::badbit);
+        stage = &*joinedOutput;
+    }
+    std::optional<lines::DecodingBuffer> lineDecoder;
+    std::optional<std::ostream> decodedOutput;
+    if (entry.isLineEncoded()) {
+        if (!lineDictionary) {
+            throw std::runtime_error("Invalid archive: " + entry.relativePath + " is line encoded but there is no line store");
+        }
+        lineDecoder.emplace(*stage, *lineDictionary);
+        decodedOutput.emplace(&*lineDecoder);
+        decodedOutput->exceptions(std::ios::badbit);
+        stage = &*decodedOutput;
+    }
+
+    decompressor.decompressStream(archive, *stage);
+    if (lineDecoder) {
+        lineDecoder->finish();
+    }
+    if (timestampDecoder) {
+        timestampDecoder->finish();
+    }
+    if (templateDecoder) {
+        templateDecoder->finish();
+    }
+    if (jsonDecoder) {
+        jsonDecoder->finish();
+    }
+    if (transcoder) {
+        transcoder->finish();
+        return transcoder->written();
+    }
+    if (templateDecoder) {
+        return templateDecoder->written();
+    }
+    if (jsonDecoder) {
+        return jsonDecoder->written();
+    }
+    return timestampDecoder ? timestampDecoder->written() : lineDecoder->written();
+}
+
+io::Attribute baseArchiveSection(const std::string& baseArchive) {
+    return {io::TAG_BASE_ARCHIVE, baseArchive};
+}
+
+std::string readBaseArchiveSection(const std::vector<io::Attribute>& sections) {
+    for (const auto& [tag, payload] : sections) {
+        if (tag == io::TAG_BASE_ARCHIVE) {
+            return payload;
+        }
+    }
+    return "";
+}
+
+lines::LineDictionary readLineStore(std::istream& archive, const lines::LineStoreLocation& location,
+                                    DecompressorCache& decompressors) {
+    CompressorSettings settings;
+    settings.windowLog = location.windowLog;
+    archive.clear();
+    archive.seekg(location.dataOffset);
+    std::ostringstream storeData;
+    uint64_t size = decompressors.get(location.codec, settings).decompressStream(archive, storeData);
+    if (size != location.size) {
+        throw std::runtime_error("Invalid archive: line store holds " + std::to_string(size) + " bytes instead of " +
+                                 std::to_string(location.size));
+    }
+    return lines::LineDictionary(storeData.str());
+}
+
+ArchiveReader::ArchiveReader(const std::string& archiveFile, const std::string& registryDir)
+    : archive(archiveFile, std::ios::binary), registryDir(registryDir) {
+    io::checkOpen(archive, archiveFile, "Archive reading");
+    std::vector<io::Attribute> sections;
+    metadata = io::readMetadata(archive, compType, &sections, io::committedSize(archiveFile));  // Ignores an append in progress
+    dictionaries = readDictionarySections(sections);
+    lineStoreLocation = lines::readLineStoreSection(sections);
+    rawChunkBlocks = chunking::readRawBlockSections(sections);
+    basePath = readBaseArchiveSection(sections);
+    if (!registryDir.empty()) {
+        registry = std::make_unique<DictionaryRegistry>(registryDir);
+    }
+
+    for (size_t i = 0; i < metadata.size(); i++) {
+        const auto& meta = metadata[i];
+        pathIndex.emplace(meta.relativePath, i);
+        if (!meta.isDuplicate() && !meta.isBaseReference()) {  // Base references hold no data here
+            dataIndex.emplace(std::make_pair(meta.dataOffset, meta.blockOffset), &meta);
+        }
+    }
+    retainedEntries = io::readRetainedEntries(sections);
+    for (const auto& meta : retainedEntries) {
+        dataIndex.emplace(std::make_pair(meta.dataOffset, meta.blockOffset), &meta);  // Only delta references reach them
+    }
+}
+
+const meta::FileMeta* ArchiveReader::find(const std::string& relativePath) const {
+    auto it = pathIndex.find(relativePath);
+    return it == pathIndex.end() ? nullptr : &metadata[it->second];
+}
+
+const meta::FileMeta& ArchiveReader::resolve(const meta::FileMeta& entry) const {
+    if (!entry.isDuplicate()) {
+        return entry;
+    }
+    auto it = dataIndex.find({entry.dataOffset, entry.blockOffset});
+    if (it == dataIndex.end()) {
+        throw std::runtime_error("Invalid archive: no original data for duplicate " + entry.relativePath);
+    }
+    return *it->second;
+}
+
+const meta::FileMeta& ArchiveReader::findReferenced(const meta::FileMeta& reference) const {
+    const meta::FileMeta* entry = find(reference.baseEntry);
+    if (!entry || resolve(*entry).hash != reference.hash) {
+        throw std::runtime_error("Base archive no longer holds the content of " + reference.relativePath + " (" +
+                                 reference.baseEntry + ")");
+    }
+    return resolve(*entry);
+}
+
+size_t ArchiveReader::referenceDepth(const meta::FileMeta& entry) {
+    const meta::FileMeta& source = resolve(entry);
+    if (!source.isBaseReference()) {
+        return 0;
+    }
+    ArchiveReader& baseArchive = base();
+    return 1 + baseArchive.referenceDepth(baseArchive.findReferenced(source));
+}
+
+ArchiveReader& ArchiveReader::base() {
+    if (!baseReader) {
+        if (basePath.empty()) {
+            throw std::runtime_error("Invalid archive: base references but no base archive");
+        }
+        if (chainLevel + 1 >= MAX_BASE_CHAIN) {
+            throw std::runtime_error("Base archive chain longer than " + std::to_string(MAX_BASE_CHAIN) +
+                                     " archives at " + basePath);
+        }
+        baseReader = std::make_unique<ArchiveReader>(basePath, registryDir);
+        baseReader->chainLevel = chainLevel + 1;
+    }
+    return *baseReader;
+}
+
+uint64_t ArchiveReader::read(const meta::FileMeta& entry, std::ostream& output) {
+    return readEntry(resolve(entry), output, 0);
+}
+
+uint64_t ArchiveReader::readBlock(const meta::FileMeta& entry, std::ostream& output) {
+    const meta::FileMeta& source = resolve(entry);
+    if (!source.isSolid()) {
+        throw std::invalid_argument(source.relativePath + " is not stored in a solid block");
+    }
+    const Compressor& decompressor = decompressors.get(source.codec, decoderSettings(source, dictionaries, registry.get()));
+    archive.clear();
+    archive.seekg(source.dataOffset);
+    return decompressor.decompressStream(archive, output);
+}
+
+uint64_t ArchiveReader::readColumns(const meta::FileMeta& entry, std::ostream& output) {
+    const meta::FileMeta& source = resolve(entry);
+    if (!source.isTemplateEncoded()) {
+        throw std::invalid_argument(source.relativePath + " is not template encoded");
+    }
+    const Compressor& decompressor = decompressors.get(source.codec, decoderSettings(source, dictionaries, registry.get()));
+    archive.clear();
+    archive.seekg(source.dataOffset);
+    return decompressor.decompressStream(archive, output);  // Columnar files are always standalone streams
+}
+
+uint64_t ArchiveReader::readEntry(const meta::FileMeta& source, std::ostream& output, size_t chainDepth) {
+    if (source.isBaseReference()) {
+        ArchiveReader& baseArchive = base();
+        return baseArchive.read(baseArchive.findReferenced(source), output);
+    }
+    const Compressor& decompressor = decompressors.get(source.codec, decoderSettings(source, dictionaries, registry.get()));
+    if (source.isDelta()) {
+        // Rebuild the reference first; the chain ends at a plain stream within the archive's depth limit
+        auto reference = dataIndex.find({source.deltaReference, 0});
+        if (reference == dataIndex.end() || chainDepth >= metadata.size() + retainedEntries.size()) {
+            throw std::runtime_error("Invalid archive: broken delta chain for " + source.relativePath);
+        }
+        std::ostringstream referenceData;
+        readEntry(*reference->second, referenceData, chainDepth + 1);
+        archive.clear();
+        archive.seekg(source.dataOffset);
+        return decompressor.decompressDelta(archive, output, referenceData.str());
+    }
+
+    const lines::LineDictionary* dictionary = source.isLineEncoded() ? &lineStore() : nullptr;  // Loaded before seeking
+    archive.clear();
+    archive.seekg(source.dataOffset);
+    if (source.isChunked()) {
+        return readChunks(source, decompressor, output);
+    }
+    if (!source.isSolid()) {
+        return decodeStream(source, decompressor, archive, output, dictionary);  // Standalone stream holds only this file
+    }
+
+    // Decode the block holding the file and cut the file out of it
+    std::ostringstream blockData;
+    decompressor.decompressStream(archive, blockData);
+    const std::string block = blockData.str();
+    if (source.blockOffset + source.originalSize > block.size()) {
+        throw std::runtime_error("Corrupt solid block " + std::to_string(source.blockId) +
+                                 ": " + source.relativePath + " lies outside the block");
+    }
+    output.write(block.data() + source.blockOffset, source.originalSize);
+    return source.originalSize;
+}
+
+const lines::LineDictionary& ArchiveReader::lineStore() {
+    if (!lineDictionary) {
+        if (!lineStoreLocation) {
+            throw std::runtime_error("Invalid archive: line-encoded entries but no line store");
+        }
+        lineDictionary = std::make_unique<lines::LineDictionary>(readLineStore(archive, *lineStoreLocation, decompressors));
+    }
+    return *lineDictionary;
+}
+
+uint64_t ArchiveReader::readChunks(const meta::FileMeta& entry, const Compressor& decompressor, std::ostream& output) {
+    auto chunks = chunking::readRecipe(archive);
+
+    // Consecutive chunks mostly come from the same block, so only the last decoded block is kept
+    int64_t loadedBlock = -1;
+    std::string block;
+    uint64_t written = 0;
+    for (const auto& chunk : chunks) {
+        if (chunk.dataOffset != loadedBlock) {
+            archive.clear();
+            archive.seekg(chunk.dataOffset);
+            std::ostringstream blockData;
+            if (rawChunkBlocks.count(chunk.dataOffset) != 0) {
+                decompressors.get(CompressionType::NONE, {}).decompressStream(archive, blockData);
+            } else {
+                decompressor.decompressStream(archive, blockData);
+            }
+            block = blockData.str();
+            loadedBlock = chunk.dataOffset;
+        }
+        if (chunk.blockOffset + chunk.length > block.size()) {
+            throw std::runtime_error("Corrupt chunk block at offset " + std::to_string(chunk.dataOffset) +
+                                     ": chunk of " + entry.relativePath + " lies outside the block");
+        }
+        output.write(block.data() + chunk.blockOffset, chunk.length);
+        written += chunk.length;
+    }
+    return written;
+}
+
+std::unique_ptr<ArchiveReader> ReaderPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!idle.empty()) {
+            auto reader = std::move(idle.back());
+            idle.pop_back();
+            return reader;
+        }
+    }
+    return std::make_unique<ArchiveReader>(archiveFile, registryDir);
+}
+
+void ReaderPool::release(std::unique_ptr<ArchiveReader> reader) {
+    std::lock_guard<std::mutex> lock(mutex);
+    idle.push_back(std::move(reader));
+}
+
+}  // End of compression namespace
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "ArchiveReader.h"
+#include "ArchiveSearch.h"
+#include "ContentProbe.h"
+#include "FileMeta.h"
+#include "GramFilter.h"
+#include "ThreadPool.h"
+
+namespace search {
+
+namespace {
+
+// Bytes of matches held for streams searched ahead of the one reported next, past which no further
+// stream is started
+constexpr uint64_t MAX_HELD_BYTES = 64 << 20;
+
+char toLowerAscii(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// Unique content and the selected entries holding it
+struct Source {
+    size_t entry;               // Unique entry in metadata
+    std::vector<size_t> paths;  // Selected entries reported for its matches
+};
+
+// Unit of parallel work: one stream of its own, or the searched files of one solid block
+struct SearchTask {
+    std::vector<Source> sources;
+};
+
+// Hands the matches of the tasks to the sink in task order, those of the next task as each of its files
+// is searched and those of later tasks once every task before them is done
+class MatchEmitter {
+public:
+    MatchEmitter(const MatchSink& sink, size_t taskCount) : sink(sink), held(taskCount), done(taskCount) {}
+
+    // Waits while too many matches are held for tasks ahead of the next, unless stopped
+    void waitForTurn(size_t task) {
+        std::unique_lock<std::mutex> lock(mutex);
+        reported.wait(lock, [&] { return task <= next || heldBytes < MAX_HELD_BYTES || stopped; });
+    }
+
+    // Takes the matches of a file a task searched
+    void add(size_t task, std::vector<SearchMatch> matches) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (task == next) {
+            report(matches);
+            return;
+        }
+        for (auto& match : matches) {
+            heldBytes += match.relativePath.size() + match.line.size();
+            held[task].push_back(std::move(match));
+        }
+    }
+
+    // Marks a task done, reporting what the tasks after it hold up to the next one not done
+    void finish(size_t task) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done[task] = true;
+        while (next < done.size() && done[next]) {
+            next++;
+            if (next < held.size()) {
+                release(next);
+            }
+        }
+        reported.notify_all();
+    }
+
+    // Lets waiting tasks go, so they see the search is over
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        reported.notify_all();
+    }
+
+    // Reports everything still held, of tasks a stop left unfinished
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (; next < held.size(); next++) {
+            release(next);
+        }
+    }
+
+private:
+    void report(const std::vector<SearchMatch>& matches) {
+        for (const auto& match : matches) {
+            sink(match);
+        }
+    }
+
+    void release(size_t task) {
+        report(held[task]);
+        for (const auto& match : held[task]) {
+            heldBytes -= match.relativePath.size() + match.line.size();
+        }
+        held[task] = std::vector<SearchMatch>();
+    }
+
+    const MatchSink& sink;
+    std::mutex mutex;
+    std::condition_variable reported;
+    std::vector<std::vector<SearchMatch>> held;  // Matches of each task, until it is next
+    std::vector<bool> done;
+    size_t next = 0;  // First task not done
+    uint64_t heldBytes = 0;
+    bool stopped = false;
+};
+
+}  // namespace
+
+LineMatcher::LineMatcher(const SearchOptions& options)
+    : literal(options.pattern), ignoreCase(options.ignoreCase), timeWindow(options.window) {
+    if (options.pattern.empty()) {
+        throw std::invalid_argument("Search pattern must not be empty");
+    }
+    if (options.regex) {
+        auto flags = std::regex::ECMAScript | std::regex::optimize;
+        if (options.ignoreCase) {
+            flags |= std::regex::icase;
+        }
+        expression.emplace(options.pattern, flags);  // Throws std::regex_error on a bad pattern
+    } else if (ignoreCase) {
+        std::transform(literal.begin(), literal.end(), literal.begin(), toLowerAscii);
+    }
+}
+
+bool LineMatcher::matches(std::string_view line) const {
+    if (expression) {
+        return std::regex_search(line.begin(), line.end(), *expression);
+    }
+    if (!ignoreCase) {
+        return line.find(literal) != std::string_view::npos;
+    }
+    auto equal = [](char a, char b) { return toLowerAscii(a) == b; };
+    return std::search(line.begin(), line.end(), literal.begin(), literal.end(), equal) != line.end();
+}
+
+MatchingBuffer::MatchingBuffer(const LineMatcher& matcher, MatchCallback onMatch, transcoding::Encoding encoding)
+    : LineSplitter(encoding), matcher(matcher), onMatch(std::move(onMatch)) {}
+
+void MatchingBuffer::onLine(std::string_view line) {
+    lineNumber++;
+    int64_t lineTime;
+    if (matcher.window().bounded() && (!clock.advance(line, lineTime) || !matcher.window().contains(lineTime))) {
+        return;
+    }
+    if (matcher.matches(line) && !onMatch(lineNumber, line)) {
+        throw SearchStopped();
+    }
+}
+
+SearchStats searchArchive(const std::string& archiveFile, const SearchOptions& options, const MatchSink& onMatch) {
+    const LineMatcher matcher(options);  // Compiled first so a bad pattern fails before any decoding
+    compression::ReaderPool readers(archiveFile, options.registryDir);
+    auto index = readers.acquire();
+    const std::vector<meta::FileMeta>& metadata = index->entries();
+
+    std::vector<size_t> selected;
+    if (options.relativePaths.empty()) {
+        for (size_t i = 0; i < metadata.size(); i++) {
+            selected.push_back(i);
+        }
+    }
+    for (const auto& relativePath : options.relativePaths) {
+        const meta::FileMeta* entry = index->find(relativePath);
+        if (!entry) {
+            throw std::runtime_error("File not found in archive: " + relativePath);
+        }
+        selected.push_back(static_cast<size_t>(entry - metadata.data()));
+    }
+
+    // Duplicates are matched once through the entry holding their data, and files of a solid block
+    // together through one decode of the block. Tasks follow archive order, so matches can be reported
+    // as the tasks ahead finish.
+    std::map<size_t, std::vector<size_t>> sourcePaths;
+    for (size_t i : selected) {
+        sourcePaths[static_cast<size_t>(&index->resolve(metadata[i]) - metadata.data())].push_back(i);
+    }
+    std::vector<SearchTask> tasks;
+    std::map<int64_t, size_t> blockTasks;  // Solid block id to its task
+    SearchStats counts;
+    for (auto& [entry, paths] : sourcePaths) {
+        const meta::FileMeta& source = metadata[entry];
+        if ((!options.regex && !grams::mayContain(source.gramFilter, options.pattern)) ||
+            (options.window.bounded() && !source.mayOverlap(options.window.since, options.window.until))) {
+            counts.skipped++;  // No line of the file can hold the literal inside the window
+            continue;
+        }
+        counts.searched++;
+        size_t task = tasks.size();
+        if (source.isSolid()) {
+            task = blockTasks.emplace(source.blockId, tasks.size()).first->second;
+        }
+        if (task == tasks.size()) {
+            tasks.emplace_back();
+        }
+        tasks[task].sources.push_back({entry, std::move(paths)});
+    }
+    readers.release(std::move(index));  // Metadata stays valid: the reader is only moved between owners
+
+    std::atomic<uint64_t> found{0};
+    std::atomic<bool> stopped{false};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    MatchEmitter emitter(onMatch, tasks.size());
+
+    auto& threadPool = threading::ThreadPool::getInstance();
+    threadPool.parallelFor(tasks.begin(), tasks.end(), [&](auto taskIt, size_t task) {
+        emitter.waitForTurn(task);
+        if (stopped) {
+            return;
+        }
+        std::unique_ptr<compression::ArchiveReader> reader;
+        try {
+            reader = readers.acquire();
+            std::string block;  // Decoded solid block shared by the task's sources
+            const meta::FileMeta& first = metadata[taskIt->sources.front().entry];
+            if (first.isSolid()) {
+                std::ostringstream blockData;
+                reader->readBlock(first, blockData);
+                block = blockData.str();
+            }
+
+            for (const Source& source : taskIt->sources) {
+                const meta::FileMeta& entry = metadata[source.entry];
+                std::string_view content;  // File inside the solid block
+                auto encoding = static_cast<transcoding::Encoding>(entry.textEncoding);
+                if (entry.isSolid()) {
+                    if (entry.blockOffset + entry.originalSize > block.size()) {
+                        throw std::runtime_error("Corrupt solid block " + std::to_string(entry.blockId) + ": " +
+                                                 entry.relativePath + " lies outside the block");
+                    }
+                    content = std::string_view(block).substr(entry.blockOffset, entry.originalSize);
+                    if (content.size() % 2 == 0) {  // Solid files were never transcoded, so detect UTF-16 here
+                        encoding = transcoding::detectUtf16(reinterpret_cast<const uint8_t*>(content.data()),
+                                                            std::min(content.size(), probe::SAMPLE_SIZE));
+                    }
+                }
+
+                std::vector<std::vector<SearchMatch>> pathMatches(source.paths.size());
+                MatchingBuffer matching(matcher, [&](uint64_t lineNumber, std::string_view line) {
+                    for (size_t i = 0; i < source.paths.size(); i++) {
+                        if (options.maxMatches > 0 && found.fetch_add(1) >= options.maxMatches) {
+                            stopped = true;
+                            return false;
+                        }
+                        pathMatches[i].push_back({metadata[source.paths[i]].relativePath, lineNumber, std::string(line)});
+                    }
+                    return !stopped;
+                }, encoding);
+                std::ostream matched(&matching);
+                matched.exceptions(std::ios::badbit);  // Rethrows SearchStopped and decoding errors
+                try {
+                    if (entry.isSolid()) {
+                        matched.write(content.data(), static_cast<std::streamsize>(content.size()));
+                    } else {
+                        if (!entry.isTranscoded()) {
+                            matching.detectEncoding(entry.originalSize);  // Kept as UTF-16 when compressed
+                        }
+                        reader->read(entry, matched);
+                    }
+                    matching.finish();
+                } catch (const SearchStopped&) {
+                    // Enough matches; the other tasks see stopped and end too
+                }
+
+                std::vector<SearchMatch> fileMatches;
+                for (auto& matches : pathMatches) {
+                    std::move(matches.begin(), matches.end(), std::back_inserter(fileMatches));
+                }
+                emitter.add(task, std::move(fileMatches));
+                if (stopped) {
+                    break;
+                }
+            }
+            emitter.finish(task);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            stopped = true;
+            emitter.stop();
+        }
+        if (reader) {
+            readers.release(std::move(reader));
+        }
+    });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    emitter.flush();
+    return counts;
+}
+
+std::vector<SearchMatch> searchArchive(const std::string& archiveFile, const SearchOptions& options,
+                                       SearchStats* stats) {
+    std::vector<SearchMatch> matches;
+    SearchStats counts = searchArchive(archiveFile, options, [&matches](const SearchMatch& match) {
+        matches.push_back(match);
+    });
+    if (stats) {
+        *stats = counts;
+    }
+    return matches;
+}
+
+}  // namespace search
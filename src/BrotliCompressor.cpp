@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <functional>
 #include <iostream>
 #include <memory>
@@ -11,7 +12,33 @@
 
 namespace compression {
 
+BrotliCompressor::BrotliCompressor(int level, const CompressorSettings& settings) : level(level), settings(settings) {
+    if (settings.dictionary) {
+#ifdef BROTLI_HAS_SHARED_DICTIONARY
+        const auto* data = reinterpret_cast<const uint8_t*>(settings.dictionary->data());
+        preparedDictionary.reset(BrotliEncoderPrepareDictionary(BROTLI_SHARED_DICTIONARY_RAW, settings.dictionary->size(),
+                                                                data, level, nullptr, nullptr, nullptr));
+        if (!preparedDictionary) {
+            throw std::runtime_error("Failed to prepare Brotli dictionary");
+        }
+#else
+        throw std::runtime_error("Brotli dictionaries need Brotli 1.1 or newer");
+#endif
+    }
+}
+
+int BrotliCompressor::windowBits() const {
+    if (settings.windowLog == 0) {
+        return BROTLI_DEFAULT_WINDOW;
+    }
+    return std::clamp(settings.windowLog, BROTLI_MIN_WINDOW_BITS, BROTLI_LARGE_MAX_WINDOW_BITS);
+}
+
 void BrotliCompressor::compressStream(std::istream& input, std::ostream& output) const {
+    compressStream(input, output, StreamHints{});
+}
+
+void BrotliCompressor::compressStream(std::istream& input, std::ostream& output, const StreamHints& hints) const {
     // Create encoder with automatic cleanup
     auto deleter = [](BrotliEncoderState* state) { BrotliEncoderDestroyInstance(state); };
     std::unique_ptr<BrotliEncoderState, decltype(deleter)> encoder(
@@ -21,9 +48,24 @@ void BrotliCompressor::compressStream(std::istream& input, std::ostream& output)
         throw std::runtime_error("Failed to create Brotli encoder");
     }
     
-    // Set default compression parameters
-    BrotliEncoderSetParameter(encoder.get(), BROTLI_PARAM_QUALITY, BROTLI_DEFAULT_QUALITY);
-    BrotliEncoderSetParameter(encoder.get(), BROTLI_PARAM_LGWIN, BROTLI_DEFAULT_WINDOW);
+    // Set compression parameters
+    int lgwin = windowBits();
+    BrotliEncoderSetParameter(encoder.get(), BROTLI_PARAM_QUALITY, level);
+    if (lgwin > BROTLI_MAX_WINDOW_BITS) {
+        BrotliEncoderSetParameter(encoder.get(), BROTLI_PARAM_LARGE_WINDOW, BROTLI_TRUE);  // Needs a matching decoder flag
+    }
+    BrotliEncoderSetParameter(encoder.get(), BROTLI_PARAM_LGWIN, lgwin);
+    if (hints.sizeHint > 0) {
+        // Lets the encoder size its window and hash tables to the input, only a hint if the file grows
+        uint32_t sizeHint = static_cast<uint32_t>(std::min<uint64_t>(hints.sizeHint, 1u << 30));
+        BrotliEncoderSetParameter(encoder.get(), BROTLI_PARAM_SIZE_HINT, sizeHint);
+    }
+    BrotliEncoderSetParameter(encoder.get(), BROTLI_PARAM_MODE, hints.text ? BROTLI_MODE_TEXT : BROTLI_MODE_GENERIC);
+#ifdef BROTLI_HAS_SHARED_DICTIONARY
+    if (preparedDictionary && !BrotliEncoderAttachPreparedDictionary(encoder.get(), preparedDictionary.get())) {
+        throw std::runtime_error("Failed to attach Brotli dictionary");
+    }
+#endif
     
     std::vector<uint8_t> inputBuffer(BUFFER_SIZE);
     std::vector<uint8_t> outputBuffer(BrotliEncoderMaxCompressedSize(BUFFER_SIZE));
@@ -45,7 +87,10 @@ void BrotliCompressor::compressStream(std::istream& input, std::ostream& output)
         const uint8_t* nextIn = inputBuffer.data();
         BrotliEncoderOperation op = isEndOfStream ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
         
-        while (availableIn > 0 || BrotliEncoderHasMoreOutput(encoder.get())) {
+        // Keep pumping until input is consumed, and on the last chunk until the stream is finished
+        // (input sizes that are a multiple of BUFFER_SIZE end with an empty FINISH call)
+        while (availableIn > 0 || BrotliEncoderHasMoreOutput(encoder.get()) ||
+               (isEndOfStream && !BrotliEncoderIsFinished(encoder.get()))) {
             size_t availableOut = outputBuffer.size();
             uint8_t* nextOut = outputBuffer.data();
             
@@ -75,6 +120,18 @@ size_t BrotliCompressor::decompressStream(std::istream& input, std::ostream& out
     if (!decoder) {
         throw std::runtime_error("Failed to create Brotli decoder");
     }
+    if (windowBits() > BROTLI_MAX_WINDOW_BITS) {
+        // Entry was written in large-window mode; standard decoders reject such streams
+        BrotliDecoderSetParameter(decoder.get(), BROTLI_DECODER_PARAM_LARGE_WINDOW, 1);
+    }
+#ifdef BROTLI_HAS_SHARED_DICTIONARY
+    if (settings.dictionary) {
+        const auto* data = reinterpret_cast<const uint8_t*>(settings.dictionary->data());
+        if (!BrotliDecoderAttachDictionary(decoder.get(), BROTLI_SHARED_DICTIONARY_RAW, settings.dictionary->size(), data)) {
+            throw std::runtime_error("Failed to attach Brotli dictionary");
+        }
+    }
+#endif
     
     std::vector<uint8_t> inputBuffer(BUFFER_SIZE);
     std::vector<uint8_t> outputBuffer(BUFFER_SIZE);
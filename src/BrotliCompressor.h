@@ -2,16 +2,47 @@
 #define BROTLI_COMPRESSOR_H
 
 #include <iostream>
+#include <memory>
+
+#include <brotli/encode.h>
 
 #include "Compressor.h"
 
+// Custom (raw) dictionaries need the shared dictionary API added in Brotli 1.1
+#if __has_include(<brotli/shared_dictionary.h>)
+#define BROTLI_HAS_SHARED_DICTIONARY
+#endif
+
 namespace compression {
 
 class BrotliCompressor : public Compressor {
 public:
+    explicit BrotliCompressor(int level, const CompressorSettings& settings = {});
+
+    // Returns true if this build can prime Brotli streams with a dictionary
+    static constexpr bool supportsDictionary() {
+#ifdef BROTLI_HAS_SHARED_DICTIONARY
+        return true;
+#else
+        return false;
+#endif
+    }
+
     void compressStream(std::istream& input, std::ostream& output) const override;
+    void compressStream(std::istream& input, std::ostream& output, const StreamHints& hints) const override;
     size_t decompressStream(std::istream& input, std::ostream& output) const override;
 private:
+    // Window bits for the encoder: the configured window, else the Brotli default
+    int windowBits() const;
+
+    const int level;                    // Compression level used when compressing
+    const CompressorSettings settings;  // Window size and dictionary; windows above 16MB switch to large-window Brotli
+#ifdef BROTLI_HAS_SHARED_DICTIONARY
+    struct PreparedDictionaryDeleter {
+        void operator()(BrotliEncoderPreparedDictionary* dictionary) const { BrotliEncoderDestroyPreparedDictionary(dictionary); }
+    };
+    std::unique_ptr<BrotliEncoderPreparedDictionary, PreparedDictionaryDeleter> preparedDictionary;  // Hashed once per compressor
+#endif
     static constexpr size_t BUFFER_SIZE = 65536; // 64KB buffer size
 };
 
@@ -0,0 +1,569 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#ifdef HAVE_FLOCK
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include "ArchiveReader.h"
+#include "Catalog.h"
+#include "FileMeta.h"
+#include "IO.h"
+
+namespace catalog {
+
+namespace {
+
+// Header: magic, version, archive and file counts, then the offsets of the archive table, the file
+// table, the path and hash indexes and the string heap
+constexpr size_t HEADER_SIZE = sizeof(uint32_t) + sizeof(uint16_t) + 7 * sizeof(uint64_t);
+
+// Archive record: path offset and length, size, modification time, first file, file count, time range
+constexpr size_t ARCHIVE_RECORD_SIZE = 8 + 4 + 8 + 8 + 8 + 8 + 8 + 8;
+
+// File record: path offset and length, archive, hash offset and length, size, time range
+constexpr size_t ENTRY_RECORD_SIZE = 8 + 4 + 4 + 8 + 4 + 8 + 8 + 8;
+
+// Sorted index record: a file number
+constexpr size_t ORDER_RECORD_SIZE = sizeof(uint64_t);
+
+std::runtime_error malformedCatalog() {
+    return std::runtime_error("Invalid catalog: malformed or truncated file");
+}
+
+template<typename T>
+void appendValue(std::string& output, T value) {
+    output.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+T takeValue(const char*& pos) {
+    T value;
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+}
+
+struct Header {
+    uint64_t archiveCount = 0;
+    uint64_t entryCount = 0;
+    uint64_t archivesOffset = 0;
+    uint64_t entriesOffset = 0;
+    uint64_t pathOrderOffset = 0;
+    uint64_t hashOrderOffset = 0;
+    uint64_t stringsOffset = 0;
+};
+
+Header parseHeader(const char* data) {
+    const char* pos = data;
+    if (takeValue<uint32_t>(pos) != CATALOG_MAGIC) {
+        throw std::runtime_error("Not a LogRescuer catalog");
+    }
+    uint16_t version = takeValue<uint16_t>(pos);
+    if (version != CATALOG_VERSION) {
+        throw std::runtime_error("Unsupported catalog version " + std::to_string(version));
+    }
+    Header header;
+    header.archiveCount = takeValue<uint64_t>(pos);
+    header.entryCount = takeValue<uint64_t>(pos);
+    header.archivesOffset = takeValue<uint64_t>(pos);
+    header.entriesOffset = takeValue<uint64_t>(pos);
+    header.pathOrderOffset = takeValue<uint64_t>(pos);
+    header.hashOrderOffset = takeValue<uint64_t>(pos);
+    header.stringsOffset = takeValue<uint64_t>(pos);
+    return header;
+}
+
+// A file as the catalog records it
+struct IndexedFile {
+    std::string relativePath;
+    std::string hash;
+    uint64_t originalSize;
+    int64_t minTimestamp;
+    int64_t maxTimestamp;
+};
+
+// An archive with its files
+struct IndexedArchive {
+    ArchiveInfo info;
+    std::vector<IndexedFile> files;
+};
+
+// Reads the footer and metadata of an archive
+IndexedArchive indexArchive(const std::filesystem::path& path) {
+    compression::ArchiveReader reader(path.string());
+    IndexedArchive indexed;
+    indexed.info.path = path.string();
+    indexed.info.size = std::filesystem::file_size(path);
+    indexed.info.modified = io::modificationTime(path);
+    bool allRanged = true;
+    for (const auto& entry : reader.entries()) {
+        const meta::FileMeta& source = reader.resolve(entry);  // Duplicates carry no hash, size or range
+        indexed.files.push_back({entry.relativePath, source.hash, source.originalSize, source.minTimestamp,
+                                 source.maxTimestamp});
+        if (source.hasTimeRange()) {
+            indexed.info.minTimestamp = std::min(indexed.info.minTimestamp, source.minTimestamp);
+            indexed.info.maxTimestamp = std::max(indexed.info.maxTimestamp, source.maxTimestamp);
+        } else {
+            allRanged = false;
+        }
+    }
+    if (!allRanged) {  // A file without a range may hold any time, so the archive's range is unknown too
+        indexed.info.minTimestamp = std::numeric_limits<int64_t>::max();
+        indexed.info.maxTimestamp = std::numeric_limits<int64_t>::min();
+    }
+    indexed.info.files = indexed.files.size();
+    return indexed;
+}
+
+// Reads a whole catalog back into archives and files
+std::vector<IndexedArchive> readCatalog(const std::string& catalogFile) {
+    std::ifstream input(catalogFile, std::ios::binary);
+    io::checkOpen(input, catalogFile, "Catalog reading");
+    std::string data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    if (data.size() < HEADER_SIZE) {
+        throw malformedCatalog();
+    }
+    Header header = parseHeader(data.data());
+    if (header.archivesOffset + header.archiveCount * ARCHIVE_RECORD_SIZE > data.size() ||
+        header.entriesOffset + header.entryCount * ENTRY_RECORD_SIZE > data.size() || header.stringsOffset > data.size()) {
+        throw malformedCatalog();
+    }
+    auto string = [&](uint64_t offset, uint32_t length) {
+        if (header.stringsOffset + offset + length > data.size()) {
+            throw malformedCatalog();
+        }
+        return data.substr(header.stringsOffset + offset, length);
+    };
+
+    std::vector<IndexedArchive> archives(header.archiveCount);
+    const char* pos = data.data() + header.archivesOffset;
+    for (auto& archive : archives) {
+        uint64_t pathOffset = takeValue<uint64_t>(pos);
+        uint32_t pathLength = takeValue<uint32_t>(pos);
+        archive.info.path = string(pathOffset, pathLength);
+        archive.info.size = takeValue<uint64_t>(pos);
+        archive.info.modified = takeValue<int64_t>(pos);
+        takeValue<uint64_t>(pos);  // First file, given by the order of the file table
+        archive.info.files = takeValue<uint64_t>(pos);
+        archive.info.minTimestamp = takeValue<int64_t>(pos);
+        archive.info.maxTimestamp = takeValue<int64_t>(pos);
+    }
+    pos = data.data() + header.entriesOffset;
+    for (uint64_t i = 0; i < header.entryCount; i++) {
+        IndexedFile file;
+        uint64_t pathOffset = takeValue<uint64_t>(pos);
+        uint32_t pathLength = takeValue<uint32_t>(pos);
+        uint32_t archive = takeValue<uint32_t>(pos);
+        uint64_t hashOffset = takeValue<uint64_t>(pos);
+        uint32_t hashLength = takeValue<uint32_t>(pos);
+        file.relativePath = string(pathOffset, pathLength);
+        file.hash = string(hashOffset, hashLength);
+        file.originalSize = takeValue<uint64_t>(pos);
+        file.minTimestamp = takeValue<int64_t>(pos);
+        file.maxTimestamp = takeValue<int64_t>(pos);
+        if (archive >= archives.size()) {
+            throw malformedCatalog();
+        }
+        archives[archive].files.push_back(std::move(file));
+    }
+    return archives;
+}
+
+// Exclusive lock on <catalog>.lock, held while a catalog is read, updated and renamed into place, so
+// concurrent updates run one after the other instead of losing each other's archives. With flock(2) it
+// is an advisory lock on a file that stays for the next update; elsewhere the lock is the file itself,
+// created exclusively and removed on release.
+class CatalogLock {
+public:
+    explicit CatalogLock(const std::string& catalogFile) : lockPath(catalogFile + ".lock") {
+#ifdef HAVE_FLOCK
+        fd = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Catalog lock creation failed: " + lockPath + ": " + std::strerror(errno));
+        }
+        while (flock(fd, LOCK_EX) != 0) {
+            if (errno != EINTR) {
+                int error = errno;
+                close(fd);
+                throw std::runtime_error("Catalog locking failed: " + lockPath + ": " + std::strerror(error));
+            }
+        }
+#else
+        while ((file = std::fopen(lockPath.c_str(), "wx")) == nullptr) {
+            if (!std::filesystem::exists(lockPath)) {
+                throw std::runtime_error("Catalog lock creation failed: " + lockPath + ": " + std::strerror(errno));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));  // Held by another update
+        }
+#endif
+    }
+
+    ~CatalogLock() {
+#ifdef HAVE_FLOCK
+        close(fd);  // Releases the lock; the file stays for the next update
+#else
+        std::fclose(file);
+        std::remove(lockPath.c_str());
+#endif
+    }
+
+    CatalogLock(const CatalogLock&) = delete;
+    CatalogLock& operator=(const CatalogLock&) = delete;
+
+    const std::string lockPath;
+
+private:
+#ifdef HAVE_FLOCK
+    int fd = -1;
+#else
+    std::FILE* file = nullptr;
+#endif
+};
+
+// Writes archives and their files with path and hash indexes
+void writeCatalog(const std::string& catalogFile, const std::vector<IndexedArchive>& archives) {
+    std::string strings;
+    auto addString = [&](const std::string& value) {
+        uint64_t offset = strings.size();
+        strings += value;
+        return offset;
+    };
+
+    struct FileRef {
+        const IndexedFile* file;
+        uint32_t archive;
+    };
+    std::vector<FileRef> files;
+    std::string archiveTable;
+    for (uint32_t a = 0; a < archives.size(); a++) {
+        const ArchiveInfo& info = archives[a].info;
+        appendValue<uint64_t>(archiveTable, addString(info.path));
+        appendValue<uint32_t>(archiveTable, static_cast<uint32_t>(info.path.size()));
+        appendValue<uint64_t>(archiveTable, info.size);
+        appendValue<int64_t>(archiveTable, info.modified);
+        appendValue<uint64_t>(archiveTable, files.size());
+        appendValue<uint64_t>(archiveTable, archives[a].files.size());
+        appendValue<int64_t>(archiveTable, info.minTimestamp);
+        appendValue<int64_t>(archiveTable, info.maxTimestamp);
+        for (const auto& file : archives[a].files) {
+            files.push_back({&file, a});
+        }
+    }
+
+    std::string entryTable;
+    std::map<std::string, uint64_t> hashOffsets;  // Hashes shared by duplicates are stored once
+    for (const FileRef& ref : files) {
+        auto hash = hashOffsets.emplace(ref.file->hash, 0);
+        if (hash.second) {
+            hash.first->second = addString(ref.file->hash);
+        }
+        appendValue<uint64_t>(entryTable, addString(ref.file->relativePath));
+        appendValue<uint32_t>(entryTable, static_cast<uint32_t>(ref.file->relativePath.size()));
+        appendValue<uint32_t>(entryTable, ref.archive);
+        appendValue<uint64_t>(entryTable, hash.first->second);
+        appendValue<uint32_t>(entryTable, static_cast<uint32_t>(ref.file->hash.size()));
+        appendValue<uint64_t>(entryTable, ref.file->originalSize);
+        appendValue<int64_t>(entryTable, ref.file->minTimestamp);
+        appendValue<int64_t>(entryTable, ref.file->maxTimestamp);
+    }
+
+    auto sortedBy = [&](auto key) {
+        std::vector<uint64_t> order(files.size());
+        for (uint64_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b) {
+            return key(*files[a].file) < key(*files[b].file);
+        });
+        std::string table;
+        for (uint64_t i : order) {
+            appendValue<uint64_t>(table, i);
+        }
+        return table;
+    };
+    std::string pathOrder = sortedBy([](const IndexedFile& file) -> const std::string& { return file.relativePath; });
+    std::string hashOrder = sortedBy([](const IndexedFile& file) -> const std::string& { return file.hash; });
+
+    std::string header;
+    appendValue<uint32_t>(header, CATALOG_MAGIC);
+    appendValue<uint16_t>(header, CATALOG_VERSION);
+    appendValue<uint64_t>(header, archives.size());
+    appendValue<uint64_t>(header, files.size());
+    uint64_t offset = HEADER_SIZE;
+    for (const std::string* section : {&archiveTable, &entryTable, &pathOrder, &hashOrder}) {
+        appendValue<uint64_t>(header, offset);
+        offset += section->size();
+    }
+    appendValue<uint64_t>(header, offset);  // Strings last
+
+    // Named after a random value and the moment, so a writer not holding the lock cannot clobber it
+    std::string temporary = catalogFile + ".tmp." + std::to_string(std::random_device{}()) + "." +
+                            std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream output(temporary, std::ios::binary);
+        io::checkOpen(output, temporary, "Catalog writing");
+        for (const std::string* section : {&header, &archiveTable, &entryTable, &pathOrder, &hashOrder, &strings}) {
+            io::writeBuffer(output, section->data(), section->size());
+        }
+        output.close();
+        io::checkErrors(output, "Catalog writing");
+    }
+    std::filesystem::rename(temporary, catalogFile);  // Replaces the old catalog in one step
+}
+
+}  // namespace
+
+UpdateStats updateCatalog(const std::string& catalogFile, const std::vector<std::string>& archivePaths) {
+    CatalogLock lock(catalogFile);
+    std::vector<IndexedArchive> archives;
+    if (std::filesystem::exists(catalogFile)) {
+        archives = readCatalog(catalogFile);
+    }
+
+    UpdateStats stats;
+    std::map<std::string, size_t> known;  // Archive path to its position in archives
+    std::vector<IndexedArchive> kept;
+    for (auto& archive : archives) {
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(archive.info.path, error)) {
+            stats.removed++;
+            continue;
+        }
+        known.emplace(archive.info.path, kept.size());
+        kept.push_back(std::move(archive));
+    }
+
+    auto add = [&](const std::filesystem::path& file, bool explicitlyNamed) {
+        std::string path = std::filesystem::absolute(file).lexically_normal().string();
+        if (path == std::filesystem::absolute(catalogFile).lexically_normal().string() ||
+            path == std::filesystem::absolute(lock.lockPath).lexically_normal().string()) {
+            return;
+        }
+        auto it = known.find(path);
+        if (it != known.end() && kept[it->second].info.size == std::filesystem::file_size(path) &&
+            kept[it->second].info.modified == io::modificationTime(path)) {
+            stats.unchanged++;
+            return;
+        }
+        IndexedArchive indexed;
+        try {
+            indexed = indexArchive(path);
+        } catch (const std::exception&) {
+            if (explicitlyNamed) {
+                throw;
+            }
+            stats.skipped++;  // Other files kept next to the archives
+            return;
+        }
+        if (it != known.end()) {
+            kept[it->second] = std::move(indexed);
+            stats.refreshed++;
+        } else {
+            known.emplace(path, kept.size());
+            kept.push_back(std::move(indexed));
+            stats.added++;
+        }
+    };
+    for (const auto& archivePath : archivePaths) {
+        if (std::filesystem::is_directory(archivePath)) {
+            auto files = io::scanDirectory(archivePath);
+            std::sort(files.begin(), files.end());  // Archives keep a stable order in the catalog
+            for (const auto& file : files) {
+                add(file, false);
+            }
+        } else {
+            add(archivePath, true);
+        }
+    }
+
+    writeCatalog(catalogFile, kept);
+    return stats;
+}
+
+struct CatalogReader::Entry {
+    uint64_t pathOffset;
+    uint32_t pathLength;
+    uint32_t archive;
+    uint64_t hashOffset;
+    uint32_t hashLength;
+    uint64_t originalSize;
+    int64_t minTimestamp;
+    int64_t maxTimestamp;
+};
+
+CatalogReader::CatalogReader(const std::string& catalogFile) : catalog(catalogFile, std::ios::binary) {
+    io::checkOpen(catalog, catalogFile, "Catalog reading");
+    char headerData[HEADER_SIZE];
+    catalog.read(headerData, HEADER_SIZE);
+    if (catalog.gcount() != static_cast<std::streamsize>(HEADER_SIZE)) {
+        throw malformedCatalog();
+    }
+    Header header = parseHeader(headerData);
+    entryCount = header.entryCount;
+    entriesOffset = header.entriesOffset;
+    pathOrderOffset = header.pathOrderOffset;
+    hashOrderOffset = header.hashOrderOffset;
+    stringsOffset = header.stringsOffset;
+
+    std::string table(header.archiveCount * ARCHIVE_RECORD_SIZE, '\0');
+    catalog.seekg(header.archivesOffset);
+    io::readBuffer(catalog, &table[0], table.size());
+    const char* pos = table.data();
+    for (uint64_t i = 0; i < header.archiveCount; i++) {
+        ArchiveInfo info;
+        uint64_t pathOffset = takeValue<uint64_t>(pos);
+        uint32_t pathLength = takeValue<uint32_t>(pos);
+        info.size = takeValue<uint64_t>(pos);
+        info.modified = takeValue<int64_t>(pos);
+        firstEntries.push_back(takeValue<uint64_t>(pos));
+        info.files = takeValue<uint64_t>(pos);
+        info.minTimestamp = takeValue<int64_t>(pos);
+        info.maxTimestamp = takeValue<int64_t>(pos);
+        info.path = readString(pathOffset, pathLength);
+        archiveTable.push_back(std::move(info));
+    }
+}
+
+CatalogReader::Entry CatalogReader::readEntry(uint64_t index) {
+    return readEntries(index, 1).front();
+}
+
+std::vector<CatalogReader::Entry> CatalogReader::readEntries(uint64_t first, uint64_t count) {
+    if (first + count > entryCount) {
+        throw malformedCatalog();
+    }
+    std::string records(count * ENTRY_RECORD_SIZE, '\0');
+    catalog.clear();
+    catalog.seekg(entriesOffset + first * ENTRY_RECORD_SIZE);
+    io::readBuffer(catalog, &records[0], records.size());
+    std::vector<Entry> entries(count);
+    const char* pos = records.data();
+    for (Entry& entry : entries) {
+        entry.pathOffset = takeValue<uint64_t>(pos);
+        entry.pathLength = takeValue<uint32_t>(pos);
+        entry.archive = takeValue<uint32_t>(pos);
+        entry.hashOffset = takeValue<uint64_t>(pos);
+        entry.hashLength = takeValue<uint32_t>(pos);
+        entry.originalSize = takeValue<uint64_t>(pos);
+        entry.minTimestamp = takeValue<int64_t>(pos);
+        entry.maxTimestamp = takeValue<int64_t>(pos);
+        if (entry.archive >= archiveTable.size()) {
+            throw malformedCatalog();
+        }
+    }
+    return entries;
+}
+
+uint64_t CatalogReader::readOrder(uint64_t indexOffset, uint64_t position) {
+    uint64_t index;
+    catalog.clear();
+    catalog.seekg(indexOffset + position * ORDER_RECORD_SIZE);
+    io::read(catalog, index);
+    return index;
+}
+
+std::string CatalogReader::readString(uint64_t offset, uint32_t length) {
+    std::string value(length, '\0');
+    catalog.clear();
+    catalog.seekg(stringsOffset + offset);
+    io::readBuffer(catalog, &value[0], length);
+    return value;
+}
+
+Location CatalogReader::toLocation(const Entry& entry) {
+    Location location;
+    location.archive = archiveTable[entry.archive].path;
+    location.relativePath = readString(entry.pathOffset, entry.pathLength);
+    location.hash = readString(entry.hashOffset, entry.hashLength);
+    location.originalSize = entry.originalSize;
+    location.minTimestamp = entry.minTimestamp;
+    location.maxTimestamp = entry.maxTimestamp;
+    return location;
+}
+
+bool CatalogReader::matches(const Entry& entry, const LocateQuery& query) {
+    if (query.window.bounded() && entry.minTimestamp <= entry.maxTimestamp &&
+        (entry.minTimestamp > query.window.until || entry.maxTimestamp < query.window.since)) {
+        return false;
+    }
+    if (!query.hash.empty() && readString(entry.hashOffset, entry.hashLength) != query.hash) {
+        return false;
+    }
+    if (!query.path.empty()) {
+        std::string path = readString(entry.pathOffset, entry.pathLength);
+        bool prefix = query.path.back() == '/';
+        return prefix ? path.compare(0, query.path.size(), query.path) == 0 : path == query.path;
+    }
+    return true;
+}
+
+std::pair<uint64_t, uint64_t> CatalogReader::equalRange(uint64_t indexOffset, const std::string& value, bool byHash,
+                                                        bool prefix) {
+    auto keyAt = [&](uint64_t position) {
+        Entry entry = readEntry(readOrder(indexOffset, position));
+        std::string key = byHash ? readString(entry.hashOffset, entry.hashLength)
+                                 : readString(entry.pathOffset, entry.pathLength);
+        return prefix ? key.substr(0, value.size()) : key;
+    };
+    // Keys cut to the prefix length keep the index order, so both bounds are binary searches
+    auto bound = [&](bool upper) {
+        uint64_t low = 0;
+        uint64_t high = entryCount;
+        while (low < high) {
+            uint64_t middle = low + (high - low) / 2;
+            std::string key = keyAt(middle);
+            if (upper ? key <= value : key < value) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    };
+    return {bound(false), bound(true)};
+}
+
+std::vector<Location> CatalogReader::locate(const LocateQuery& query) {
+    std::vector<Location> found;
+    if (!query.path.empty() || !query.hash.empty()) {
+        bool byPath = !query.path.empty();
+        auto [first, last] = byPath ? equalRange(pathOrderOffset, query.path, false, query.path.back() == '/')
+                                    : equalRange(hashOrderOffset, query.hash, true, false);
+        for (uint64_t position = first; position < last; position++) {
+            Entry entry = readEntry(readOrder(byPath ? pathOrderOffset : hashOrderOffset, position));
+            if (matches(entry, query)) {
+                found.push_back(toLocation(entry));
+            }
+        }
+        return found;
+    }
+
+    // Archives whose range misses the window are passed over without reading their files
+    for (size_t a = 0; a < archiveTable.size(); a++) {
+        const ArchiveInfo& info = archiveTable[a];
+        if (query.window.bounded() && info.minTimestamp <= info.maxTimestamp &&
+            (info.minTimestamp > query.window.until || info.maxTimestamp < query.window.since)) {
+            continue;
+        }
+        for (const Entry& entry : readEntries(firstEntries[a], info.files)) {
+            if (matches(entry, query)) {
+                found.push_back(toLocation(entry));
+            }
+        }
+    }
+    return found;
+}
+
+}  // namespace catalog
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Chunker.h"
+#include "IO.h"
+
+namespace chunking {
+
+namespace {
+
+// Random 64-bit value per byte value, from a fixed seed so cut points are stable across runs and builds
+std::array<uint64_t, 256> makeGearTable() {
+    std::array<uint64_t, 256> table{};
+    uint64_t state = 0x4C6F675265736375ULL;  // splitmix64
+    for (auto& entry : table) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        entry = z ^ (z >> 31);
+    }
+    return table;
+}
+
+const std::array<uint64_t, 256> GEAR = makeGearTable();
+
+// Mask of the top bits of the hash; shifting left makes the top bits depend on the most bytes
+uint64_t topBitsMask(unsigned bits) {
+    return bits == 0 ? 0 : ~0ULL << (64 - bits);
+}
+
+unsigned log2Floor(uint32_t value) {
+    unsigned bits = 0;
+    while (value >>= 1) {
+        bits++;
+    }
+    return bits;
+}
+
+// Upper bound on the entries of a recipe, so a corrupt count is rejected before reading on
+constexpr uint64_t MAX_RECIPE_CHUNKS = uint64_t(1) << 32;
+
+}  // namespace
+
+ChunkParams ChunkParams::forAverage(uint32_t avgSize) {
+    avgSize = std::max<uint32_t>(avgSize, 256);
+    return {avgSize / 4, avgSize, avgSize * 4};
+}
+
+size_t cutPoint(const uint8_t* data, size_t size, const ChunkParams& params) {
+    if (size <= params.minSize) {
+        return size;
+    }
+    size = std::min<size_t>(size, params.maxSize);
+    size_t normalSize = std::min<size_t>(size, params.avgSize);
+
+    // Normalized chunking: two more mask bits before the average, two fewer after it
+    unsigned bits = log2Floor(params.avgSize);
+    const uint64_t strictMask = topBitsMask(bits + 2);
+    const uint64_t looseMask = topBitsMask(bits > 2 ? bits - 2 : 1);
+
+    uint64_t hash = 0;
+    size_t i = params.minSize;  // Cut points below the minimum are skipped without hashing
+    for (; i < normalSize; i++) {
+        hash = (hash << 1) + GEAR[data[i]];
+        if ((hash & strictMask) == 0) {
+            return i + 1;
+        }
+    }
+    for (; i < size; i++) {
+        hash = (hash << 1) + GEAR[data[i]];
+        if ((hash & looseMask) == 0) {
+            return i + 1;
+        }
+    }
+    return size;
+}
+
+void splitStream(std::istream& input, const ChunkParams& params,
+                 const std::function<void(const char* data, size_t size)>& onChunk) {
+    std::vector<char> buffer(std::max<size_t>(size_t(params.maxSize) * 4, 1 << 20));
+    size_t start = 0;
+    size_t end = 0;
+    bool eof = false;
+
+    while (true) {
+        // Keep at least one maximal chunk buffered so every cut point sees its full search range
+        if (!eof && end - start < params.maxSize) {
+            std::copy(buffer.begin() + start, buffer.begin() + end, buffer.begin());
+            end -= start;
+            start = 0;
+            input.read(buffer.data() + end, buffer.size() - end);
+            end += input.gcount();
+            eof = !input;
+        }
+        if (start == end) {
+            break;
+        }
+        size_t length = cutPoint(reinterpret_cast<const uint8_t*>(buffer.data() + start), end - start, params);
+        onChunk(buffer.data() + start, length);
+        start += length;
+    }
+}
+
+std::vector<size_t> selectSharingFiles(const std::vector<FileChunks>& files) {
+    std::vector<bool> selected(files.size(), true);
+    bool dropped = true;
+    while (dropped) {
+        // Files holding each chunk, counted once per file
+        std::unordered_map<std::string, size_t> holders;
+        for (size_t i = 0; i < files.size(); i++) {
+            if (!selected[i]) {
+                continue;
+            }
+            std::unordered_set<std::string> seen;
+            for (const auto& [hash, length] : files[i]) {
+                if (seen.insert(hash).second) {
+                    holders[hash]++;
+                }
+            }
+        }
+        dropped = false;
+        for (size_t i = 0; i < files.size(); i++) {
+            if (!selected[i]) {
+                continue;
+            }
+            uint64_t total = 0;
+            uint64_t shared = 0;
+            for (const auto& [hash, length] : files[i]) {
+                total += length;
+                shared += holders[hash] > 1 ? length : 0;
+            }
+            if (total == 0 || shared < total * MIN_SHARED_RATIO) {
+                selected[i] = false;
+                dropped = true;
+            }
+        }
+    }
+
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (selected[i]) {
+            indices.push_back(i);
+        }
+    }
+    return indices;
+}
+
+io::Attribute rawBlockSection(int64_t dataOffset) {
+    return {io::TAG_RAW_CHUNK_BLOCK, io::encodeValue(dataOffset)};
+}
+
+std::set<int64_t> readRawBlockSections(const std::vector<io::Attribute>& sections) {
+    std::set<int64_t> offsets;
+    for (const auto& [tag, payload] : sections) {
+        if (tag == io::TAG_RAW_CHUNK_BLOCK) {
+            offsets.insert(io::decodeValue<int64_t>(payload));
+        }
+    }
+    return offsets;
+}
+
+void writeRecipe(std::ostream& stream, const std::vector<ChunkRef>& chunks) {
+    io::write(stream, static_cast<uint64_t>(chunks.size()));
+    for (const auto& chunk : chunks) {
+        io::write(stream, chunk.dataOffset);
+        io::write(stream, chunk.blockOffset);
+        io::write(stream, chunk.length);
+    }
+}
+
+std::vector<ChunkRef> readRecipe(std::istream& stream) {
+    uint64_t count;
+    io::read(stream, count);
+    if (count > MAX_RECIPE_CHUNKS) {
+        throw std::runtime_error("Invalid archive: chunk list of " + std::to_string(count) + " entries");
+    }
+    std::vector<ChunkRef> chunks;
+    chunks.reserve(std::min<uint64_t>(count, 1 << 16));  // Grows further only as entries are actually read
+    for (uint64_t i = 0; i < count; i++) {
+        ChunkRef chunk;
+        io::read(stream, chunk.dataOffset);
+        io::read(stream, chunk.blockOffset);
+        io::read(stream, chunk.length);
+        chunks.push_back(chunk);
+    }
+    return chunks;
+}
+
+}  // namespace chunking
@@ -0,0 +1,120 @@
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#include "CodecSelector.h"
+#include "IO.h"
+
+namespace compression {
+
+namespace {
+
+// Levels tried for each codec, from fastest to strongest
+std::vector<int> candidateLevels(CompressionType type) {
+    switch (type) {
+        case CompressionType::ZLIB: return {1, 6, 9};
+        case CompressionType::BROTLI: return {1, 5, 9};
+        case CompressionType::ZSTD: return {1, 3, 9, 15};
+        case CompressionType::LZ4: return {0, 9};
+        default: return {};
+    }
+}
+
+}  // namespace
+
+CodecSelector::CodecSelector(double throughputTarget) : throughputTarget(throughputTarget) {}
+
+CodecChoice CodecSelector::select(const std::filesystem::path& filePath, const std::string& relativePath) {
+    uint64_t fileSize = std::filesystem::file_size(filePath);
+    std::string key = familyKey(relativePath, fileSize);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);  // Thread-safe cache lookup
+        auto it = familyChoices.find(key);
+        if (it != familyChoices.end()) {
+            return it->second;  // Family already evaluated
+        }
+    }
+
+    // Read the head of the file as a representative sample
+    std::ifstream file(filePath, std::ios::binary);
+    io::checkOpen(file, filePath.string(), "Codec selection");
+    std::vector<char> sample(std::min<uint64_t>(fileSize, SAMPLE_SIZE));
+    file.read(sample.data(), sample.size());
+    sample.resize(file.gcount());
+
+    CodecChoice choice = evaluate(sample);  // Evaluated outside the lock so families are sampled in parallel
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return familyChoices.emplace(key, choice).first->second;  // Keep the first decision if another thread raced us
+}
+
+CodecChoice CodecSelector::evaluate(const std::vector<char>& sample) const {
+    CodecChoice best{CompressionType::NONE, 0};
+    size_t bestSize = sample.size();  // Compression must beat storing the data as-is
+    CodecChoice fastest{CompressionType::NONE, 0};
+    double fastestSpeed = 0.0;
+    bool anyMeetsTarget = false;
+
+    for (auto type : availableCompressionTypes()) {
+        for (int level : candidateLevels(type)) {
+            auto compressor = createCompressor(type, level);
+            std::istringstream input(std::string(sample.begin(), sample.end()));
+            std::ostringstream output;
+
+            // Time a full trial compression of the sample
+            auto start = std::chrono::steady_clock::now();
+            compressor->compressStream(input, output);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            double seconds = std::max(elapsed.count(), 1e-9);
+            double speed = sample.size() / 1e6 / seconds;  // MB/s
+            size_t compressedSize = output.str().size();
+
+            if (speed > fastestSpeed) {
+                fastestSpeed = speed;
+                fastest = {type, level};
+            }
+            if (speed >= throughputTarget) {
+                anyMeetsTarget = true;
+                if (compressedSize < bestSize) {
+                    bestSize = compressedSize;
+                    best = {type, level};
+                }
+            }
+        }
+    }
+
+    // Nothing reached the target: fall back to the fastest codec rather than the best ratio
+    return anyMeetsTarget ? best : fastest;
+}
+
+std::string CodecSelector::familyKey(const std::string& relativePath, uint64_t fileSize) {
+    std::string key = pathPattern(relativePath);
+
+    // Separate tiny files from huge ones by the number of decimal digits in their size
+    key += '|' + std::to_string(std::to_string(fileSize).size());
+    return key;
+}
+
+std::string CodecSelector::pathPattern(const std::string& relativePath) {
+    std::string key;
+    key.reserve(relativePath.size());
+
+    // Mask digit runs so rotated and per-host files share a family (app.log.1, app.log.2 -> app.log.#)
+    bool inDigits = false;
+    for (char c : relativePath) {
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            if (!inDigits) {
+                key += '#';
+            }
+            inDigits = true;
+        } else {
+            key += c;
+            inDigits = false;
+        }
+    }
+    return key;
+}
+
+}  // End of compression namespace
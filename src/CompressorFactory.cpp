@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cctype>
 #include <stdexcept>
 
 // Conditionally include compressor implementations based on available libraries
@@ -13,42 +15,171 @@
 #include "ZStandardCompressor.h"
 #endif
 
+#ifdef HAVE_LZ4
+#include "Lz4Compressor.h"
+#endif
+
+#include "StoreCompressor.h"
 #include "CompressorFactory.h"
 
 namespace compression {
 
-std::unique_ptr<Compressor> createCompressor(CompressionType type) {
+std::unique_ptr<Compressor> createCompressor(CompressionType type, int level, const CompressorSettings& settings) {
+    if (level == DEFAULT_LEVEL) {
+        level = defaultCompressionLevel(type);  // Resolve the codec's own default
+    }
+    auto [minLevel, maxLevel] = compressionLevelRange(type);
+    if (level < minLevel || level > maxLevel) {
+        throw std::invalid_argument("Compression level " + std::to_string(level) + " is out of range for " +
+                                    CompressionTypeToString(type) + " (" + std::to_string(minLevel) + ".." +
+                                    std::to_string(maxLevel) + ")");
+    }
+
     switch (type) {  // Select compressor implementation based on requested type
         #ifdef HAVE_ZLIB
         case CompressionType::ZLIB:
-            return std::make_unique<ZlibCompressor>();  // Create and return a Zlib compressor
+            return std::make_unique<ZlibCompressor>(level, settings);  // Create and return a Zlib compressor
         #endif
         #ifdef HAVE_BROTLI
         case CompressionType::BROTLI:
-            return std::make_unique<BrotliCompressor>();  // Create and return a Brotli compressor
+            return std::make_unique<BrotliCompressor>(level, settings);  // Create and return a Brotli compressor
         #endif
         #ifdef HAVE_ZSTD
         case CompressionType::ZSTD:
-            return std::make_unique<ZStandardCompressor>();  // Create and return a ZStandard compressor
+            return std::make_unique<ZStandardCompressor>(level, settings);  // Create and return a ZStandard compressor
+        #endif
+        #ifdef HAVE_LZ4
+        case CompressionType::LZ4:
+            return std::make_unique<Lz4Compressor>(level);  // Create and return an LZ4 compressor
         #endif
+        case CompressionType::NONE:
+            return std::make_unique<StoreCompressor>();  // Create and return a pass-through compressor
         default:
-            throw std::runtime_error("No supported compression method available");  // Throw if no suitable compressor found
+            throw std::runtime_error("Compression method " + CompressionTypeToString(type) +
+                                     " is not available in this build");  // Throw if no suitable compressor found
     }
 }
 
-std::string CompressionTypeToString(CompressionType type) {
+bool isCompressionTypeAvailable(CompressionType type) {
     switch (type) {
         #ifdef HAVE_ZLIB
-        case CompressionType::ZLIB: return "ZLIB";
+        case CompressionType::ZLIB: return true;
         #endif
         #ifdef HAVE_BROTLI
-        case CompressionType::BROTLI: return "BROTLI";
+        case CompressionType::BROTLI: return true;
         #endif
         #ifdef HAVE_ZSTD
-        case CompressionType::ZSTD: return "ZSTD";
+        case CompressionType::ZSTD: return true;
+        #endif
+        #ifdef HAVE_LZ4
+        case CompressionType::LZ4: return true;
         #endif
+        case CompressionType::NONE: return true;
+        default: return false;
+    }
+}
+
+bool supportsDictionary(CompressionType type) {
+    switch (type) {
+        #ifdef HAVE_ZLIB
+        case CompressionType::ZLIB: return true;  // Preset dictionary, last 32KB only
+        #endif
+        #ifdef HAVE_BROTLI
+        case CompressionType::BROTLI: return BrotliCompressor::supportsDictionary();
+        #endif
+        #ifdef HAVE_ZSTD
+        case CompressionType::ZSTD: return true;
+        #endif
+        default: return false;
+    }
+}
+
+std::vector<CompressionType> availableCompressionTypes() {
+    std::vector<CompressionType> types;
+    for (auto type : {CompressionType::BROTLI, CompressionType::ZLIB, CompressionType::ZSTD, CompressionType::LZ4}) {
+        if (isCompressionTypeAvailable(type)) {
+            types.push_back(type);
+        }
+    }
+    return types;
+}
+
+CompressionType defaultCompressionType() {
+    auto types = availableCompressionTypes();
+    if (types.empty()) {
+        throw std::runtime_error("No supported compression method available");
+    }
+    return types.front();  // Ordered by preference
+}
+
+int defaultCompressionLevel(CompressionType type) {
+    switch (type) {
+        case CompressionType::ZLIB: return 6;     // Z_DEFAULT_COMPRESSION
+        case CompressionType::BROTLI: return 11;  // BROTLI_DEFAULT_QUALITY
+        case CompressionType::ZSTD: return 3;     // ZSTD_CLEVEL_DEFAULT
+        case CompressionType::LZ4: return 0;      // Fast mode, LZ4HC starts at 3
+        default: return 0;
+    }
+}
+
+std::pair<int, int> compressionLevelRange(CompressionType type) {
+    switch (type) {
+        case CompressionType::ZLIB: return {0, 9};
+        case CompressionType::BROTLI: return {0, 11};
+        case CompressionType::ZSTD: return {-7, 22};  // Negative levels trade ratio for speed
+        case CompressionType::LZ4: return {-8, 12};   // Negative levels accelerate, 3 and above use LZ4HC
+        default: return {0, 0};
+    }
+}
+
+std::string CompressionTypeToString(CompressionType type) {
+    switch (type) {
+        case CompressionType::ZLIB: return "ZLIB";
+        case CompressionType::BROTLI: return "BROTLI";
+        case CompressionType::ZSTD: return "ZSTD";
+        case CompressionType::LZ4: return "LZ4";
+        case CompressionType::NONE: return "NONE";
         default: return "UNKNOWN";
     }
 }
 
-}  // End of compression namespace
\ No newline at end of file
+CompressionType CompressionTypeFromString(const std::string& name) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    for (auto type : {CompressionType::NONE, CompressionType::ZLIB, CompressionType::BROTLI, CompressionType::ZSTD,
+                      CompressionType::LZ4}) {
+        std::string candidate = CompressionTypeToString(type);
+        std::transform(candidate.begin(), candidate.end(), candidate.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (lower == candidate) {
+            return type;
+        }
+    }
+    throw std::invalid_argument("Unknown compression type '" + name + "'");
+}
+
+const Compressor& CompressorCache::get(CompressionType type, int level,
+                                       const std::shared_ptr<const std::string>& dictionary) {
+    if (level == DEFAULT_LEVEL) {
+        level = defaultCompressionLevel(type);
+    }
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto& compressor = compressors[{type, level, dictionary.get()}];
+    if (!compressor) {
+        CompressorSettings compressorSettings = settings;
+        compressorSettings.dictionary = dictionary;
+        compressor = createCompressor(type, level, compressorSettings);  // Created on first use
+    }
+    return *compressor;
+}
+
+const Compressor& DecompressorCache::get(CompressionType type, const CompressorSettings& settings) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto& decompressor = decompressors[{type, settings.windowLog, settings.dictionary.get()}];
+    if (!decompressor) {
+        decompressor = createCompressor(type, DEFAULT_LEVEL, settings);  // Level does not matter for decoding
+    }
+    return *decompressor;
+}
+
+}  // End of compression namespace
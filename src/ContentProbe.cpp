@@ -0,0 +1,125 @@
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "ContentProbe.h"
+#include "IO.h"
+
+namespace probe {
+
+namespace {
+
+// Signature table: format, magic bytes and their length
+struct Signature {
+    KnownFormat format;
+    std::array<uint8_t, 6> magic;
+    size_t length;
+};
+
+constexpr std::array<Signature, 7> SIGNATURES = {{
+    {KnownFormat::GZIP,      {0x1F, 0x8B},                         2},
+    {KnownFormat::ZSTD,      {0x28, 0xB5, 0x2F, 0xFD},             4},
+    {KnownFormat::BZIP2,     {'B', 'Z', 'h'},                      3},
+    {KnownFormat::XZ,        {0xFD, '7', 'z', 'X', 'Z', 0x00},     6},
+    {KnownFormat::LZ4,       {0x04, 0x22, 0x4D, 0x18},             4},
+    {KnownFormat::ZIP,       {'P', 'K', 0x03, 0x04},               4},
+    {KnownFormat::SEVEN_ZIP, {'7', 'z', 0xBC, 0xAF, 0x27, 0x1C},   6},
+}};
+
+}  // namespace
+
+KnownFormat detectFormat(const uint8_t* data, size_t size) {
+    for (const auto& signature : SIGNATURES) {
+        if (size >= signature.length && std::memcmp(data, signature.magic.data(), signature.length) == 0) {
+            return signature.format;
+        }
+    }
+    return KnownFormat::UNKNOWN;
+}
+
+double estimateEntropy(const uint8_t* data, size_t size) {
+    if (size == 0) {
+        return 0.0;
+    }
+
+    // Build a byte histogram of the sample
+    std::array<size_t, 256> histogram{};
+    for (size_t i = 0; i < size; i++) {
+        histogram[data[i]]++;
+    }
+
+    // Sum -p*log2(p) over all observed symbols
+    double entropy = 0.0;
+    for (size_t count : histogram) {
+        if (count > 0) {
+            double probability = static_cast<double>(count) / size;
+            entropy -= probability * std::log2(probability);
+        }
+    }
+    return entropy;
+}
+
+bool isIncompressible(const uint8_t* data, size_t size) {
+    if (detectFormat(data, size) != KnownFormat::UNKNOWN) {
+        return true;  // Already compressed by a known tool
+    }
+    // Tiny samples do not give a meaningful entropy estimate
+    return size >= 1024 && estimateEntropy(data, size) > ENTROPY_THRESHOLD;
+}
+
+bool isText(const uint8_t* data, size_t size) {
+    if (size == 0) {
+        return false;
+    }
+
+    size_t controlBytes = 0;
+    for (size_t i = 0; i < size; i++) {
+        uint8_t byte = data[i];
+        if (byte == 0) {
+            return false;  // NUL never appears in text, but fills UTF-16 and binary data
+        }
+        if (byte < 0x20 && byte != '\n' && byte != '\r' && byte != '\t') {
+            controlBytes++;
+        }
+    }
+    return controlBytes <= size * TEXT_CONTROL_RATIO;
+}
+
+FileProfile probeFile(const std::string& filePath) {
+    std::ifstream file(filePath, std::ios::binary);
+    io::checkOpen(file, filePath, "Content probe");
+
+    // Only the head of the file is inspected to keep the check cheap
+    std::vector<uint8_t> sample(SAMPLE_SIZE);
+    file.read(reinterpret_cast<char*>(sample.data()), sample.size());
+    if (file.bad()) {
+        throw std::runtime_error("Content probe failed: could not read '" + filePath + "'");
+    }
+    size_t sampleSize = static_cast<size_t>(file.gcount());
+
+    FileProfile profile;
+    profile.incompressible = isIncompressible(sample.data(), sampleSize);
+    profile.text = !profile.incompressible && isText(sample.data(), sampleSize);
+    return profile;
+}
+
+bool isIncompressibleFile(const std::string& filePath) {
+    return probeFile(filePath).incompressible;
+}
+
+std::string KnownFormatToString(KnownFormat format) {
+    switch (format) {
+        case KnownFormat::GZIP: return "GZIP";
+        case KnownFormat::ZSTD: return "ZSTD";
+        case KnownFormat::BZIP2: return "BZIP2";
+        case KnownFormat::XZ: return "XZ";
+        case KnownFormat::LZ4: return "LZ4";
+        case KnownFormat::ZIP: return "ZIP";
+        case KnownFormat::SEVEN_ZIP: return "7Z";
+        default: return "UNKNOWN";
+    }
+}
+
+} // namespace probe
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <string_view>
+#include <unordered_set>
+
+#include "Chunker.h"
+#include "Compressor.h"
+#include "DeltaPlanner.h"
+#include "IO.h"
+#include "ThreadPool.h"
+
+namespace compression {
+
+namespace {
+
+// Content-defined chunks of a file as (hash, size) pairs
+using ChunkSignature = std::vector<std::pair<size_t, uint64_t>>;
+
+ChunkSignature chunkSignature(const std::filesystem::path& filePath) {
+    std::ifstream input(filePath, std::ios::binary);
+    io::checkOpen(input, filePath.string(), "Overlap detection");
+    ChunkSignature signature;
+    chunking::splitStream(input, chunking::ChunkParams::forAverage(OVERLAP_CHUNK_SIZE), [&](const char* data, size_t size) {
+        signature.emplace_back(std::hash<std::string_view>()(std::string_view(data, size)), size);
+    });
+    return signature;
+}
+
+// Share of the bytes of a signature whose chunks also occur in the reference signature
+double signatureOverlap(const ChunkSignature& file, const ChunkSignature& reference) {
+    std::unordered_set<size_t> referenceChunks;
+    for (const auto& [hash, size] : reference) {
+        referenceChunks.insert(hash);
+    }
+    uint64_t total = 0;
+    uint64_t shared = 0;
+    for (const auto& [hash, size] : file) {
+        total += size;
+        if (referenceChunks.count(hash)) {
+            shared += size;
+        }
+    }
+    return total == 0 ? 0.0 : static_cast<double>(shared) / total;
+}
+
+}  // namespace
+
+std::pair<std::string, unsigned> rotationFamily(const std::string& relativePath) {
+    size_t dot = relativePath.find_last_of('.');
+    size_t slash = relativePath.find_last_of('/');
+    if (dot == std::string::npos || dot + 1 == relativePath.size() || (slash != std::string::npos && dot < slash)) {
+        return {relativePath, 0};
+    }
+    std::string suffix = relativePath.substr(dot + 1);
+    if (suffix.size() > 9 || !std::all_of(suffix.begin(), suffix.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        return {relativePath, 0};  // Not a rotation counter (an extension, or a date that would overflow)
+    }
+    return {relativePath.substr(0, dot), static_cast<unsigned>(std::stoul(suffix))};
+}
+
+double contentOverlap(const std::filesystem::path& filePath, const std::filesystem::path& referencePath) {
+    return signatureOverlap(chunkSignature(filePath), chunkSignature(referencePath));
+}
+
+std::unordered_map<std::string, std::string>
+planDeltaChains(const std::vector<std::pair<std::filesystem::path, std::string>>& files, int maxDepth) {
+    // Group files by rotation family, newest generation first
+    std::map<std::string, std::vector<std::pair<unsigned, const std::pair<std::filesystem::path, std::string>*>>> families;
+    for (const auto& file : files) {
+        auto [family, generation] = rotationFamily(file.second);
+        families[family].emplace_back(generation, &file);
+    }
+
+    std::vector<const std::pair<std::filesystem::path, std::string>*> members;  // Files in families of two or more
+    for (auto& [family, generations] : families) {
+        std::sort(generations.begin(), generations.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        if (generations.size() > 1) {
+            for (const auto& [generation, file] : generations) {
+                members.push_back(file);
+            }
+        }
+    }
+
+    // Each member is chunked once and compared with its neighbour from the signatures
+    std::vector<ChunkSignature> signatures(members.size());
+    threading::ThreadPool::getInstance().parallelFor(members.begin(), members.end(), [&](auto it, size_t index) {
+        signatures[index] = chunkSignature((*it)->first);
+    });
+    std::unordered_map<const std::pair<std::filesystem::path, std::string>*, size_t> signatureIndex;
+    for (size_t i = 0; i < members.size(); i++) {
+        signatureIndex[members[i]] = i;
+    }
+
+    std::unordered_map<std::string, std::string> references;
+    for (const auto& [family, generations] : families) {
+        int depth = 0;  // Depth of the previous member in its chain
+        for (size_t i = 1; i < generations.size(); i++) {
+            const auto* file = generations[i].second;
+            const auto* neighbour = generations[i - 1].second;
+            uint64_t window = std::filesystem::file_size(file->first) + std::filesystem::file_size(neighbour->first);
+            bool fits = window <= (uint64_t(1) << MAX_DELTA_WINDOW_LOG);  // Decoder holds both in one window
+            if (depth < maxDepth && fits &&
+                signatureOverlap(signatures[signatureIndex.at(file)], signatures[signatureIndex.at(neighbour)]) >= MIN_DELTA_OVERLAP) {
+                references[file->second] = neighbour->second;
+                depth++;
+            } else {
+                depth = 0;  // Stored as a plain stream and starts a new chain
+            }
+        }
+    }
+    return references;
+}
+
+}  // End of compression namespace
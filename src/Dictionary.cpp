@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef HAVE_ZSTD
+#include <zdict.h>
+#endif
+
+#include "Dictionary.h"
+#include "HashUtils.h"
+
+namespace compression {
+
+std::string trainDictionary(const std::vector<std::string>& samples, size_t maxSize) {
+    size_t sampledBytes = 0;
+    for (const auto& sample : samples) {
+        sampledBytes += sample.size();
+    }
+    maxSize = std::min(maxSize, sampledBytes / DICTIONARY_SAMPLE_RATIO);  // Embedding it must stay cheap
+    if (samples.size() < MIN_DICTIONARY_SAMPLES || maxSize == 0) {
+        return "";
+    }
+
+#ifdef HAVE_ZSTD
+    // ZDICT takes the samples back to back with their sizes alongside
+    std::string buffer;
+    std::vector<size_t> sampleSizes;
+    for (const auto& sample : samples) {
+        buffer += sample;
+        sampleSizes.push_back(sample.size());
+    }
+
+    std::string dictionary(maxSize, '\0');
+    size_t size = ZDICT_trainFromBuffer(&dictionary[0], dictionary.size(), buffer.data(),
+                                        sampleSizes.data(), static_cast<unsigned>(sampleSizes.size()));
+    if (ZDICT_isError(size)) {
+        return "";  // Too little or too uniform data to learn from
+    }
+    dictionary.resize(size);
+    return dictionary;
+#else
+    // Without a trainer, give every sample an equal share; later samples end up nearest to the data
+    size_t share = std::max<size_t>(maxSize / samples.size(), 1);
+    std::string dictionary;
+    for (const auto& sample : samples) {
+        if (dictionary.size() >= maxSize) {
+            break;
+        }
+        dictionary.append(sample, 0, std::min({share, sample.size(), maxSize - dictionary.size()}));
+    }
+    return dictionary;
+#endif
+}
+
+uint32_t dictionaryId(const std::string& content) {
+    std::string hash = hashutils::computeSHA256FromDataBuffer(reinterpret_cast<const uint8_t*>(content.data()),
+                                                              content.size());
+    uint32_t id = static_cast<uint32_t>(std::stoul(hash.substr(0, 8), nullptr, 16));
+    return id == 0 ? 1 : id;
+}
+
+std::string dictionaryName(uint32_t id) {
+    char name[9];
+    std::snprintf(name, sizeof(name), "%08x", id);
+    return name;
+}
+
+io::Attribute dictionarySection(uint32_t id, const std::string& content) {
+    return {io::TAG_DICTIONARY, io::encodeValue(id) + content};
+}
+
+io::Attribute dictionaryReferenceSection(uint32_t id) {
+    return {io::TAG_DICTIONARY_REF, io::encodeValue(id)};
+}
+
+DictionaryMap readDictionarySections(const std::vector<io::Attribute>& sections) {
+    DictionaryMap dictionaries;
+    for (const auto& [tag, payload] : sections) {
+        if (tag != io::TAG_DICTIONARY) {
+            continue;
+        }
+        if (payload.size() < sizeof(uint32_t)) {
+            throw std::runtime_error("Invalid archive: malformed dictionary section");
+        }
+        uint32_t id = io::decodeValue<uint32_t>(payload.substr(0, sizeof(uint32_t)));
+        dictionaries[id] = std::make_shared<const std::string>(payload.substr(sizeof(uint32_t)));
+    }
+    return dictionaries;
+}
+
+namespace {
+
+// Index of path families, one "<id> <pattern>" line per family
+const char* const FAMILY_INDEX = "families";
+
+// Writes a file under a temporary name and renames it, so concurrent readers never see it half written
+void writeAtomically(const std::filesystem::path& path, const std::string& content) {
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        io::checkOpen(file, temporary.string(), "Dictionary registry");
+        file.write(content.data(), content.size());
+        if (!file) {
+            throw std::runtime_error("Failed to write " + temporary.string());
+        }
+    }
+    std::filesystem::rename(temporary, path);
+}
+
+}  // namespace
+
+DictionaryRegistry::DictionaryRegistry(const std::filesystem::path& directory) : directory(directory) {
+    std::ifstream index(directory / FAMILY_INDEX);
+    std::string line;
+    while (std::getline(index, line)) {
+        size_t separator = line.find(' ');
+        if (separator == std::string::npos) {
+            continue;  // Tolerate a damaged line; the family is simply retrained
+        }
+        families[line.substr(separator + 1)] = static_cast<uint32_t>(std::stoul(line.substr(0, separator), nullptr, 16));
+    }
+}
+
+uint32_t DictionaryRegistry::familyDictionary(const std::string& pattern) const {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto it = families.find(pattern);
+    return it == families.end() ? 0 : it->second;
+}
+
+uint32_t DictionaryRegistry::add(const std::string& pattern, const std::string& content) {
+    uint32_t id = dictionaryId(content);
+    std::filesystem::path file = directory / (dictionaryName(id) + ".dict");
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (!std::filesystem::exists(file)) {
+        std::filesystem::create_directories(directory);
+        writeAtomically(file, content);
+    }
+    families[pattern] = id;
+    loaded.emplace(id, std::make_shared<const std::string>(content));
+    return id;
+}
+
+std::shared_ptr<const std::string> DictionaryRegistry::load(uint32_t id) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto it = loaded.find(id);
+    if (it != loaded.end()) {
+        return it->second;
+    }
+
+    std::filesystem::path file = directory / (dictionaryName(id) + ".dict");
+    std::ifstream input(file, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Dictionary " + dictionaryName(id) + " not found in registry " + directory.string());
+    }
+    std::string content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    if (dictionaryId(content) != id) {
+        throw std::runtime_error("Corrupt dictionary " + file.string() + ": content does not match its id");
+    }
+    return loaded.emplace(id, std::make_shared<const std::string>(std::move(content))).first->second;
+}
+
+void DictionaryRegistry::save() const {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (families.empty()) {
+        return;
+    }
+    std::ostringstream index;
+    for (const auto& [pattern, id] : families) {
+        index << dictionaryName(id) << ' ' << pattern << '\n';
+    }
+    std::filesystem::create_directories(directory);
+    writeAtomically(directory / FAMILY_INDEX, index.str());
+}
+
+}  // End of compression namespace
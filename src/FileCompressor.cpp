@@ -1,19 +1,500 @@
+#include <atomic>
 #include <filesystem>
 #include <fstream>
+#include <algorithm>
+#include <cctype>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <unordered_set>
+#include <functional>
 #include <future>
 #include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <tuple>
 
+#include "ArchiveReader.h"
+#include "Catalog.h"
+#include "Chunker.h"
+#include "CodecSelector.h"
+#include "CompressionOptions.h"
 #include "CompressorFactory.h"
+#include "ContentProbe.h"
+#include "DeltaPlanner.h"
+#include "Dictionary.h"
 #include "FileCompressor.h"
 #include "FileMeta.h"
+#include "GramFilter.h"
 #include "HashUtils.h"
 #include "IO.h"
+#include "JsonLinesCodec.h"
+#include "LineStore.h"
+#include "Similarity.h"
+#include "TemplateCodec.h"
 #include "ThreadPool.h"
+#include "TimestampCodec.h"
+#include "Transcoder.h"
 
 namespace compression {
 
+namespace {
+
+// Where a unique file's data lives, shared with its duplicates
+struct EntryLocation {
+    uint64_t dataOffset;   // Start of the compressed stream in the archive
+    int64_t blockId;       // Solid block id, -1 for a standalone stream
+    uint64_t blockOffset;  // Position of the data inside the decompressed block
+};
+
+// Read-only stream buffer over memory owned elsewhere, so a large buffer is compressed without a copy
+class ViewBuffer : public std::streambuf {
+public:
+    explicit ViewBuffer(const std::string& data) {
+        char* begin = const_cast<char*>(data.data());
+        setg(begin, begin, begin + data.size());
+    }
+};
+
+// Text stages a standalone stream is passed through before compression
+struct TextStages {
+    transcoding::Encoding encoding = transcoding::Encoding::NONE;  // Transcoded to UTF-8 from this encoding
+    bool timestamps = false;                                       // Leading timestamps moved to their own column
+    bool templates = false;                                        // Lines split into templates and variable columns
+    bool json = false;                                             // JSON-lines records split into per-key columns
+
+    bool any() const { return encoding != transcoding::Encoding::NONE || timestamps || columnar(); }
+
+    // Columns hold no lines for the line store to match
+    bool columnar() const { return templates || json; }
+};
+
+// A file as a standalone stream sees it before compression: transcoded to UTF-8, then either split into
+// JSON or template columns or its timestamps split off and encoded through the line store, each stage only
+// when given
+class EncodedInput {
+public:
+    EncodedInput(std::istream& file, uint64_t fileSize, const TextStages& stages, const lines::LineStore* lineStore)
+        : current(&file) {
+        if (stages.encoding != transcoding::Encoding::NONE) {
+            transcoder.emplace(*current, stages.encoding, fileSize);
+            transcoded.emplace(&*transcoder);
+            transcoded->exceptions(std::ios::badbit);  // Rethrows transcoding errors
+            current = &*transcoded;
+        }
+        if (stages.json) {
+            jsonEncoder.emplace(*current);
+            jsonEncoded.emplace(&*jsonEncoder);
+            jsonEncoded->exceptions(std::ios::badbit);
+            current = &*jsonEncoded;
+        }
+        if (stages.templates) {
+            templateEncoder.emplace(*current);
+            templateEncoded.emplace(&*templateEncoder);
+            templateEncoded->exceptions(std::ios::badbit);
+            current = &*templateEncoded;
+        }
+        if (stages.timestamps) {
+            timestampEncoder.emplace(*current);
+            timestampEncoded.emplace(&*timestampEncoder);
+            timestampEncoded->exceptions(std::ios::badbit);
+            current = &*timestampEncoded;
+        }
+        if (lineStore) {
+            lineEncoder.emplace(*current, *lineStore);
+            lineEncoded.emplace(&*lineEncoder);
+            current = &*lineEncoded;
+        }
+    }
+
+    std::istream& stream() { return *current; }
+
+private:
+    std::optional<transcoding::ToUtf8Buffer> transcoder;
+    std::optional<std::istream> transcoded;
+    std::optional<jsonlines::EncodingBuffer> jsonEncoder;
+    std::optional<std::istream> jsonEncoded;
+    std::optional<templates::EncodingBuffer> templateEncoder;
+    std::optional<std::istream> templateEncoded;
+    std::optional<timestamps::EncodingBuffer> timestampEncoder;
+    std::optional<std::istream> timestampEncoded;
+    std::optional<lines::EncodingBuffer> lineEncoder;
+    std::optional<std::istream> lineEncoded;
+    std::istream* current;
+};
+
+constexpr size_t INDEX_READ_SIZE = 1 << 20;  // Bytes read at a time while indexing text
+
+// Reads a file once in the UTF-8 form search sees and records in its entry the n-gram filter and the
+// range of line timestamps the options ask for
+void indexText(const std::filesystem::path& filePath, meta::FileMeta& meta, const CompressionOptions& options) {
+    std::ifstream file(filePath, std::ios::binary);
+    io::checkOpen(file, filePath.string(), "Text indexing");
+    TextStages stages;
+    stages.encoding = transcoding::detectFileEncoding(filePath);
+    EncodedInput input(file, std::filesystem::file_size(filePath), stages, nullptr);
+
+    std::unique_ptr<grams::GramSet> gramSet;  // Exact set of 2MB, built only for a filter
+    if (options.gramFilters) {
+        gramSet = std::make_unique<grams::GramSet>();
+    }
+    timestamps::TimeRangeScanner times;
+    std::vector<char> buffer(INDEX_READ_SIZE);
+    while (input.stream()) {
+        input.stream().read(buffer.data(), buffer.size());
+        size_t size = static_cast<size_t>(input.stream().gcount());
+        if (gramSet) {
+            gramSet->add(buffer.data(), size);
+        }
+        if (options.timeIndex) {
+            times.add(buffer.data(), size);
+        }
+    }
+    if (gramSet) {
+        meta.gramFilter = grams::buildFilter(*gramSet);
+    }
+    if (times.found()) {
+        meta.minTimestamp = times.minTimestamp();
+        meta.maxTimestamp = times.maxTimestamp();
+    }
+}
+
+// Files packed together into one compressed stream
+struct SolidBlock {
+    std::vector<std::pair<std::filesystem::path, std::string>> files;  // Files in stream order with relative paths
+    uint64_t size = 0;                                                 // Sum of the file sizes
+};
+
+// Orders files so that similar content ends up adjacent in a block: by the extension and name of the
+// file with digit runs masked (rotations and per-host copies line up), then by directory
+std::string solidOrderKey(const std::string& relativePath) {
+    std::filesystem::path path(relativePath);
+    std::string maskedName;
+    for (char c : path.filename().string()) {
+        if (!std::isdigit(static_cast<unsigned char>(c))) {
+            maskedName += c;
+        } else if (maskedName.empty() || maskedName.back() != '#') {
+            maskedName += '#';
+        }
+    }
+    return std::filesystem::path(maskedName).extension().string() + '\n' + maskedName + '\n' +
+           path.parent_path().string() + '\n' + relativePath;
+}
+
+// Moves files smaller than the block size out of uniqueFiles and packs them, in similarity order,
+// into blocks of at most blockSize bytes. With cluster set, near-duplicate content is also kept
+// together when names differ: each cluster is emitted as a whole where its first member sorts.
+std::vector<SolidBlock> packSolidBlocks(std::vector<std::pair<std::filesystem::path, std::string>>& uniqueFiles,
+                                        uint64_t blockSize, bool cluster) {
+    std::vector<std::tuple<std::string, uint64_t, std::pair<std::filesystem::path, std::string>>> candidates;
+    std::vector<std::pair<std::filesystem::path, std::string>> standalone;
+    for (auto& file : uniqueFiles) {
+        uint64_t fileSize = std::filesystem::file_size(file.first);
+        if (fileSize < blockSize) {
+            candidates.emplace_back(solidOrderKey(file.second), fileSize, std::move(file));
+        } else {
+            standalone.push_back(std::move(file));  // Large files already fill a window on their own
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto& a, const auto& b) { return std::get<0>(a) < std::get<0>(b); });
+
+    if (cluster) {
+        std::vector<similarity::Sketch> sketches(candidates.size());
+        threading::ThreadPool::getInstance().parallelFor(candidates.begin(), candidates.end(), [&](auto it, size_t index) {
+            sketches[index] = similarity::sketchFile(std::get<2>(*it).first);
+        });
+        std::vector<size_t> clusters = similarity::clusterSketches(sketches);
+        std::map<size_t, std::vector<size_t>> members;  // Cluster id to its members in name order
+        for (size_t i = 0; i < candidates.size(); i++) {
+            members[clusters[i]].push_back(i);
+        }
+
+        std::vector<std::tuple<std::string, uint64_t, std::pair<std::filesystem::path, std::string>>> clustered;
+        clustered.reserve(candidates.size());
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (clusters[i] == i) {  // The first member of a cluster in name order is its id
+                for (size_t member : members[i]) {
+                    clustered.push_back(std::move(candidates[member]));
+                }
+            }
+        }
+        candidates = std::move(clustered);
+    }
+
+    std::vector<SolidBlock> blocks;
+    for (auto& [key, fileSize, file] : candidates) {
+        if (blocks.empty() || blocks.back().size + fileSize > blockSize) {
+            blocks.emplace_back();  // Start a new block when the current one would overflow
+        }
+        blocks.back().files.push_back(std::move(file));
+        blocks.back().size += fileSize;
+    }
+
+    // A block holding a single file gains nothing over a standalone stream
+    std::vector<SolidBlock> packed;
+    for (auto& block : blocks) {
+        if (block.files.size() == 1) {
+            standalone.push_back(std::move(block.files.front()));
+        } else {
+            packed.push_back(std::move(block));
+        }
+    }
+    uniqueFiles = std::move(standalone);
+    return packed;
+}
+
+// Gives every path family of small files a dictionary and maps each file of those families to it.
+// Families known to the registry reuse their stored dictionary unless retrain is set; the others
+// are trained and, with a registry, stored in it. Returns the number of dictionaries trained.
+size_t assignFamilyDictionaries(const std::vector<std::pair<std::filesystem::path, std::string>>& files,
+                                size_t dictionarySize, DictionaryRegistry* registry, bool retrain,
+                                DictionaryMap& dictionaries, std::unordered_map<std::string, uint32_t>& fileDictionaries) {
+    std::map<std::string, std::vector<const std::pair<std::filesystem::path, std::string>*>> families;
+    for (const auto& file : files) {
+        if (std::filesystem::file_size(file.first) < MAX_DICTIONARY_FILE_SIZE) {
+            families[CodecSelector::pathPattern(file.second)].push_back(&file);
+        }
+    }
+
+    std::vector<const decltype(families)::value_type*> pending;  // Families in the order they are processed
+    for (const auto& family : families) {
+        pending.push_back(&family);
+    }
+
+    std::mutex dictionaryMutex;  // Protects dictionaries and fileDictionaries
+    std::atomic<size_t> trained{0};
+    threading::ThreadPool::getInstance().parallelFor(pending.begin(), pending.end(), [&](auto it, size_t) {
+        const auto& [pattern, members] = **it;
+        auto assign = [&](uint32_t id, std::shared_ptr<const std::string> dictionary) {
+            std::lock_guard<std::mutex> lock(dictionaryMutex);
+            dictionaries.emplace(id, std::move(dictionary));
+            for (const auto* member : members) {
+                fileDictionaries[member->second] = id;
+            }
+        };
+
+        // A family seen in an earlier run reuses its dictionary at no training cost, however few files it has now
+        uint32_t knownId = registry && !retrain ? registry->familyDictionary(pattern) : 0;
+        if (knownId != 0) {
+            try {
+                assign(knownId, registry->load(knownId));
+                return;
+            } catch (const std::runtime_error& e) {
+                std::cout << "Retraining dictionary for " << pattern << ": " << e.what() << std::endl;
+            }
+        }
+        if (members.size() < MIN_DICTIONARY_SAMPLES) {
+            return;  // Too few files would teach the dictionary nothing general
+        }
+
+        // Sample the heads of files spread evenly across the family
+        std::vector<std::string> samples;
+        size_t step = std::max<size_t>(members.size() / MAX_DICTIONARY_SAMPLES, 1);
+        for (size_t i = 0; i < members.size() && samples.size() < MAX_DICTIONARY_SAMPLES; i += step) {
+            std::ifstream file(members[i]->first, std::ios::binary);
+            io::checkOpen(file, members[i]->first.string(), "Dictionary training");
+            std::string sample(DICTIONARY_SAMPLE_SIZE, '\0');
+            file.read(&sample[0], sample.size());
+            sample.resize(file.gcount());
+            samples.push_back(std::move(sample));
+        }
+
+        std::string dictionary = trainDictionary(samples, dictionarySize);
+        if (dictionary.empty()) {
+            return;  // Family compresses without a dictionary
+        }
+        trained++;
+        uint32_t id = registry ? registry->add(pattern, dictionary) : dictionaryId(dictionary);
+        assign(id, std::make_shared<const std::string>(std::move(dictionary)));
+    });
+    return trained;
+}
+
+// What the chunk store kept of the files routed through it
+struct ChunkStoreStats {
+    uint64_t totalBytes = 0;    // Bytes in all chunked files
+    uint64_t storedBytes = 0;   // Bytes in distinct chunks
+    uint64_t chunks = 0;        // Chunks in all chunked files
+    uint64_t uniqueChunks = 0;  // Distinct chunks
+    uint64_t blocks = 0;        // Compressed blocks holding the distinct chunks
+    uint64_t rawBlocks = 0;     // Blocks stored without compression because they would not shrink
+};
+
+// Splits files into content-defined chunks and hashes them in parallel; only the hashes and lengths are kept
+std::vector<chunking::FileChunks> hashFileChunks(const std::vector<std::pair<std::filesystem::path, std::string>>& files,
+                                                 const chunking::ChunkParams& params) {
+    std::vector<chunking::FileChunks> fileChunks(files.size());
+    threading::ThreadPool::getInstance().parallelFor(files.begin(), files.end(), [&](auto fileIt, size_t index) {
+        std::ifstream input(fileIt->first, std::ios::binary);
+        io::checkOpen(input, fileIt->first.string(), "Chunking");
+        chunking::splitStream(input, params, [&](const char* data, size_t size) {
+            fileChunks[index].emplace_back(
+                hashutils::computeSHA256FromDataBuffer(reinterpret_cast<const uint8_t*>(data), size), size);
+        });
+    });
+    return fileChunks;
+}
+
+// Writes every distinct chunk of the files once into compressed blocks and then one chunk list per file.
+// Blocks the probe finds incompressible are stored with the NONE codec and listed in the archive sections.
+// Returns the archive offset of each file's chunk list.
+std::vector<uint64_t> storeChunkedFiles(const std::vector<std::pair<std::filesystem::path, std::string>>& files,
+                                        const std::vector<chunking::FileChunks>& fileChunks,
+                                        const Compressor& blockCompressor, const Compressor& rawCompressor,
+                                        std::ostream& archive, std::vector<io::Attribute>& sections,
+                                        ChunkStoreStats& stats) {
+    // Assemble distinct chunks into blocks in file order, so chunks of one file stay close together
+    struct StoredChunk {
+        size_t block;          // Index of the block holding the chunk
+        uint64_t blockOffset;  // Position of the chunk inside the block
+    };
+    std::unordered_map<std::string, StoredChunk> chunkIndex;  // Chunk hash to its stored copy
+    std::vector<int64_t> blockOffsets;                        // Archive offset of each written block
+    std::string block;                                        // Block being filled
+    auto flush = [&]() {
+        if (block.empty()) {
+            return;
+        }
+        const auto* sample = reinterpret_cast<const uint8_t*>(block.data());
+        size_t sampleSize = std::min<size_t>(block.size(), probe::SAMPLE_SIZE);
+        StreamHints hints{block.size(), probe::isText(sample, sampleSize)};
+        bool raw = probe::isIncompressible(sample, sampleSize);
+        blockOffsets.push_back(archive.tellp());
+        if (raw) {
+            sections.push_back(chunking::rawBlockSection(blockOffsets.back()));
+            stats.rawBlocks++;
+        }
+        std::istringstream blockStream(std::move(block));
+        (raw ? rawCompressor : blockCompressor).compressStream(blockStream, archive, hints);
+        block.clear();
+    };
+
+    std::vector<std::vector<chunking::ChunkRef>> recipes(files.size());
+    std::string chunk;
+    for (size_t i = 0; i < files.size(); i++) {
+        std::ifstream input(files[i].first, std::ios::binary);
+        io::checkOpen(input, files[i].first.string(), "Chunking");
+        for (const auto& [hash, length] : fileChunks[i]) {
+            chunk.resize(length);
+            io::readBuffer(input, &chunk[0], length);
+            stats.totalBytes += length;
+            stats.chunks++;
+
+            auto [stored, isNew] = chunkIndex.try_emplace(hash, StoredChunk{blockOffsets.size(), block.size()});
+            if (isNew) {
+                block += chunk;
+                stats.storedBytes += length;
+                stats.uniqueChunks++;
+            }
+            // The block index stands in for the block's archive offset until the block is written
+            recipes[i].push_back({static_cast<int64_t>(stored->second.block), stored->second.blockOffset, length});
+            if (block.size() >= chunking::CHUNK_BLOCK_SIZE) {
+                flush();
+            }
+        }
+    }
+    flush();
+    stats.blocks = blockOffsets.size();
+
+    std::vector<uint64_t> recipeOffsets;
+    for (auto& recipe : recipes) {
+        for (auto& ref : recipe) {
+            ref.dataOffset = blockOffsets[ref.dataOffset];
+        }
+        recipeOffsets.push_back(archive.tellp());
+        chunking::writeRecipe(archive, recipe);
+    }
+    return recipeOffsets;
+}
+
+// Copy of an entry under another path, for a duplicate taking over the data of a replaced original
+meta::FileMeta renamedEntry(const meta::FileMeta& source, const std::string& relativePath) {
+    meta::FileMeta entry(source.dataOffset, source.hash, relativePath, source.codec, source.level, source.originalSize);
+    entry.windowLog = source.windowLog;
+    entry.blockId = source.blockId;
+    entry.blockOffset = source.blockOffset;
+    entry.dictionaryId = source.dictionaryId;
+    entry.chunked = source.chunked;
+    entry.deltaReference = source.deltaReference;
+    entry.lineEncoded = source.lineEncoded;
+    entry.textEncoding = source.textEncoding;
+    entry.timestampEncoded = source.timestampEncoded;
+    entry.templateEncoded = source.templateEncoded;
+    entry.jsonEncoded = source.jsonEncoded;
+    entry.gramFilter = source.gramFilter;
+    entry.minTimestamp = source.minTimestamp;
+    entry.maxTimestamp = source.maxTimestamp;
+    entry.baseEntry = source.baseEntry;
+    return entry;
+}
+
+// Drops the entries of replaced files from an append base. The data of a dropped original stays in
+// place for its duplicates, the first of which takes over its entry. An original that delta streams
+// still decode against, such as a live log whose rotations are deltas of it, is kept as a retained
+// entry section: it lists no file, but readers find its stream by data offset.
+void dropReplacedEntries(AppendBase& base, const std::unordered_set<std::string>& replaced) {
+    std::map<std::pair<int64_t, uint64_t>, const meta::FileMeta*> droppedOriginals;  // By data location
+    for (const auto& entry : base.metadata) {
+        if (replaced.count(entry.relativePath) != 0 && !entry.isDuplicate()) {
+            droppedOriginals.emplace(std::make_pair(entry.dataOffset, entry.blockOffset), &entry);
+        }
+    }
+
+    std::vector<meta::FileMeta> kept;
+    for (const auto& entry : base.metadata) {
+        if (replaced.count(entry.relativePath) != 0) {
+            continue;
+        }
+        auto original = entry.isDuplicate() ? droppedOriginals.find({entry.dataOffset, entry.blockOffset})
+                                            : droppedOriginals.end();
+        if (original != droppedOriginals.end()) {
+            kept.push_back(renamedEntry(*original->second, entry.relativePath));
+            kept.back().modifiedTime = entry.modifiedTime;
+            droppedOriginals.erase(original);
+        } else {
+            kept.push_back(entry);
+        }
+    }
+    std::set<int64_t> deltaReferences;  // Data offsets delta streams decode against
+    auto addReference = [&](const meta::FileMeta& entry) {
+        if (entry.isDelta()) {
+            deltaReferences.insert(entry.deltaReference);
+        }
+    };
+    for (const auto& entry : kept) {
+        addReference(entry);
+    }
+    for (const auto& entry : io::readRetainedEntries(base.sections)) {
+        addReference(entry);
+    }
+    for (bool retaining = true; retaining;) {  // A retained delta keeps its own reference in turn
+        retaining = false;
+        for (auto original = droppedOriginals.begin(); original != droppedOriginals.end();) {
+            if (deltaReferences.count(original->second->dataOffset) != 0) {
+                base.sections.push_back(io::retainedEntrySection(*original->second));
+                addReference(*original->second);
+                original = droppedOriginals.erase(original);
+                retaining = true;
+            } else {
+                ++original;
+            }
+        }
+    }
+    base.metadata = std::move(kept);
+}
+
+// Registers a finished archive in the catalog the options name, if any
+void registerInCatalog(const CompressionOptions& options, const std::string& archiveFile) {
+    if (!options.catalogFile.empty()) {
+        catalog::updateCatalog(options.catalogFile, {archiveFile});
+        std::cout << "Registered in catalog: " << options.catalogFile << "\n";
+    }
+}
+
+}  // namespace
+
 std::pair<std::unordered_map<std::string, std::string>, std::unordered_map<std::string, std::string>>
 FileCompressor::computeHashes(const std::vector<std::filesystem::path>& filePaths, const std::filesystem::path& rootPath) {
     threading::ThreadPool& threadPool = threading::ThreadPool::getInstance();  // Get thread pool for parallel processing
@@ -46,25 +527,147 @@ FileCompressor::computeHashes(const std::vector<std::filesystem::path>& filePath
     return {hashToPathMap, pathToHashMap};
 }
 
+CompressorSettings FileCompressor::codecSettings(const CompressionOptions& options, size_t poolThreads) {
+    CompressorSettings settings;
+    settings.longDistance = options.longDistance;
+    settings.windowLog = options.windowLog;
+    settings.workers = options.workers;
+    if (settings.workers == AUTO_WORKERS) {
+        // Archive writes are serialized, so only one file is compressed at a time while the other pool
+        // threads wait on the archive lock. Give the codec as many workers as the pool has threads so the
+        // two together keep every core busy without oversubscribing them.
+        settings.workers = poolThreads > 1 ? static_cast<int>(poolThreads) : 0;
+    }
+    return settings;
+}
+
 std::vector<meta::FileMeta> 
 FileCompressor::compressFiles(const std::string& inputDir, std::ofstream& archive, CompressionType compType) {
+    CompressionOptions options;
+    options.compType = compType;
+    return compressFiles(inputDir, archive, options);
+}
+
+std::vector<meta::FileMeta> 
+FileCompressor::compressFiles(const std::string& inputDir, std::ofstream& archive, const CompressionOptions& options,
+                              AppendBase* base) {
 
     threading::ThreadPool& threadPool = threading::ThreadPool::getInstance();  // Get thread pool for parallel processing
     std::vector<meta::FileMeta> metadata;  // Container for file metadata
     
-    // Scan directory and compute file hashes
-    auto filePaths = io::scanDirectory(inputDir);  // Get all files in the input directory
-    auto [hashToPathMap, pathToHashMap] = computeHashes(filePaths, std::filesystem::path(inputDir));  // Calculate file hashes
+    // Scan directory and compute file hashes. An incremental archive takes the hash of a file whose size and
+    // modification time match its entry in the base archive from that entry instead of reading the file.
+    std::vector<std::filesystem::path> filePaths;  // The files selected, or all files in the input directory
+    for (const auto& relativePath : options.files) {
+        filePaths.push_back(std::filesystem::path(inputDir) / relativePath);
+    }
+    if (options.files.empty()) {
+        filePaths = io::scanDirectory(inputDir);
+    }
+    // Size and modification time of each file are taken before any of its bytes are read, so a file that
+    // changes while it is archived looks changed to the next incremental archive
+    std::unordered_map<std::string, std::pair<uint64_t, int64_t>> fileStamps;  // Relative path to size and time
+    for (const auto& filePath : filePaths) {
+        fileStamps[std::filesystem::relative(filePath, inputDir).string()] = {std::filesystem::file_size(filePath),
+                                                                              io::modificationTime(filePath)};
+    }
+    std::unique_ptr<ArchiveReader> baseArchive;
+    std::unordered_map<std::string, std::string> knownHashes;  // Relative path to the hash its base entry records
+    std::vector<std::filesystem::path> changedPaths;  // Files hashed anew
+    if (!options.baseArchive.empty()) {
+        baseArchive = std::make_unique<ArchiveReader>(options.baseArchive, options.dictionaryRegistry);
+        for (const auto& filePath : filePaths) {
+            std::string relativePath = std::filesystem::relative(filePath, inputDir).string();
+            const meta::FileMeta* entry = baseArchive->find(relativePath);
+            const auto& [size, modifiedTime] = fileStamps.at(relativePath);
+            if (entry && entry->modifiedTime != 0 && entry->modifiedTime == modifiedTime &&
+                baseArchive->resolve(*entry).originalSize == size) {
+                knownHashes[relativePath] = baseArchive->resolve(*entry).hash;
+            } else {
+                changedPaths.push_back(filePath);
+            }
+        }
+    }
+    auto hashes = computeHashes(baseArchive ? changedPaths : filePaths, std::filesystem::path(inputDir));  // Calculate file hashes
+    auto& pathToHashMap = hashes.second;
+    pathToHashMap.insert(knownHashes.begin(), knownHashes.end());
     
-    auto compressor = createCompressor(compType);  // Create appropriate compressor based on compression type
+    const CompressionType compType = options.compType;  // Archive default codec
+    const CompressorSettings settings = codecSettings(options, threadPool.getThreadCount());  // Shared by every codec
+    CompressorCache compressors(settings);  // One shared compressor per codec and level in use
+    CodecSelector codecSelector(options.throughputTarget);  // Per-family codec choice for adaptive mode
 
     // Containers to separate unique files from duplicates
     std::vector<std::pair<std::filesystem::path, std::string>> uniqueFiles;  // Stores unique files with their relative paths
     std::vector<std::pair<std::filesystem::path, std::string>> duplicateFiles;  // Stores duplicate files with their relative paths
 
     std::filesystem::path rootPath(inputDir);  // Base path for calculating relative paths
+    std::unordered_map<std::string, EntryLocation> hashToLocationMap;  // Maps file hash to its data location in the archive
+
+    // An append skips files archived unchanged under their path and replaces the entries of changed ones;
+    // files whose content the archive already holds become duplicates of it
+    std::unordered_set<std::string> unchangedFiles;
+    int64_t firstBlockId = 0;  // New solid blocks are numbered after the archive's own
+    if (base) {
+        std::map<std::pair<int64_t, uint64_t>, const meta::FileMeta*> originals;  // Unique entries by data location
+        for (const auto& entry : base->metadata) {
+            if (!entry.isDuplicate() && !entry.isBaseReference()) {
+                originals.emplace(std::make_pair(entry.dataOffset, entry.blockOffset), &entry);
+            }
+        }
+        std::unordered_set<std::string> replaced;
+        for (const auto& entry : base->metadata) {
+            auto hash = pathToHashMap.find(entry.relativePath);
+            if (hash == pathToHashMap.end()) {
+                continue;
+            }
+            const meta::FileMeta* original = &entry;
+            if (entry.isDuplicate()) {
+                auto it = originals.find({entry.dataOffset, entry.blockOffset});
+                original = it != originals.end() ? it->second : nullptr;
+            }
+            if (original && original->hash == hash->second) {
+                unchangedFiles.insert(entry.relativePath);
+            } else {
+                replaced.insert(entry.relativePath);
+            }
+        }
+        dropReplacedEntries(*base, replaced);
+        for (const auto& entry : base->metadata) {
+            if (!entry.isDuplicate() && !entry.isBaseReference()) {
+                hashToLocationMap.emplace(entry.hash, EntryLocation{static_cast<uint64_t>(entry.dataOffset), entry.blockId,
+                                                                    entry.blockOffset});
+            }
+            firstBlockId = std::max(firstBlockId, entry.blockId + 1);
+        }
+    }
     
+    // An incremental archive references the base archive entry holding a file's content instead of storing
+    // it, preferring the entry under the same path, unless reading it would pass through more base archives
+    // than allowed; such files are stored again, which starts their chains over
+    std::vector<meta::FileMeta> baseReferences;
+    std::unordered_map<std::string, const meta::FileMeta*> baseContents;  // Hash to a base entry holding it
+    if (baseArchive) {
+        for (const auto& entry : baseArchive->entries()) {
+            if (!entry.isDuplicate()) {
+                baseContents.emplace(entry.hash, &entry);
+            }
+        }
+    }
+    auto findInBase = [&](const std::string& relativePath, const std::string& hash) -> const meta::FileMeta* {
+        const meta::FileMeta* entry = baseArchive->find(relativePath);
+        if (!entry || baseArchive->resolve(*entry).hash != hash) {
+            auto content = baseContents.find(hash);
+            entry = content != baseContents.end() ? content->second : nullptr;
+        }
+        if (entry && baseArchive->referenceDepth(*entry) >= static_cast<size_t>(options.baseDepth)) {
+            return nullptr;
+        }
+        return entry;
+    };
+
     // Classify files as either unique or duplicates based on their hashes
+    std::unordered_map<std::string, std::string> firstPaths;  // Hash to the first file stored with it
     for (const auto& filePath : filePaths) {
         if (std::filesystem::file_size(filePath) == 0) {  // Skip empty files
             continue;
@@ -73,13 +676,150 @@ FileCompressor::compressFiles(const std::string& inputDir, std::ofstream& archiv
         std::string relativePath = std::filesystem::relative(filePath, rootPath).string();  // Get path relative to root
         std::string hash = pathToHashMap.at(relativePath);  // Get file hash
         
-        if (hashToPathMap.at(hash) == relativePath) {  // If this is the first occurrence of this hash
+        const meta::FileMeta* referenced = baseArchive ? findInBase(relativePath, hash) : nullptr;
+        if (unchangedFiles.count(relativePath) != 0) {
+            std::cout << "Unchanged file: " << relativePath << std::endl;
+        } else if (referenced) {
+            const meta::FileMeta& source = baseArchive->resolve(*referenced);
+            meta::FileMeta meta(-1, hash, relativePath, CompressionType::NONE, 0, source.originalSize);
+            meta.baseEntry = referenced->relativePath;
+            meta.gramFilter = source.gramFilter;  // Search and time windows rule it out as they would the base entry
+            meta.minTimestamp = source.minTimestamp;
+            meta.maxTimestamp = source.maxTimestamp;
+            baseReferences.push_back(std::move(meta));
+            std::cout << "Base file: " << relativePath << std::endl;
+        } else if (hashToLocationMap.count(hash) == 0 && firstPaths.emplace(hash, relativePath).second) {  // If this is the first occurrence of this hash
             uniqueFiles.push_back({filePath, relativePath});  // Add to unique files
         } else {
             duplicateFiles.push_back({filePath, relativePath});  // Add to duplicate files
         }
     }
     
+    // Solid mode packs small files into shared blocks so they share one stream and one window
+    std::vector<SolidBlock> solidBlocks;
+    if (options.solidBlockSize > 0) {
+        solidBlocks = packSolidBlocks(uniqueFiles, options.solidBlockSize, options.clusterSimilar);
+    }
+
+    // Chunk mode takes the files solid mode left over that share enough chunks with each other and stores
+    // each distinct chunk of them once. The other files keep their own streams and every other mode.
+    std::vector<std::pair<std::filesystem::path, std::string>> chunkedFiles;
+    std::vector<chunking::FileChunks> chunkedHashes;
+    if (options.chunkSize > 0) {
+        std::sort(uniqueFiles.begin(), uniqueFiles.end(), [](const auto& a, const auto& b) {
+            return solidOrderKey(a.second) < solidOrderKey(b.second);  // Rotations of a log are chunked back to back
+        });
+        auto fileChunks = hashFileChunks(uniqueFiles, chunking::ChunkParams::forAverage(options.chunkSize));
+        std::vector<std::pair<std::filesystem::path, std::string>> unchunkedFiles;
+        auto selected = chunking::selectSharingFiles(fileChunks);
+        auto nextSelected = selected.begin();
+        for (size_t i = 0; i < uniqueFiles.size(); i++) {
+            if (nextSelected != selected.end() && *nextSelected == i) {
+                chunkedFiles.push_back(std::move(uniqueFiles[i]));
+                chunkedHashes.push_back(std::move(fileChunks[i]));
+                ++nextSelected;
+            } else {
+                unchunkedFiles.push_back(std::move(uniqueFiles[i]));
+            }
+        }
+        uniqueFiles = std::move(unchunkedFiles);
+    }
+
+    // Delta mode encodes rotated logs against their newer neighbour when they share content
+    std::unordered_map<std::string, std::string> deltaReferences;  // Relative path to the path of its reference
+    std::unordered_map<std::string, std::filesystem::path> uniquePaths;  // Relative path to the file on disk
+    if (options.deltaDepth > 0) {
+        deltaReferences = planDeltaChains(uniqueFiles, options.deltaDepth);
+        for (const auto& [filePath, relativePath] : uniqueFiles) {
+            uniquePaths[relativePath] = filePath;
+        }
+    }
+
+    // UTF-16 text is converted to UTF-8 before compression, halving the bytes the codec sees. In JSON mode
+    // files of JSON-lines records are stored as shape and per-key columns, in template mode files whose lines
+    // mostly share a few templates are stored as template and variable columns, and in timestamp mode files whose lines mostly start with a timestamp get them moved to a delta-encoded
+    // column. Delta streams need the raw file.
+    std::unordered_map<std::string, TextStages> fileStages;  // Relative path of each file with a text stage to its stages
+    if (options.transcodeUtf16 || options.timestampColumns || options.templateColumns || options.jsonColumns) {
+        std::mutex stagesMutex;
+        threadPool.parallelFor(uniqueFiles.begin(), uniqueFiles.end(), [&](auto fileIt, size_t) {
+            if (deltaReferences.count(fileIt->second) != 0) {
+                return;
+            }
+            TextStages stages;
+            if (options.transcodeUtf16) {
+                stages.encoding = transcoding::detectFileEncoding(fileIt->first);
+            }
+            if (options.timestampColumns || options.templateColumns || options.jsonColumns) {
+                std::ifstream input(fileIt->first, std::ios::binary);
+                io::checkOpen(input, fileIt->first.string(), "Text stage detection");
+                EncodedInput sampled(input, std::filesystem::file_size(fileIt->first), stages, nullptr);  // Sampled as UTF-8
+                std::string sample(probe::SAMPLE_SIZE, '\0');
+                sampled.stream().read(&sample[0], sample.size());
+                size_t sampleSize = static_cast<size_t>(sampled.stream().gcount());
+                stages.json = options.jsonColumns && jsonlines::hasJsonLines(sample.data(), sampleSize);
+                stages.templates = options.templateColumns && !stages.json &&
+                                   templates::hasTemplates(sample.data(), sampleSize);
+                stages.timestamps = options.timestampColumns && !stages.columnar() &&  // Columns hold their own timestamps
+                                    timestamps::hasTimestamps(sample.data(), sampleSize);
+            }
+            if (stages.any()) {
+                std::lock_guard<std::mutex> lock(stagesMutex);
+                fileStages[fileIt->second] = stages;
+            }
+        });
+    }
+
+    // Line mode stores each long line repeated across the remaining files once, in a line store written
+    // ahead of them, and the files encode those lines as references. Delta streams need the raw file, and
+    // columnar files hold no lines. An archive has a single line store, so appended files are not line encoded.
+    std::unique_ptr<lines::LineStore> lineStore;
+    std::vector<io::Attribute> sections;  // Archive level sections
+    if (base) {
+        sections = base->sections;
+    }
+    if (options.lineMemory > 0 && !base) {
+        lineStore = std::make_unique<lines::LineStore>(options.lineMemory);
+        for (const auto& [filePath, relativePath] : uniqueFiles) {
+            auto stages = fileStages.find(relativePath);  // Lines are stored as files will encode them
+            bool columnar = stages != fileStages.end() && stages->second.columnar();
+            if (deltaReferences.count(relativePath) == 0 && !columnar) {
+                std::ifstream input(filePath, std::ios::binary);
+                io::checkOpen(input, filePath.string(), "Line scanning");
+                EncodedInput scanned(input, std::filesystem::file_size(filePath),
+                                     stages == fileStages.end() ? TextStages{} : stages->second, nullptr);
+                lineStore->scan(scanned.stream());
+            }
+        }
+        if (lineStore->size() == 0) {
+            lineStore.reset();  // Nothing repeats, files are stored as they are
+        } else {
+            int level = options.level == DEFAULT_LEVEL ? defaultCompressionLevel(compType) : options.level;
+            lines::LineStoreLocation location{static_cast<int64_t>(archive.tellp()), lineStore->data().size(), compType,
+                                              compType != CompressionType::NONE ? settings.windowLog : 0};
+            ViewBuffer storeData(lineStore->data());
+            std::istream storeStream(&storeData);
+            compressors.get(compType, level).compressStream(storeStream, archive, StreamHints{location.size, true});
+            sections.push_back(lines::lineStoreSection(location));
+            std::cout << "Line store: " << lineStore->size() << " lines (" << location.size << " -> "
+                      << static_cast<uint64_t>(archive.tellp()) - location.dataOffset << " bytes), "
+                      << lineStore->table().size() << " of " << lineStore->table().capacity() << " table slots used" << std::endl;
+        }
+    }
+
+    // Dictionary mode gives each path family of the remaining small files a dictionary, reusing the
+    // registry's dictionaries when one is configured
+    DictionaryMap dictionaries;  // Dictionaries in use by id
+    std::unordered_map<std::string, uint32_t> fileDictionaries;  // Maps relative path to its family dictionary
+    std::unique_ptr<DictionaryRegistry> registry;
+    if (!options.dictionaryRegistry.empty()) {
+        registry = std::make_unique<DictionaryRegistry>(options.dictionaryRegistry);
+    }
+    if (options.dictionarySize > 0) {
+        assignFamilyDictionaries(uniqueFiles, options.dictionarySize, registry.get(), false, dictionaries, fileDictionaries);
+    }
+    std::set<uint32_t> usedDictionaries;  // Dictionaries referenced by at least one entry
+
     metadata.reserve(uniqueFiles.size() + duplicateFiles.size());  // Pre-allocate metadata storage
     
     // Mutexes for thread-safe operations
@@ -87,7 +827,7 @@ FileCompressor::compressFiles(const std::string& inputDir, std::ofstream& archiv
     std::mutex hashOffsetMutex;  // Protects hash-to-offset map access
     std::mutex metadataMutex;  // Protects metadata collection updates
     std::mutex streamMutex;  // Protects console output
-    std::unordered_map<std::string, uint64_t> hashToOffsetMap;  // Maps file hash to its offset in the archive
+    std::unordered_map<std::string, std::string> deltaSources;  // Delta encoded file to the relative path of its reference
 
     // Process unique files in parallel
     threadPool.parallelFor(uniqueFiles.begin(), uniqueFiles.end(),
@@ -98,8 +838,42 @@ FileCompressor::compressFiles(const std::string& inputDir, std::ofstream& archiv
                 return;
             }
             
+            // Route already-compressed or high-entropy files to store mode instead of wasting CPU on them
+            CodecChoice choice{compType, options.level};
+            probe::FileProfile profile = probe::probeFile(filePath.string());
+            if (profile.incompressible) {
+                choice = {CompressionType::NONE, 0};
+            } else if (options.adaptive) {
+                choice = codecSelector.select(filePath, relativePath);  // Sampled once per file family
+            }
+            if (choice.level == DEFAULT_LEVEL) {
+                choice.level = defaultCompressionLevel(choice.type);  // Record the level actually used
+            }
+            const CompressionType fileCodec = choice.type;
+
+            // A planned delta needs a codec that can reference the content of its reference
+            auto deltaReference = deltaReferences.find(relativePath);
+            bool delta = deltaReference != deltaReferences.end() && fileCodec != CompressionType::NONE &&
+                         compressors.get(choice.type, choice.level).supportsDelta();
+
+            // Files of a family with a trained dictionary are primed with it, if the codec can use one
+            uint32_t dictionaryId = 0;
+            std::shared_ptr<const std::string> dictionary;
+            auto familyDictionary = fileDictionaries.find(relativePath);
+            if (!delta && familyDictionary != fileDictionaries.end() && supportsDictionary(fileCodec)) {
+                dictionaryId = familyDictionary->second;
+                dictionary = dictionaries.at(dictionaryId);
+            }
+            const Compressor& fileCompressor = compressors.get(choice.type, choice.level, dictionary);
+            auto fileStage = fileStages.find(relativePath);
+            const TextStages stages = fileStage != fileStages.end() && !delta && fileCodec != CompressionType::NONE
+                                          ? fileStage->second : TextStages{};
+            const bool lineEncoded = lineStore && !delta && fileCodec != CompressionType::NONE && !stages.columnar();
+            const transcoding::Encoding encoding = stages.encoding;
+
             uint64_t dataOffset;  // Position in archive where file data begins
             uint64_t compressedSize;  // Size of compressed data
+            uint64_t referenceSize = 0;  // Size of the delta reference, which sizes the decoding window
             {
                 std::lock_guard<std::mutex> lock(archiveMutex);  // Thread-safe archive write
                 dataOffset = archive.tellp();  // Get current position in archive
@@ -111,8 +885,21 @@ FileCompressor::compressFiles(const std::string& inputDir, std::ofstream& archiv
                 // Get current archive position to calculate compressed size later
                 uint64_t startPos = archive.tellp();  // Record starting position
                 
-                // Stream compress the file directly into the archive
-                compressor->compressStream(inputFile, archive);  // Compress and write file to archive
+                // Stream compress the file directly into the archive. A delta reference is loaded only while
+                // the archive is held, so at most one sits in memory however many workers wait.
+                if (delta) {
+                    std::ifstream referenceFile(uniquePaths.at(deltaReference->second), std::ios::binary);
+                    io::checkOpen(referenceFile, deltaReference->second, "Delta compression");
+                    std::string reference(std::istreambuf_iterator<char>(referenceFile), {});
+                    referenceSize = reference.size();
+                    fileCompressor.compressDelta(inputFile, archive, reference, StreamHints{fileSize, profile.text});
+                } else if (lineEncoded || stages.any()) {
+                    EncodedInput encodedInput(inputFile, fileSize, stages, lineEncoded ? lineStore.get() : nullptr);
+                    bool text = profile.text || encoding != transcoding::Encoding::NONE;  // UTF-16 reads as binary until transcoded
+                    fileCompressor.compressStream(encodedInput.stream(), archive, StreamHints{fileSize, text});
+                } else {
+                    fileCompressor.compressStream(inputFile, archive, StreamHints{fileSize, profile.text});  // Compress and write file to archive
+                }
                 
                 // Calculate the size of the compressed data
                 compressedSize = archive.tellp() - startPos;  // Calculate bytes written
@@ -121,18 +908,157 @@ FileCompressor::compressFiles(const std::string& inputDir, std::ofstream& archiv
             {
                 std::scoped_lock lock(hashOffsetMutex, metadataMutex);  // Thread-safe update to multiple resources
                 std::string hash = pathToHashMap.at(relativePath);  // Get file hash
-                hashToOffsetMap[hash] = dataOffset;  // Store data location by hash
-                meta::FileMeta meta(dataOffset, hash, relativePath);  // Create metadata for file
+                hashToLocationMap[hash] = {dataOffset, -1, 0};  // Store data location by hash
+                meta::FileMeta meta(dataOffset, hash, relativePath, fileCodec, choice.level, fileSize);  // Create metadata for file
+                if (fileCodec != CompressionType::NONE) {
+                    meta.windowLog = settings.windowLog;  // Decoder needs the window to accept the stream
+                }
+                if (dictionaryId != 0) {
+                    meta.dictionaryId = dictionaryId;  // Dictionary is stored once in the metadata section
+                    usedDictionaries.insert(dictionaryId);
+                }
+                if (delta) {
+                    meta.windowLog = deltaWindowLog(referenceSize, fileSize);  // Reference and file share one window
+                    deltaSources[relativePath] = deltaReference->second;  // Linked to its offset once everything is written
+                }
+                meta.lineEncoded = lineEncoded;
+                meta.textEncoding = static_cast<uint8_t>(encoding);
+                meta.timestampEncoded = stages.timestamps;
+                meta.templateEncoded = stages.templates;
+                meta.jsonEncoded = stages.json;
                 metadata.push_back(std::move(meta));  // Add to metadata collection
             }
             
             {
                 std::lock_guard<std::mutex> lock(streamMutex);  // Thread-safe console output
-                std::cout << "Compressed file: " << relativePath 
-                      << " (" << fileSize << " -> " << compressedSize << " bytes)" << std::endl;  // Log compression results
+                if (delta) {
+                    std::cout << "Delta file: " << relativePath << " (" << fileSize << " -> " << compressedSize
+                              << " bytes, against " << deltaReference->second << ")" << std::endl;  // Log delta encoding
+                } else if (encoding != transcoding::Encoding::NONE) {
+                    std::cout << "Compressed file: " << relativePath 
+                          << " (" << fileSize << " -> " << compressedSize << " bytes, transcoded from UTF-16)" << std::endl;  // Log transcoding
+                } else if (fileCodec == CompressionType::NONE && compType != CompressionType::NONE) {
+                    std::cout << "Stored file: " << relativePath 
+                          << " (" << fileSize << " bytes, incompressible)" << std::endl;  // Log skipped compression
+                } else if (options.adaptive) {
+                    std::cout << "Compressed file: " << relativePath 
+                          << " (" << fileSize << " -> " << compressedSize << " bytes, "
+                          << CompressionTypeToString(fileCodec) << " level " << choice.level << ")" << std::endl;  // Log codec choice
+                } else {
+                    std::cout << "Compressed file: " << relativePath 
+                          << " (" << fileSize << " -> " << compressedSize << " bytes)" << std::endl;  // Log compression results
+                }
             }
         });
 
+    // Point every delta entry at the stream of its reference
+    if (!deltaSources.empty()) {
+        std::unordered_map<std::string, int64_t> streamOffsets;
+        for (const auto& meta : metadata) {
+            streamOffsets[meta.relativePath] = meta.dataOffset;
+        }
+        for (auto& meta : metadata) {
+            auto source = deltaSources.find(meta.relativePath);
+            if (source != deltaSources.end()) {
+                meta.deltaReference = streamOffsets.at(source->second);
+            }
+        }
+    }
+
+    // Process solid blocks in parallel, each compressed as a single stream
+    threadPool.parallelFor(solidBlocks.begin(), solidBlocks.end(),
+        [&](auto blockIt, size_t blockIndex) {
+            const SolidBlock& block = *blockIt;
+            const int64_t blockId = firstBlockId + static_cast<int64_t>(blockIndex);
+
+            // Concatenate the files, remembering where each one starts
+            std::string blockData;
+            blockData.reserve(block.size);
+            std::vector<std::pair<uint64_t, uint64_t>> fileRanges;  // Offset and size of each file in the block
+            for (const auto& [filePath, relativePath] : block.files) {
+                std::ifstream inputFile(filePath.string(), std::ios::binary);
+                io::checkOpen(inputFile, filePath.string(), "Compression");
+                uint64_t blockOffset = blockData.size();
+                blockData.append(std::istreambuf_iterator<char>(inputFile), std::istreambuf_iterator<char>());
+                fileRanges.emplace_back(blockOffset, blockData.size() - blockOffset);
+            }
+
+            // The block is probed as a whole; adaptive mode samples the family of its first file
+            const auto* sample = reinterpret_cast<const uint8_t*>(blockData.data());
+            size_t sampleSize = std::min<size_t>(blockData.size(), probe::SAMPLE_SIZE);
+            CodecChoice choice{compType, options.level};
+            if (probe::isIncompressible(sample, sampleSize)) {
+                choice = {CompressionType::NONE, 0};
+            } else if (options.adaptive) {
+                choice = codecSelector.select(block.files.front().first, block.files.front().second);
+            }
+            if (choice.level == DEFAULT_LEVEL) {
+                choice.level = defaultCompressionLevel(choice.type);
+            }
+            const Compressor& blockCompressor = compressors.get(choice.type, choice.level);
+            StreamHints hints{blockData.size(), probe::isText(sample, sampleSize)};
+
+            uint64_t dataOffset;
+            uint64_t compressedSize;
+            {
+                std::lock_guard<std::mutex> lock(archiveMutex);  // Thread-safe archive write
+                dataOffset = archive.tellp();
+                std::istringstream blockStream(std::move(blockData));
+                blockCompressor.compressStream(blockStream, archive, hints);
+                compressedSize = static_cast<uint64_t>(archive.tellp()) - dataOffset;
+            }
+
+            {
+                std::scoped_lock lock(hashOffsetMutex, metadataMutex);  // Thread-safe update to multiple resources
+                for (size_t i = 0; i < block.files.size(); i++) {
+                    const auto& [offset, size] = fileRanges[i];
+                    std::string hash = pathToHashMap.at(block.files[i].second);
+                    hashToLocationMap[hash] = {dataOffset, blockId, offset};
+                    meta::FileMeta meta(dataOffset, hash, block.files[i].second, choice.type, choice.level, size);
+                    if (choice.type != CompressionType::NONE) {
+                        meta.windowLog = settings.windowLog;
+                    }
+                    meta.blockId = blockId;
+                    meta.blockOffset = offset;
+                    metadata.push_back(std::move(meta));
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(streamMutex);  // Thread-safe console output
+                std::cout << "Compressed block " << blockId << ": " << block.files.size() << " files ("
+                          << block.size << " -> " << compressedSize << " bytes, "
+                          << CompressionTypeToString(choice.type) << " level " << choice.level << ")" << std::endl;
+            }
+        });
+
+    // Chunked files go through the chunk store once the parallel writers are done
+    if (!chunkedFiles.empty()) {
+        int level = options.level == DEFAULT_LEVEL ? defaultCompressionLevel(compType) : options.level;
+        ChunkStoreStats stats;
+        auto recipeOffsets = storeChunkedFiles(chunkedFiles, chunkedHashes, compressors.get(compType, level),
+                                               compressors.get(CompressionType::NONE, 0), archive, sections, stats);
+        for (size_t i = 0; i < chunkedFiles.size(); i++) {
+            const std::string& relativePath = chunkedFiles[i].second;
+            std::string hash = pathToHashMap.at(relativePath);
+            hashToLocationMap[hash] = {recipeOffsets[i], -1, 0};  // Duplicates share the chunk list
+            uint64_t size = 0;  // The bytes chunked, which the chunk list adds up to
+            for (const auto& chunk : chunkedHashes[i]) {
+                size += chunk.second;
+            }
+            meta::FileMeta meta(recipeOffsets[i], hash, relativePath, compType, level, size);
+            if (compType != CompressionType::NONE) {
+                meta.windowLog = settings.windowLog;
+            }
+            meta.chunked = true;
+            metadata.push_back(std::move(meta));
+            std::cout << "Chunked file: " << relativePath << std::endl;
+        }
+        std::cout << "Chunk store: " << stats.storedBytes << " of " << stats.totalBytes << " bytes in "
+                  << stats.uniqueChunks << " of " << stats.chunks << " chunks, " << stats.blocks << " blocks ("
+                  << stats.rawBlocks << " stored without compression)" << std::endl;
+    }
+
     // Process duplicate files in parallel
     threadPool.parallelFor(duplicateFiles.begin(), duplicateFiles.end(),
         [&](auto fileIt, size_t) {
@@ -141,8 +1067,10 @@ FileCompressor::compressFiles(const std::string& inputDir, std::ofstream& archiv
             {
                 std::lock_guard<std::mutex> lock(metadataMutex);  // Thread-safe metadata update
                 std::string hash = pathToHashMap.at(relativePath);  // Get file hash
-                uint64_t dataOffset = hashToOffsetMap.at(hash);  // Get data location from original file
-                meta::FileMeta meta(dataOffset, "", relativePath);  // Create metadata for duplicate file
+                const EntryLocation& location = hashToLocationMap.at(hash);  // Get data location from original file
+                meta::FileMeta meta(location.dataOffset, "", relativePath);  // Create metadata for duplicate file
+                meta.blockId = location.blockId;  // Solid files are told apart by their block position
+                meta.blockOffset = location.blockOffset;
                 metadata.push_back(std::move(meta));  // Add to metadata collection
             }
             
@@ -152,59 +1080,295 @@ FileCompressor::compressFiles(const std::string& inputDir, std::ofstream& archiv
             }
         });
 
-    io::writeMetadata(archive, metadata, compType);  // Write metadata and compression type to archive
+    if (!baseReferences.empty()) {
+        sections.push_back(baseArchiveSection(std::filesystem::absolute(options.baseArchive).lexically_normal().string()));
+        for (auto& meta : baseReferences) {
+            metadata.push_back(std::move(meta));
+        }
+    }
+
+    // Every entry records the modification time of its file from before the file was read, so an incremental
+    // archive built on this one tells unchanged files by their size and time without reading them
+    for (auto& meta : metadata) {
+        meta.modifiedTime = fileStamps.at(meta.relativePath).second;
+    }
+
+    // Filter mode stores the n-grams of each unique file's text in a Bloom filter, so search can rule
+    // files out without decoding them, and the time index records the range of its line timestamps, so
+    // time-bounded extraction and search skip files outside their window
+    if (options.gramFilters || options.timeIndex) {
+        threadPool.parallelFor(metadata.begin(), metadata.end(), [&](auto metaIt, size_t) {
+            if (!metaIt->isDuplicate() && !metaIt->isBaseReference()) {  // References carry the base entry's
+                indexText(rootPath / metaIt->relativePath, *metaIt, options);
+            }
+        });
+    }
+
+    for (uint32_t id : usedDictionaries) {
+        // Registry dictionaries are only referenced; otherwise each dictionary is embedded once
+        io::Attribute section = registry ? dictionaryReferenceSection(id) : dictionarySection(id, *dictionaries.at(id));
+        if (std::find(sections.begin(), sections.end(), section) == sections.end()) {  // Appends reuse the archive's
+            sections.push_back(std::move(section));
+        }
+    }
+    if (registry) {
+        registry->save();  // Later runs reuse the dictionaries trained now
+    }
+    if (base) {
+        std::vector<meta::FileMeta> combined(base->metadata.begin(), base->metadata.end());  // Kept entries come first
+        combined.reserve(combined.size() + metadata.size());
+        for (auto& meta : metadata) {
+            combined.push_back(std::move(meta));
+        }
+        metadata = std::move(combined);
+    }
+    io::writeMetadata(archive, metadata, base ? base->compType : compType, sections);  // Write metadata and compression type to archive
     
     return std::move(metadata);  // Return metadata for statistics
 }
 
 void FileCompressor::compress(const std::string& rootDir, const std::string& outputFile, CompressionType compType) {
+    CompressionOptions options;
+    options.compType = compType;
+    compress(rootDir, outputFile, options);
+}
+
+void FileCompressor::compress(const std::string& rootDir, const std::string& outputFile, const CompressionOptions& options) {
     std::ofstream archive(outputFile, std::ios::binary);  // Create binary output stream for the archive
     io::checkOpen(archive, outputFile, "Archive creation");  // Verify archive file was opened successfully
-    auto metadata = compressFiles(rootDir, archive, compType);  // Compress files and get metadata
+    auto metadata = compressFiles(rootDir, archive, options);  // Compress files and get metadata
     displayStats(metadata);  // Output compression statistics
+    if (!options.catalogFile.empty()) {
+        archive.close();
+        io::checkErrors(archive, "Archive writing");
+        registerInCatalog(options, outputFile);
+    }
+}
+
+void FileCompressor::append(const std::string& rootDir, const std::string& archiveFile, const CompressionOptions& options) {
+    if (!options.baseArchive.empty()) {
+        throw std::invalid_argument("An append cannot set a base archive; appended files are stored in full");
+    }
+    if (io::rollBackAppend(archiveFile)) {
+        std::cout << "Rolled back an unfinished append to " << archiveFile << std::endl;
+    }
+    AppendBase base;
+    {
+        std::ifstream existing(archiveFile, std::ios::binary);
+        io::checkOpen(existing, archiveFile, "Archive reading");
+        base.metadata = io::readMetadata(existing, base.compType, &base.sections);
+    }
+
+    // Until the journal is removed, readers and the next append see the archive end at its current footer
+    io::writeJournal(archiveFile, std::filesystem::file_size(archiveFile));
+    std::vector<meta::FileMeta> metadata;
+    try {
+        std::ofstream archive(archiveFile, std::ios::binary | std::ios::in | std::ios::out);  // Keeps the content
+        io::checkOpen(archive, archiveFile, "Archive appending");
+        archive.seekp(0, std::ios::end);
+        metadata = compressFiles(rootDir, archive, options, &base);
+        archive.close();
+        io::checkErrors(archive, "Archive appending");
+    } catch (...) {
+        io::rollBackAppend(archiveFile);
+        throw;
+    }
+    std::filesystem::remove(io::journalPath(archiveFile));  // Commits the append
+    displayStats(metadata);
+    registerInCatalog(options, archiveFile);
 }
 
 void FileCompressor::displayStats(const std::vector<meta::FileMeta>& metadata) {
     uint32_t uniqueCount = 0;  // Counter for unique files
     uint32_t duplicateCount = 0;  // Counter for duplicate files
+    uint32_t storedCount = 0;  // Counter for unique files kept uncompressed
+    uint32_t solidCount = 0;  // Counter for unique files packed into solid blocks
+    uint32_t chunkedCount = 0;  // Counter for unique files stored as chunk lists
+    uint32_t lineEncodedCount = 0;  // Counter for unique files encoded through the line store
+    uint32_t transcodedCount = 0;  // Counter for unique files transcoded from UTF-16
+    uint32_t timestampCount = 0;  // Counter for unique files with a timestamp column
+    uint32_t templateCount = 0;  // Counter for unique files stored as template columns
+    uint32_t jsonCount = 0;  // Counter for unique files stored as JSON-lines columns
+    uint32_t filteredCount = 0;  // Counter for unique files with an n-gram filter
+    uint64_t filterBytes = 0;  // Total size of the n-gram filters
+    uint32_t timedCount = 0;  // Counter for unique files with a time range
+    uint32_t baseCount = 0;  // Counter for files held by the base archive
+    std::unordered_set<int64_t> blockIds;  // Distinct solid blocks
     
     for (const auto& meta : metadata) {
         if (meta.isDuplicate()) {
             duplicateCount++;  // Files that are duplicates
+        } else if (meta.isBaseReference()) {
+            baseCount++;  // Files an incremental archive leaves to its base
         } else {
             uniqueCount++;  // Files with unique contents
+            if (meta.codec == CompressionType::NONE) {
+                storedCount++;  // Files stored without compression
+            }
+            if (meta.isSolid()) {
+                solidCount++;  // Files sharing a stream with others
+                blockIds.insert(meta.blockId);
+            }
+            if (meta.isChunked()) {
+                chunkedCount++;  // Files sharing chunks with others
+            }
+            if (meta.isLineEncoded()) {
+                lineEncodedCount++;  // Files sharing lines with others
+            }
+            if (meta.isTranscoded()) {
+                transcodedCount++;  // Files compressed as UTF-8
+            }
+            if (meta.isTimestampEncoded()) {
+                timestampCount++;  // Files with timestamps split from their lines
+            }
+            if (meta.isTemplateEncoded()) {
+                templateCount++;  // Files stored as columns
+            }
+            if (meta.isJsonEncoded()) {
+                jsonCount++;  // Files stored as per-key columns
+            }
+            if (meta.hasGramFilter()) {
+                filteredCount++;  // Files search can skip
+                filterBytes += meta.gramFilter.size();
+            }
+            if (meta.hasTimeRange()) {
+                timedCount++;  // Files time-bounded reads can skip
+            }
         }
     }
     
     std::cout << "Total files in archive: " << metadata.size() << std::endl;
     std::cout << "Unique files: " << uniqueCount << ", Duplicate files: " << duplicateCount << std::endl;
+    std::cout << "Stored without compression: " << storedCount << std::endl;
+    if (baseCount > 0) {
+        std::cout << "Held by the base archive: " << baseCount << " files" << std::endl;
+    }
+    if (solidCount > 0) {
+        std::cout << "Packed in solid blocks: " << solidCount << " files in " << blockIds.size() << " blocks" << std::endl;
+    }
+    if (chunkedCount > 0) {
+        std::cout << "Stored as chunk lists: " << chunkedCount << " files" << std::endl;
+    }
+    if (lineEncodedCount > 0) {
+        std::cout << "Encoded through the line store: " << lineEncodedCount << " files" << std::endl;
+    }
+    if (transcodedCount > 0) {
+        std::cout << "Transcoded from UTF-16: " << transcodedCount << " files" << std::endl;
+    }
+    if (timestampCount > 0) {
+        std::cout << "Timestamps in a separate column: " << timestampCount << " files" << std::endl;
+    }
+    if (templateCount > 0) {
+        std::cout << "Stored as template columns: " << templateCount << " files" << std::endl;
+    }
+    if (jsonCount > 0) {
+        std::cout << "Stored as JSON-lines columns: " << jsonCount << " files" << std::endl;
+    }
+    if (filteredCount > 0) {
+        std::cout << "N-gram filters: " << filteredCount << " files, " << filterBytes << " bytes" << std::endl;
+    }
+    if (timedCount > 0) {
+        std::cout << "Time ranges recorded: " << timedCount << " files" << std::endl;
+    }
 }
 
 std::vector<meta::FileMeta>
-FileCompressor::decompressFiles(const std::string& outputDir, std::ifstream& archive) {
+FileCompressor::decompressFiles(const std::string& outputDir, std::ifstream& archive, const std::string& registryDir,
+                                uint64_t archiveEnd) {
     CompressionType compType;
-    auto metadata = io::readMetadata(archive, compType);  // Read file metadata and compression type from archive
-    auto decompressor = createCompressor(compType);  // Create appropriate decompressor based on compression type
+    std::vector<io::Attribute> sections;
+    auto metadata = io::readMetadata(archive, compType, &sections, archiveEnd);  // Read file metadata and compression type from archive
+    DictionaryMap dictionaries = readDictionarySections(sections);  // Dictionaries shared by entries
+    auto lineStoreLocation = lines::readLineStoreSection(sections);  // Lines shared by line-encoded entries
+    auto rawChunkBlocks = chunking::readRawBlockSections(sections);  // Chunk blocks stored without compression
+    std::unique_ptr<DictionaryRegistry> registry;  // Holds the dictionaries the archive only references
+    if (!registryDir.empty()) {
+        registry = std::make_unique<DictionaryRegistry>(registryDir);
+    }
 
     std::filesystem::create_directories(outputDir);  // Create output directory if it doesn't exist
     threading::ThreadPool& threadPool = threading::ThreadPool::getInstance();  // Get thread pool for parallel processing
     std::mutex archiveMutex, outputMutex;  // Mutexes for thread-safe archive reading and output operations
     
-    // Maps data offset to the corresponding file path in the output directory for linking duplicates
-    std::unordered_map<int64_t, std::string> extractedPaths;
+    // Maps data location (stream offset, position in block) to the extracted file path for linking duplicates
+    std::map<std::pair<int64_t, uint64_t>, std::string> extractedPaths;
     
-    // Separate containers to process unique and duplicate files
+    // Separate containers to process unique, solid and duplicate files
     std::vector<const meta::FileMeta*> uniqueFiles;
     std::vector<const meta::FileMeta*> duplicateFiles;
+    std::map<int64_t, std::vector<const meta::FileMeta*>> solidBlocks;  // Files grouped by the block holding them
+    std::vector<const meta::FileMeta*> chunkedFiles;  // Files rebuilt from the chunk store
+    std::vector<const meta::FileMeta*> deltaFiles;  // Files decoded against another extracted file
+    std::vector<const meta::FileMeta*> baseFiles;  // Files read from the base archive
     
     // Classify files as either unique or duplicates
     for (const auto& meta : metadata) {
-        if (meta.isDuplicate()) {
+        if (meta.isBaseReference()) {
+            baseFiles.push_back(&meta);  // Restored through the base archive chain
+        } else if (meta.isDuplicate()) {
             duplicateFiles.push_back(&meta);  // Add duplicate files to their container
+        } else if (meta.isSolid()) {
+            solidBlocks[meta.blockId].push_back(&meta);  // Solid files are extracted per block
+        } else if (meta.isChunked()) {
+            chunkedFiles.push_back(&meta);  // Chunked files are extracted per chunk block
+        } else if (meta.isDelta()) {
+            deltaFiles.push_back(&meta);  // Delta files wait for their reference
+        } else if (meta.isLineEncoded() && !lineStoreLocation) {
+            throw std::runtime_error("Invalid archive: " + meta.relativePath + " is line encoded but there is no line store");
         } else {
             uniqueFiles.push_back(&meta);  // Add unique files to their containerer
         }
     }
+
+    // Each unique file records its own codec, window and dictionary, so decompressors are shared per combination
+    DecompressorCache decompressors;
+
+    // Lines shared by line-encoded files are decoded once up front
+    lines::LineDictionary lineDictionary;
+    if (lineStoreLocation) {
+        lineDictionary = readLineStore(archive, *lineStoreLocation, decompressors);
+    }
+
+    // Resolve every stream's dictionary up front so a missing one fails the extraction instead of a worker
+    for (const auto* meta : uniqueFiles) {
+        decoderSettings(*meta, dictionaries, registry.get());
+    }
+    for (const auto* meta : deltaFiles) {
+        decoderSettings(*meta, dictionaries, registry.get());
+    }
+    for (const auto& meta : io::readRetainedEntries(sections)) {
+        decoderSettings(meta, dictionaries, registry.get());
+    }
+    for (const auto& [blockId, files] : solidBlocks) {
+        decoderSettings(*files.front(), dictionaries, registry.get());
+    }
+
+    // Chunked files are written piece by piece, so create them at full size and note where each chunk goes
+    struct ChunkPiece {
+        const meta::FileMeta* meta;  // File using the chunk
+        uint64_t fileOffset;         // Position of the chunk in the file
+        uint64_t blockOffset;        // Position of the chunk in its decompressed block
+        uint64_t length;
+    };
+    std::map<int64_t, std::vector<ChunkPiece>> chunkBlocks;  // Pieces grouped by the block holding them
+    for (const auto* meta : chunkedFiles) {
+        archive.clear();
+        archive.seekg(meta->dataOffset);
+        uint64_t fileOffset = 0;
+        for (const auto& chunk : chunking::readRecipe(archive)) {
+            chunkBlocks[chunk.dataOffset].push_back({meta, fileOffset, chunk.blockOffset, chunk.length});
+            fileOffset += chunk.length;
+        }
+        if (fileOffset != meta->originalSize) {
+            throw std::runtime_error("Invalid archive: chunks of " + meta->relativePath + " do not add up to its size");
+        }
+        std::filesystem::path outputPath = std::filesystem::path(outputDir) / meta->relativePath;
+        std::filesystem::create_directories(outputPath.parent_path());
+        std::ofstream outputFile(outputPath, std::ios::binary);
+        io::checkOpen(outputFile, outputPath.string(), "Output file creation");
+        outputFile.close();
+        std::filesystem::resize_file(outputPath, meta->originalSize);
+    }
     
     // Process unique files in parallel using the thread pool
     threadPool.parallelFor(uniqueFiles.begin(), uniqueFiles.end(), [&](auto it, size_t) {
@@ -220,16 +1384,199 @@ FileCompressor::decompressFiles(const std::string& outputDir, std::ifstream& arc
             
             std::ofstream outputFile(outputPath, std::ios::binary);  // Create output file
             io::checkOpen(outputFile, outputPath.string(), "Output file creation");  // Verify file opened successfully
-            decompressor->decompressStream(archive, outputFile);  // Decompress file data from archive to output
+            decodeStream(meta, decompressors.get(meta.codec, decoderSettings(meta, dictionaries, registry.get())),
+                         archive, outputFile, lineStoreLocation ? &lineDictionary : nullptr);  // Decompress file data from archive to output
         }
         
         {
             std::lock_guard<std::mutex> lock(outputMutex);  // Thread-safe output operations
-            extractedPaths[meta.dataOffset] = outputPath.string();  // Record extracted file path for duplicates
+            extractedPaths[{meta.dataOffset, meta.blockOffset}] = outputPath.string();  // Record extracted file path for duplicates
             std::cout << "Extracted: " << meta.relativePath << std::endl;  // Log extraction
         }
     });
+
+    // Delta files are decoded chain level by chain level, each level against files extracted before it.
+    // Entries an append replaced but kept for their delta streams are decoded in memory when reached.
+    std::vector<meta::FileMeta> retainedEntries = io::readRetainedEntries(sections);
+    std::unordered_map<int64_t, const meta::FileMeta*> retainedStreams;  // Data offset to retained entry
+    for (const auto& meta : retainedEntries) {
+        retainedStreams[meta.dataOffset] = &meta;
+    }
+    std::unordered_map<int64_t, const meta::FileMeta*> deltaStreams;  // Data offset to delta entry, retained ones included
+    for (const auto* meta : deltaFiles) {
+        deltaStreams[meta->dataOffset] = meta;
+    }
+    for (const auto& meta : retainedEntries) {
+        if (meta.isDelta()) {
+            deltaStreams[meta.dataOffset] = &meta;
+        }
+    }
+    std::map<size_t, std::vector<const meta::FileMeta*>> deltaLevels;  // Chain depth to the entries at that depth
+    for (const auto* meta : deltaFiles) {
+        size_t depth = 1;
+        for (auto reference = deltaStreams.find(meta->deltaReference); reference != deltaStreams.end();
+             reference = deltaStreams.find(reference->second->deltaReference)) {
+            if (++depth > deltaStreams.size()) {
+                throw std::runtime_error("Invalid archive: delta chain of " + meta->relativePath + " loops");
+            }
+        }
+        deltaLevels[depth].push_back(meta);
+    }
+    // Content a delta stream decodes against: an extracted file, or a retained entry decoded with its own chain
+    std::function<std::optional<std::string>(int64_t)> referenceContent = [&](int64_t dataOffset) -> std::optional<std::string> {
+        std::string referencePath;
+        {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            auto source = extractedPaths.find({dataOffset, 0});
+            if (source != extractedPaths.end()) {
+                referencePath = source->second;
+            }
+        }
+        if (!referencePath.empty()) {
+            std::ifstream referenceFile(referencePath, std::ios::binary);
+            io::checkOpen(referenceFile, referencePath, "Delta reference reading");
+            return std::string((std::istreambuf_iterator<char>(referenceFile)), std::istreambuf_iterator<char>());
+        }
+        auto retained = retainedStreams.find(dataOffset);
+        if (retained == retainedStreams.end()) {
+            return std::nullopt;
+        }
+        const meta::FileMeta& source = *retained->second;
+        std::optional<std::string> sourceReference;
+        if (source.isDelta() && !(sourceReference = referenceContent(source.deltaReference))) {
+            return std::nullopt;
+        }
+        std::ostringstream content;
+        std::lock_guard<std::mutex> lock(archiveMutex);
+        archive.clear();
+        archive.seekg(source.dataOffset);
+        const Compressor& decompressor = decompressors.get(source.codec, decoderSettings(source, dictionaries, registry.get()));
+        if (source.isDelta()) {
+            decompressor.decompressDelta(archive, content, *sourceReference);
+        } else {
+            decodeStream(source, decompressor, archive, content, lineStoreLocation ? &lineDictionary : nullptr);
+        }
+        return content.str();
+    };
+    for (const auto& [depth, levelFiles] : deltaLevels) {
+        threadPool.parallelFor(levelFiles.begin(), levelFiles.end(), [&](auto it, size_t) {
+            const auto& meta = **it;
+            std::optional<std::string> referenceData = referenceContent(meta.deltaReference);
+            if (!referenceData) {
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cout << "Error: No reference file found for " << meta.relativePath << std::endl;
+                return;
+            }
+            const std::string& reference = *referenceData;
+
+            std::filesystem::path outputPath = std::filesystem::path(outputDir) / meta.relativePath;
+            std::filesystem::create_directories(outputPath.parent_path());
+            {
+                std::lock_guard<std::mutex> lock(archiveMutex);  // Thread-safe archive access
+                archive.clear();
+                archive.seekg(meta.dataOffset);
+                std::ofstream outputFile(outputPath, std::ios::binary);
+                io::checkOpen(outputFile, outputPath.string(), "Output file creation");
+                decompressors.get(meta.codec, decoderSettings(meta, dictionaries, registry.get()))
+                    .decompressDelta(archive, outputFile, reference);
+            }
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+            extractedPaths[{meta.dataOffset, meta.blockOffset}] = outputPath.string();
+            std::cout << "Extracted: " << meta.relativePath << std::endl;
+        });
+    }
+
+    // Process solid blocks in parallel, decompressing each block once and splitting it into its files
+    threadPool.parallelFor(solidBlocks.begin(), solidBlocks.end(), [&](auto it, size_t) {
+        const auto& files = it->second;
+        const auto& head = *files.front();
+
+        std::ostringstream blockData;
+        {
+            std::lock_guard<std::mutex> lock(archiveMutex);  // Thread-safe archive access
+            archive.clear();
+            archive.seekg(head.dataOffset);  // All files of a block share its stream
+            decompressors.get(head.codec, decoderSettings(head, dictionaries, registry.get())).decompressStream(archive, blockData);
+        }
+        const std::string block = blockData.str();
+
+        for (const auto* meta : files) {
+            if (meta->blockOffset + meta->originalSize > block.size()) {
+                throw std::runtime_error("Corrupt solid block " + std::to_string(meta->blockId) +
+                                         ": " + meta->relativePath + " lies outside the block");
+            }
+            std::filesystem::path outputPath = std::filesystem::path(outputDir) / meta->relativePath;
+            std::filesystem::create_directories(outputPath.parent_path());
+            std::ofstream outputFile(outputPath, std::ios::binary);
+            io::checkOpen(outputFile, outputPath.string(), "Output file creation");
+            outputFile.write(block.data() + meta->blockOffset, meta->originalSize);
+
+            std::lock_guard<std::mutex> lock(outputMutex);  // Thread-safe output operations
+            extractedPaths[{meta->dataOffset, meta->blockOffset}] = outputPath.string();
+            std::cout << "Extracted: " << meta->relativePath << std::endl;
+        }
+    });
+    
+    // Process chunk blocks in parallel, decompressing each block once and copying its chunks to every file using them
+    threadPool.parallelFor(chunkBlocks.begin(), chunkBlocks.end(), [&](auto it, size_t) {
+        const auto& pieces = it->second;
+        const auto& head = *pieces.front().meta;  // Every chunked file shares the chunk store codec
+
+        std::ostringstream blockData;
+        {
+            std::lock_guard<std::mutex> lock(archiveMutex);  // Thread-safe archive access
+            archive.clear();
+            archive.seekg(it->first);
+            const Compressor& blockDecompressor = rawChunkBlocks.count(it->first) != 0
+                ? decompressors.get(CompressionType::NONE, {})
+                : decompressors.get(head.codec, decoderSettings(head, dictionaries, registry.get()));
+            blockDecompressor.decompressStream(archive, blockData);
+        }
+        const std::string block = blockData.str();
+
+        // Pieces of one file are adjacent, so each file is opened once per block
+        std::fstream outputFile;
+        const meta::FileMeta* openFile = nullptr;
+        for (const auto& piece : pieces) {
+            if (piece.blockOffset + piece.length > block.size()) {
+                throw std::runtime_error("Corrupt chunk block at offset " + std::to_string(it->first) +
+                                         ": chunk of " + piece.meta->relativePath + " lies outside the block");
+            }
+            if (piece.meta != openFile) {
+                std::filesystem::path outputPath = std::filesystem::path(outputDir) / piece.meta->relativePath;
+                outputFile = std::fstream(outputPath, std::ios::binary | std::ios::in | std::ios::out);
+                io::checkOpen(outputFile, outputPath.string(), "Output file update");
+                openFile = piece.meta;
+            }
+            outputFile.seekp(piece.fileOffset);
+            outputFile.write(block.data() + piece.blockOffset, piece.length);
+        }
+    });
+    for (const auto* meta : chunkedFiles) {
+        extractedPaths[{meta->dataOffset, meta->blockOffset}] = (std::filesystem::path(outputDir) / meta->relativePath).string();
+        std::cout << "Extracted: " << meta->relativePath << std::endl;
+    }
     
+    // Files of an incremental archive held by its base archive are read through the chain of base archives,
+    // one reader per worker
+    if (!baseFiles.empty()) {
+        ReaderPool baseReaders(readBaseArchiveSection(sections), registryDir);
+        threadPool.parallelFor(baseFiles.begin(), baseFiles.end(), [&](auto it, size_t) {
+            const auto& meta = **it;
+            std::filesystem::path outputPath = std::filesystem::path(outputDir) / meta.relativePath;
+            std::filesystem::create_directories(outputPath.parent_path());
+            std::ofstream outputFile(outputPath, std::ios::binary);
+            io::checkOpen(outputFile, outputPath.string(), "Output file creation");
+            auto reader = baseReaders.acquire();
+            reader->read(reader->findReferenced(meta), outputFile);
+            baseReaders.release(std::move(reader));
+
+            std::lock_guard<std::mutex> lock(outputMutex);  // Thread-safe console output
+            std::cout << "Extracted from base: " << meta.relativePath << std::endl;
+        });
+    }
+
     // Process duplicate files in parallel after originals are extracted
     threadPool.parallelFor(duplicateFiles.begin(), duplicateFiles.end(), [&](auto it, size_t) {
         const auto& meta = **it;  // Dereference to get the actual metadata
@@ -240,11 +1587,12 @@ FileCompressor::decompressFiles(const std::string& outputDir, std::ifstream& arc
         std::string sourcePath;
         {
             std::lock_guard<std::mutex> lock(outputMutex);  // Thread-safe output operations
-            if (extractedPaths.find(meta.dataOffset) == extractedPaths.end()) {  // Check if original file was extracted
+            auto source = extractedPaths.find({meta.dataOffset, meta.blockOffset});
+            if (source == extractedPaths.end()) {  // Check if original file was extracted
                 std::cout << "Error: No original file found for " << meta.relativePath << std::endl;  // Log error
                 return;
             }
-            sourcePath = extractedPaths[meta.dataOffset];  // Get path of original file
+            sourcePath = source->second;  // Get path of original file
         }
         
         try {
@@ -263,11 +1611,67 @@ FileCompressor::decompressFiles(const std::string& outputDir, std::ifstream& arc
     return std::move(metadata);  // Return metadata for statistics
 }
 
-void FileCompressor::decompress(const std::string& archiveFile, const std::string& outputDir) {
+void FileCompressor::decompress(const std::string& archiveFile, const std::string& outputDir,
+                                const std::string& registryDir) {
     std::ifstream archive(archiveFile, std::ios::binary);  // Open archive file in binary mode for reading
     io::checkOpen(archive, archiveFile, "Archive reading");  // Verify the archive file opened successfully
-    auto metadata = decompressFiles(outputDir, archive);  // Extract files to output directory and get metadata
+    auto metadata = decompressFiles(outputDir, archive, registryDir, io::committedSize(archiveFile));  // Extract files to output directory and get metadata
     displayStats(metadata);  // Show statistics about decompressed files
 }
 
+size_t FileCompressor::extract(const std::string& archiveFile, const std::string& outputDir,
+                               const std::vector<std::string>& relativePaths, const std::string& registryDir,
+                               const timestamps::TimeWindow& window) {
+    ArchiveReader reader(archiveFile, registryDir);  // Reads only the metadata up front
+
+    std::vector<const meta::FileMeta*> selected;
+    for (const auto& relativePath : relativePaths) {
+        const meta::FileMeta* entry = reader.find(relativePath);
+        if (!entry) {
+            throw std::runtime_error("File not found in archive: " + relativePath);
+        }
+        selected.push_back(entry);
+    }
+    if (relativePaths.empty() && window.bounded()) {
+        for (const auto& entry : reader.entries()) {
+            selected.push_back(&entry);
+        }
+    }
+
+    size_t extracted = 0;
+    for (const meta::FileMeta* entry : selected) {
+        if (window.bounded() && !reader.resolve(*entry).mayOverlap(window.since, window.until)) {
+            continue;  // Duplicates carry no range of their own
+        }
+        std::filesystem::path outputPath = std::filesystem::path(outputDir) / entry->relativePath;  // Build output file path
+        std::filesystem::create_directories(outputPath.parent_path());  // Create parent directories if needed
+        std::ofstream outputFile(outputPath, std::ios::binary);
+        io::checkOpen(outputFile, outputPath.string(), "Output file creation");
+        uint64_t size = reader.read(*entry, outputFile);  // Decodes the file's own stream or solid block
+        std::cout << "Extracted: " << entry->relativePath << " (" << size << " bytes)" << std::endl;
+        extracted++;
+    }
+    if (window.bounded()) {
+        std::cout << "Outside the time window: " << selected.size() - extracted << " files" << std::endl;
+    }
+    return extracted;
+}
+
+size_t FileCompressor::train(const std::string& rootDir, const std::string& registryDir, size_t dictionarySize) {
+    std::filesystem::path rootPath(rootDir);
+    std::vector<std::pair<std::filesystem::path, std::string>> files;  // Non-empty files with their relative paths
+    for (const auto& filePath : io::scanDirectory(rootDir)) {
+        if (std::filesystem::file_size(filePath) > 0) {
+            files.push_back({filePath, std::filesystem::relative(filePath, rootPath).string()});
+        }
+    }
+
+    DictionaryRegistry registry(registryDir);
+    DictionaryMap dictionaries;
+    std::unordered_map<std::string, uint32_t> fileDictionaries;
+    size_t trained = assignFamilyDictionaries(files, dictionarySize, &registry, true, dictionaries, fileDictionaries);
+    registry.save();
+    return trained;
+}
+
 }
@@ -0,0 +1,104 @@
+#include <algorithm>
+
+#include "GramFilter.h"
+
+namespace grams {
+
+namespace {
+
+constexpr uint32_t GRAM_MASK = (1u << (8 * GRAM_LENGTH)) - 1;
+
+uint8_t foldCase(uint8_t c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<uint8_t>(c - 'A' + 'a') : c;
+}
+
+// Bit positions of an n-gram by double hashing one 64-bit mix of it
+struct GramHash {
+    explicit GramHash(uint32_t gram) {
+        uint64_t h = (gram + 1) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 29;
+        first = h >> 32;
+        step = static_cast<uint32_t>(h) | 1;
+    }
+
+    uint64_t bit(uint8_t i, uint64_t bitCount) const {
+        return (first + static_cast<uint64_t>(i) * step) % bitCount;
+    }
+
+    uint64_t first;
+    uint64_t step;
+};
+
+}  // namespace
+
+GramSet::GramSet() : bits((size_t(GRAM_MASK) + 1) / 64) {}
+
+void GramSet::add(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        uint8_t c = static_cast<uint8_t>(data[i]);
+        if (c == '\n') {
+            run = 0;
+            continue;
+        }
+        window = (window << 8 | foldCase(c)) & GRAM_MASK;
+        if (++run >= GRAM_LENGTH) {
+            bits[window >> 6] |= uint64_t(1) << (window & 63);
+        }
+    }
+}
+
+size_t GramSet::count() const {
+    size_t total = 0;
+    for (uint64_t word : bits) {
+        total += static_cast<size_t>(__builtin_popcountll(word));
+    }
+    return total;
+}
+
+std::string buildFilter(const GramSet& grams) {
+    size_t size = std::clamp((grams.count() * BITS_PER_GRAM + 7) / 8, MIN_FILTER_SIZE, MAX_FILTER_SIZE);
+    std::string filter(1 + size, '\0');
+    filter[0] = static_cast<char>(HASH_COUNT);
+    uint8_t* bits = reinterpret_cast<uint8_t*>(&filter[1]);
+    const uint64_t bitCount = static_cast<uint64_t>(size) * 8;
+    grams.forEach([&](uint32_t gram) {
+        GramHash hash(gram);
+        for (uint8_t i = 0; i < HASH_COUNT; i++) {
+            uint64_t bit = hash.bit(i, bitCount);
+            bits[bit >> 3] |= static_cast<uint8_t>(1 << (bit & 7));
+        }
+    });
+    return filter;
+}
+
+bool mayContain(std::string_view filter, std::string_view literal) {
+    if (filter.size() < 2 || filter[0] == 0) {
+        return true;  // No usable filter
+    }
+    const uint8_t hashCount = static_cast<uint8_t>(filter[0]);
+    const uint8_t* bits = reinterpret_cast<const uint8_t*>(filter.data() + 1);
+    const uint64_t bitCount = static_cast<uint64_t>(filter.size() - 1) * 8;
+
+    uint32_t window = 0;
+    size_t run = 0;
+    for (char c : literal) {
+        if (c == '\n') {
+            run = 0;  // Filters hold no n-grams across lines
+            continue;
+        }
+        window = (window << 8 | foldCase(static_cast<uint8_t>(c))) & GRAM_MASK;
+        if (++run < GRAM_LENGTH) {
+            continue;
+        }
+        GramHash hash(window);
+        for (uint8_t i = 0; i < hashCount; i++) {
+            uint64_t bit = hash.bit(i, bitCount);
+            if (!((bits[bit >> 3] >> (bit & 7)) & 1)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace grams
@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -29,47 +31,230 @@ void checkReadSize(size_t expected, size_t actual) {
     }
 }
 
-void writeFooter(std::ofstream& stream, compression::CompressionType compType, uint64_t uniqueCount, uint64_t duplicateCount, uint64_t metaOffset) {
+void appendVarint(std::string& output, uint64_t value) {
+    while (value >= 0x80) {
+        output += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    output += static_cast<char>(value);
+}
+
+bool readVarint(const char*& pos, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos != end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*pos++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void writeFooter(std::ostream& stream, compression::CompressionType compType, uint64_t uniqueCount, uint64_t duplicateCount, uint64_t metaOffset) {
     write(stream, compType);
     write(stream, uniqueCount);
     write(stream, duplicateCount);
     write(stream, metaOffset);
+    write(stream, FORMAT_VERSION);
+    write(stream, ARCHIVE_MAGIC);  // Magic comes last so the file tail identifies the archive
 }
 
-void readFooter(std::ifstream& stream, compression::CompressionType& compType, uint64_t& uniqueCount, uint64_t& duplicateCount, uint64_t& metaOffset) {
-    // Seek to the end of the file, minus the size of the extended footer
-    // Footer contains: compression type (4 bytes) + 3 uint64_t values (8 bytes each)
-    size_t footerSize = sizeof(compression::CompressionType) + 3 * sizeof(uint64_t);
-    stream.seekg(-static_cast<std::streamoff>(footerSize), std::ios::end);
+void readFooter(std::istream& stream, compression::CompressionType& compType, uint64_t& uniqueCount, uint64_t& duplicateCount, uint64_t& metaOffset,
+                uint64_t archiveEnd) {
+    // Seek to the end of the archive, minus the size of the footer
+    // Footer contains: compression type (1 byte) + 3 uint64_t values + format version (2 bytes) + magic (4 bytes)
+    size_t footerSize = sizeof(compression::CompressionType) + 3 * sizeof(uint64_t) + sizeof(uint16_t) + sizeof(uint32_t);
+    if (archiveEnd == 0) {
+        stream.seekg(-static_cast<std::streamoff>(footerSize), std::ios::end);
+    } else if (archiveEnd >= footerSize) {
+        stream.seekg(static_cast<std::streamoff>(archiveEnd - footerSize));
+    } else {
+        stream.setstate(std::ios::failbit);
+    }
+    if (!stream) {
+        throw std::runtime_error("Invalid archive: file is too small to contain a footer");
+    }
     
+    uint16_t version;
+    uint32_t magic;
     read(stream, compType);
     read(stream, uniqueCount);
     read(stream, duplicateCount);    
     read(stream, metaOffset);
+    read(stream, version);
+    read(stream, magic);
+
+    if (magic != ARCHIVE_MAGIC) {
+        throw std::runtime_error("Invalid archive: missing LogRescuer signature (not an archive or created by a pre-versioned release)");
+    }
+    if (version > FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported archive format version " + std::to_string(version) +
+                                 " (this build reads up to version " + std::to_string(FORMAT_VERSION) + ")");
+    }
 }
 
-void write(std::ofstream& stream, const std::string& str) {
+void write(std::ostream& stream, const std::string& str) {
     uint64_t length = str.length();
     write(stream, length);
     writeBuffer(stream, str.c_str(), length);
 }
 
-void read(std::ifstream& stream, std::string& str) {
+void read(std::istream& stream, std::string& str) {
     uint64_t length;
     read(stream, length);
     str.resize(length);
     readBuffer(stream, &str[0], length);
 }
 
-void write(std::ofstream& stream, const meta::FileMeta& meta) {
+void writeAttributes(std::ostream& stream, const std::vector<Attribute>& attributes) {
+    uint16_t count = static_cast<uint16_t>(attributes.size());
+    write(stream, count);
+    for (const auto& [tag, payload] : attributes) {
+        write(stream, static_cast<uint16_t>(mustUnderstand(tag) ? tag | TAG_MUST_UNDERSTAND : tag));
+        write(stream, payload);  // Length-prefixed so unknown tags can be skipped
+    }
+}
+
+std::vector<Attribute> readAttributes(std::istream& stream) {
+    uint16_t count;
+    read(stream, count);
+
+    std::vector<Attribute> attributes(count);
+    for (auto& [tag, payload] : attributes) {
+        read(stream, tag);
+        read(stream, payload);
+        if (tag & TAG_MUST_UNDERSTAND) {
+            tag = static_cast<uint16_t>(tag & ~TAG_MUST_UNDERSTAND);
+            if (tag == 0 || tag > TAG_LAST) {
+                throw std::runtime_error("Unsupported archive: record " + std::to_string(tag) +
+                                         " changes how data is decoded but is unknown to this build");
+            }
+        }
+    }
+    return attributes;
+}
+
+namespace {
+
+// Collects the optional fields of an entry that differ from their defaults
+std::vector<Attribute> entryAttributes(const meta::FileMeta& meta) {
+    std::vector<Attribute> attributes;
+    if (meta.windowLog != 0) {
+        attributes.emplace_back(TAG_WINDOW_LOG, encodeValue(meta.windowLog));
+    }
+    if (meta.isSolid()) {
+        attributes.emplace_back(TAG_BLOCK_ID, encodeValue(static_cast<uint32_t>(meta.blockId)));
+        attributes.emplace_back(TAG_BLOCK_OFFSET, encodeValue(meta.blockOffset));
+    }
+    if (meta.dictionaryId != 0) {
+        attributes.emplace_back(TAG_DICTIONARY_ID, encodeValue(meta.dictionaryId));
+    }
+    if (meta.chunked) {
+        attributes.emplace_back(TAG_CHUNKED, "");
+    }
+    if (meta.isDelta()) {
+        attributes.emplace_back(TAG_DELTA_REFERENCE, encodeValue(meta.deltaReference));
+    }
+    if (meta.lineEncoded) {
+        attributes.emplace_back(TAG_LINE_ENCODED, "");
+    }
+    if (meta.isTranscoded()) {
+        attributes.emplace_back(TAG_TEXT_ENCODING, encodeValue(meta.textEncoding));
+    }
+    if (meta.timestampEncoded) {
+        attributes.emplace_back(TAG_TIMESTAMP_ENCODED, "");
+    }
+    if (meta.templateEncoded) {
+        attributes.emplace_back(TAG_TEMPLATE_ENCODED, "");
+    }
+    if (meta.jsonEncoded) {
+        attributes.emplace_back(TAG_JSON_ENCODED, "");
+    }
+    if (meta.hasGramFilter()) {
+        attributes.emplace_back(TAG_GRAM_FILTER, meta.gramFilter);
+    }
+    if (meta.hasTimeRange()) {
+        attributes.emplace_back(TAG_TIME_RANGE, encodeValue(meta.minTimestamp) + encodeValue(meta.maxTimestamp));
+    }
+    if (meta.modifiedTime != 0) {
+        attributes.emplace_back(TAG_MODIFIED_TIME, encodeValue(meta.modifiedTime));
+    }
+    if (meta.isBaseReference()) {
+        attributes.emplace_back(TAG_BASE_ENTRY, meta.baseEntry);
+    }
+    return attributes;
+}
+
+// Restores optional fields of an entry, skipping attributes this version does not understand
+void applyAttributes(meta::FileMeta& meta, const std::vector<Attribute>& attributes) {
+    for (const auto& [tag, payload] : attributes) {
+        switch (tag) {
+            case TAG_WINDOW_LOG: meta.windowLog = decodeValue<int32_t>(payload); break;
+            case TAG_BLOCK_ID: meta.blockId = decodeValue<uint32_t>(payload); break;
+            case TAG_BLOCK_OFFSET: meta.blockOffset = decodeValue<uint64_t>(payload); break;
+            case TAG_DICTIONARY_ID: meta.dictionaryId = decodeValue<uint32_t>(payload); break;
+            case TAG_CHUNKED: meta.chunked = true; break;
+            case TAG_DELTA_REFERENCE: meta.deltaReference = decodeValue<int64_t>(payload); break;
+            case TAG_LINE_ENCODED: meta.lineEncoded = true; break;
+            case TAG_TEXT_ENCODING: meta.textEncoding = decodeValue<uint8_t>(payload); break;
+            case TAG_TIMESTAMP_ENCODED: meta.timestampEncoded = true; break;
+            case TAG_TEMPLATE_ENCODED: meta.templateEncoded = true; break;
+            case TAG_JSON_ENCODED: meta.jsonEncoded = true; break;
+            case TAG_GRAM_FILTER: meta.gramFilter = payload; break;
+            case TAG_TIME_RANGE:
+                meta.minTimestamp = decodeValue<int64_t>(payload.substr(0, sizeof(int64_t)));
+                meta.maxTimestamp = decodeValue<int64_t>(payload.substr(std::min(payload.size(), sizeof(int64_t))));
+                break;
+            case TAG_MODIFIED_TIME: meta.modifiedTime = decodeValue<int64_t>(payload); break;
+            case TAG_BASE_ENTRY: meta.baseEntry = payload; break;
+            default: break;
+        }
+    }
+}
+
+// Reads one entry as written for a unique file: core fields followed by its extension attributes
+meta::FileMeta readEntry(std::istream& stream) {
+    int64_t offset;
+    std::string hash;
+    std::string path;
+    compression::CompressionType codec;
+    int32_t level;
+    uint64_t originalSize;
+
+    io::read(stream, offset);
+    io::read(stream, hash);
+    io::read(stream, path);
+    io::read(stream, codec);
+    io::read(stream, level);
+    io::read(stream, originalSize);
+    auto attributes = io::readAttributes(stream);
+
+    meta::FileMeta meta(offset, hash, path, codec, level, originalSize);
+    applyAttributes(meta, attributes);
+    return meta;
+}
+
+}  // namespace
+
+// Writes one metadata entry: core fields followed by its extension attributes
+void write(std::ostream& stream, const meta::FileMeta& meta) {
     io::write(stream, meta.dataOffset);
     io::write(stream, meta.hash);
     io::write(stream, meta.relativePath);
+    io::write(stream, meta.codec);
+    io::write(stream, meta.level);
+    io::write(stream, meta.originalSize);
+    io::writeAttributes(stream, entryAttributes(meta));
 }
 
-void writeMetadata(std::ofstream& stream, const std::vector<meta::FileMeta>& metadata, compression::CompressionType compType) {
+void writeMetadata(std::ostream& stream, const std::vector<meta::FileMeta>& metadata, compression::CompressionType compType,
+                   const std::vector<Attribute>& sections) {
     uint64_t metaOffset = stream.tellp();  // Get position for metadata section
 
+    // Archive level sections precede the entries
+    io::writeAttributes(stream, sections);
+
     // Split metadata into unique and duplicate files
     std::vector<const meta::FileMeta*> uniqueFiles;
     std::vector<const meta::FileMeta*> duplicateFiles;
@@ -87,38 +272,37 @@ void writeMetadata(std::ofstream& stream, const std::vector<meta::FileMeta>& met
         io::write(stream, *meta);
     }
     
-    // Write duplicate files (only dataOffset and relativePath for duplicates)
+    // Write duplicate files (only dataOffset, relativePath and the block position for duplicates)
     for (const auto* meta : duplicateFiles) {
         io::write(stream, meta->dataOffset);
         io::write(stream, meta->relativePath);
+        io::writeAttributes(stream, entryAttributes(*meta));
     }
     
     // Write footer with metadata position, count, and compression type
     io::writeFooter(stream, compType, uniqueFiles.size(), duplicateFiles.size(), metaOffset);
 }
 
-std::vector<meta::FileMeta> readMetadata(std::ifstream& stream, compression::CompressionType& compType) {
+std::vector<meta::FileMeta> readMetadata(std::istream& stream, compression::CompressionType& compType,
+                                         std::vector<Attribute>* sections, uint64_t archiveEnd) {
     uint64_t uniqueCount;
-    size_t duplicateCount;
-    size_t metaOffset;
+    uint64_t duplicateCount;
+    uint64_t metaOffset;
     
-    io::readFooter(stream, compType, uniqueCount, duplicateCount, metaOffset);
+    io::readFooter(stream, compType, uniqueCount, duplicateCount, metaOffset, archiveEnd);
     stream.seekg(metaOffset);
 
+    auto archiveSections = io::readAttributes(stream);  // Interpreted by the caller, e.g. embedded dictionaries
+    if (sections) {
+        *sections = std::move(archiveSections);
+    }
+
     std::vector<meta::FileMeta> metadata;
     metadata.reserve(uniqueCount + duplicateCount);
 
     // Read unique files
     for (size_t i = 0; i < uniqueCount; i++) {
-        int64_t offset;
-        std::string hash;
-        std::string path;
-        
-        io::read(stream, offset);
-        io::read(stream, hash);
-        io::read(stream, path);
-        
-        metadata.emplace_back(offset, hash, path);
+        metadata.push_back(readEntry(stream));
     }
         
     // Read duplicate files
@@ -128,13 +312,78 @@ std::vector<meta::FileMeta> readMetadata(std::ifstream& stream, compression::Com
         
         io::read(stream, dataOffset);
         io::read(stream, path);
+        auto attributes = io::readAttributes(stream);
         
         metadata.emplace_back(dataOffset, "", path);
+        applyAttributes(metadata.back(), attributes);
     }
     
     return std::move(metadata);
 }
 
+Attribute retainedEntrySection(const meta::FileMeta& meta) {
+    std::ostringstream payload;
+    write(payload, meta);
+    return {TAG_RETAINED_ENTRY, payload.str()};
+}
+
+std::vector<meta::FileMeta> readRetainedEntries(const std::vector<Attribute>& sections) {
+    std::vector<meta::FileMeta> entries;
+    for (const auto& [tag, payload] : sections) {
+        if (tag == TAG_RETAINED_ENTRY) {
+            std::istringstream stream(payload);
+            entries.push_back(readEntry(stream));
+        }
+    }
+    return entries;
+}
+
+std::string journalPath(const std::string& archiveFile) {
+    return archiveFile + ".journal";
+}
+
+void writeJournal(const std::string& archiveFile, uint64_t committedSize) {
+    std::string path = journalPath(archiveFile);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream journal(tempPath, std::ios::binary);
+        checkOpen(journal, tempPath, "Journal creation");
+        write(journal, JOURNAL_MAGIC);
+        write(journal, committedSize);
+        journal.close();
+        checkErrors(journal, "Journal writing");
+    }
+    std::filesystem::rename(tempPath, path);
+}
+
+uint64_t committedSize(const std::string& archiveFile) {
+    std::ifstream journal(journalPath(archiveFile), std::ios::binary);
+    if (!journal.is_open()) {
+        return std::filesystem::file_size(archiveFile);
+    }
+    uint32_t magic;
+    uint64_t size;
+    read(journal, magic);
+    read(journal, size);
+    if (magic != JOURNAL_MAGIC) {
+        throw std::runtime_error("Invalid append journal: " + journalPath(archiveFile));
+    }
+    return size;
+}
+
+bool rollBackAppend(const std::string& archiveFile) {
+    if (!std::filesystem::exists(journalPath(archiveFile))) {
+        return false;
+    }
+    std::filesystem::resize_file(archiveFile, committedSize(archiveFile));
+    std::filesystem::remove(journalPath(archiveFile));
+    return true;
+}
+
+int64_t modificationTime(const std::filesystem::path& path) {
+    return static_cast<int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+}
+
 std::vector<std::filesystem::path> scanDirectory(const std::string& rootDir, bool skipEmptyFiles) {
     std::vector<std::filesystem::path> filePaths;  // Container for all found file paths
     
@@ -0,0 +1,495 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "IO.h"
+#include "JsonLinesCodec.h"
+
+namespace jsonlines {
+
+namespace {
+
+constexpr size_t BLOCK_HEADER_SIZE = (2 + COLUMN_COUNT) * sizeof(uint32_t);
+constexpr size_t KEY_COLUMN_HEADER_SIZE = 2 * sizeof(uint32_t);
+constexpr size_t MAX_ENCODED_BLOCK_SIZE = 16 * JSON_BLOCK_SIZE;
+constexpr size_t MAX_INTEGER_DIGITS = 18;  // Every such decimal fits an int64_t
+
+// Share of sampled lines that must be records, and the most distinct shapes per record
+constexpr double MIN_RECORD_LINE_RATIO = 0.5;
+constexpr size_t MIN_RECORDS_PER_SHAPE = 2;
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Canonical decimals without leading zeros or a negative zero go to integer encoding; they print back the same
+bool parseInteger(std::string_view token, int64_t& value) {
+    std::string_view digits = token.substr(!token.empty() && token[0] == '-' ? 1 : 0);
+    if (digits.empty() || digits.size() > MAX_INTEGER_DIGITS || (digits.size() > 1 && digits[0] == '0') ||
+        !std::all_of(digits.begin(), digits.end(), isDigit) || token == "-0") {
+        return false;
+    }
+    std::from_chars(token.data(), token.data() + token.size(), value);
+    return true;
+}
+
+// Returns the position after the closing quote of the string opening at pos, or npos if there is none
+// or it holds a control byte
+size_t skipString(std::string_view line, size_t pos) {
+    for (size_t i = pos + 1; i < line.size(); i++) {
+        if (static_cast<unsigned char>(line[i]) < 0x20) {
+            return std::string_view::npos;
+        }
+        if (line[i] == '"') {
+            return i + 1;
+        }
+        if (line[i] == '\\') {
+            if (++i == line.size() || static_cast<unsigned char>(line[i]) < 0x20) {
+                return std::string_view::npos;
+            }
+        }
+    }
+    return std::string_view::npos;
+}
+
+// Returns the position after the object or array opening at pos, or npos if it is not closed on this line
+size_t skipNested(std::string_view line, size_t pos) {
+    size_t depth = 0;
+    for (size_t i = pos; i < line.size();) {
+        char c = line[i];
+        if (c == '"') {
+            i = skipString(line, i);
+            if (i == std::string_view::npos) {
+                return i;
+            }
+            continue;
+        }
+        if (c == '\n') {
+            return std::string_view::npos;
+        }
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if ((c == '}' || c == ']') && --depth == 0) {
+            return i + 1;
+        }
+        i++;
+    }
+    return std::string_view::npos;
+}
+
+size_t skipSpaces(std::string_view line, size_t pos) {
+    while (pos < line.size() && isSpace(line[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+void appendBytes(std::string& output, std::string_view bytes) {
+    io::appendVarint(output, bytes.size());
+    output.append(bytes.data(), bytes.size());
+}
+
+void appendUint32(std::string& output, uint32_t value) {
+    output.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+uint32_t readUint32(const char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+}  // namespace
+
+bool parseRecord(std::string_view line, ParsedRecord& parsed) {
+    parsed.shape.clear();
+    parsed.fields.clear();
+    size_t pos = skipSpaces(line, 0);
+    if (pos == line.size() || line[pos] != '{') {
+        return false;
+    }
+    pos = skipSpaces(line, pos + 1);
+    parsed.shape.append(line.data(), pos);
+
+    while (pos < line.size() && line[pos] != '}') {
+        // "key" : value, with the key and every separator kept in the shape
+        if (line[pos] != '"' || parsed.fields.size() == MAX_FIELDS) {
+            return false;
+        }
+        size_t keyEnd = skipString(line, pos);
+        if (keyEnd == std::string_view::npos) {
+            return false;
+        }
+        size_t colon = skipSpaces(line, keyEnd);
+        if (colon == line.size() || line[colon] != ':') {
+            return false;
+        }
+        size_t start = skipSpaces(line, colon + 1);
+        parsed.shape.append(line.data() + pos, start - pos);
+        if (start == line.size()) {
+            return false;
+        }
+
+        Field field;
+        field.key = line.substr(pos + 1, keyEnd - pos - 2);
+        size_t end;
+        if (line[start] == '"') {
+            end = skipString(line, start);
+            if (end == std::string_view::npos) {
+                return false;
+            }
+            field.type = STRING_PLACEHOLDER;
+            field.text = line.substr(start + 1, end - start - 2);
+            parsed.shape += '"';
+            parsed.shape += STRING_PLACEHOLDER;
+            parsed.shape += '"';
+        } else {
+            if (line[start] == '{' || line[start] == '[') {
+                end = skipNested(line, start);
+            } else {
+                end = start;
+                while (end < line.size() && !isSpace(line[end]) && line[end] != ',' && line[end] != '}' &&
+                       line[end] != '\r' && line[end] != '\n') {
+                    end++;
+                }
+            }
+            if (end == std::string_view::npos || end == start) {
+                return false;
+            }
+            field.text = line.substr(start, end - start);
+            field.type = parseInteger(field.text, field.integer) ? INTEGER_PLACEHOLDER : LITERAL_PLACEHOLDER;
+            parsed.shape += field.type;
+        }
+        parsed.fields.push_back(field);
+
+        pos = skipSpaces(line, end);
+        if (pos < line.size() && line[pos] == ',') {
+            size_t next = skipSpaces(line, pos + 1);
+            if (next == line.size() || line[next] != '"') {
+                return false;  // Trailing comma
+            }
+            parsed.shape.append(line.data() + end, next - end);
+            pos = next;
+        } else if (pos < line.size() && line[pos] == '}') {
+            parsed.shape.append(line.data() + end, pos - end);
+        } else {
+            return false;
+        }
+        if (parsed.shape.size() > MAX_SHAPE_LENGTH) {
+            return false;
+        }
+    }
+    if (pos == line.size()) {
+        return false;  // Object not closed
+    }
+
+    // Only whitespace and the line break may follow the object
+    for (size_t i = pos + 1; i < line.size(); i++) {
+        if (!isSpace(line[i]) && line[i] != '\r' && line[i] != '\n') {
+            return false;
+        }
+    }
+    parsed.shape.append(line.data() + pos, line.size() - pos);
+    return parsed.shape.size() <= MAX_SHAPE_LENGTH;
+}
+
+bool hasJsonLines(const char* data, size_t size) {
+    std::unordered_set<std::string> distinct;
+    ParsedRecord parsed;
+    size_t lines = 0;
+    size_t records = 0;
+    size_t pos = 0;
+    while (pos < size) {
+        const char* end = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+        size_t length = end ? static_cast<size_t>(end - data) + 1 - pos : size - pos;
+        lines++;
+        if (parseRecord(std::string_view(data + pos, length), parsed) && !parsed.fields.empty()) {
+            records++;
+            distinct.insert(parsed.shape);
+        }
+        pos += length;
+    }
+    return records > 0 && records >= lines * MIN_RECORD_LINE_RATIO &&
+           distinct.size() * MIN_RECORDS_PER_SHAPE <= records;
+}
+
+EncodingBuffer::EncodingBuffer(std::istream& source) : source(source), input(JSON_BLOCK_SIZE) {}
+
+EncodingBuffer::int_type EncodingBuffer::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    source.read(input.data() + buffered, input.size() - buffered);
+    buffered += static_cast<size_t>(source.gcount());
+    if (buffered == 0) {
+        return traits_type::eof();
+    }
+
+    // A block ends after its last complete line, unless a single line fills all of it
+    size_t blockSize = buffered;
+    if (buffered == input.size()) {
+        auto lastNewline = std::find(input.rbegin(), input.rend(), '\n');
+        if (lastNewline != input.rend()) {
+            blockSize = static_cast<size_t>(input.rend() - lastNewline);
+        }
+    }
+
+    struct KeyColumn {
+        std::string data;
+        int64_t previous = 0;  // Last integer of the key, the base of the next delta
+    };
+    std::string columns[COLUMN_COUNT];
+    std::map<uint32_t, KeyColumn> keyColumns;  // Ordered by key id
+    std::vector<uint32_t> fieldKeys;
+    ParsedRecord parsed;
+    uint32_t lineCount = 0;
+    for (size_t pos = 0; pos < blockSize; lineCount++) {
+        const char* start = input.data() + pos;
+        const char* end = static_cast<const char*>(std::memchr(start, '\n', blockSize - pos));
+        std::string_view line(start, end ? static_cast<size_t>(end - start) + 1 : blockSize - pos);
+        pos += line.size();
+
+        const ShapeEntry* shape = nullptr;
+        if (parseRecord(line, parsed)) {
+            auto known = shapes.find(parsed.shape);
+            if (known != shapes.end()) {
+                shape = &known->second;
+            } else if (shapes.size() < MAX_SHAPES && keyIds.size() + parsed.fields.size() <= MAX_KEYS) {
+                ShapeEntry entry{static_cast<uint32_t>(shapes.size()) + 1, {}};
+                appendBytes(columns[COLUMN_SHAPES], parsed.shape);
+                for (const Field& field : parsed.fields) {
+                    auto [key, added] = keyIds.emplace(std::string(field.key), static_cast<uint32_t>(keyIds.size()));
+                    if (added) {
+                        appendBytes(columns[COLUMN_KEYS], field.key);
+                    }
+                    io::appendVarint(columns[COLUMN_SHAPES], key->second);
+                    entry.keyIds.push_back(key->second);
+                }
+                shape = &shapes.emplace(parsed.shape, std::move(entry)).first->second;
+            }
+        }
+        io::appendVarint(columns[COLUMN_SHAPE_IDS], shape ? shape->id : RAW_LINE);
+        if (!shape) {
+            appendBytes(columns[COLUMN_RAW], line);
+            continue;
+        }
+
+        for (size_t i = 0; i < parsed.fields.size(); i++) {
+            const Field& field = parsed.fields[i];
+            KeyColumn& column = keyColumns[shape->keyIds[i]];
+            if (field.type == INTEGER_PLACEHOLDER) {
+                io::appendVarint(column.data, io::zigzagEncode(static_cast<int64_t>(
+                    static_cast<uint64_t>(field.integer) - static_cast<uint64_t>(column.previous))));
+                column.previous = field.integer;
+            } else {
+                appendBytes(column.data, field.text);
+            }
+        }
+    }
+
+    encoded.clear();
+    appendUint32(encoded, lineCount);
+    for (const std::string& column : columns) {
+        appendUint32(encoded, static_cast<uint32_t>(column.size()));
+    }
+    appendUint32(encoded, static_cast<uint32_t>(keyColumns.size()));
+    for (const auto& [keyId, column] : keyColumns) {
+        appendUint32(encoded, keyId);
+        appendUint32(encoded, static_cast<uint32_t>(column.data.size()));
+    }
+    for (const std::string& column : columns) {
+        encoded += column;
+    }
+    for (const auto& [keyId, column] : keyColumns) {
+        encoded += column.data;
+    }
+
+    std::copy(input.begin() + blockSize, input.begin() + buffered, input.begin());
+    buffered -= blockSize;
+    setg(&encoded[0], &encoded[0], &encoded[0] + encoded.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+DecodingBuffer::DecodingBuffer(std::ostream& target) : target(target) {}
+
+void DecodingBuffer::finish() const {
+    if (!pending.empty()) {
+        throw std::runtime_error("Invalid archive: JSON-lines stream ends inside a block");
+    }
+}
+
+DecodingBuffer::int_type DecodingBuffer::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        char byte = traits_type::to_char_type(c);
+        xsputn(&byte, 1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize DecodingBuffer::xsputn(const char* data, std::streamsize size) {
+    pending.append(data, size);
+    decodeBlocks();
+    return size;
+}
+
+void DecodingBuffer::decodeBlocks() {
+    auto malformed = []() {
+        return std::runtime_error("Invalid archive: malformed block in a JSON-lines stream");
+    };
+
+    // Read position, end and last integer of a column
+    struct Cursor {
+        const char* pos;
+        const char* end;
+        int64_t previous = 0;
+    };
+    auto readValue = [&](Cursor& cursor) {
+        uint64_t value;
+        if (!io::readVarint(cursor.pos, cursor.end, value)) {
+            throw malformed();
+        }
+        return value;
+    };
+    auto readBytes = [&](Cursor& cursor, size_t maxSize) {
+        uint64_t size = readValue(cursor);
+        if (size > maxSize || size > static_cast<uint64_t>(cursor.end - cursor.pos)) {
+            throw malformed();
+        }
+        std::string_view bytes(cursor.pos, size);
+        cursor.pos += size;
+        return bytes;
+    };
+
+    size_t pos = 0;
+    while (pending.size() - pos >= BLOCK_HEADER_SIZE) {
+        const char* header = pending.data() + pos;
+        uint32_t lineCount = readUint32(header);
+        uint32_t keyColumnCount = readUint32(header + (1 + COLUMN_COUNT) * sizeof(uint32_t));
+        if (lineCount == 0 || lineCount > JSON_BLOCK_SIZE || keyColumnCount > MAX_KEYS) {
+            throw malformed();
+        }
+        uint64_t headerSize = BLOCK_HEADER_SIZE + static_cast<uint64_t>(keyColumnCount) * KEY_COLUMN_HEADER_SIZE;
+        if (pending.size() - pos < headerSize) {
+            break;  // Rest of the header is still to come
+        }
+        uint64_t blockSize = headerSize;
+        for (size_t column = 0; column < COLUMN_COUNT; column++) {
+            blockSize += readUint32(header + (1 + column) * sizeof(uint32_t));
+        }
+        for (uint32_t i = 0; i < keyColumnCount; i++) {
+            blockSize += readUint32(header + BLOCK_HEADER_SIZE + i * KEY_COLUMN_HEADER_SIZE + sizeof(uint32_t));
+        }
+        if (blockSize > MAX_ENCODED_BLOCK_SIZE) {
+            throw malformed();
+        }
+        if (pending.size() - pos < blockSize) {
+            break;  // Rest of the block is still to come
+        }
+
+        const char* next = header + headerSize;
+        Cursor columns[COLUMN_COUNT];
+        for (size_t column = 0; column < COLUMN_COUNT; column++) {
+            columns[column].pos = next;
+            next += readUint32(header + (1 + column) * sizeof(uint32_t));
+            columns[column].end = next;
+        }
+        std::vector<Cursor> keyColumns(keyColumnCount);
+        std::unordered_map<uint32_t, size_t> keyColumnIndex;  // Key id to its column in this block
+        for (uint32_t i = 0; i < keyColumnCount; i++) {
+            const char* entry = header + BLOCK_HEADER_SIZE + i * KEY_COLUMN_HEADER_SIZE;
+            if (!keyColumnIndex.emplace(readUint32(entry), i).second) {
+                throw malformed();
+            }
+            keyColumns[i].pos = next;
+            next += readUint32(entry + sizeof(uint32_t));
+            keyColumns[i].end = next;
+        }
+
+        while (columns[COLUMN_KEYS].pos != columns[COLUMN_KEYS].end) {
+            if (keyCount >= MAX_KEYS) {
+                throw malformed();
+            }
+            readBytes(columns[COLUMN_KEYS], MAX_SHAPE_LENGTH);
+            keyCount++;
+        }
+        while (columns[COLUMN_SHAPES].pos != columns[COLUMN_SHAPES].end) {
+            if (shapes.size() >= MAX_SHAPES) {
+                throw malformed();
+            }
+            Shape shape;
+            shape.text = readBytes(columns[COLUMN_SHAPES], MAX_SHAPE_LENGTH);
+            for (char c : shape.text) {
+                if (c == STRING_PLACEHOLDER || c == INTEGER_PLACEHOLDER || c == LITERAL_PLACEHOLDER) {
+                    uint64_t keyId = readValue(columns[COLUMN_SHAPES]);
+                    if (keyId >= keyCount) {
+                        throw malformed();
+                    }
+                    shape.keyIds.push_back(static_cast<uint32_t>(keyId));
+                }
+            }
+            shapes.push_back(std::move(shape));
+        }
+
+        decoded.clear();
+        for (uint32_t i = 0; i < lineCount; i++) {
+            uint64_t id = readValue(columns[COLUMN_SHAPE_IDS]);
+            if (id == RAW_LINE) {
+                std::string_view line = readBytes(columns[COLUMN_RAW], JSON_BLOCK_SIZE);
+                decoded.append(line.data(), line.size());
+                continue;
+            }
+            if (id > shapes.size()) {
+                throw malformed();
+            }
+            const Shape& shape = shapes[id - 1];
+            size_t field = 0;
+            for (char c : shape.text) {
+                if (c != STRING_PLACEHOLDER && c != INTEGER_PLACEHOLDER && c != LITERAL_PLACEHOLDER) {
+                    decoded += c;
+                    continue;
+                }
+                auto index = keyColumnIndex.find(shape.keyIds[field++]);
+                if (index == keyColumnIndex.end()) {
+                    throw malformed();
+                }
+                Cursor& column = keyColumns[index->second];
+                if (c == INTEGER_PLACEHOLDER) {
+                    int64_t delta = io::zigzagDecode(readValue(column));
+                    column.previous = static_cast<int64_t>(static_cast<uint64_t>(column.previous) +
+                                                           static_cast<uint64_t>(delta));
+                    char digits[20];
+                    auto result = std::to_chars(digits, digits + sizeof(digits), column.previous);
+                    decoded.append(digits, result.ptr);
+                } else {
+                    std::string_view value = readBytes(column, JSON_BLOCK_SIZE);
+                    decoded.append(value.data(), value.size());
+                }
+            }
+        }
+        for (const Cursor& column : columns) {
+            if (column.pos != column.end) {
+                throw malformed();  // Values no line used
+            }
+        }
+        for (const Cursor& column : keyColumns) {
+            if (column.pos != column.end) {
+                throw malformed();
+            }
+        }
+
+        io::writeBuffer(target, decoded.data(), decoded.size());
+        restored += decoded.size();
+        pos += blockSize;
+    }
+    pending.erase(0, pos);
+}
+
+}  // namespace jsonlines
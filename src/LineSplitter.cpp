@@ -0,0 +1,90 @@
+#include <cstring>
+
+#include "ContentProbe.h"
+#include "LineSplitter.h"
+
+namespace lines {
+
+LineSplitter::LineSplitter(transcoding::Encoding encoding) : encoding(encoding) {}
+
+void LineSplitter::detectEncoding(uint64_t fileSize) {
+    encoding = transcoding::Encoding::NONE;
+    detecting = fileSize > 0 && fileSize % 2 == 0;  // Odd sizes are never UTF-16
+}
+
+void LineSplitter::finish() {
+    if (detecting) {
+        encoding = transcoding::detectUtf16(reinterpret_cast<const uint8_t*>(carried.data()), carried.size());
+        detecting = false;
+    }
+    if (!carried.empty()) {
+        convertCarried(true);  // A lone high surrogate; an odd last byte is dropped
+    }
+    if (!partial.empty()) {
+        std::string line = std::move(partial);
+        partial.clear();
+        onLine(line);
+    }
+}
+
+LineSplitter::int_type LineSplitter::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        char byte = traits_type::to_char_type(c);
+        xsputn(&byte, 1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize LineSplitter::xsputn(const char* data, std::streamsize size) {
+    if (encoding == transcoding::Encoding::NONE && !detecting) {
+        scan(data, static_cast<size_t>(size));
+        return size;
+    }
+    carried.append(data, static_cast<size_t>(size));
+    if (detecting) {
+        if (carried.size() < probe::SAMPLE_SIZE) {
+            return size;
+        }
+        encoding = transcoding::detectUtf16(reinterpret_cast<const uint8_t*>(carried.data()), probe::SAMPLE_SIZE);
+        detecting = false;
+    }
+    convertCarried(false);
+    return size;
+}
+
+void LineSplitter::convertCarried(bool final) {
+    if (encoding == transcoding::Encoding::NONE) {
+        std::string sample = std::move(carried);  // Detected as not UTF-16
+        carried.clear();
+        scan(sample.data(), sample.size());
+        return;
+    }
+    converted.clear();
+    size_t consumed = transcoding::utf16ToUtf8(reinterpret_cast<const uint8_t*>(carried.data()), carried.size(),
+                                               encoding, final, converted);
+    carried.erase(0, final ? carried.size() : consumed);
+    scan(converted.data(), converted.size());
+}
+
+void LineSplitter::scan(const char* data, size_t size) {
+    const char* pos = data;
+    const char* end = data + size;
+    while (pos < end) {
+        const char* newline = static_cast<const char*>(std::memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        if (!newline) {
+            partial.append(pos, end);
+            break;
+        }
+        if (partial.empty()) {
+            onLine(std::string_view(pos, static_cast<size_t>(newline - pos)));  // Whole line in this write
+        } else {
+            partial.append(pos, newline);
+            std::string line = std::move(partial);
+            partial.clear();
+            onLine(line);
+        }
+        pos = newline + 1;
+    }
+}
+
+}  // namespace lines
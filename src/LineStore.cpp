@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+#include "LineStore.h"
+
+namespace lines {
+
+namespace {
+
+constexpr size_t RECORD_HEADER_SIZE = 1 + sizeof(uint32_t);
+
+// Lines are hashed with the standard library hash; the table lives only as long as one run
+uint64_t hashLine(std::string_view line) {
+    return std::hash<std::string_view>()(line);
+}
+
+void appendRecord(std::string& output, RecordKind kind, uint32_t value) {
+    output += static_cast<char>(kind);
+    output.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+}  // namespace
+
+LineReader::LineReader(std::istream& input) : input(input), buffer(std::max<size_t>(MAX_LINE_LENGTH * 4, 1 << 20)) {}
+
+bool LineReader::next(std::string_view& line) {
+    while (true) {
+        size_t available = end - start;
+        const char* data = buffer.data() + start;
+        const void* newline = std::memchr(data, '\n', std::min(available, MAX_LINE_LENGTH));
+        if (newline || available >= MAX_LINE_LENGTH || (eof && available > 0)) {
+            size_t length = newline ? static_cast<const char*>(newline) - data + 1 : std::min(available, MAX_LINE_LENGTH);
+            line = std::string_view(data, length);
+            start += length;
+            return true;
+        }
+        if (eof) {
+            return false;
+        }
+
+        // Keep the partial line and read on behind it
+        std::copy(buffer.begin() + start, buffer.begin() + end, buffer.begin());
+        end -= start;
+        start = 0;
+        input.read(buffer.data() + end, buffer.size() - end);
+        end += input.gcount();
+        eof = !input;
+    }
+}
+
+LineTable::LineTable(uint64_t memoryLimit) {
+    size_t capacity = 1024;
+    while (capacity * 2 * sizeof(Slot) <= memoryLimit) {
+        capacity *= 2;
+    }
+    slots.resize(capacity);
+    mask = capacity - 1;
+}
+
+LineTable::Slot* LineTable::insert(uint64_t hash) {
+    hash = hash == 0 ? 1 : hash;  // 0 marks an empty slot
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        Slot& slot = slots[i];
+        if (slot.hash == hash) {
+            return &slot;
+        }
+        if (slot.hash == 0) {
+            if (used >= slots.size() / 4 * 3) {
+                return nullptr;  // Probe sequences grow long beyond three quarters full
+            }
+            slot.hash = hash;
+            used++;
+            return &slot;
+        }
+    }
+}
+
+const LineTable::Slot* LineTable::find(uint64_t hash) const {
+    hash = hash == 0 ? 1 : hash;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Slot& slot = slots[i];
+        if (slot.hash == hash) {
+            return &slot;
+        }
+        if (slot.hash == 0) {
+            return nullptr;  // The table is never full, so every probe sequence ends at an empty slot
+        }
+    }
+}
+
+LineDictionary::LineDictionary(std::string content) : content(std::move(content)) {
+    offsets.push_back(0);
+    for (size_t i = 0; i < this->content.size(); i++) {
+        if (this->content[i] == '\n') {
+            offsets.push_back(i + 1);
+        }
+    }
+    if (offsets.back() != this->content.size()) {
+        throw std::runtime_error("Invalid archive: line store does not end with a complete line");
+    }
+}
+
+uint32_t LineDictionary::append(std::string_view line) {
+    if (offsets.empty()) {
+        offsets.push_back(0);
+    }
+    content.append(line.data(), line.size());
+    offsets.push_back(content.size());
+    return static_cast<uint32_t>(offsets.size() - 2);
+}
+
+LineStore::LineStore(uint64_t memoryLimit) : lineTable(memoryLimit / 4) {
+    uint64_t tableSize = lineTable.capacity() * sizeof(LineTable::Slot);
+    storeLimit = memoryLimit > tableSize ? memoryLimit - tableSize : 0;
+}
+
+void LineStore::scan(std::istream& input) {
+    LineReader reader(input);
+    std::string_view line;
+    while (reader.next(line)) {
+        if (line.size() < MIN_LINE_LENGTH || line.back() != '\n') {
+            continue;  // Short lines and pieces of overlong ones are left to the codec
+        }
+        LineTable::Slot* slot = lineTable.insert(hashLine(line));
+        if (!slot) {
+            continue;
+        }
+        slot->count += slot->count < UINT32_MAX;
+        uint64_t cost = line.size() + sizeof(uint64_t);  // The line and its offset
+        if (slot->count == 2 && slot->lineId == LineTable::NO_LINE && storeUsed + cost <= storeLimit &&
+            size() < LineTable::NO_LINE - 1) {
+            slot->lineId = append(line);
+            storeUsed += cost;
+        }
+    }
+}
+
+uint32_t LineStore::find(std::string_view line) const {
+    if (line.size() < MIN_LINE_LENGTH || line.back() != '\n') {
+        return LineTable::NO_LINE;
+    }
+    const LineTable::Slot* slot = lineTable.find(hashLine(line));
+    if (!slot || slot->lineId == LineTable::NO_LINE || this->line(slot->lineId) != line) {
+        return LineTable::NO_LINE;  // Not stored, or a different line with the same hash
+    }
+    return slot->lineId;
+}
+
+EncodingBuffer::EncodingBuffer(std::istream& source, const LineStore& store) : reader(source), store(store) {}
+
+EncodingBuffer::int_type EncodingBuffer::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    auto flushLiteral = [&]() {
+        if (!literal.empty()) {
+            appendRecord(encoded, RECORD_LITERAL, static_cast<uint32_t>(literal.size()));
+            encoded += literal;
+            literal.clear();
+        }
+    };
+
+    // Encode lines until about a literal's worth of records is ready
+    encoded.clear();
+    std::string_view line;
+    while (encoded.size() < MAX_LITERAL_SIZE) {
+        if (!reader.next(line)) {
+            flushLiteral();
+            break;
+        }
+        uint32_t id = store.find(line);
+        if (id != LineTable::NO_LINE) {
+            flushLiteral();
+            appendRecord(encoded, RECORD_REFERENCE, id);
+        } else {
+            if (literal.size() + line.size() > MAX_LITERAL_SIZE) {
+                flushLiteral();
+            }
+            literal.append(line.data(), line.size());
+        }
+    }
+    if (encoded.empty()) {
+        return traits_type::eof();
+    }
+    setg(&encoded[0], &encoded[0], &encoded[0] + encoded.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+DecodingBuffer::DecodingBuffer(std::ostream& target, const LineDictionary& dictionary)
+    : target(target), dictionary(dictionary) {}
+
+void DecodingBuffer::finish() const {
+    if (!pending.empty()) {
+        throw std::runtime_error("Invalid archive: line-encoded stream ends inside a record");
+    }
+}
+
+DecodingBuffer::int_type DecodingBuffer::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        char byte = traits_type::to_char_type(c);
+        xsputn(&byte, 1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize DecodingBuffer::xsputn(const char* data, std::streamsize size) {
+    pending.append(data, size);
+    decodeRecords();
+    return size;
+}
+
+void DecodingBuffer::decodeRecords() {
+    size_t pos = 0;
+    while (pending.size() - pos >= RECORD_HEADER_SIZE) {
+        uint8_t kind = static_cast<uint8_t>(pending[pos]);
+        uint32_t value;
+        std::memcpy(&value, pending.data() + pos + 1, sizeof(value));
+        if (kind == RECORD_REFERENCE) {
+            if (value >= dictionary.size()) {
+                throw std::runtime_error("Invalid archive: reference to line " + std::to_string(value) +
+                                         " outside the line store");
+            }
+            std::string_view line = dictionary.line(value);
+            io::writeBuffer(target, line.data(), line.size());
+            expanded += line.size();
+            pos += RECORD_HEADER_SIZE;
+        } else if (kind == RECORD_LITERAL) {
+            if (value > MAX_LITERAL_SIZE) {
+                throw std::runtime_error("Invalid archive: literal of " + std::to_string(value) +
+                                         " bytes in a line-encoded stream");
+            }
+            if (pending.size() - pos - RECORD_HEADER_SIZE < value) {
+                break;  // Rest of the literal is still to come
+            }
+            io::writeBuffer(target, pending.data() + pos + RECORD_HEADER_SIZE, value);
+            expanded += value;
+            pos += RECORD_HEADER_SIZE + value;
+        } else {
+            throw std::runtime_error("Invalid archive: unknown record in a line-encoded stream");
+        }
+    }
+    pending.erase(0, pos);
+}
+
+io::Attribute lineStoreSection(const LineStoreLocation& location) {
+    return {io::TAG_LINE_STORE, io::encodeValue(location.dataOffset) + io::encodeValue(location.size) +
+                                io::encodeValue(location.codec) + io::encodeValue(location.windowLog)};
+}
+
+std::optional<LineStoreLocation> readLineStoreSection(const std::vector<io::Attribute>& sections) {
+    for (const auto& [tag, payload] : sections) {
+        if (tag != io::TAG_LINE_STORE) {
+            continue;
+        }
+        constexpr size_t codecPos = sizeof(int64_t) + sizeof(uint64_t);
+        constexpr size_t windowPos = codecPos + sizeof(compression::CompressionType);
+        if (payload.size() != windowPos + sizeof(int32_t)) {
+            throw std::runtime_error("Invalid archive: malformed line store section");
+        }
+        LineStoreLocation location;
+        location.dataOffset = io::decodeValue<int64_t>(payload.substr(0, sizeof(int64_t)));
+        location.size = io::decodeValue<uint64_t>(payload.substr(sizeof(int64_t), sizeof(uint64_t)));
+        location.codec = io::decodeValue<compression::CompressionType>(payload.substr(codecPos, sizeof(compression::CompressionType)));
+        location.windowLog = io::decodeValue<int32_t>(payload.substr(windowPos));
+        return location;
+    }
+    return std::nullopt;
+}
+
+}  // namespace lines
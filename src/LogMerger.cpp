@@ -0,0 +1,368 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+
+#include "ArchiveReader.h"
+#include "FileMeta.h"
+#include "IO.h"
+#include "LineSplitter.h"
+#include "LogMerger.h"
+
+namespace merge {
+
+namespace {
+
+// A file or run to merge, with the span of its record times
+struct MergeInput {
+    int64_t start;
+    int64_t end;
+    RecordStream::Producer producer;
+};
+
+// Cuts the decoded text of a file into records and adds the ones inside the window to a stream
+class RecordSplitter : public lines::LineSplitter {
+public:
+    RecordSplitter(RecordStream& stream, size_t order, const std::string& label, int64_t leadingTime,
+                   const timestamps::TimeWindow& window, transcoding::Encoding encoding)
+        : LineSplitter(encoding), stream(stream), order(order), label(label), leadingTime(leadingTime),
+          window(window) {}
+
+    // Adds the last record
+    void finishRecords() {
+        finish();
+        addRecord();
+    }
+
+protected:
+    void onLine(std::string_view line) override {
+        if (firstLine && line.substr(0, timestamps::UTF8_BOM_LENGTH) == timestamps::UTF8_BOM) {
+            line.remove_prefix(timestamps::UTF8_BOM_LENGTH);  // Meaningless inside the merged stream
+        }
+        firstLine = false;
+        int64_t time;
+        bool timed = clock.advance(line, time);
+        if (clock.stamped() || record.size() >= MERGE_BATCH_SIZE) {  // Huge records are cut to bound memory
+            addRecord();
+        }
+        if (record.empty()) {
+            recordTimed = timed;
+            recordTime = timed ? time : leadingTime;
+        }
+        record += label;
+        record.append(line);
+        record += '\n';
+    }
+
+private:
+    void addRecord() {
+        if (!record.empty() && (!window.bounded() || (recordTimed && window.contains(recordTime)))) {
+            stream.add(recordTime, order, record);
+        }
+        record.clear();
+    }
+
+    RecordStream& stream;
+    const size_t order;  // Position of the file among the merged files
+    const std::string& label;
+    const int64_t leadingTime;  // Time of lines ahead of the first timestamp
+    const timestamps::TimeWindow& window;
+    timestamps::LineClock clock;
+    bool firstLine = true;
+    std::string record;
+    int64_t recordTime = 0;
+    bool recordTimed = false;
+};
+
+// Temporary run files, removed when the merge ends
+class RunFiles {
+public:
+    explicit RunFiles(const std::filesystem::path& dir)
+        : dir(dir.empty() ? std::filesystem::temp_directory_path() : dir),
+          prefix("logrescuer-merge-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())) {}
+
+    ~RunFiles() {
+        for (const auto& path : paths) {
+            std::error_code ignored;
+            std::filesystem::remove(path, ignored);
+        }
+    }
+
+    std::filesystem::path create() {
+        paths.push_back(dir / (prefix + "-" + std::to_string(paths.size()) + ".run"));
+        return paths.back();
+    }
+
+private:
+    const std::filesystem::path dir;
+    const std::string prefix;
+    std::vector<std::filesystem::path> paths;
+};
+
+// Producer decoding an archived file into records
+RecordStream::Producer fileProducer(compression::ReaderPool& readers, const meta::FileMeta& entry,
+                                    const meta::FileMeta& source, size_t order, const MergeOptions& options) {
+    std::string label = options.labelLines ? entry.relativePath + ":" : "";
+    int64_t leadingTime = source.hasTimeRange() ? source.minTimestamp : timestamps::MIN_TIMESTAMP;
+    return [&readers, &entry, &source, &options, order, label, leadingTime](RecordStream& stream) {
+        auto reader = readers.acquire();
+        RecordSplitter splitter(stream, order, label, leadingTime, options.window,
+                                static_cast<transcoding::Encoding>(source.textEncoding));
+        if (!source.isTranscoded()) {
+            splitter.detectEncoding(source.originalSize);  // UTF-16 kept as it is when compressed
+        }
+        std::ostream decoded(&splitter);
+        decoded.exceptions(std::ios::badbit);  // Rethrows Cancelled and decoding errors
+        reader->read(entry, decoded);
+        splitter.finishRecords();
+        readers.release(std::move(reader));
+    };
+}
+
+// Producer reading back the records of a run: int64 time, uint64 file order, uint32 size and the text of each
+RecordStream::Producer runProducer(const std::filesystem::path& path) {
+    return [path](RecordStream& stream) {
+        std::ifstream run(path, std::ios::binary);
+        io::checkOpen(run, path.string(), "Merge run reading");
+        std::string text;
+        int64_t time;
+        while (run.read(reinterpret_cast<char*>(&time), sizeof(time))) {
+            uint64_t order;
+            uint32_t size;
+            io::read(run, order);
+            io::read(run, size);
+            text.resize(size);
+            io::readBuffer(run, &text[0], size);
+            stream.add(time, static_cast<size_t>(order), text);
+        }
+    };
+}
+
+// Largest number of inputs whose time spans share a moment
+size_t maxOverlap(const std::vector<MergeInput>& inputs) {
+    std::vector<std::pair<int64_t, int>> events;  // Time and -1 for a start, +1 for an end, so starts sort first
+    for (const auto& input : inputs) {
+        events.push_back({input.start, -1});
+        events.push_back({input.end, 1});
+    }
+    std::sort(events.begin(), events.end());
+    size_t open = 0;
+    size_t most = 0;
+    for (const auto& [time, kind] : events) {
+        open = kind < 0 ? open + 1 : open - 1;
+        most = std::max(most, open);
+    }
+    return most;
+}
+
+// Merges inputs sorted by start, handing each record to emit in time order and records of equal time in
+// the order of their files. An input is started once fewer than fanIn are running and made part of the
+// merge once the merge reaches its start.
+void mergePass(const std::vector<MergeInput>& inputs, size_t fanIn,
+               const std::function<void(int64_t, size_t, std::string_view)>& emit) {
+    std::vector<std::unique_ptr<RecordStream>> streams(inputs.size());
+    using Head = std::tuple<int64_t, size_t, size_t>;  // Time and file order of an input's current record, the input
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    size_t started = 0;  // Inputs decoding or done
+    size_t due = 0;      // Inputs part of the merge or done
+    size_t running = 0;
+    auto start = [&]() {
+        streams[started] = std::make_unique<RecordStream>(inputs[started].producer);
+        started++;
+        running++;
+    };
+    auto advance = [&](size_t input) {
+        if (streams[input]->next()) {
+            heads.push({streams[input]->time(), streams[input]->order(), input});
+        } else {
+            streams[input].reset();
+            running--;
+        }
+    };
+
+    while (true) {
+        while (started < inputs.size() && running < fanIn) {
+            start();  // Decodes ahead of the merge
+        }
+        if (due < inputs.size() && (heads.empty() || inputs[due].start <= std::get<0>(heads.top()))) {
+            if (due == started) {
+                start();  // More inputs overlap than planned for
+            }
+            advance(due++);
+            continue;
+        }
+        if (heads.empty()) {
+            break;
+        }
+        size_t input = std::get<2>(heads.top());
+        heads.pop();
+        emit(streams[input]->time(), streams[input]->order(), streams[input]->text());
+        advance(input);
+    }
+}
+
+}  // namespace
+
+RecordStream::RecordStream(Producer producer) {
+    // A thread of its own rather than a pool worker: producers wait while their queue is full, which
+    // would leave the pool without workers for the inputs the merge waits on
+    producerThread = std::thread([this, producer = std::move(producer)] { produce(producer); });
+}
+
+RecordStream::~RecordStream() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+    }
+    changed.notify_all();
+    producerThread.join();
+}
+
+void RecordStream::produce(const Producer& producer) {
+    try {
+        producer(*this);
+        flush();
+    } catch (const Cancelled&) {
+        // The reader is gone
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    changed.notify_all();
+}
+
+void RecordStream::add(int64_t time, size_t order, std::string_view text) {
+    filling.text.append(text);
+    filling.times.push_back(time);
+    filling.orders.push_back(order);
+    filling.ends.push_back(filling.text.size());
+    if (filling.text.size() >= MERGE_BATCH_SIZE) {
+        flush();
+    }
+}
+
+void RecordStream::flush() {
+    if (filling.times.empty()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return cancelled || queue.size() < MERGE_QUEUE_DEPTH; });
+    if (cancelled) {
+        throw Cancelled();
+    }
+    queue.push_back(std::move(filling));
+    filling = Batch();
+    lock.unlock();
+    changed.notify_all();
+}
+
+bool RecordStream::next() {
+    if (started && position + 1 < current.times.size()) {
+        position++;
+        return true;
+    }
+    started = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return done || !queue.empty(); });
+    if (queue.empty()) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return false;
+    }
+    current = std::move(queue.front());
+    queue.pop_front();
+    position = 0;
+    lock.unlock();
+    changed.notify_all();
+    return true;
+}
+
+std::string_view RecordStream::text() const {
+    size_t begin = position > 0 ? current.ends[position - 1] : 0;
+    return std::string_view(current.text).substr(begin, current.ends[position] - begin);
+}
+
+MergeStats mergeArchive(const std::string& archiveFile, std::ostream& output, const MergeOptions& options) {
+    if (options.fanIn < 2) {
+        throw std::invalid_argument("Merge fan-in must be at least 2");
+    }
+    compression::ReaderPool readers(archiveFile, options.registryDir);
+    auto index = readers.acquire();
+    const std::vector<meta::FileMeta>& metadata = index->entries();
+
+    std::vector<const meta::FileMeta*> selected;
+    for (const auto& relativePath : options.relativePaths) {
+        const meta::FileMeta* entry = index->find(relativePath);
+        if (!entry) {
+            throw std::runtime_error("File not found in archive: " + relativePath);
+        }
+        selected.push_back(entry);
+    }
+    if (options.relativePaths.empty()) {
+        for (const auto& entry : metadata) {
+            selected.push_back(&entry);
+        }
+    }
+
+    MergeStats stats;
+    std::vector<MergeInput> inputs;
+    for (const meta::FileMeta* entry : selected) {
+        const meta::FileMeta& source = index->resolve(*entry);  // Duplicates carry no range of their own
+        if (options.window.bounded() && !source.mayOverlap(options.window.since, options.window.until)) {
+            stats.skipped++;
+            continue;
+        }
+        int64_t start = source.hasTimeRange() ? source.minTimestamp : timestamps::MIN_TIMESTAMP;
+        int64_t end = source.hasTimeRange() ? source.maxTimestamp : timestamps::MAX_TIMESTAMP;
+        inputs.push_back({start, end, fileProducer(readers, *entry, source, inputs.size(), options)});
+        stats.files++;
+    }
+    readers.release(std::move(index));  // Metadata stays valid: the reader is only moved between owners
+    std::stable_sort(inputs.begin(), inputs.end(), [](const auto& a, const auto& b) { return a.start < b.start; });
+
+    // Rounds merge groups of inputs adjacent in start time into runs until few enough overlap
+    RunFiles runFiles(options.tempDir);
+    while (maxOverlap(inputs) > options.fanIn) {
+        std::vector<MergeInput> runs;
+        for (size_t first = 0; first < inputs.size(); first += options.fanIn) {
+            std::vector<MergeInput> group(inputs.begin() + first,
+                                          inputs.begin() + std::min(first + options.fanIn, inputs.size()));
+            std::filesystem::path path = runFiles.create();
+            std::ofstream run(path, std::ios::binary);
+            io::checkOpen(run, path.string(), "Merge run creation");
+            mergePass(group, options.fanIn, [&](int64_t time, size_t order, std::string_view text) {
+                io::write(run, time);
+                io::write(run, static_cast<uint64_t>(order));
+                io::write(run, static_cast<uint32_t>(text.size()));
+                io::writeBuffer(run, text.data(), text.size());
+            });
+            run.close();
+            io::checkErrors(run, "Merge run writing");
+
+            int64_t end = std::max_element(group.begin(), group.end(), [](const auto& a, const auto& b) {
+                return a.end < b.end;
+            })->end;
+            runs.push_back({group.front().start, end, runProducer(path)});
+            stats.runs++;
+        }
+        inputs = std::move(runs);
+    }
+
+    mergePass(inputs, options.fanIn, [&](int64_t, size_t, std::string_view text) {
+        io::writeBuffer(output, text.data(), text.size());
+        stats.records++;
+    });
+    output.flush();
+    io::checkErrors(output, "Merge output");
+    return stats;
+}
+
+}  // namespace merge
@@ -0,0 +1,528 @@
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "ArchiveReader.h"
+#include "ContentProbe.h"
+#include "FileMeta.h"
+#include "LineSplitter.h"
+#include "LogQuery.h"
+#include "TemplateCodec.h"
+#include "ThreadPool.h"
+
+namespace query {
+
+namespace {
+
+// Severity words recognised as levels, in upper case only so message words are not taken for them
+constexpr std::string_view LEVELS[] = {"TRACE", "DEBUG", "INFO", "NOTICE", "WARN", "WARNING", "ERROR",
+                                       "SEVERE", "CRITICAL", "ALERT", "FATAL", "EMERG"};
+
+// Words after the timestamp searched for a level, and bytes searched for a level and a component
+constexpr size_t LEVEL_WORDS = 4;
+constexpr size_t FIELD_SCAN_LENGTH = 160;
+
+const char* const RAW_TEMPLATE = "(raw)";
+
+bool isLevel(std::string_view word) {
+    return std::find(std::begin(LEVELS), std::end(LEVELS), word) != std::end(LEVELS);
+}
+
+bool isWordDelimiter(char c) {
+    switch (c) {
+        case ' ': case '\t': case '\r': case '\n': case '[': case ']': case '(': case ')': case '|': case ':':
+        case ',': case ';': case '=':
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Appends text with the template placeholders replaced
+void appendRendered(std::string& output, std::string_view text, bool named) {
+    for (char c : text) {
+        if (c == templates::TIMESTAMP_PLACEHOLDER) {
+            output += named ? "<time>" : "*";
+        } else if (c == templates::INTEGER_PLACEHOLDER) {
+            output += named ? "<int>" : "*";
+        } else if (c == templates::VARIABLE_PLACEHOLDER) {
+            output += named ? "<var>" : "*";
+        } else {
+            output += c;
+        }
+    }
+}
+
+bool isVariable(char c) {
+    return c == templates::INTEGER_PLACEHOLDER || c == templates::VARIABLE_PLACEHOLDER;
+}
+
+// Fields of a template as parsed by templates::parseLine, or of a line that does not parse when raw;
+// component is set to the name the component was taken from, inside text
+LineFields describeText(std::string_view text, bool raw, std::string_view& component) {
+    LineFields fields;
+    std::string_view body = text;
+    int64_t ignored;
+    if (!raw && !body.empty() && body[0] == templates::TIMESTAMP_PLACEHOLDER) {
+        body.remove_prefix(1);
+    } else if (raw && timestamps::parseTimestamp(body.data(), body.size(), ignored)) {
+        body.remove_prefix(timestamps::TIMESTAMP_LENGTH);
+    }
+    std::string_view head = body.substr(0, FIELD_SCAN_LENGTH);
+
+    size_t words = 0;
+    for (size_t pos = 0; pos < head.size() && words < LEVEL_WORDS && fields.level.empty();) {
+        if (isWordDelimiter(head[pos])) {
+            pos++;
+            continue;
+        }
+        size_t end = pos;
+        while (end < head.size() && !isWordDelimiter(head[end])) {
+            end++;
+        }
+        std::string_view word = head.substr(pos, end - pos);
+        if (isLevel(word)) {
+            fields.level = word;
+        }
+        words++;
+        pos = end;
+    }
+
+    component = std::string_view();
+    for (size_t open = head.find('['); open != std::string_view::npos; open = head.find('[', open + 1)) {
+        size_t close = head.find(']', open + 1);
+        if (close == std::string_view::npos) {
+            break;
+        }
+        std::string_view name = head.substr(open + 1, close - open - 1);
+        if (!name.empty() && name.find('[') == std::string_view::npos && !isLevel(name)) {
+            component = name;
+            appendRendered(fields.component, name, false);
+            break;
+        }
+    }
+
+    if (raw) {
+        fields.templateText = RAW_TEMPLATE;
+    } else {
+        while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) {
+            text.remove_suffix(1);
+        }
+        appendRendered(fields.templateText, text, true);
+    }
+    if (fields.level.empty()) {
+        fields.level = NO_VALUE;
+    }
+    if (fields.component.empty()) {
+        fields.component = NO_VALUE;
+    }
+    return fields;
+}
+
+// Fields of a template, and where a line finds the variables its component holds. Brackets are
+// delimiters of the template, so a line's component is the same bracketed token filled in.
+struct TemplateFields {
+    LineFields fields;          // Variables of the component shown as *
+    std::string component;      // Component with its placeholders, empty when it holds none
+    size_t integersBefore = 0;  // Variables of a line ahead of its component
+    size_t variablesBefore = 0;
+};
+
+TemplateFields describeTemplate(std::string_view text) {
+    TemplateFields result;
+    std::string_view component;
+    result.fields = describeText(text, false, component);
+    if (std::any_of(component.begin(), component.end(), isVariable)) {
+        result.component = component;
+        for (char c : text.substr(0, static_cast<size_t>(component.data() - text.data()))) {
+            result.integersBefore += c == templates::INTEGER_PLACEHOLDER;
+            result.variablesBefore += c == templates::VARIABLE_PLACEHOLDER;
+        }
+    }
+    return result;
+}
+
+// Component of a line of the template, its placeholders filled in from the line's variables
+void fillComponent(const TemplateFields& fields, const std::vector<uint64_t>& integers,
+                   const std::vector<std::string_view>& variables, std::string& component) {
+    component.clear();
+    size_t integer = fields.integersBefore;
+    size_t variable = fields.variablesBefore;
+    for (char c : fields.component) {
+        if (c == templates::INTEGER_PLACEHOLDER) {
+            char digits[20];
+            auto result = std::to_chars(digits, digits + sizeof(digits), integers[integer++]);
+            component.append(digits, result.ptr);
+        } else if (c == templates::VARIABLE_PLACEHOLDER) {
+            component.append(variables[variable].data(), variables[variable].size());
+            variable++;
+        } else {
+            component += c;
+        }
+    }
+}
+
+// Fields of a line, parsed into parsed
+LineFields describeParsed(std::string_view line, templates::ParsedLine& parsed) {
+    std::string_view component;
+    if (!templates::parseLine(line, parsed)) {
+        return describeText(line, true, component);
+    }
+    TemplateFields fields = describeTemplate(parsed.text);
+    if (!fields.component.empty()) {
+        fillComponent(fields, parsed.integers, parsed.variables, fields.fields.component);
+    }
+    return fields.fields;
+}
+
+// Whether counting needs the components of lines, and so the variables of template-encoded ones
+bool groupsByComponent(const QueryOptions& options) {
+    return std::find(options.groupBy.begin(), options.groupBy.end(), Field::COMPONENT) != options.groupBy.end();
+}
+
+// Unique content and the selected entries holding it
+struct Source {
+    size_t entry;               // Unique entry in metadata
+    std::vector<size_t> paths;  // Selected entries counted for it
+};
+
+// Unit of parallel work: one stream of its own, or the queried files of one solid block
+struct QueryTask {
+    std::vector<Source> sources;
+    uint64_t size = 0;  // Bytes to read, to start the largest tasks first
+};
+
+using Counts = std::map<std::vector<std::string>, uint64_t>;
+
+// Thrown while reading columns when the stream needs its lines restored after all
+struct NeedsLines {};
+
+// Counts the entries of one file into the counts of a task
+class EntryCounter {
+public:
+    EntryCounter(const QueryOptions& options, Counts& counts, uint64_t copies)
+        : options(options), counts(counts), copies(copies), key(keySize(options)) {}
+
+    // Counts a plain line, timed or not, known to start an entry
+    void addLine(std::string_view line, bool timed, int64_t time) {
+        if (!needsFields()) {
+            add(nullptr, timed, time);
+            return;
+        }
+        text.assign(line.data(), line.size());
+        text += '\n';  // Parsed with its break, as template mode parses it
+        LineFields fields = describeParsed(text, parsed);
+        add(&fields, timed, time);
+    }
+
+    // Counts a line of a columnar stream known to start an entry; its variables are needed when
+    // grouping by component
+    void addColumnLine(const templates::ColumnLine& line) {
+        if (!needsFields()) {
+            add(nullptr, line.timestamped, line.timestamp);
+            return;
+        }
+        if (line.templateId == templates::RAW_LINE) {
+            addLine(line.text, line.timestamped, line.timestamp);  // Raw lines may still parse, past the template limit
+            return;
+        }
+        if (line.templateId > templateFields.size()) {
+            templateFields.resize(line.templateId);
+        }
+        std::optional<TemplateFields>& fields = templateFields[line.templateId - 1];
+        if (!fields) {
+            fields = describeTemplate(line.text);  // Once per template
+        }
+        if (fields->component.empty() || !groupsByComponent(options)) {
+            add(&fields->fields, line.timestamped, line.timestamp);
+            return;
+        }
+        filled.level = fields->fields.level;
+        filled.templateText = fields->fields.templateText;
+        fillComponent(*fields, line.integers, line.variables, filled.component);
+        add(&filled, line.timestamped, line.timestamp);
+    }
+
+private:
+    static size_t keySize(const QueryOptions& options) {
+        return options.groupBy.size() + (options.bucketMillis > 0 ? 1 : 0);
+    }
+
+    bool needsFields() const {
+        return !options.groupBy.empty() || !options.levels.empty();
+    }
+
+    void add(const LineFields* fields, bool timed, int64_t time) {
+        if (options.window.bounded() && (!timed || !options.window.contains(time))) {
+            return;
+        }
+        if (!options.levels.empty() &&
+            std::find(options.levels.begin(), options.levels.end(), fields->level) == options.levels.end()) {
+            return;
+        }
+        size_t column = 0;
+        if (options.bucketMillis > 0) {
+            key[column++] = timed ? bucketName(time) : NO_VALUE;
+        }
+        for (Field field : options.groupBy) {
+            key[column++] = field == Field::LEVEL ? fields->level
+                          : field == Field::COMPONENT ? fields->component : fields->templateText;
+        }
+        auto it = counts.find(key);
+        if (it == counts.end()) {
+            it = counts.emplace(key, 0).first;
+        }
+        it->second += copies;
+    }
+
+    // Start of the time bucket, down to the minute, hour or day
+    std::string bucketName(int64_t time) const {
+        int64_t start = time - ((time % options.bucketMillis) + options.bucketMillis) % options.bucketMillis;
+        char formatted[timestamps::TIMESTAMP_LENGTH];
+        timestamps::formatTimestamp(start, formatted);  // [YYYY-MM-DD HH:MM:SS.mmm]
+        return std::string(formatted + 1, options.bucketMillis >= DAY_MILLIS ? 10 : 16);
+    }
+
+    const QueryOptions& options;
+    Counts& counts;
+    const uint64_t copies;  // Selected paths holding the file
+    std::vector<std::string> key;
+    std::string text;
+    templates::ParsedLine parsed;
+    std::vector<std::optional<TemplateFields>> templateFields;  // Fields of each template id of the stream
+    LineFields filled;  // Fields of the last line whose component was filled in
+};
+
+// Output stream buffer counting the entries of the text written to it. Lines after a timestamped line
+// without one of their own continue its entry and are not counted.
+class CountingBuffer : public lines::LineSplitter {
+public:
+    CountingBuffer(EntryCounter& counter, transcoding::Encoding encoding)
+        : LineSplitter(encoding), counter(counter) {}
+
+protected:
+    void onLine(std::string_view line) override {
+        if (firstLine && line.substr(0, timestamps::UTF8_BOM_LENGTH) == timestamps::UTF8_BOM) {
+            line.remove_prefix(timestamps::UTF8_BOM_LENGTH);
+        }
+        firstLine = false;
+        int64_t time;
+        bool timed = clock.advance(line, time);
+        if (timed && !clock.stamped()) {
+            return;  // Continuation line
+        }
+        counter.addLine(line, timed, time);
+    }
+
+private:
+    EntryCounter& counter;
+    timestamps::LineClock clock;
+    bool firstLine = true;
+};
+
+}  // namespace
+
+Field parseField(const std::string& name) {
+    if (name == "level") {
+        return Field::LEVEL;
+    }
+    if (name == "component") {
+        return Field::COMPONENT;
+    }
+    if (name == "template") {
+        return Field::TEMPLATE;
+    }
+    throw std::invalid_argument("Unknown query field '" + name + "': expected level, component or template");
+}
+
+std::string fieldName(Field field) {
+    switch (field) {
+        case Field::LEVEL: return "level";
+        case Field::COMPONENT: return "component";
+        default: return "template";
+    }
+}
+
+LineFields describeLine(std::string_view line) {
+    templates::ParsedLine parsed;
+    return describeParsed(line, parsed);
+}
+
+QueryResult queryArchive(const std::string& archiveFile, const QueryOptions& options, QueryStats* stats) {
+    if (options.bucketMillis != 0 && options.bucketMillis != MINUTE_MILLIS && options.bucketMillis != HOUR_MILLIS &&
+        options.bucketMillis != DAY_MILLIS) {
+        throw std::invalid_argument("Query time buckets must be a minute, an hour or a day");
+    }
+    compression::ReaderPool readers(archiveFile, options.registryDir);
+    auto index = readers.acquire();
+    const std::vector<meta::FileMeta>& metadata = index->entries();
+
+    std::vector<size_t> selected;
+    if (options.relativePaths.empty()) {
+        for (size_t i = 0; i < metadata.size(); i++) {
+            selected.push_back(i);
+        }
+    }
+    for (const auto& relativePath : options.relativePaths) {
+        const meta::FileMeta* entry = index->find(relativePath);
+        if (!entry) {
+            throw std::runtime_error("File not found in archive: " + relativePath);
+        }
+        selected.push_back(static_cast<size_t>(entry - metadata.data()));
+    }
+
+    // Duplicates are read once through the entry holding their data, and files of a solid block
+    // together through one decode of the block
+    std::map<size_t, std::vector<size_t>> sourcePaths;
+    for (size_t i : selected) {
+        sourcePaths[static_cast<size_t>(&index->resolve(metadata[i]) - metadata.data())].push_back(i);
+    }
+    std::vector<QueryTask> tasks;
+    std::map<int64_t, size_t> blockTasks;  // Solid block id to its task
+    QueryStats counts;
+    for (auto& [entry, paths] : sourcePaths) {
+        const meta::FileMeta& source = metadata[entry];
+        if (options.window.bounded() && !source.mayOverlap(options.window.since, options.window.until)) {
+            counts.skipped++;  // No entry of the file is timed inside the window
+            continue;
+        }
+        counts.queried++;
+        size_t task = tasks.size();
+        if (source.isSolid()) {
+            task = blockTasks.emplace(source.blockId, tasks.size()).first->second;
+        }
+        if (task == tasks.size()) {
+            tasks.emplace_back();
+        }
+        tasks[task].sources.push_back({entry, std::move(paths)});
+        tasks[task].size += source.originalSize;
+    }
+    std::stable_sort(tasks.begin(), tasks.end(), [](const auto& a, const auto& b) { return a.size > b.size; });
+    readers.release(std::move(index));  // Metadata stays valid: the reader is only moved between owners
+
+    std::mutex resultsMutex;
+    QueryResult result;
+    std::exception_ptr error;
+
+    auto& threadPool = threading::ThreadPool::getInstance();
+    threadPool.parallelFor(tasks.begin(), tasks.end(), [&](auto taskIt, size_t) {
+        std::unique_ptr<compression::ArchiveReader> reader;
+        Counts taskCounts;
+        uint64_t columnar = 0;
+        try {
+            reader = readers.acquire();
+            std::string block;  // Decoded solid block shared by the task's sources
+            const meta::FileMeta& first = metadata[taskIt->sources.front().entry];
+            if (first.isSolid()) {
+                std::ostringstream blockData;
+                reader->readBlock(first, blockData);
+                block = blockData.str();
+            }
+
+            for (const Source& source : taskIt->sources) {
+                const meta::FileMeta& entry = metadata[source.entry];
+                auto encoding = static_cast<transcoding::Encoding>(entry.textEncoding);
+                if (entry.isSolid()) {
+                    if (entry.blockOffset + entry.originalSize > block.size()) {
+                        throw std::runtime_error("Corrupt solid block " + std::to_string(entry.blockId) + ": " +
+                                                 entry.relativePath + " lies outside the block");
+                    }
+                    std::string_view content = std::string_view(block).substr(entry.blockOffset, entry.originalSize);
+                    if (content.size() % 2 == 0) {  // Solid files were never transcoded, so detect UTF-16 here
+                        encoding = transcoding::detectUtf16(reinterpret_cast<const uint8_t*>(content.data()),
+                                                            std::min(content.size(), probe::SAMPLE_SIZE));
+                    }
+                    EntryCounter counter(options, taskCounts, source.paths.size());
+                    CountingBuffer counting(counter, encoding);
+                    std::ostream counted(&counting);
+                    counted.exceptions(std::ios::badbit);
+                    counted.write(content.data(), static_cast<std::streamsize>(content.size()));
+                    counting.finish();
+                    continue;
+                }
+
+                // Transcoded files start with a byte order mark, which hides the first line's timestamp
+                // from the template, so their lines are restored
+                if (entry.isTemplateEncoded() && !entry.isTranscoded()) {
+                    Counts columnCounts;  // Kept apart until the stream proves readable from its columns
+                    EntryCounter counter(options, columnCounts, source.paths.size());
+                    bool timedBefore = false;
+                    bool firstLine = true;
+                    templates::ColumnReader columns([&](const templates::ColumnLine& line) {
+                        if (firstLine && line.text.substr(0, timestamps::UTF8_BOM_LENGTH) == timestamps::UTF8_BOM) {
+                            throw NeedsLines();
+                        }
+                        firstLine = false;
+                        if (!line.timestamped && timedBefore) {
+                            return;  // Continuation line
+                        }
+                        timedBefore |= line.timestamped;
+                        counter.addColumnLine(line);
+                    }, groupsByComponent(options));
+                    std::ostream read(&columns);
+                    read.exceptions(std::ios::badbit);  // Rethrows NeedsLines and decoding errors
+                    try {
+                        reader->readColumns(entry, read);
+                        columns.finish();
+                        for (const auto& [key, count] : columnCounts) {
+                            taskCounts[key] += count;
+                        }
+                        columnar++;
+                        continue;
+                    } catch (const NeedsLines&) {
+                        // Read again as text below
+                    }
+                }
+
+                EntryCounter counter(options, taskCounts, source.paths.size());
+                CountingBuffer counting(counter, encoding);
+                std::ostream counted(&counting);
+                counted.exceptions(std::ios::badbit);  // Rethrows decoding errors
+                if (!entry.isTranscoded()) {
+                    counting.detectEncoding(entry.originalSize);  // Kept as UTF-16 when compressed
+                }
+                reader->read(entry, counted);
+                counting.finish();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        if (reader) {
+            readers.release(std::move(reader));
+        }
+
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        for (auto& [key, count] : taskCounts) {
+            result.counts[key] += count;
+        }
+        counts.columnar += columnar;
+    });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if (stats) {
+        *stats = counts;
+    }
+
+    if (options.bucketMillis > 0) {
+        result.columns.push_back(options.bucketMillis >= DAY_MILLIS ? "day"
+                                 : options.bucketMillis >= HOUR_MILLIS ? "hour" : "minute");
+    }
+    for (Field field : options.groupBy) {
+        result.columns.push_back(fieldName(field));
+    }
+    return result;
+}
+
+}  // namespace query
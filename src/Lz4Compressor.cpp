@@ -0,0 +1,130 @@
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <lz4frame.h>
+
+#include "Lz4Compressor.h"
+
+namespace compression {
+
+void Lz4Compressor::compressStream(std::istream& input, std::ostream& output) const {
+    // Create compression context with automatic cleanup
+    LZ4F_cctx* rawContext = nullptr;
+    size_t result = LZ4F_createCompressionContext(&rawContext, LZ4F_VERSION);
+    if (LZ4F_isError(result)) {
+        throw std::runtime_error(std::string("Failed to create LZ4 compression context: ") + LZ4F_getErrorName(result));
+    }
+    auto deleter = [](LZ4F_cctx* context) { LZ4F_freeCompressionContext(context); };
+    std::unique_ptr<LZ4F_cctx, decltype(deleter)> context(rawContext, deleter);
+
+    // Independent 64KB blocks with a content checksum
+    LZ4F_preferences_t preferences = LZ4F_INIT_PREFERENCES;
+    preferences.compressionLevel = level;
+    preferences.frameInfo.blockSizeID = LZ4F_max64KB;
+    preferences.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+
+    std::vector<char> inputBuffer(BUFFER_SIZE);
+    std::vector<char> outputBuffer(LZ4F_compressBound(BUFFER_SIZE, &preferences));
+
+    // Write frame header
+    result = LZ4F_compressBegin(context.get(), outputBuffer.data(), outputBuffer.size(), &preferences);
+    if (LZ4F_isError(result)) {
+        throw std::runtime_error(std::string("LZ4 compression error: ") + LZ4F_getErrorName(result));
+    }
+    output.write(outputBuffer.data(), result);
+    if (!output) {
+        throw std::runtime_error("Failed to write compressed data");
+    }
+
+    // Process input stream
+    while (input) {
+        input.read(inputBuffer.data(), inputBuffer.size());
+        if (input.fail() && !input.eof()) {
+            throw std::runtime_error("Error reading from input stream");
+        }
+        size_t bytesRead = input.gcount();
+        if (bytesRead == 0) {
+            break;
+        }
+
+        result = LZ4F_compressUpdate(context.get(), outputBuffer.data(), outputBuffer.size(),
+                                     inputBuffer.data(), bytesRead, nullptr);
+        if (LZ4F_isError(result)) {
+            throw std::runtime_error(std::string("LZ4 compression error: ") + LZ4F_getErrorName(result));
+        }
+        output.write(outputBuffer.data(), result);
+        if (!output) {
+            throw std::runtime_error("Failed to write compressed data");
+        }
+    }
+
+    // Flush remaining data and write the frame footer
+    result = LZ4F_compressEnd(context.get(), outputBuffer.data(), outputBuffer.size(), nullptr);
+    if (LZ4F_isError(result)) {
+        throw std::runtime_error(std::string("LZ4 compression error: ") + LZ4F_getErrorName(result));
+    }
+    output.write(outputBuffer.data(), result);
+    if (!output) {
+        throw std::runtime_error("Failed to write final compressed data");
+    }
+}
+
+size_t Lz4Compressor::decompressStream(std::istream& input, std::ostream& output) const {
+    // Create decompression context with automatic cleanup
+    LZ4F_dctx* rawContext = nullptr;
+    size_t result = LZ4F_createDecompressionContext(&rawContext, LZ4F_VERSION);
+    if (LZ4F_isError(result)) {
+        throw std::runtime_error(std::string("Failed to create LZ4 decompression context: ") + LZ4F_getErrorName(result));
+    }
+    auto deleter = [](LZ4F_dctx* context) { LZ4F_freeDecompressionContext(context); };
+    std::unique_ptr<LZ4F_dctx, decltype(deleter)> context(rawContext, deleter);
+
+    std::vector<char> inputBuffer(BUFFER_SIZE);
+    std::vector<char> outputBuffer(BUFFER_SIZE);
+    size_t totalDecompressedBytes = 0;
+    bool frameComplete = false;
+
+    // Process input stream until the end of the frame
+    while (input && !frameComplete) {
+        input.read(inputBuffer.data(), inputBuffer.size());
+        if (input.fail() && !input.eof()) {
+            throw std::runtime_error("Error reading from input stream");
+        }
+        size_t bytesRead = input.gcount();
+        if (bytesRead == 0) {
+            break;
+        }
+
+        size_t consumed = 0;
+        bool outputFull = false;  // A full output buffer may leave decoded data buffered in the context
+        while ((consumed < bytesRead || outputFull) && !frameComplete) {
+            size_t srcSize = bytesRead - consumed;
+            size_t dstSize = outputBuffer.size();
+
+            result = LZ4F_decompress(context.get(), outputBuffer.data(), &dstSize,
+                                     inputBuffer.data() + consumed, &srcSize, nullptr);
+            if (LZ4F_isError(result)) {
+                throw std::runtime_error(std::string("LZ4 decompression error: ") + LZ4F_getErrorName(result));
+            }
+            consumed += srcSize;
+
+            output.write(outputBuffer.data(), dstSize);
+            if (!output) {
+                throw std::runtime_error("Failed to write decompressed data");
+            }
+            totalDecompressedBytes += dstSize;
+            outputFull = (dstSize == outputBuffer.size());
+
+            frameComplete = (result == 0);  // End of frame reached, ignore data that follows it
+        }
+    }
+
+    if (!frameComplete) {
+        throw std::runtime_error("Unexpected end of LZ4 stream");
+    }
+    return totalDecompressedBytes;
+}
+
+}  // End of compression namespace
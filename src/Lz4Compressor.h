@@ -0,0 +1,24 @@
+#ifndef LZ4_COMPRESSOR_H
+#define LZ4_COMPRESSOR_H
+
+#include <iostream>
+
+#include "Compressor.h"
+
+namespace compression {
+
+// LZ4 frame format compressor, tuned for speed over ratio
+class Lz4Compressor : public Compressor {
+public:
+    explicit Lz4Compressor(int level) : level(level) {}
+
+    void compressStream(std::istream& input, std::ostream& output) const override;
+    size_t decompressStream(std::istream& input, std::ostream& output) const override;
+private:
+    const int level;  // Compression level used when compressing (negative values accelerate, >= 3 selects LZ4HC)
+    static constexpr size_t BUFFER_SIZE = 65536; // 64KB buffer size
+};
+
+} // namespace compression
+
+#endif // LZ4_COMPRESSOR_H
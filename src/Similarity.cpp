@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+
+#include "IO.h"
+#include "Similarity.h"
+
+namespace similarity {
+
+namespace {
+
+// splitmix64 finalizer, a cheap well-mixed hash of a 64-bit value
+uint64_t mix(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+// Seeds of the hash functions, fixed so sketches are comparable across runs
+const std::array<uint64_t, SKETCH_SIZE> SEEDS = [] {
+    std::array<uint64_t, SKETCH_SIZE> seeds{};
+    for (size_t i = 0; i < SKETCH_SIZE; i++) {
+        seeds[i] = mix(i + 1);
+    }
+    return seeds;
+}();
+
+// Finds the root of a union-find tree, halving the path as it goes
+size_t findRoot(std::vector<size_t>& parents, size_t item) {
+    while (parents[item] != item) {
+        parents[item] = parents[parents[item]];
+        item = parents[item];
+    }
+    return item;
+}
+
+}  // namespace
+
+Sketch sketchBuffer(const char* data, size_t size) {
+    Sketch sketch;
+    sketch.fill(std::numeric_limits<uint64_t>::max());
+
+    auto addShingle = [&](uint64_t shingle) {
+        for (size_t i = 0; i < SKETCH_SIZE; i++) {
+            sketch[i] = std::min(sketch[i], mix(shingle ^ SEEDS[i]));
+        }
+    };
+
+    // FNV-1a over each line, digit runs hashed as a single marker
+    const uint64_t FNV_OFFSET = 0xCBF29CE484222325ULL;
+    const uint64_t FNV_PRIME = 0x100000001B3ULL;
+    uint64_t hash = FNV_OFFSET;
+    size_t length = 0;
+    bool inDigits = false;
+    for (size_t i = 0; i < size; i++) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c == '\n' || length == MAX_SHINGLE_SIZE) {
+            if (length > 0) {
+                addShingle(hash);
+            }
+            hash = FNV_OFFSET;
+            length = 0;
+            inDigits = false;
+            if (c == '\n') {
+                continue;
+            }
+        }
+        if (std::isdigit(c)) {
+            if (inDigits) {
+                continue;
+            }
+            c = '#';
+            inDigits = true;
+        } else {
+            inDigits = false;
+        }
+        hash = (hash ^ c) * FNV_PRIME;
+        length++;
+    }
+    if (length > 0) {
+        addShingle(hash);
+    }
+    return sketch;
+}
+
+Sketch sketchFile(const std::filesystem::path& filePath) {
+    std::ifstream file(filePath, std::ios::binary);
+    io::checkOpen(file, filePath.string(), "Similarity sketching");
+    std::string sample(SKETCH_SAMPLE_SIZE, '\0');
+    file.read(&sample[0], sample.size());
+    sample.resize(file.gcount());
+    return sketchBuffer(sample.data(), sample.size());
+}
+
+double estimateSimilarity(const Sketch& a, const Sketch& b) {
+    size_t equal = 0;
+    for (size_t i = 0; i < SKETCH_SIZE; i++) {
+        equal += a[i] == b[i];
+    }
+    return static_cast<double>(equal) / SKETCH_SIZE;
+}
+
+std::vector<size_t> clusterSketches(const std::vector<Sketch>& sketches) {
+    std::vector<size_t> parents(sketches.size());
+    std::iota(parents.begin(), parents.end(), 0);
+
+    // Files landing in the same bucket of any band are joined
+    constexpr size_t rows = SKETCH_SIZE / SKETCH_BANDS;
+    for (size_t band = 0; band < SKETCH_BANDS; band++) {
+        std::unordered_map<uint64_t, size_t> buckets;  // Band hash to the first file seen with it
+        for (size_t i = 0; i < sketches.size(); i++) {
+            uint64_t bandHash = mix(band);
+            for (size_t row = 0; row < rows; row++) {
+                bandHash = mix(bandHash ^ sketches[i][band * rows + row]);
+            }
+            auto [bucket, isNew] = buckets.emplace(bandHash, i);
+            if (!isNew) {
+                size_t a = findRoot(parents, bucket->second);
+                size_t b = findRoot(parents, i);
+                parents[std::max(a, b)] = std::min(a, b);  // The lowest index stays the root
+            }
+        }
+    }
+
+    std::vector<size_t> clusters(sketches.size());
+    for (size_t i = 0; i < sketches.size(); i++) {
+        clusters[i] = findRoot(parents, i);
+    }
+    return clusters;
+}
+
+}  // namespace similarity
@@ -0,0 +1,70 @@
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "StoreCompressor.h"
+
+namespace compression {
+
+void StoreCompressor::compressStream(std::istream& input, std::ostream& output) const {
+    std::vector<char> buffer(BUFFER_SIZE);
+
+    do {
+        // Read input chunk
+        input.read(buffer.data(), BUFFER_SIZE);
+        if (input.fail() && !input.eof()) {
+            throw std::runtime_error("Error reading from input stream");
+        }
+        uint32_t chunkSize = static_cast<uint32_t>(input.gcount());
+
+        // Write chunk header followed by the raw bytes
+        if (chunkSize > 0) {
+            output.write(reinterpret_cast<const char*>(&chunkSize), sizeof(chunkSize));
+            output.write(buffer.data(), chunkSize);
+            if (!output) {
+                throw std::runtime_error("Failed to write stored data");
+            }
+        }
+    } while (!input.eof());
+
+    // A zero length chunk marks the end of the stream
+    uint32_t endMarker = 0;
+    output.write(reinterpret_cast<const char*>(&endMarker), sizeof(endMarker));
+    if (!output) {
+        throw std::runtime_error("Failed to write stored data");
+    }
+}
+
+size_t StoreCompressor::decompressStream(std::istream& input, std::ostream& output) const {
+    std::vector<char> buffer(BUFFER_SIZE);
+    size_t totalBytes = 0;
+
+    while (true) {
+        uint32_t chunkSize = 0;
+        input.read(reinterpret_cast<char*>(&chunkSize), sizeof(chunkSize));
+        if (input.gcount() != sizeof(chunkSize)) {
+            throw std::runtime_error("Unexpected end of stored stream");
+        }
+        if (chunkSize == 0) {
+            break;  // End marker reached
+        }
+        if (chunkSize > BUFFER_SIZE) {
+            throw std::runtime_error("Corrupt stored stream: chunk too large");
+        }
+
+        input.read(buffer.data(), chunkSize);
+        if (static_cast<uint32_t>(input.gcount()) != chunkSize) {
+            throw std::runtime_error("Unexpected end of stored stream");
+        }
+
+        output.write(buffer.data(), chunkSize);
+        if (!output) {
+            throw std::runtime_error("Failed to write stored data");
+        }
+        totalBytes += chunkSize;
+    }
+
+    return totalBytes;
+}
+
+}  // End of compression namespace
@@ -0,0 +1,23 @@
+#ifndef STORE_COMPRESSOR_H
+#define STORE_COMPRESSOR_H
+
+#include <iostream>
+
+#include "Compressor.h"
+
+namespace compression {
+
+// Pass-through "compressor" used for data that would not benefit from compression.
+// Data is written as length-prefixed chunks terminated by an empty chunk so the
+// stream stays self-delimiting like the real codecs.
+class StoreCompressor : public Compressor {
+public:
+    void compressStream(std::istream& input, std::ostream& output) const override;
+    size_t decompressStream(std::istream& input, std::ostream& output) const override;
+private:
+    static constexpr size_t BUFFER_SIZE = 65536; // 64KB buffer size
+};
+
+} // namespace compression
+
+#endif // STORE_COMPRESSOR_H
@@ -0,0 +1,450 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "IO.h"
+#include "TemplateCodec.h"
+#include "TimestampCodec.h"
+
+namespace templates {
+
+namespace {
+
+constexpr size_t BLOCK_HEADER_SIZE = (1 + COLUMN_COUNT) * sizeof(uint32_t);
+constexpr size_t MAX_ENCODED_BLOCK_SIZE = 16 * TEMPLATE_BLOCK_SIZE;
+constexpr size_t MAX_INTEGER_DIGITS = 18;  // Every such decimal fits a uint64_t
+
+// Share of sampled lines that must fit a template, and the most distinct templates per templated line
+constexpr double MIN_TEMPLATED_LINE_RATIO = 0.5;
+constexpr size_t MIN_LINES_PER_TEMPLATE = 4;
+
+bool isPlaceholder(char c) {
+    return c == TIMESTAMP_PLACEHOLDER || c == INTEGER_PLACEHOLDER || c == VARIABLE_PLACEHOLDER;
+}
+
+// Characters separating the tokens of a line; they always stay in the template
+bool isDelimiter(char c) {
+    switch (c) {
+        case ' ': case '\t': case '\r': case '\n': case '[': case ']': case '(': case ')': case '{': case '}':
+        case '<': case '>': case ',': case ';': case '=': case '"': case '\'': case '|':
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Plain decimals without leading zeros go to the integer column; they print back the same
+bool isInteger(std::string_view token) {
+    return token.size() <= MAX_INTEGER_DIGITS && (token.size() == 1 || token[0] != '0') &&
+           std::all_of(token.begin(), token.end(), isDigit);
+}
+
+void appendBytes(std::string& output, std::string_view bytes) {
+    io::appendVarint(output, bytes.size());
+    output.append(bytes.data(), bytes.size());
+}
+
+uint32_t readUint32(const char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+std::runtime_error malformedBlock() {
+    return std::runtime_error("Invalid archive: malformed block in a template-encoded stream");
+}
+
+// The columns of an encoded block, each read from its start as lines are restored
+struct BlockColumns {
+    uint32_t lineCount = 0;
+    uint64_t size = 0;                    // Header and columns
+    const char* begin[COLUMN_COUNT] = {};  // Read position in each column
+    const char* end[COLUMN_COUNT] = {};
+
+    uint64_t readValue(Column column) {
+        uint64_t value;
+        if (!io::readVarint(begin[column], end[column], value)) {
+            throw malformedBlock();
+        }
+        return value;
+    }
+
+    std::string_view readBytes(Column column, size_t maxSize) {
+        uint64_t length = readValue(column);
+        if (length > maxSize || length > static_cast<uint64_t>(end[column] - begin[column])) {
+            throw malformedBlock();
+        }
+        std::string_view bytes(begin[column], length);
+        begin[column] += length;
+        return bytes;
+    }
+
+    // Throws unless the given columns were read to their end
+    void checkRead(std::initializer_list<Column> columns) const {
+        for (Column column : columns) {
+            if (begin[column] != end[column]) {
+                throw malformedBlock();  // Values no line used
+            }
+        }
+    }
+};
+
+// Locates the columns of the block at pos, returning false while the block is still incomplete
+bool locateBlock(const std::string& pending, size_t pos, BlockColumns& block) {
+    if (pending.size() - pos < BLOCK_HEADER_SIZE) {
+        return false;
+    }
+    block.lineCount = readUint32(pending.data() + pos);
+    block.size = BLOCK_HEADER_SIZE;
+    for (size_t column = 0; column < COLUMN_COUNT; column++) {
+        block.size += readUint32(pending.data() + pos + (1 + column) * sizeof(uint32_t));
+    }
+    if (block.lineCount == 0 || block.lineCount > TEMPLATE_BLOCK_SIZE || block.size > MAX_ENCODED_BLOCK_SIZE) {
+        throw malformedBlock();
+    }
+    if (pending.size() - pos < block.size) {
+        return false;  // Rest of the block is still to come
+    }
+    const char* next = pending.data() + pos + BLOCK_HEADER_SIZE;
+    for (size_t column = 0; column < COLUMN_COUNT; column++) {
+        block.begin[column] = next;
+        next += readUint32(pending.data() + pos + (1 + column) * sizeof(uint32_t));
+        block.end[column] = next;
+    }
+    return true;
+}
+
+// Adds the templates a block defines to those defined so far
+void readTemplates(BlockColumns& block, std::vector<std::string>& templates) {
+    while (block.begin[COLUMN_TEMPLATES] != block.end[COLUMN_TEMPLATES]) {
+        if (templates.size() >= MAX_TEMPLATES) {
+            throw malformedBlock();
+        }
+        templates.emplace_back(block.readBytes(COLUMN_TEMPLATES, MAX_TEMPLATE_LENGTH));
+    }
+}
+
+// Reads the distinct other variables of a block
+std::vector<std::string_view> readVariables(BlockColumns& block) {
+    std::vector<std::string_view> variables;
+    while (block.begin[COLUMN_VARIABLES] != block.end[COLUMN_VARIABLES]) {
+        variables.push_back(block.readBytes(COLUMN_VARIABLES, TEMPLATE_BLOCK_SIZE));
+    }
+    return variables;
+}
+
+// Reads the index of the next other variable of a block
+std::string_view readVariable(BlockColumns& block, const std::vector<std::string_view>& variables) {
+    uint64_t index = block.readValue(COLUMN_VARIABLE_IDS);
+    if (index >= variables.size()) {
+        throw malformedBlock();
+    }
+    return variables[index];
+}
+
+// Applies the next timestamp difference to the previous timestamp
+int64_t readTimestamp(BlockColumns& block, int64_t previous) {
+    uint64_t delta = static_cast<uint64_t>(io::zigzagDecode(block.readValue(COLUMN_TIMESTAMPS)));
+    int64_t timestamp = static_cast<int64_t>(static_cast<uint64_t>(previous) + delta);
+    if (timestamp < timestamps::MIN_TIMESTAMP || timestamp > timestamps::MAX_TIMESTAMP) {
+        throw malformedBlock();
+    }
+    return timestamp;
+}
+
+}  // namespace
+
+bool parseLine(std::string_view line, ParsedLine& parsed) {
+    parsed.text.clear();
+    parsed.integers.clear();
+    parsed.variables.clear();
+    parsed.timestamped = timestamps::parseTimestamp(line.data(), line.size(), parsed.timestamp);
+    size_t pos = 0;
+    if (parsed.timestamped) {
+        parsed.text += TIMESTAMP_PLACEHOLDER;
+        pos = timestamps::TIMESTAMP_LENGTH;
+    }
+
+    while (pos < line.size()) {
+        if (isDelimiter(line[pos])) {
+            parsed.text += line[pos++];
+            continue;
+        }
+        size_t end = pos;
+        bool hasDigit = false;
+        while (end < line.size() && !isDelimiter(line[end])) {
+            if (isPlaceholder(line[end])) {
+                return false;  // The template could not tell it from a variable
+            }
+            hasDigit |= isDigit(line[end]);
+            end++;
+        }
+        std::string_view token = line.substr(pos, end - pos);
+        if (!hasDigit) {
+            parsed.text.append(token.data(), token.size());
+        } else if (isInteger(token)) {
+            parsed.text += INTEGER_PLACEHOLDER;
+            uint64_t value = 0;
+            std::from_chars(token.data(), token.data() + token.size(), value);
+            parsed.integers.push_back(value);
+        } else {
+            parsed.text += VARIABLE_PLACEHOLDER;
+            parsed.variables.push_back(token);
+        }
+        if (parsed.text.size() > MAX_TEMPLATE_LENGTH) {
+            return false;
+        }
+        pos = end;
+    }
+    return parsed.text.size() <= MAX_TEMPLATE_LENGTH;
+}
+
+bool hasTemplates(const char* data, size_t size) {
+    std::unordered_set<std::string> distinct;
+    ParsedLine parsed;
+    size_t lines = 0;
+    size_t templated = 0;
+    size_t pos = 0;
+    while (pos < size) {
+        const char* end = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+        size_t length = end ? static_cast<size_t>(end - data) + 1 - pos : size - pos;
+        lines++;
+        if (parseLine(std::string_view(data + pos, length), parsed)) {
+            templated++;
+            distinct.insert(parsed.text);
+        }
+        pos += length;
+    }
+    return templated > 0 && templated >= lines * MIN_TEMPLATED_LINE_RATIO &&
+           distinct.size() * MIN_LINES_PER_TEMPLATE <= templated;
+}
+
+EncodingBuffer::EncodingBuffer(std::istream& source) : source(source), input(TEMPLATE_BLOCK_SIZE) {}
+
+EncodingBuffer::int_type EncodingBuffer::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    source.read(input.data() + buffered, input.size() - buffered);
+    buffered += static_cast<size_t>(source.gcount());
+    if (buffered == 0) {
+        return traits_type::eof();
+    }
+
+    // A block ends after its last complete line, unless a single line fills all of it
+    size_t blockSize = buffered;
+    if (buffered == input.size()) {
+        auto lastNewline = std::find(input.rbegin(), input.rend(), '\n');
+        if (lastNewline != input.rend()) {
+            blockSize = static_cast<size_t>(input.rend() - lastNewline);
+        }
+    }
+
+    std::string columns[COLUMN_COUNT];
+    std::unordered_map<std::string_view, uint32_t> variableIds;  // Views into input, valid for this block
+    ParsedLine parsed;
+    uint32_t lineCount = 0;
+    for (size_t pos = 0; pos < blockSize; lineCount++) {
+        const char* start = input.data() + pos;
+        const char* end = static_cast<const char*>(std::memchr(start, '\n', blockSize - pos));
+        std::string_view line(start, end ? static_cast<size_t>(end - start) + 1 : blockSize - pos);
+        pos += line.size();
+
+        uint32_t id = RAW_LINE;
+        if (parseLine(line, parsed)) {
+            auto known = templateIds.find(parsed.text);
+            if (known != templateIds.end()) {
+                id = known->second;
+            } else if (templateIds.size() < MAX_TEMPLATES) {
+                id = static_cast<uint32_t>(templateIds.size()) + 1;
+                templateIds.emplace(parsed.text, id);
+                appendBytes(columns[COLUMN_TEMPLATES], parsed.text);
+            }
+        }
+        io::appendVarint(columns[COLUMN_TEMPLATE_IDS], id);
+        if (id == RAW_LINE) {
+            appendBytes(columns[COLUMN_RAW], line);
+            continue;
+        }
+
+        if (parsed.timestamped) {
+            io::appendVarint(columns[COLUMN_TIMESTAMPS], io::zigzagEncode(parsed.timestamp - previous));
+            previous = parsed.timestamp;
+        }
+        for (uint64_t value : parsed.integers) {
+            io::appendVarint(columns[COLUMN_INTEGERS], value);
+        }
+        for (std::string_view variable : parsed.variables) {
+            auto [entry, added] = variableIds.emplace(variable, static_cast<uint32_t>(variableIds.size()));
+            if (added) {
+                appendBytes(columns[COLUMN_VARIABLES], variable);
+            }
+            io::appendVarint(columns[COLUMN_VARIABLE_IDS], entry->second);
+        }
+    }
+
+    encoded.clear();
+    encoded.append(reinterpret_cast<const char*>(&lineCount), sizeof(lineCount));
+    for (const std::string& column : columns) {
+        uint32_t size = static_cast<uint32_t>(column.size());
+        encoded.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    }
+    for (const std::string& column : columns) {
+        encoded += column;
+    }
+
+    std::copy(input.begin() + blockSize, input.begin() + buffered, input.begin());
+    buffered -= blockSize;
+    setg(&encoded[0], &encoded[0], &encoded[0] + encoded.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+DecodingBuffer::DecodingBuffer(std::ostream& target) : target(target) {}
+
+void DecodingBuffer::finish() const {
+    if (!pending.empty()) {
+        throw std::runtime_error("Invalid archive: template-encoded stream ends inside a block");
+    }
+}
+
+DecodingBuffer::int_type DecodingBuffer::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        char byte = traits_type::to_char_type(c);
+        xsputn(&byte, 1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize DecodingBuffer::xsputn(const char* data, std::streamsize size) {
+    pending.append(data, size);
+    decodeBlocks();
+    return size;
+}
+
+void DecodingBuffer::decodeBlocks() {
+    size_t pos = 0;
+    BlockColumns block;
+    while (locateBlock(pending, pos, block)) {
+        readTemplates(block, templates);
+        std::vector<std::string_view> variables = readVariables(block);
+
+        decoded.clear();
+        for (uint32_t i = 0; i < block.lineCount; i++) {
+            uint64_t id = block.readValue(COLUMN_TEMPLATE_IDS);
+            if (id == RAW_LINE) {
+                std::string_view line = block.readBytes(COLUMN_RAW, TEMPLATE_BLOCK_SIZE);
+                decoded.append(line.data(), line.size());
+                continue;
+            }
+            if (id > templates.size()) {
+                throw malformedBlock();
+            }
+            for (char c : templates[id - 1]) {
+                if (c == TIMESTAMP_PLACEHOLDER) {
+                    previous = readTimestamp(block, previous);
+                    char formatted[timestamps::TIMESTAMP_LENGTH];
+                    timestamps::formatTimestamp(previous, formatted);
+                    decoded.append(formatted, timestamps::TIMESTAMP_LENGTH);
+                } else if (c == INTEGER_PLACEHOLDER) {
+                    char digits[20];
+                    auto result = std::to_chars(digits, digits + sizeof(digits), block.readValue(COLUMN_INTEGERS));
+                    decoded.append(digits, result.ptr);
+                } else if (c == VARIABLE_PLACEHOLDER) {
+                    std::string_view variable = readVariable(block, variables);
+                    decoded.append(variable.data(), variable.size());
+                } else {
+                    decoded += c;
+                }
+            }
+        }
+        block.checkRead({COLUMN_TEMPLATES, COLUMN_TEMPLATE_IDS, COLUMN_TIMESTAMPS, COLUMN_INTEGERS, COLUMN_VARIABLES,
+                         COLUMN_VARIABLE_IDS, COLUMN_RAW});
+
+        io::writeBuffer(target, decoded.data(), decoded.size());
+        restored += decoded.size();
+        pos += block.size;
+    }
+    pending.erase(0, pos);
+}
+
+ColumnReader::ColumnReader(LineCallback onLine, bool withVariables)
+    : onLine(std::move(onLine)), withVariables(withVariables) {}
+
+void ColumnReader::finish() const {
+    if (!pending.empty()) {
+        throw std::runtime_error("Invalid archive: template-encoded stream ends inside a block");
+    }
+}
+
+ColumnReader::int_type ColumnReader::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        char byte = traits_type::to_char_type(c);
+        xsputn(&byte, 1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize ColumnReader::xsputn(const char* data, std::streamsize size) {
+    pending.append(data, size);
+    readBlocks();
+    return size;
+}
+
+void ColumnReader::readBlocks() {
+    size_t pos = 0;
+    BlockColumns block;
+    while (locateBlock(pending, pos, block)) {
+        readTemplates(block, templates);
+        std::vector<std::string_view> variables;
+        if (withVariables) {
+            variables = readVariables(block);
+        }
+        ColumnLine line;
+        for (uint32_t i = 0; i < block.lineCount; i++) {
+            uint64_t id = block.readValue(COLUMN_TEMPLATE_IDS);
+            line.templateId = static_cast<uint32_t>(id);
+            line.integers.clear();
+            line.variables.clear();
+            if (id == RAW_LINE) {
+                line.text = block.readBytes(COLUMN_RAW, TEMPLATE_BLOCK_SIZE);
+                line.timestamped = timestamps::parseTimestamp(line.text.data(), line.text.size(), line.timestamp);
+            } else {
+                if (id > templates.size()) {
+                    throw malformedBlock();
+                }
+                line.text = templates[id - 1];
+                line.timestamped = !line.text.empty() && line.text[0] == TIMESTAMP_PLACEHOLDER;
+                if (line.timestamped) {
+                    previous = readTimestamp(block, previous);  // Only a leading placeholder is ever emitted
+                    line.timestamp = previous;
+                }
+                if (withVariables) {
+                    for (char c : line.text) {
+                        if (c == INTEGER_PLACEHOLDER) {
+                            line.integers.push_back(block.readValue(COLUMN_INTEGERS));
+                        } else if (c == VARIABLE_PLACEHOLDER) {
+                            line.variables.push_back(readVariable(block, variables));
+                        }
+                    }
+                }
+            }
+            onLine(line);
+        }
+        if (withVariables) {
+            block.checkRead({COLUMN_INTEGERS, COLUMN_VARIABLES, COLUMN_VARIABLE_IDS});
+        }
+        block.checkRead({COLUMN_TEMPLATE_IDS, COLUMN_TIMESTAMPS, COLUMN_RAW});
+        pos += block.size;
+    }
+    pending.erase(0, pos);
+}
+
+}  // namespace templates
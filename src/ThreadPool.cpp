@@ -15,6 +15,12 @@ ThreadPool& ThreadPool::getInstance(size_t numThreads) {
     return *instance;
 }
 
+// Leave one core for the calling thread while guaranteeing at least one worker
+size_t ThreadPool::defaultThreadCount() {
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();  // May be 0 if unknown
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+
 // Initialize thread pool with specified number of worker threads
 ThreadPool::ThreadPool(size_t numThreads) {    
     for (size_t i = 0; i < numThreads; ++i) {
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "IO.h"
+#include "TimestampCodec.h"
+
+namespace timestamps {
+
+namespace {
+
+constexpr size_t BLOCK_HEADER_SIZE = 3 * sizeof(uint32_t);
+constexpr size_t MAX_VARINT_SIZE = 10;
+constexpr int64_t MILLIS_PER_DAY = 86400000;
+
+// Layout of a timestamp: 'd' marks a digit, anything else must match exactly
+constexpr char PATTERN[] = "[dddd-dd-dd dd:dd:dd.ddd]";
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+int64_t daysFromCivil(int64_t year, int64_t month, int64_t day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+void civilFromDays(int64_t days, int64_t& year, int64_t& month, int64_t& day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t dayOfEra = days - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    year = yearOfEra + era * 400 + (month <= 2);
+}
+
+// Checks the digits and separators of a timestamp, sixteen bytes at a time where available
+bool matchesPattern(const char* data) {
+#ifdef __SSE2__
+    // Two overlapping loads cover all 25 bytes
+    auto matches16 = [](const char* bytes, const char* pattern) {
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+        __m128i expected = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern));
+        __m128i digitMask = _mm_cmpeq_epi8(expected, _mm_set1_epi8('d'));
+        __m128i offset = _mm_sub_epi8(input, _mm_set1_epi8('0'));
+        __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(9)), offset);
+        __m128i isSeparator = _mm_cmpeq_epi8(input, expected);
+        __m128i valid = _mm_or_si128(_mm_and_si128(digitMask, isDigit), _mm_andnot_si128(digitMask, isSeparator));
+        return _mm_movemask_epi8(valid) == 0xFFFF;
+    };
+    constexpr size_t tail = TIMESTAMP_LENGTH - 16;
+    return matches16(data, PATTERN) && matches16(data + tail, PATTERN + tail);
+#else
+    for (size_t i = 0; i < TIMESTAMP_LENGTH; i++) {
+        bool valid = PATTERN[i] == 'd' ? data[i] >= '0' && data[i] <= '9' : data[i] == PATTERN[i];
+        if (!valid) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+int64_t digits(const char* data, size_t count) {
+    int64_t value = 0;
+    for (size_t i = 0; i < count; i++) {
+        value = value * 10 + (data[i] - '0');
+    }
+    return value;
+}
+
+void writeDigits(char* output, int64_t value, size_t count) {
+    for (size_t i = count; i-- > 0;) {
+        output[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+}
+
+void appendUint32(std::string& output, uint32_t value) {
+    output.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+uint32_t readUint32(const char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+}  // namespace
+
+bool parseTimestamp(const char* data, size_t size, int64_t& millis) {
+    if (size < TIMESTAMP_LENGTH || !matchesPattern(data)) {
+        return false;
+    }
+    int64_t year = digits(data + 1, 4);
+    int64_t month = digits(data + 6, 2);
+    int64_t day = digits(data + 9, 2);
+    int64_t hour = digits(data + 12, 2);
+    int64_t minute = digits(data + 15, 2);
+    int64_t second = digits(data + 18, 2);
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 59) {
+        return false;
+    }
+    millis = daysFromCivil(year, month, day) * MILLIS_PER_DAY +
+             ((hour * 60 + minute) * 60 + second) * 1000 + digits(data + 21, 3);
+
+    // Dates such as February 30 would come back as another day, so they stay in the text
+    char formatted[TIMESTAMP_LENGTH];
+    formatTimestamp(millis, formatted);
+    return std::memcmp(formatted, data, TIMESTAMP_LENGTH) == 0;
+}
+
+void formatTimestamp(int64_t millis, char* output) {
+    int64_t days = millis >= 0 ? millis / MILLIS_PER_DAY : (millis - MILLIS_PER_DAY + 1) / MILLIS_PER_DAY;
+    int64_t timeOfDay = millis - days * MILLIS_PER_DAY;
+    int64_t year, month, day;
+    civilFromDays(days, year, month, day);
+
+    std::memcpy(output, PATTERN, TIMESTAMP_LENGTH);
+    writeDigits(output + 1, year, 4);
+    writeDigits(output + 6, month, 2);
+    writeDigits(output + 9, day, 2);
+    writeDigits(output + 12, timeOfDay / 3600000, 2);
+    writeDigits(output + 15, timeOfDay / 60000 % 60, 2);
+    writeDigits(output + 18, timeOfDay / 1000 % 60, 2);
+    writeDigits(output + 21, timeOfDay % 1000, 3);
+}
+
+bool hasTimestamps(const char* data, size_t size) {
+    size_t lines = 0;
+    size_t stamped = 0;
+    size_t pos = 0;
+    while (pos < size) {
+        const char* end = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+        size_t length = end ? static_cast<size_t>(end - data) + 1 - pos : size - pos;
+        int64_t millis;
+        lines++;
+        stamped += parseTimestamp(data + pos, length, millis);
+        pos += length;
+    }
+    return lines > 0 && stamped >= lines * MIN_TIMESTAMP_LINE_RATIO;
+}
+
+int64_t parseTimeBound(const std::string& text, bool upper) {
+    static const std::string LOWER_TIME = " 00:00:00.000";
+    static const std::string UPPER_TIME = " 23:59:59.999";
+    const std::string& fill = upper ? UPPER_TIME : LOWER_TIME;
+    const size_t dateLength = 10;
+    std::string value = text;
+    if (value.size() > dateLength && value[dateLength] == 'T') {
+        value[dateLength] = ' ';
+    }
+    size_t given = value.size() - std::min(value.size(), dateLength);  // Bytes of the time part
+    int64_t millis;
+    if (value.size() < dateLength || (given != 0 && given != 6 && given != 9 && given != fill.size()) ||
+        !parseTimestamp(("[" + value + fill.substr(given) + "]").c_str(), TIMESTAMP_LENGTH, millis)) {
+        throw std::invalid_argument("Invalid time '" + text + "', expected YYYY-MM-DD[ HH:MM[:SS[.mmm]]]");
+    }
+    return millis;
+}
+
+bool LineClock::advance(std::string_view line, int64_t& millis) {
+    if (firstLine && line.substr(0, UTF8_BOM_LENGTH) == UTF8_BOM) {
+        line.remove_prefix(UTF8_BOM_LENGTH);
+    }
+    firstLine = false;
+    int64_t parsed;
+    ownTimestamp = parseTimestamp(line.data(), line.size(), parsed);
+    if (ownTimestamp) {
+        last = parsed;
+        timed = true;
+    }
+    millis = last;
+    return timed;
+}
+
+void TimeRangeScanner::add(const char* data, size_t size) {
+    size_t pos = 0;
+    while (pos < size) {
+        if (inLine) {
+            const char* end = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+            if (!end) {
+                return;
+            }
+            pos = static_cast<size_t>(end - data) + 1;
+            inLine = false;
+            continue;
+        }
+        const char* end = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+        size_t available = (end ? static_cast<size_t>(end - data) : size) - pos;
+        const size_t startLength = firstLine ? UTF8_BOM_LENGTH + TIMESTAMP_LENGTH : TIMESTAMP_LENGTH;
+        if (head.empty() && available >= startLength) {
+            record(data + pos, available);  // Whole line start in this piece
+        } else {
+            head.append(data + pos, std::min(available, startLength - head.size()));
+            if (head.size() < startLength && !end) {
+                return;  // The line start continues in the next piece
+            }
+            record(head.data(), head.size());
+            head.clear();
+        }
+        inLine = true;
+    }
+}
+
+void TimeRangeScanner::record(const char* line, size_t size) {
+    if (firstLine && size >= UTF8_BOM_LENGTH && std::memcmp(line, UTF8_BOM, UTF8_BOM_LENGTH) == 0) {
+        line += UTF8_BOM_LENGTH;
+        size -= UTF8_BOM_LENGTH;
+    }
+    firstLine = false;
+    int64_t millis;
+    if (parseTimestamp(line, size, millis)) {
+        earliest = std::min(earliest, millis);
+        latest = std::max(latest, millis);
+    }
+}
+
+EncodingBuffer::EncodingBuffer(std::istream& source) : source(source), input(TIMESTAMP_BLOCK_SIZE) {}
+
+EncodingBuffer::int_type EncodingBuffer::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    source.read(input.data() + buffered, input.size() - buffered);
+    buffered += static_cast<size_t>(source.gcount());
+    if (buffered == 0) {
+        return traits_type::eof();
+    }
+
+    // A block ends after its last complete line, unless a single line fills all of it
+    size_t blockSize = buffered;
+    if (buffered == input.size()) {
+        auto lastNewline = std::find(input.rbegin(), input.rend(), '\n');
+        if (lastNewline != input.rend()) {
+            blockSize = static_cast<size_t>(input.rend() - lastNewline);
+        }
+    }
+
+    std::string text;
+    std::string stamps;
+    text.reserve(blockSize);
+    uint32_t lineCount = 0;
+    for (size_t pos = 0; pos < blockSize; lineCount++) {
+        const char* line = input.data() + pos;
+        const char* end = static_cast<const char*>(std::memchr(line, '\n', blockSize - pos));
+        size_t length = end ? static_cast<size_t>(end - line) + 1 : blockSize - pos;
+        int64_t millis;
+        if (parseTimestamp(line, length, millis)) {
+            io::appendVarint(stamps, io::zigzagEncode(millis - previous) << 1 | 1);
+            text.append(line + TIMESTAMP_LENGTH, length - TIMESTAMP_LENGTH);
+            previous = millis;
+        } else {
+            io::appendVarint(stamps, 0);
+            text.append(line, length);
+        }
+        pos += length;
+    }
+
+    encoded.clear();
+    appendUint32(encoded, lineCount);
+    appendUint32(encoded, static_cast<uint32_t>(text.size()));
+    appendUint32(encoded, static_cast<uint32_t>(stamps.size()));
+    encoded += text;
+    encoded += stamps;
+
+    std::copy(input.begin() + blockSize, input.begin() + buffered, input.begin());
+    buffered -= blockSize;
+    setg(&encoded[0], &encoded[0], &encoded[0] + encoded.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+DecodingBuffer::DecodingBuffer(std::ostream& target) : target(target) {}
+
+void DecodingBuffer::finish() const {
+    if (!pending.empty()) {
+        throw std::runtime_error("Invalid archive: timestamp-encoded stream ends inside a block");
+    }
+}
+
+DecodingBuffer::int_type DecodingBuffer::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        char byte = traits_type::to_char_type(c);
+        xsputn(&byte, 1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize DecodingBuffer::xsputn(const char* data, std::streamsize size) {
+    pending.append(data, size);
+    decodeBlocks();
+    return size;
+}
+
+void DecodingBuffer::decodeBlocks() {
+    auto malformed = []() {
+        return std::runtime_error("Invalid archive: malformed block in a timestamp-encoded stream");
+    };
+
+    size_t pos = 0;
+    while (pending.size() - pos >= BLOCK_HEADER_SIZE) {
+        uint32_t lineCount = readUint32(pending.data() + pos);
+        uint32_t textSize = readUint32(pending.data() + pos + 4);
+        uint32_t stampSize = readUint32(pending.data() + pos + 8);
+        if (lineCount == 0 || lineCount > TIMESTAMP_BLOCK_SIZE || textSize > TIMESTAMP_BLOCK_SIZE ||
+            stampSize > static_cast<uint64_t>(lineCount) * MAX_VARINT_SIZE) {
+            throw malformed();
+        }
+        if (pending.size() - pos - BLOCK_HEADER_SIZE < static_cast<size_t>(textSize) + stampSize) {
+            break;  // Rest of the block is still to come
+        }
+
+        const char* text = pending.data() + pos + BLOCK_HEADER_SIZE;
+        const char* textEnd = text + textSize;
+        const char* stamp = textEnd;
+        const char* stampEnd = stamp + stampSize;
+        decoded.clear();
+        decoded.reserve(textSize + static_cast<size_t>(lineCount) * TIMESTAMP_LENGTH);
+        for (uint32_t i = 0; i < lineCount; i++) {
+            uint64_t value;
+            if (!io::readVarint(stamp, stampEnd, value)) {
+                throw malformed();
+            }
+            if (value & 1) {
+                uint64_t delta = static_cast<uint64_t>(io::zigzagDecode(value >> 1));
+                previous = static_cast<int64_t>(static_cast<uint64_t>(previous) + delta);
+                if (previous < MIN_TIMESTAMP || previous > MAX_TIMESTAMP) {
+                    throw malformed();
+                }
+                char formatted[TIMESTAMP_LENGTH];
+                formatTimestamp(previous, formatted);
+                decoded.append(formatted, TIMESTAMP_LENGTH);
+            }
+            const char* end = static_cast<const char*>(std::memchr(text, '\n', textEnd - text));
+            const char* lineEnd = end ? end + 1 : textEnd;
+            decoded.append(text, lineEnd);
+            text = lineEnd;
+        }
+        if (text != textEnd || stamp != stampEnd) {
+            throw malformed();
+        }
+
+        io::writeBuffer(target, decoded.data(), decoded.size());
+        restored += decoded.size();
+        pos += BLOCK_HEADER_SIZE + textSize + stampSize;
+    }
+    pending.erase(0, pos);
+}
+
+}  // namespace timestamps
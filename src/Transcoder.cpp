@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ContentProbe.h"
+#include "IO.h"
+#include "Transcoder.h"
+
+namespace transcoding {
+
+namespace {
+
+uint16_t readUnit(const uint8_t* data, Encoding encoding) {
+    return encoding == Encoding::UTF16LE ? static_cast<uint16_t>(data[0] | data[1] << 8)
+                                         : static_cast<uint16_t>(data[0] << 8 | data[1]);
+}
+
+void appendUnit(std::string& output, uint16_t unit, Encoding encoding) {
+    char bytes[2];
+    bytes[encoding == Encoding::UTF16LE ? 0 : 1] = static_cast<char>(unit & 0xFF);
+    bytes[encoding == Encoding::UTF16LE ? 1 : 0] = static_cast<char>(unit >> 8);
+    output.append(bytes, 2);
+}
+
+void appendCodePoint(std::string& output, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        output += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        output += static_cast<char>(0xC0 | codePoint >> 6);
+        output += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        output += static_cast<char>(0xE0 | codePoint >> 12);
+        output += static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+        output += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        output += static_cast<char>(0xF0 | codePoint >> 18);
+        output += static_cast<char>(0x80 | (codePoint >> 12 & 0x3F));
+        output += static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+        output += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+bool isHighSurrogate(uint16_t unit) {
+    return unit >= 0xD800 && unit < 0xDC00;
+}
+
+bool isLowSurrogate(uint16_t unit) {
+    return unit >= 0xDC00 && unit < 0xE000;
+}
+
+// Bytes of UTF-8 per UTF-16 code unit, for deciding whether transcoding pays off
+size_t utf8Length(uint16_t unit) {
+    if (unit < 0x80) {
+        return 1;
+    }
+    if (unit < 0x800 || isHighSurrogate(unit) || isLowSurrogate(unit)) {
+        return 2;  // A surrogate pair takes four bytes either way
+    }
+    return 3;
+}
+
+}  // namespace
+
+Encoding detectUtf16(const uint8_t* data, size_t size) {
+    size &= ~size_t(1);
+    if (size < 2) {
+        return Encoding::NONE;
+    }
+
+    Encoding encoding = Encoding::NONE;
+    size_t start = 0;
+    if (data[0] == 0xFF && data[1] == 0xFE) {
+        encoding = Encoding::UTF16LE;
+        start = 2;
+    } else if (data[0] == 0xFE && data[1] == 0xFF) {
+        encoding = Encoding::UTF16BE;
+        start = 2;
+    } else {
+        // Without a byte order mark, ASCII text in UTF-16 has a zero byte in every code unit
+        size_t littleEndian = 0;
+        size_t bigEndian = 0;
+        for (size_t i = 0; i < size; i += 2) {
+            littleEndian += data[i] != 0 && data[i + 1] == 0;
+            bigEndian += data[i] == 0 && data[i + 1] != 0;
+        }
+        size_t units = size / 2;
+        if (littleEndian >= units * MIN_UTF16_ASCII_RATIO) {
+            encoding = Encoding::UTF16LE;
+        } else if (bigEndian >= units * MIN_UTF16_ASCII_RATIO) {
+            encoding = Encoding::UTF16BE;
+        } else {
+            return Encoding::NONE;
+        }
+    }
+
+    size_t converted = 0;
+    for (size_t i = start; i < size; i += 2) {
+        converted += utf8Length(readUnit(data + i, encoding));
+    }
+    return converted < size - start ? encoding : Encoding::NONE;
+}
+
+Encoding detectFileEncoding(const std::filesystem::path& filePath) {
+    uint64_t fileSize = std::filesystem::file_size(filePath);
+    if (fileSize == 0 || fileSize % 2 != 0) {
+        return Encoding::NONE;
+    }
+    std::ifstream file(filePath, std::ios::binary);
+    io::checkOpen(file, filePath.string(), "Encoding detection");
+    std::vector<uint8_t> sample(probe::SAMPLE_SIZE);
+    file.read(reinterpret_cast<char*>(sample.data()), sample.size());
+    return detectUtf16(sample.data(), static_cast<size_t>(file.gcount()));
+}
+
+size_t utf16ToUtf8(const uint8_t* data, size_t size, Encoding encoding, bool final, std::string& output) {
+    size &= ~size_t(1);
+    output.reserve(output.size() + size / 2);
+    size_t i = 0;
+    while (i < size) {
+#ifdef __SSE2__
+        // Runs of ASCII are narrowed eight code units at a time
+        const __m128i asciiMask = _mm_set1_epi16(static_cast<short>(0xFF80));
+        while (i + 16 <= size) {
+            __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            if (encoding == Encoding::UTF16BE) {
+                units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+            }
+            __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(units, asciiMask), _mm_setzero_si128());
+            if (_mm_movemask_epi8(ascii) != 0xFFFF) {
+                break;
+            }
+            alignas(16) char narrowed[16];
+            _mm_store_si128(reinterpret_cast<__m128i*>(narrowed), _mm_packus_epi16(units, units));
+            output.append(narrowed, 8);
+            i += 16;
+        }
+        if (i == size) {
+            break;
+        }
+#endif
+        uint16_t unit = readUnit(data + i, encoding);
+        if (isHighSurrogate(unit)) {
+            if (i + 4 > size && !final) {
+                break;  // The low surrogate may follow in the next call
+            }
+            uint16_t next = i + 4 <= size ? readUnit(data + i + 2, encoding) : 0;
+            if (isLowSurrogate(next)) {
+                appendCodePoint(output, 0x10000 + ((unit - 0xD800) << 10) + (next - 0xDC00));
+                i += 4;
+                continue;
+            }
+        }
+        appendCodePoint(output, unit);  // Includes unpaired surrogates, as WTF-8
+        i += 2;
+    }
+    return i;
+}
+
+size_t utf8ToUtf16(const uint8_t* data, size_t size, Encoding encoding, std::string& output) {
+    output.reserve(output.size() + size * 2);
+    auto invalid = []() {
+        return std::runtime_error("Invalid archive: transcoded stream is not valid UTF-8");
+    };
+
+    size_t i = 0;
+    while (i < size) {
+#ifdef __SSE2__
+        // Runs of ASCII are widened sixteen bytes at a time
+        while (i + 16 <= size) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            if (_mm_movemask_epi8(bytes) != 0) {
+                break;
+            }
+            const __m128i zero = _mm_setzero_si128();
+            bool little = encoding == Encoding::UTF16LE;
+            alignas(16) char widened[32];
+            _mm_store_si128(reinterpret_cast<__m128i*>(widened),
+                            little ? _mm_unpacklo_epi8(bytes, zero) : _mm_unpacklo_epi8(zero, bytes));
+            _mm_store_si128(reinterpret_cast<__m128i*>(widened + 16),
+                            little ? _mm_unpackhi_epi8(bytes, zero) : _mm_unpackhi_epi8(zero, bytes));
+            output.append(widened, 32);
+            i += 16;
+        }
+        if (i == size) {
+            break;
+        }
+#endif
+        uint8_t lead = data[i];
+        size_t length = lead < 0x80 ? 1 : (lead & 0xE0) == 0xC0 ? 2 : (lead & 0xF0) == 0xE0 ? 3 : (lead & 0xF8) == 0xF0 ? 4 : 0;
+        if (length == 0) {
+            throw invalid();
+        }
+        if (i + length > size) {
+            break;  // Rest of the sequence is still to come
+        }
+        uint32_t codePoint = length == 1 ? lead : lead & (0x7F >> length);
+        for (size_t k = 1; k < length; k++) {
+            if ((data[i + k] & 0xC0) != 0x80) {
+                throw invalid();
+            }
+            codePoint = codePoint << 6 | (data[i + k] & 0x3F);
+        }
+        // Overlong and out of range forms never come out of utf16ToUtf8
+        if ((length == 2 && codePoint < 0x80) || (length == 3 && codePoint < 0x800) ||
+            (length == 4 && (codePoint < 0x10000 || codePoint > 0x10FFFF))) {
+            throw invalid();
+        }
+        if (codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            appendUnit(output, static_cast<uint16_t>(0xD800 + (codePoint >> 10)), encoding);
+            appendUnit(output, static_cast<uint16_t>(0xDC00 + (codePoint & 0x3FF)), encoding);
+        } else {
+            appendUnit(output, static_cast<uint16_t>(codePoint), encoding);
+        }
+        i += length;
+    }
+    return i;
+}
+
+ToUtf8Buffer::ToUtf8Buffer(std::istream& source, Encoding encoding, uint64_t size)
+    : source(source), encoding(encoding), remaining(size), input(1 << 16) {}
+
+ToUtf8Buffer::int_type ToUtf8Buffer::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    converted.clear();
+    while (converted.empty()) {
+        size_t wanted = static_cast<size_t>(std::min<uint64_t>(input.size() - carried, remaining));
+        source.read(input.data() + carried, wanted);
+        size_t size = carried + static_cast<size_t>(source.gcount());
+        remaining -= source.gcount();
+        bool final = remaining == 0 || !source;
+        if (size == 0) {
+            return traits_type::eof();
+        }
+
+        size_t consumed = utf16ToUtf8(reinterpret_cast<const uint8_t*>(input.data()), size, encoding, final, converted);
+        carried = size - consumed;
+        if (final && carried > 0) {
+            throw std::runtime_error("Transcoding failed: input ends inside a UTF-16 code unit");
+        }
+        std::copy(input.begin() + consumed, input.begin() + size, input.begin());
+    }
+    setg(&converted[0], &converted[0], &converted[0] + converted.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+FromUtf8Buffer::FromUtf8Buffer(std::ostream& target, Encoding encoding) : target(target), encoding(encoding) {}
+
+void FromUtf8Buffer::finish() const {
+    if (!pending.empty()) {
+        throw std::runtime_error("Invalid archive: transcoded stream ends inside a UTF-8 sequence");
+    }
+}
+
+FromUtf8Buffer::int_type FromUtf8Buffer::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        char byte = traits_type::to_char_type(c);
+        xsputn(&byte, 1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize FromUtf8Buffer::xsputn(const char* data, std::streamsize size) {
+    pending.append(data, size);
+    converted.clear();
+    size_t consumed = utf8ToUtf16(reinterpret_cast<const uint8_t*>(pending.data()), pending.size(), encoding, converted);
+    pending.erase(0, consumed);
+    io::writeBuffer(target, converted.data(), converted.size());
+    restored += converted.size();
+    return size;
+}
+
+}  // namespace transcoding
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "Catalog.h"
+#include "FileCompressor.h"
+#include "TimestampCodec.h"
+#include "Watcher.h"
+
+namespace watch {
+
+namespace {
+
+// Events of a watched directory: files finished by their writer or moved in, and directories appearing
+constexpr uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+
+// Events read at once; large enough for bursts of rotations
+constexpr size_t EVENT_BUFFER_SIZE = 64 << 10;
+
+// Removes a prefix of the given layout from text, where 0 stands for any digit; false if it does not match
+bool consumeLayout(std::string_view& text, std::string_view layout) {
+    if (text.size() < layout.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < layout.size(); i++) {
+        if (layout[i] == '0' ? !std::isdigit(static_cast<unsigned char>(text[i])) : text[i] != layout[i]) {
+            return false;
+        }
+    }
+    text.remove_prefix(layout.size());
+    return true;
+}
+
+std::runtime_error systemError(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+}  // namespace
+
+Segment parseSegment(const std::string& name) {
+    if (name == "hour") {
+        return Segment::HOUR;
+    }
+    if (name == "day") {
+        return Segment::DAY;
+    }
+    throw std::invalid_argument("Unknown segment '" + name + "': expected hour or day");
+}
+
+std::string segmentArchive(const std::string& archivePrefix, int64_t millis, Segment segment) {
+    char timestamp[timestamps::TIMESTAMP_LENGTH];  // [YYYY-MM-DD HH:MM:SS.mmm]
+    timestamps::formatTimestamp(millis, timestamp);
+    std::string name = archivePrefix + "-" + std::string(timestamp + 1, 10);
+    if (segment == Segment::HOUR) {
+        name += "-" + std::string(timestamp + 12, 2);
+    }
+    return name;
+}
+
+Watcher::Watcher(const std::string& rootDir, const std::string& archivePrefix, const WatchOptions& options)
+    : root(std::filesystem::absolute(rootDir).lexically_normal()),
+      archivePrefix(std::filesystem::absolute(archivePrefix).lexically_normal().string()),
+      catalogFile(options.compression.catalogFile.empty()
+                      ? std::string()
+                      : std::filesystem::absolute(options.compression.catalogFile).lexically_normal().string()),
+      options(options) {
+    if (!std::filesystem::is_directory(root)) {
+        throw std::runtime_error("Not a directory: " + rootDir);
+    }
+    if (options.latencyMillis < 0) {
+        throw std::invalid_argument("Watch latency must not be negative");
+    }
+    notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notifyFd < 0) {
+        throw systemError("inotify initialization");
+    }
+    if (pipe2(stopPipe, O_NONBLOCK | O_CLOEXEC) != 0) {  // Non-blocking, so stop() never waits in a signal handler
+        close(notifyFd);
+        throw systemError("Watch stop pipe creation");
+    }
+    try {
+        addWatches(root, false);
+    } catch (...) {
+        close(notifyFd);
+        close(stopPipe[0]);
+        close(stopPipe[1]);
+        throw;
+    }
+}
+
+Watcher::~Watcher() {
+    close(notifyFd);  // Drops every watch
+    close(stopPipe[0]);
+    close(stopPipe[1]);
+}
+
+void Watcher::addWatches(const std::filesystem::path& dir, bool queueFiles) {
+    std::vector<std::filesystem::path> dirs = {dir};
+    while (!dirs.empty()) {
+        std::filesystem::path current = std::move(dirs.back());
+        dirs.pop_back();
+        // Watched before listed, so files created meanwhile are either listed or reported
+        int wd = inotify_add_watch(notifyFd, current.c_str(), WATCH_EVENTS | IN_ONLYDIR);
+        if (wd < 0) {
+            if (errno == ENOENT || errno == ENOTDIR) {
+                continue;  // Gone again
+            }
+            if (errno == ENOSPC) {
+                throw std::runtime_error("inotify watch limit reached at " + current.string() +
+                                         "; raise fs.inotify.max_user_watches");
+            }
+            throw systemError("Watching " + current.string());
+        }
+        watchedDirs[wd] = current;  // A directory moved within the tree keeps its descriptor
+
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(current, error)) {
+            std::error_code typeError;
+            if (entry.is_directory(typeError) && !entry.is_symlink(typeError)) {
+                dirs.push_back(entry.path());
+            } else if (queueFiles && entry.is_regular_file(typeError)) {
+                queue(entry.path());
+            }
+        }
+    }
+}
+
+void Watcher::readEvents() {
+    alignas(inotify_event) char buffer[EVENT_BUFFER_SIZE];
+    while (true) {
+        ssize_t size = read(notifyFd, buffer, sizeof(buffer));
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                return;
+            }
+            throw systemError("inotify reading");
+        }
+        for (char* position = buffer; position < buffer + size;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(position);
+            position += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were dropped: every file may have changed unseen. Unchanged files are skipped by the
+                // append after hashing, and directories created meanwhile are watched.
+                std::cerr << "Watch events were lost; queueing every file under " << root.string() << std::endl;
+                watchStats.rescans++;
+                addWatches(root, true);
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                watchedDirs.erase(event->wd);  // The directory was removed
+                continue;
+            }
+            auto dir = watchedDirs.find(event->wd);
+            if (dir == watchedDirs.end() || event->len == 0) {
+                continue;
+            }
+            std::filesystem::path path = dir->second / event->name;
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    addWatches(path, true);  // Its files may have been written before the watch was added
+                }
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                queue(path);
+            }
+        }
+    }
+}
+
+bool Watcher::isOwnFile(const std::string& path) const {
+    if (!catalogFile.empty()) {
+        std::string temporaryStart = catalogFile + ".tmp.";
+        if (path == catalogFile || path == catalogFile + ".lock" ||
+            path.compare(0, temporaryStart.size(), temporaryStart) == 0) {
+            return true;
+        }
+    }
+    std::string segmentStart = archivePrefix + "-";
+    if (path.compare(0, segmentStart.size(), segmentStart) != 0) {
+        return false;
+    }
+    // -YYYY-MM-DD or -YYYY-MM-DD-HH, then nothing or a suffix of the files written beside an archive
+    std::string_view rest = std::string_view(path).substr(segmentStart.size());
+    if (!consumeLayout(rest, "0000-00-00")) {
+        return false;
+    }
+    consumeLayout(rest, "-00");
+    return rest.empty() || rest == ".partial" || rest == ".journal" || rest == ".journal.tmp";
+}
+
+void Watcher::queue(const std::filesystem::path& path) {
+    if (isOwnFile(path.string())) {
+        return;  // Queueing them would archive every segment and catalog update in the next batch
+    }
+    if (pending.empty()) {
+        batchStart = std::chrono::steady_clock::now();
+    }
+    pending.insert(path.lexically_relative(root).string());
+}
+
+void Watcher::archiveBatch() {
+    std::vector<std::string> files;
+    for (const auto& relativePath : pending) {
+        std::error_code error;
+        std::filesystem::path path = root / relativePath;
+        if (std::filesystem::is_regular_file(path, error) && std::filesystem::file_size(path, error) > 0 && !error) {
+            files.push_back(relativePath);  // Files removed or emptied since are left out
+        }
+    }
+    if (files.empty()) {
+        pending.clear();
+        return;
+    }
+
+    compression::CompressionOptions compression = options.compression;
+    compression.files = files;
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::string archive = segmentArchive(archivePrefix, now, options.segment);
+    bool created = !std::filesystem::exists(archive);
+    std::string partial = archive + ".partial";
+    try {
+        if (created) {
+            // Built aside and renamed into place, so the segment is never seen, appended to or cataloged half written
+            compression.catalogFile.clear();
+            compression::FileCompressor::compress(root.string(), partial, compression);
+            std::filesystem::rename(partial, archive);
+            if (!options.compression.catalogFile.empty()) {
+                catalog::updateCatalog(options.compression.catalogFile, {archive});
+            }
+        } else {
+            compression::FileCompressor::append(root.string(), archive, compression);
+        }
+    } catch (const std::exception& e) {
+        // Kept queued, as files still being rotated or a full disk may let the next attempt succeed
+        std::cerr << "Archiving " << files.size() << " files to " << archive << " failed, retrying: " << e.what()
+                  << std::endl;
+        if (created) {
+            std::error_code ignored;
+            std::filesystem::remove(partial, ignored);
+        }
+        watchStats.failures++;
+        batchStart = std::chrono::steady_clock::now();
+        return;
+    }
+    pending.clear();
+    watchStats.batches++;
+    watchStats.files += files.size();
+    watchStats.archives += created ? 1 : 0;
+}
+
+void Watcher::run() {
+    const auto latency = std::chrono::milliseconds(options.latencyMillis);
+    while (true) {
+        int timeout = -1;  // Sleeps until an event arrives when nothing is queued
+        if (!pending.empty()) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                batchStart + latency - std::chrono::steady_clock::now()).count();
+            timeout = static_cast<int>(std::clamp<int64_t>(remaining, 0, INT_MAX));
+        }
+        pollfd fds[2] = {{notifyFd, POLLIN, 0}, {stopPipe[0], POLLIN, 0}};
+        if (poll(fds, 2, timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw systemError("Watch polling");
+        }
+        if (fds[0].revents & POLLIN) {
+            readEvents();
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        if (!pending.empty() && std::chrono::steady_clock::now() >= batchStart + latency) {
+            archiveBatch();
+        }
+    }
+    readEvents();  // Files finished before the stop
+    if (!pending.empty()) {
+        archiveBatch();
+    }
+}
+
+void Watcher::stop() {
+    char byte = 0;
+    if (write(stopPipe[1], &byte, 1) < 0) {
+        // Fails without blocking once the pipe is full, when run() is already woken
+    }
+}
+
+}  // namespace watch
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <vector>
@@ -9,21 +10,106 @@
 
 #include "ZStandardCompressor.h"
 
-// using ZSTD v1.4.8
+// using ZSTD v1.4.8 advanced parameter API (ZSTD_CCtx_setParameter / ZSTD_compressStream2)
 
 namespace compression {
 
-void ZStandardCompressor::compressStream(std::istream& input, std::ostream& output) const {
-    // Create compression context with automatic cleanup
-    auto deleter = [](ZSTD_CStream* stream) { ZSTD_freeCStream(stream); };
-    std::unique_ptr<ZSTD_CStream, decltype(deleter)> cstream(ZSTD_createCStream(), deleter);
-    
-    if (!cstream) {
+namespace {
+
+// Largest window log a decoder accepts without ZSTD_d_windowLogMax (ZSTD_WINDOWLOG_LIMIT_DEFAULT)
+constexpr int DEFAULT_DECODER_WINDOW_LOG = 27;
+
+// Applies a compression parameter, clamped to what the linked libzstd supports
+// (a library built without threading only accepts nbWorkers = 0)
+void setParameter(ZSTD_CCtx* context, ZSTD_cParameter parameter, int value) {
+    ZSTD_bounds bounds = ZSTD_cParam_getBounds(parameter);
+    if (ZSTD_isError(bounds.error)) {
+        throw std::runtime_error(std::string("ZSTD parameter error: ") + ZSTD_getErrorName(bounds.error));
+    }
+    size_t result = ZSTD_CCtx_setParameter(context, parameter, std::clamp(value, bounds.lowerBound, bounds.upperBound));
+    if (ZSTD_isError(result)) {
+        throw std::runtime_error(std::string("ZSTD initialization error: ") + ZSTD_getErrorName(result));
+    }
+}
+
+}  // namespace
+
+ZStandardCompressor::ZStandardCompressor(int level, const CompressorSettings& settings)
+    : level(level), settings(settings) {
+    if (settings.dictionary) {
+        const std::string& dictionary = *settings.dictionary;
+        compressionDictionary.reset(ZSTD_createCDict(dictionary.data(), dictionary.size(), level));
+        decompressionDictionary.reset(ZSTD_createDDict(dictionary.data(), dictionary.size()));
+        if (!compressionDictionary || !decompressionDictionary) {
+            throw std::runtime_error("Failed to load ZSTD dictionary");
+        }
+    }
+}
+
+ZStandardCompressor::ContextPtr ZStandardCompressor::createContext() const {
+    ContextPtr context(ZSTD_createCCtx());
+    if (!context) {
         throw std::runtime_error("Failed to create ZSTD compression context");
     }
-    // Initialize with default compression level
-    ZSTD_initCStream(cstream.get(), ZSTD_CLEVEL_DEFAULT);
+    setParameter(context.get(), ZSTD_c_compressionLevel, level);
+    if (settings.windowLog > 0) {
+        setParameter(context.get(), ZSTD_c_windowLog, settings.windowLog);  // Window must cover the distance between repeats
+    }
+    if (settings.longDistance) {
+        setParameter(context.get(), ZSTD_c_enableLongDistanceMatching, 1);  // Defaults the window to 128MB unless set above
+    }
+    if (settings.workers > 0) {
+        setParameter(context.get(), ZSTD_c_nbWorkers, settings.workers);  // Compress jobs on zstd's own threads
+    }
+    return context;
+}
+
+ZStandardCompressor::ContextPtr ZStandardCompressor::acquireContext() const {
+    {
+        std::lock_guard<std::mutex> lock(contextMutex);
+        if (!idleContexts.empty()) {
+            ContextPtr context = std::move(idleContexts.back());
+            idleContexts.pop_back();
+            return context;  // Parameters survive a session reset
+        }
+    }
+
+    ContextPtr context = createContext();
+    if (compressionDictionary) {
+        size_t result = ZSTD_CCtx_refCDict(context.get(), compressionDictionary.get());  // Kept across session resets
+        if (ZSTD_isError(result)) {
+            throw std::runtime_error(std::string("ZSTD dictionary error: ") + ZSTD_getErrorName(result));
+        }
+    }
+    return context;
+}
 
+void ZStandardCompressor::releaseContext(ContextPtr context) const {
+    ZSTD_CCtx_reset(context.get(), ZSTD_reset_session_only);  // Ready for the next frame, parameters kept
+    std::lock_guard<std::mutex> lock(contextMutex);
+    idleContexts.push_back(std::move(context));
+}
+
+void ZStandardCompressor::compressStream(std::istream& input, std::ostream& output) const {
+    ContextPtr context = acquireContext();
+    compressFrame(context.get(), input, output);
+    releaseContext(std::move(context));
+}
+
+void ZStandardCompressor::compressDelta(std::istream& input, std::ostream& output, const std::string& reference,
+                                        const StreamHints& hints) const {
+    // Not pooled: the delta window and the prefix only apply to this frame
+    ContextPtr context = createContext();
+    setParameter(context.get(), ZSTD_c_windowLog, deltaWindowLog(reference.size(), hints.sizeHint));
+    setParameter(context.get(), ZSTD_c_enableLongDistanceMatching, 1);  // Finds matches anywhere in a large reference
+    size_t result = ZSTD_CCtx_refPrefix(context.get(), reference.data(), reference.size());
+    if (ZSTD_isError(result)) {
+        throw std::runtime_error(std::string("ZSTD reference error: ") + ZSTD_getErrorName(result));
+    }
+    compressFrame(context.get(), input, output);
+}
+
+void ZStandardCompressor::compressFrame(ZSTD_CCtx* context, std::istream& input, std::ostream& output) const {
     // Create buffers for input and output
     std::vector<char> inputBuffer(ZSTD_CStreamInSize());
     std::vector<char> outputBuffer(ZSTD_CStreamOutSize());
@@ -48,7 +134,7 @@ void ZStandardCompressor::compressStream(std::istream& input, std::ostream& outp
             ZSTD_outBuffer outBuf = {outputBuffer.data(), outputBuffer.size(), 0};
             
             // Compress
-            size_t remaining = ZSTD_compressStream(cstream.get(), &outBuf, &inBuf);
+            size_t remaining = ZSTD_compressStream2(context, &outBuf, &inBuf, ZSTD_e_continue);
             if (ZSTD_isError(remaining)) {
                 throw std::runtime_error(std::string("ZSTD compression error: ") + 
                                        ZSTD_getErrorName(remaining));
@@ -62,35 +148,69 @@ void ZStandardCompressor::compressStream(std::istream& input, std::ostream& outp
         }
     }
 
-    // Flush remaining data
-    ZSTD_outBuffer outBuf = {outputBuffer.data(), outputBuffer.size(), 0};
-    if (ZSTD_endStream(cstream.get(), &outBuf) > 0) {
-        throw std::runtime_error("ZSTD compression error: couldn't flush remaining data");
+    // Flush remaining data, waiting for worker threads to finish their jobs
+    size_t remaining;
+    do {
+        ZSTD_outBuffer outBuf = {outputBuffer.data(), outputBuffer.size(), 0};
+        ZSTD_inBuffer inBuf = {nullptr, 0, 0};
+        remaining = ZSTD_compressStream2(context, &outBuf, &inBuf, ZSTD_e_end);
+        if (ZSTD_isError(remaining)) {
+            throw std::runtime_error(std::string("ZSTD compression error: ") + ZSTD_getErrorName(remaining));
+        }
+        output.write(outputBuffer.data(), outBuf.pos);
+        if (!output) {
+            throw std::runtime_error("Failed to write final compressed data");
+        }
+    } while (remaining > 0);
+}
+
+ZStandardCompressor::DecompressionContextPtr ZStandardCompressor::createDecompressionContext(int windowLog) const {
+    DecompressionContextPtr context(ZSTD_createDCtx());
+    if (!context) {
+        throw std::runtime_error("Failed to create ZSTD decompression context");
     }
-    output.write(outputBuffer.data(), outBuf.pos);
-    if (!output) {
-        throw std::runtime_error("Failed to write final compressed data");
+
+    // Accept the window the entry was written with; the default limit rejects anything above 128MB
+    if (windowLog > DEFAULT_DECODER_WINDOW_LOG) {
+        ZSTD_bounds windowBounds = ZSTD_dParam_getBounds(ZSTD_d_windowLogMax);
+        int windowLogMax = std::min(windowLog, windowBounds.upperBound);
+        size_t result = ZSTD_DCtx_setParameter(context.get(), ZSTD_d_windowLogMax, windowLogMax);
+        if (ZSTD_isError(result)) {
+            throw std::runtime_error(std::string("ZSTD initialization error: ") + ZSTD_getErrorName(result));
+        }
     }
+    return context;
 }
 
 size_t ZStandardCompressor::decompressStream(std::istream& input, std::ostream& output) const {
-    // Create and initialize decompression context
-    auto deleter = [](ZSTD_DStream* stream) { ZSTD_freeDStream(stream); };
-    std::unique_ptr<ZSTD_DStream, decltype(deleter)> dstream(ZSTD_createDStream(), deleter);
-    
-    if (!dstream) {
-        throw std::runtime_error("Failed to create ZSTD decompression context");
+    DecompressionContextPtr context = createDecompressionContext(settings.windowLog);
+    if (decompressionDictionary) {
+        size_t result = ZSTD_DCtx_refDDict(context.get(), decompressionDictionary.get());
+        if (ZSTD_isError(result)) {
+            throw std::runtime_error(std::string("ZSTD dictionary error: ") + ZSTD_getErrorName(result));
+        }
     }
+    return decompressFrame(context.get(), input, output);
+}
 
-    ZSTD_initDStream(dstream.get());
+size_t ZStandardCompressor::decompressDelta(std::istream& input, std::ostream& output, const std::string& reference) const {
+    DecompressionContextPtr context = createDecompressionContext(settings.windowLog);
+    size_t result = ZSTD_DCtx_refPrefix(context.get(), reference.data(), reference.size());
+    if (ZSTD_isError(result)) {
+        throw std::runtime_error(std::string("ZSTD reference error: ") + ZSTD_getErrorName(result));
+    }
+    return decompressFrame(context.get(), input, output);
+}
 
+size_t ZStandardCompressor::decompressFrame(ZSTD_DCtx* context, std::istream& input, std::ostream& output) const {
     // Prepare buffers
     std::vector<char> inputBuffer(ZSTD_DStreamInSize());
     std::vector<char> outputBuffer(ZSTD_DStreamOutSize());
     size_t totalDecompressedBytes = 0;
+    bool frameComplete = false;
 
-    // Process input stream
-    while (input) {
+    // Process input stream until the end of the current frame
+    while (input && !frameComplete) {
         input.read(inputBuffer.data(), inputBuffer.size());
         if (input.fail() && !input.eof()) {
             throw std::runtime_error("Error reading from input stream");
@@ -105,7 +225,7 @@ size_t ZStandardCompressor::decompressStream(std::istream& input, std::ostream&
         while (inBuf.pos < inBuf.size) {
             ZSTD_outBuffer outBuf = {outputBuffer.data(), outputBuffer.size(), 0};
             
-            size_t ret = ZSTD_decompressStream(dstream.get(), &outBuf, &inBuf);
+            size_t ret = ZSTD_decompressStream(context, &outBuf, &inBuf);
             if (ZSTD_isError(ret)) {
                 throw std::runtime_error(std::string("ZSTD decompression error: ") + 
                                       ZSTD_getErrorName(ret));
@@ -118,7 +238,8 @@ size_t ZStandardCompressor::decompressStream(std::istream& input, std::ostream&
             totalDecompressedBytes += outBuf.pos;
             
             if (ret == 0) {
-                break;  // End of frame reached
+                frameComplete = true;  // End of frame reached, ignore data that follows it
+                break;
             }
         }
     }
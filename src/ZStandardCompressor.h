@@ -1,14 +1,67 @@
 #ifndef ZSTANDARD_COMPRESSOR_H
 #define ZSTANDARD_COMPRESSOR_H
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <zstd.h>
+
 #include "Compressor.h"
 
 namespace compression {
 
 class ZStandardCompressor : public Compressor {
 public:
+    explicit ZStandardCompressor(int level, const CompressorSettings& settings = {});
+
     void compressStream(std::istream& input, std::ostream& output) const override;
     size_t decompressStream(std::istream& input, std::ostream& output) const override;
+
+    // Delta frames reference the previous content as a prefix, like zstd --patch-from
+    bool supportsDelta() const override { return true; }
+    void compressDelta(std::istream& input, std::ostream& output, const std::string& reference,
+                       const StreamHints& hints) const override;
+    size_t decompressDelta(std::istream& input, std::ostream& output, const std::string& reference) const override;
+private:
+    struct ContextDeleter {
+        void operator()(ZSTD_CCtx* context) const { ZSTD_freeCCtx(context); }
+    };
+    using ContextPtr = std::unique_ptr<ZSTD_CCtx, ContextDeleter>;
+    struct CompressionDictionaryDeleter {
+        void operator()(ZSTD_CDict* dictionary) const { ZSTD_freeCDict(dictionary); }
+    };
+    struct DecompressionDictionaryDeleter {
+        void operator()(ZSTD_DDict* dictionary) const { ZSTD_freeDDict(dictionary); }
+    };
+
+    struct DecompressionContextDeleter {
+        void operator()(ZSTD_DCtx* context) const { ZSTD_freeDCtx(context); }
+    };
+    using DecompressionContextPtr = std::unique_ptr<ZSTD_DCtx, DecompressionContextDeleter>;
+
+    // Creates a context configured from the level and settings
+    ContextPtr createContext() const;
+
+    // Hands out a configured context, reusing an idle one so worker threads are not respawned per file
+    ContextPtr acquireContext() const;
+    void releaseContext(ContextPtr context) const;
+
+    // Compresses the whole input as one frame
+    void compressFrame(ZSTD_CCtx* context, std::istream& input, std::ostream& output) const;
+
+    // Creates a decompression context accepting the configured window
+    DecompressionContextPtr createDecompressionContext(int windowLog) const;
+
+    // Decompresses one frame and returns the number of bytes written
+    size_t decompressFrame(ZSTD_DCtx* context, std::istream& input, std::ostream& output) const;
+
+    const int level;                      // Compression level used when compressing
+    const CompressorSettings settings;    // Worker, long-distance matching, window and dictionary settings
+    std::unique_ptr<ZSTD_CDict, CompressionDictionaryDeleter> compressionDictionary;      // Digested once, shared by all frames
+    std::unique_ptr<ZSTD_DDict, DecompressionDictionaryDeleter> decompressionDictionary;  // Null without a dictionary
+    mutable std::mutex contextMutex;      // Protects idleContexts
+    mutable std::vector<ContextPtr> idleContexts;  // Contexts returned after a completed frame
 };
 
 } // namespace compression
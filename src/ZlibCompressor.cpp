@@ -13,7 +13,7 @@ namespace compression {
 void ZlibCompressor::compressStream(std::istream& input, std::ostream& output) const {
     // Create compressor with automatic cleanup
     z_stream zs = {};    
-    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    if (deflateInit(&zs, level) != Z_OK) {
         throw std::runtime_error("Failed to initialize zlib compressor");
     }
     struct ZStreamCleanup { 
@@ -22,6 +22,14 @@ void ZlibCompressor::compressStream(std::istream& input, std::ostream& output) c
             deflateEnd(z); 
         } 
     } cleanup{&zs};
+
+    if (settings.dictionary) {
+        // Prime the window; the dictionary id in the header lets inflate ask for it back
+        const auto* dictionary = reinterpret_cast<const Bytef*>(settings.dictionary->data());
+        if (deflateSetDictionary(&zs, dictionary, static_cast<uInt>(settings.dictionary->size())) != Z_OK) {
+            throw std::runtime_error("Failed to set zlib dictionary");
+        }
+    }
     
     std::vector<Bytef> inBuffer(BUFFER_SIZE);
     std::vector<Bytef> outBuffer(BUFFER_SIZE);
@@ -93,6 +101,13 @@ size_t ZlibCompressor::decompressStream(std::istream& input, std::ostream& outpu
             zs.next_out = outBuffer.data();
             
             ret = inflate(&zs, Z_NO_FLUSH);
+            if (ret == Z_NEED_DICT) {
+                if (!settings.dictionary) {
+                    throw std::runtime_error("Zlib decompression failed: stream needs a dictionary");
+                }
+                const auto* dictionary = reinterpret_cast<const Bytef*>(settings.dictionary->data());
+                ret = inflateSetDictionary(&zs, dictionary, static_cast<uInt>(settings.dictionary->size()));
+            }
             if (ret < 0) {
                 throw std::runtime_error("Zlib decompression failed: error code " + std::to_string(ret));
             }
@@ -7,9 +7,13 @@ namespace compression {
 
 class ZlibCompressor : public Compressor {
 public:
+    explicit ZlibCompressor(int level, const CompressorSettings& settings = {}) : level(level), settings(settings) {}
+
     void compressStream(std::istream& input, std::ostream& output) const override;
     size_t decompressStream(std::istream& input, std::ostream& output) const override;
 private:
+    const int level;                    // Compression level used when compressing
+    const CompressorSettings settings;  // Preset dictionary; deflate only uses its last 32KB
     static constexpr size_t BUFFER_SIZE = 65536; // 64KB buffer size
 };
 
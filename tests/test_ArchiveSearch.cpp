@@ -0,0 +1,303 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ArchiveSearch.h"
+#include "CompressionOptions.h"
+#include "CompressorFactory.h"
+#include "FileCompressor.h"
+
+namespace search {
+
+class ArchiveSearchTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tempDir = std::filesystem::temp_directory_path() / "archivesearch_test";
+        std::filesystem::remove_all(tempDir);
+        std::filesystem::create_directories(tempDir / "input");
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(tempDir);
+    }
+
+    // Writes the files and compresses them into archive.bin
+    std::string createArchive(const std::unordered_map<std::string, std::string>& files,
+                              const compression::CompressionOptions& options) {
+        for (const auto& [path, content] : files) {
+            std::filesystem::path filePath = tempDir / "input" / path;
+            std::filesystem::create_directories(filePath.parent_path());
+            std::ofstream file(filePath, std::ios::binary);
+            file << content;
+        }
+        std::string archive = (tempDir / "archive.bin").string();
+        compression::FileCompressor::compress((tempDir / "input").string(), archive, options);
+        return archive;
+    }
+
+    std::filesystem::path tempDir;
+};
+
+// Feeds text to a matching buffer in pieces of pieceSize bytes and returns the matching line numbers
+std::vector<uint64_t> matchLines(const std::string& text, const SearchOptions& options, size_t pieceSize) {
+    LineMatcher matcher(options);
+    std::vector<uint64_t> lineNumbers;
+    MatchingBuffer matching(matcher, [&](uint64_t lineNumber, std::string_view) {
+        lineNumbers.push_back(lineNumber);
+        return true;
+    });
+    std::ostream output(&matching);
+    for (size_t i = 0; i < text.size(); i += pieceSize) {
+        output.write(text.data() + i, std::min(pieceSize, text.size() - i));
+    }
+    matching.finish();
+    return lineNumbers;
+}
+
+// Test literal, case-insensitive and regex matching over lines split across writes
+TEST(LineMatcherTest, MatchesLinesAcrossWrites) {
+    std::string text = "INFO start\nERROR disk full\nwarn: Error retried\n\nERROR again";
+    SearchOptions options;
+    options.pattern = "ERROR";
+    EXPECT_EQ(matchLines(text, options, text.size()), (std::vector<uint64_t>{2, 5}));
+    EXPECT_EQ(matchLines(text, options, 1), (std::vector<uint64_t>{2, 5}));
+    options.ignoreCase = true;
+    EXPECT_EQ(matchLines(text, options, 3), (std::vector<uint64_t>{2, 3, 5}));
+    options.pattern = "^(info|warn)";
+    options.regex = true;
+    EXPECT_EQ(matchLines(text, options, 7), (std::vector<uint64_t>{1, 3}));
+
+    options.pattern = "(unclosed";
+    EXPECT_THROW(LineMatcher{options}, std::regex_error);
+    options.pattern.clear();
+    EXPECT_THROW(LineMatcher{options}, std::invalid_argument);
+}
+
+// Test that search finds lines in standalone, solid and duplicate entries with their line numbers
+TEST_F(ArchiveSearchTest, FindsLinesInAllEntryKinds) {
+    std::string big;
+    for (int i = 1; i <= 20000; i++) {
+        big += "[2105-05-13 03:49:27.000] INFO [Batch] - Job " + std::to_string(i) + " finished\n";
+    }
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/big.log", big},
+        {"host01/small.log", "boot\nJob 17 failed\n"},
+        {"host02/small.log", "idle\nJob 17 failed\n"},
+        {"host02/copy.log", "boot\nJob 17 failed\n"},  // Duplicate of host01/small.log
+        {"host02/other.log", "nothing here"},
+    };
+    compression::CompressionOptions options;
+    options.compType = compression::availableCompressionTypes().front();
+    options.solidBlockSize = 1 << 10;
+    options.templateColumns = true;
+    std::string archive = createArchive(files, options);
+
+    SearchOptions search;
+    search.pattern = "Job 17 ";
+    auto matches = searchArchive(archive, search);
+    std::unordered_map<std::string, uint64_t> found;
+    for (const auto& match : matches) {
+        found[match.relativePath] = match.lineNumber;
+        EXPECT_NE(match.line.find("Job 17 "), std::string::npos);
+        EXPECT_EQ(match.line.find('\n'), std::string::npos);
+    }
+    EXPECT_EQ(matches.size(), 4u);
+    EXPECT_EQ(found["host01/big.log"], 17u);
+    EXPECT_EQ(found["host01/small.log"], 2u);
+    EXPECT_EQ(found["host02/small.log"], 2u);
+    EXPECT_EQ(found["host02/copy.log"], 2u);
+
+    search.pattern = "Job 1999[0-9] finished$";
+    search.regex = true;
+    search.relativePaths = {"host01/big.log"};
+    matches = searchArchive(archive, search);
+    ASSERT_EQ(matches.size(), 10u);
+    for (size_t i = 0; i < matches.size(); i++) {
+        EXPECT_EQ(matches[i].lineNumber, 19990 + i);  // Ordered by line
+    }
+
+    search.relativePaths = {"host01/missing.log"};
+    EXPECT_THROW(searchArchive(archive, search), std::runtime_error);
+}
+
+// Test that UTF-16 files are matched in their UTF-8 form, whether transcoded or packed in a solid block
+TEST_F(ArchiveSearchTest, MatchesUtf16Text) {
+    auto utf16 = [](const std::string& text) {
+        std::string result = "\xFF\xFE";
+        for (char c : text) {
+            result += std::string{c, '\0'};
+        }
+        return result;
+    };
+    std::string log;
+    for (int i = 0; i < 3000; i++) {
+        log += "INFO [Service] request " + std::to_string(i) + " served\r\n";
+    }
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/windows.log", utf16(log)},
+        {"host01/small.log", utf16("boot\r\nrequest 2999 served\r\n")},
+    };
+    compression::CompressionOptions options;
+    options.compType = compression::availableCompressionTypes().front();
+    options.solidBlockSize = 1 << 10;
+    options.gramFilters = true;  // Built from the UTF-8 text too
+    std::string archive = createArchive(files, options);
+
+    SearchOptions search;
+    search.pattern = "request 2999 served";
+    auto matches = searchArchive(archive, search);
+    ASSERT_EQ(matches.size(), 2u);
+    std::unordered_map<std::string, std::string> lines;
+    for (const auto& match : matches) {
+        lines[match.relativePath] = match.line;
+    }
+    EXPECT_EQ(lines["host01/small.log"], "request 2999 served\r");  // Solid, detected when searched
+    EXPECT_EQ(lines["host01/windows.log"], "INFO [Service] request 2999 served\r");  // Transcoded when compressed
+}
+
+// Test that n-gram filters let a search for a rare id skip the files that cannot hold it
+TEST_F(ArchiveSearchTest, SkipsFilesByGramFilter) {
+    std::unordered_map<std::string, std::string> files;
+    for (int f = 0; f < 12; f++) {
+        std::string content;
+        for (int i = 0; i < 2000; i++) {
+            content += "INFO request req-" + std::to_string(f * 100000 + i) + " served\n";
+        }
+        files["host" + std::to_string(f) + "/app.log"] = content;
+    }
+    compression::CompressionOptions options;
+    options.compType = compression::availableCompressionTypes().front();
+    options.solidBlockSize = 1 << 20;
+    options.gramFilters = true;
+    std::string archive = createArchive(files, options);
+
+    SearchOptions search;
+    search.pattern = "req-700123 ";
+    SearchStats stats;
+    auto matches = searchArchive(archive, search, &stats);
+    ASSERT_EQ(matches.size(), 1u);
+    EXPECT_EQ(matches[0].relativePath, "host7/app.log");
+    EXPECT_EQ(matches[0].lineNumber, 124u);
+    EXPECT_LE(stats.searched, 2u);
+    EXPECT_EQ(stats.searched + stats.skipped, 12u);
+
+    search.pattern = "REQ-700123 ";
+    search.ignoreCase = true;
+    EXPECT_EQ(searchArchive(archive, search).size(), 1u);
+
+    search.pattern = "req-700123 ";
+    search.regex = true;  // Regexes are never ruled out
+    EXPECT_EQ(searchArchive(archive, search, &stats).size(), 1u);
+    EXPECT_EQ(stats.searched, 12u);
+}
+
+// Test that a time-bounded search reports only lines timed inside the window and skips files outside it
+TEST_F(ArchiveSearchTest, LimitsMatchesToTimeWindow) {
+    auto hourLog = [](int hour) {
+        std::string log = "ERROR before any timestamp\n";
+        for (int minute = 0; minute < 60; minute++) {
+            std::string mm = (minute < 10 ? "0" : "") + std::to_string(minute);
+            log += "[2105-05-13 0" + std::to_string(hour) + ":" + mm + ":00.000] ERROR tick " + mm + "\n";
+            log += "  ERROR detail " + mm + "\n";
+        }
+        return log;
+    };
+    std::unordered_map<std::string, std::string> files;
+    for (int hour = 1; hour <= 6; hour++) {
+        files["host01/app.log." + std::to_string(hour)] = hourLog(hour);
+    }
+    compression::CompressionOptions options;
+    options.compType = compression::availableCompressionTypes().front();
+    options.timeIndex = true;
+    std::string archive = createArchive(files, options);
+
+    SearchOptions search;
+    search.pattern = "ERROR";
+    search.window.since = timestamps::parseTimeBound("2105-05-13 03:10", false);
+    search.window.until = timestamps::parseTimeBound("2105-05-13 03:14", true);
+    SearchStats stats;
+    auto matches = searchArchive(archive, search, &stats);
+    EXPECT_EQ(stats.searched, 1u);
+    EXPECT_EQ(stats.skipped, 5u);
+    ASSERT_EQ(matches.size(), 10u);  // Five timed lines and the detail lines after them
+    for (const auto& match : matches) {
+        EXPECT_EQ(match.relativePath, "host01/app.log.3");
+    }
+    EXPECT_EQ(matches.front().line, "[2105-05-13 03:10:00.000] ERROR tick 10");
+    EXPECT_EQ(matches.back().line, "  ERROR detail 14");
+}
+
+// Test that the match limit stops the search early
+TEST_F(ArchiveSearchTest, StopsAtMatchLimit) {
+    std::unordered_map<std::string, std::string> files;
+    for (int f = 0; f < 8; f++) {
+        std::string content;
+        for (int i = 0; i < 5000; i++) {
+            content += "ERROR request " + std::to_string(f * 5000 + i) + " timed out\n";
+        }
+        files["host01/app" + std::to_string(f) + ".log"] = content;
+    }
+    compression::CompressionOptions options;
+    options.compType = compression::availableCompressionTypes().front();
+    std::string archive = createArchive(files, options);
+
+    SearchOptions search;
+    search.pattern = "error";
+    search.ignoreCase = true;
+    search.maxMatches = 25;
+    EXPECT_EQ(searchArchive(archive, search).size(), 25u);
+    search.maxMatches = 0;
+    EXPECT_EQ(searchArchive(archive, search).size(), 40000u);
+}
+
+// Test that matches reach the sink file by file in archive order, each file's ordered by line
+TEST_F(ArchiveSearchTest, ReportsMatchesInArchiveOrder) {
+    std::unordered_map<std::string, std::string> files;
+    for (int f = 0; f < 8; f++) {
+        std::string content;
+        for (int i = 0; i < 5000; i++) {
+            content += "ERROR request " + std::to_string(f * 5000 + i) + " timed out\n";
+        }
+        files["host01/app" + std::to_string(f) + ".log"] = content;
+    }
+    files["host02/app0.log"] = files["host01/app0.log"];  // Duplicate, reported right after its original
+    compression::CompressionOptions options;
+    options.compType = compression::availableCompressionTypes().front();
+    std::string archive = createArchive(files, options);
+
+    SearchOptions search;
+    search.pattern = "timed out";
+    std::vector<std::string> paths;  // In the order reported
+    uint64_t lines = 0;
+    uint64_t lastLine = 0;
+    SearchStats stats = searchArchive(archive, search, [&](const SearchMatch& match) {
+        if (paths.empty() || paths.back() != match.relativePath) {
+            paths.push_back(match.relativePath);
+            lastLine = 0;
+        }
+        EXPECT_GT(match.lineNumber, lastLine);
+        lastLine = match.lineNumber;
+        lines++;
+    });
+    EXPECT_EQ(lines, 45000u);
+    EXPECT_EQ(stats.searched, 8u);
+    ASSERT_EQ(paths.size(), 9u);  // Every file's matches together
+    EXPECT_EQ(std::set<std::string>(paths.begin(), paths.end()).size(), 9u);
+    auto original = std::find(paths.begin(), paths.end(), "host01/app0.log");
+    ASSERT_NE(original + 1, paths.end());
+    EXPECT_EQ(original[1], "host02/app0.log");
+    EXPECT_EQ(searchArchive(archive, search).size(), 45000u);
+}
+
+}  // namespace search
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
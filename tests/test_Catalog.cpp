@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Catalog.h"
+#include "CompressionOptions.h"
+#include "CompressorFactory.h"
+#include "FileCompressor.h"
+
+namespace catalog {
+
+class CatalogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tempDir = std::filesystem::temp_directory_path() / "catalog_test";
+        std::filesystem::remove_all(tempDir);
+        std::filesystem::create_directories(tempDir / "archives");
+        catalogFile = (tempDir / "fleet.catalog").string();
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(tempDir);
+    }
+
+    // Compresses an hour of logs from the given hosts into archives/<name>
+    std::string createArchive(const std::string& name, int hour, const std::vector<std::string>& hosts) {
+        std::filesystem::path input = tempDir / ("input-" + name);
+        std::filesystem::remove_all(input);
+        for (const auto& host : hosts) {
+            std::filesystem::create_directories(input / host);
+            std::ofstream file(input / host / "app.log", std::ios::binary);
+            for (int minute = 0; minute < 60; minute++) {
+                file << "[2105-05-13 0" << hour << ":" << (minute < 10 ? "0" : "") << minute << ":00.000] "
+                     << host << " tick\n";
+            }
+            std::ofstream shared(input / host / "motd.txt", std::ios::binary);
+            shared << "same on every host\n";  // Duplicates within an archive
+        }
+        compression::CompressionOptions options;
+        options.compType = compression::availableCompressionTypes().front();
+        options.timeIndex = true;
+        std::string archive = (tempDir / "archives" / name).string();
+        compression::FileCompressor::compress(input.string(), archive, options);
+        return std::filesystem::absolute(archive).lexically_normal().string();
+    }
+
+    std::filesystem::path tempDir;
+    std::string catalogFile;
+};
+
+// Test that paths, hashes and time windows are found across archives, duplicates included
+TEST_F(CatalogTest, LocatesFilesAcrossArchives) {
+    std::string first = createArchive("hour1", 1, {"host01", "host02"});
+    std::string second = createArchive("hour2", 2, {"host02", "host03"});
+    std::ofstream((tempDir / "archives" / "notes.txt").string()) << "not an archive";
+
+    UpdateStats stats = updateCatalog(catalogFile, {(tempDir / "archives").string()});
+    EXPECT_EQ(stats.added, 2u);
+    EXPECT_EQ(stats.skipped, 1u);
+
+    CatalogReader reader(catalogFile);
+    EXPECT_EQ(reader.archives().size(), 2u);
+    EXPECT_EQ(reader.fileCount(), 8u);
+
+    LocateQuery query;
+    query.path = "host02/app.log";
+    auto found = reader.locate(query);
+    ASSERT_EQ(found.size(), 2u);
+    EXPECT_EQ(found[0].archive, first);
+    EXPECT_EQ(found[1].archive, second);
+    EXPECT_TRUE(found[0].hasTimeRange());
+
+    query.path = "host02/";
+    EXPECT_EQ(reader.locate(query).size(), 4u);
+    query.path = "host0";  // Not a directory, so not a prefix
+    EXPECT_TRUE(reader.locate(query).empty());
+
+    query.path.clear();
+    query.hash = found[1].hash;
+    found = reader.locate(query);
+    ASSERT_EQ(found.size(), 1u);
+    EXPECT_EQ(found[0].relativePath, "host02/app.log");
+
+    query.path = "host03/motd.txt";  // A duplicate, located by the hash of its original
+    query.hash.clear();
+    std::string motdHash = reader.locate(query).at(0).hash;
+    EXPECT_FALSE(motdHash.empty());
+    query.path.clear();
+    query.hash = motdHash;
+    EXPECT_EQ(reader.locate(query).size(), 4u);
+
+    query.hash.clear();
+    query.window.since = timestamps::parseTimeBound("2105-05-13 02:30", false);
+    found = reader.locate(query);
+    ASSERT_EQ(found.size(), 6u);  // Text files without timestamps may hold any time
+    for (const auto& location : found) {
+        EXPECT_TRUE(location.archive == second || !location.hasTimeRange()) << location.relativePath;
+    }
+}
+
+// Test that updates index only new or changed archives and drop deleted ones
+TEST_F(CatalogTest, UpdatesIncrementally) {
+    std::string first = createArchive("hour1", 1, {"host01"});
+    EXPECT_EQ(updateCatalog(catalogFile, {first}).added, 1u);
+
+    compression::CompressionOptions options;  // Compression registers archives itself
+    options.compType = compression::availableCompressionTypes().front();
+    options.catalogFile = catalogFile;
+    compression::FileCompressor::compress((tempDir / "input-hour1").string(), (tempDir / "archives" / "copy").string(),
+                                          options);
+
+    UpdateStats stats = updateCatalog(catalogFile, {(tempDir / "archives").string()});
+    EXPECT_EQ(stats.added, 0u);
+    EXPECT_EQ(stats.unchanged, 2u);
+
+    std::filesystem::remove(tempDir / "archives" / "copy");
+    createArchive("hour1", 3, {"host01", "host04"});  // Rewritten in place
+    stats = updateCatalog(catalogFile, {first});
+    EXPECT_EQ(stats.refreshed, 1u);
+    EXPECT_EQ(stats.removed, 1u);
+
+    CatalogReader reader(catalogFile);
+    ASSERT_EQ(reader.archives().size(), 1u);
+    LocateQuery query;
+    query.path = "host04/app.log";
+    EXPECT_EQ(reader.locate(query).size(), 1u);
+
+    EXPECT_THROW(updateCatalog(catalogFile, {(tempDir / "input-hour1" / "host01" / "app.log").string()}),
+                 std::runtime_error);
+    std::ofstream(catalogFile, std::ios::binary) << "garbage";
+    EXPECT_THROW(CatalogReader{catalogFile}, std::runtime_error);
+}
+
+// Test that updates running at the same time each keep the archives of the others
+TEST_F(CatalogTest, ConcurrentUpdatesKeepEveryArchive) {
+    std::vector<std::string> archives;
+    for (int hour = 0; hour < 8; hour++) {
+        archives.push_back(createArchive("hour" + std::to_string(hour), hour, {"host0" + std::to_string(hour)}));
+    }
+    std::vector<std::thread> updates;
+    for (const auto& archive : archives) {
+        updates.emplace_back([this, archive] { updateCatalog(catalogFile, {archive}); });
+    }
+    for (auto& update : updates) {
+        update.join();
+    }
+
+    CatalogReader reader(catalogFile);
+    EXPECT_EQ(reader.archives().size(), archives.size());
+    EXPECT_EQ(reader.fileCount(), 2 * archives.size());
+}
+
+}  // namespace catalog
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
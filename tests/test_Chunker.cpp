@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Chunker.h"
+
+namespace chunking {
+
+// Random bytes from a fixed seed
+std::string randomData(size_t size, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::string data(size, '\0');
+    for (auto& c : data) {
+        c = static_cast<char>(distribution(generator));
+    }
+    return data;
+}
+
+// Splits data and returns the chunks
+std::vector<std::string> split(const std::string& data, const ChunkParams& params) {
+    std::vector<std::string> chunks;
+    std::istringstream input(data);
+    splitStream(input, params, [&](const char* chunk, size_t size) { chunks.emplace_back(chunk, size); });
+    return chunks;
+}
+
+// Test that chunks cover the input exactly and stay within the configured bounds
+TEST(ChunkerTest, ChunksRespectBounds) {
+    ChunkParams params = ChunkParams::forAverage(4096);
+    std::string data = randomData(3 << 20, 1);
+    auto chunks = split(data, params);
+
+    std::string joined;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (i + 1 < chunks.size()) {
+            EXPECT_GE(chunks[i].size(), params.minSize);
+        }
+        EXPECT_LE(chunks[i].size(), params.maxSize);
+        joined += chunks[i];
+    }
+    EXPECT_EQ(joined, data);
+
+    // Normalized chunking keeps the mean near the configured average
+    double mean = static_cast<double>(data.size()) / chunks.size();
+    EXPECT_GT(mean, params.avgSize / 2.0);
+    EXPECT_LT(mean, params.avgSize * 2.0);
+}
+
+// Test that an insertion only changes the chunks around it, unlike fixed-size blocks
+TEST(ChunkerTest, BoundariesResynchronizeAfterInsertion) {
+    ChunkParams params = ChunkParams::forAverage(4096);
+    std::string original = randomData(1 << 20, 2);
+    std::string edited = original;
+    edited.insert(300000, "inserted line\n");
+
+    auto originalChunks = split(original, params);
+    std::set<std::string> editedChunks;
+    for (const auto& chunk : split(edited, params)) {
+        editedChunks.insert(chunk);
+    }
+    size_t shared = 0;
+    for (const auto& chunk : originalChunks) {
+        shared += editedChunks.count(chunk);
+    }
+    EXPECT_GE(shared + 3, originalChunks.size());
+}
+
+// Test that chunk lists survive a write and read
+TEST(ChunkerTest, RecipeRoundTrip) {
+    std::vector<ChunkRef> chunks = {{100, 0, 4096}, {100, 4096, 1200}, {9000, 17, 65536}};
+    std::stringstream stream;
+    writeRecipe(stream, chunks);
+    auto read = readRecipe(stream);
+    ASSERT_EQ(read.size(), chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        EXPECT_EQ(read[i].dataOffset, chunks[i].dataOffset);
+        EXPECT_EQ(read[i].blockOffset, chunks[i].blockOffset);
+        EXPECT_EQ(read[i].length, chunks[i].length);
+    }
+}
+
+// Test that only files sharing enough of their bytes with other chunked files are selected
+TEST(ChunkerTest, SelectsOnlySharingFiles) {
+    std::vector<FileChunks> files = {
+        {{"a", 100}, {"b", 100}},   // Half shared with the next file
+        {{"a", 100}, {"c", 300}},   // A quarter shared
+        {{"d", 100}},               // Shares nothing
+        {{"e", 100}},               // Shares all with a file that is dropped, so is dropped in turn
+        {{"e", 100}, {"f", 900}},   // A tenth shared
+    };
+    EXPECT_EQ(selectSharingFiles(files), (std::vector<size_t>{0, 1}));
+    EXPECT_TRUE(selectSharingFiles({{{"a", 100}}}).empty());
+}
+
+}  // namespace chunking
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CodecSelector.h"
+#include "CompressorFactory.h"
+
+namespace compression {
+
+// Test that rotated and per-host files land in the same family
+TEST(CodecSelectorTest, FamilyKeyMasksDigits) {
+    EXPECT_EQ(CodecSelector::familyKey("host01/app.log.1", 5000), CodecSelector::familyKey("host02/app.log.17", 7000));
+    EXPECT_NE(CodecSelector::familyKey("host01/app.log", 5000), CodecSelector::familyKey("host01/db.log", 5000));
+}
+
+// Test that tiny files and huge files are evaluated separately
+TEST(CodecSelectorTest, FamilyKeySeparatesSizeClasses) {
+    EXPECT_NE(CodecSelector::familyKey("dumps/core.bin", 512), CodecSelector::familyKey("dumps/core.bin", 512000000));
+}
+
+// Test that random data is not worth compressing
+TEST(CodecSelectorTest, RandomSampleSelectsStore) {
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::vector<char> sample(64 * 1024);
+    for (auto& c : sample) {
+        c = static_cast<char>(distribution(generator));
+    }
+
+    CodecSelector selector(0.0);
+    EXPECT_EQ(selector.evaluate(sample).type, CompressionType::NONE);
+}
+
+// Test that text picks a real codec with a valid level when any speed is acceptable
+TEST(CodecSelectorTest, TextSampleSelectsAvailableCodec) {
+    std::string text;
+    for (int i = 0; i < 1000; i++) {
+        text += "[2105-05-13 03:49:27.000] WARNING [TimeSync] [FOLD] - Time variance " + std::to_string(i) + " detected\n";
+    }
+    std::vector<char> sample(text.begin(), text.end());
+
+    CodecSelector selector(0.0);
+    CodecChoice choice = selector.evaluate(sample);
+    EXPECT_NE(choice.type, CompressionType::NONE);
+    EXPECT_TRUE(isCompressionTypeAvailable(choice.type));
+    auto [minLevel, maxLevel] = compressionLevelRange(choice.type);
+    EXPECT_GE(choice.level, minLevel);
+    EXPECT_LE(choice.level, maxLevel);
+}
+
+}  // namespace compression
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
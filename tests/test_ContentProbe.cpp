@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ContentProbe.h"
+
+class ContentProbeTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tempDir = std::filesystem::temp_directory_path() / "contentprobe_test";
+        std::filesystem::create_directories(tempDir);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(tempDir);
+    }
+
+    std::filesystem::path writeFile(const std::string& name, const std::vector<uint8_t>& data) {
+        std::filesystem::path path = tempDir / name;
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        return path;
+    }
+
+    static std::vector<uint8_t> randomBytes(size_t size) {
+        std::mt19937 generator(42);  // Fixed seed for reproducible tests
+        std::uniform_int_distribution<int> distribution(0, 255);
+        std::vector<uint8_t> data(size);
+        for (auto& byte : data) {
+            byte = static_cast<uint8_t>(distribution(generator));
+        }
+        return data;
+    }
+
+    static std::vector<uint8_t> logText(size_t lines) {
+        std::string text;
+        for (size_t i = 0; i < lines; i++) {
+            text += "[2105-05-13 03:49:27.000] INFO [Database] [READ] - Request " + std::to_string(i) + " processed\n";
+        }
+        return std::vector<uint8_t>(text.begin(), text.end());
+    }
+
+    std::filesystem::path tempDir;
+};
+
+// Test detection of common compressed container signatures
+TEST_F(ContentProbeTest, DetectsKnownFormats) {
+    const std::vector<uint8_t> gzip = {0x1F, 0x8B, 0x08, 0x00};
+    const std::vector<uint8_t> zstd = {0x28, 0xB5, 0x2F, 0xFD, 0x00};
+    const std::vector<uint8_t> bzip2 = {'B', 'Z', 'h', '9'};
+    const std::vector<uint8_t> xz = {0xFD, '7', 'z', 'X', 'Z', 0x00, 0x00};
+
+    EXPECT_EQ(probe::detectFormat(gzip.data(), gzip.size()), probe::KnownFormat::GZIP);
+    EXPECT_EQ(probe::detectFormat(zstd.data(), zstd.size()), probe::KnownFormat::ZSTD);
+    EXPECT_EQ(probe::detectFormat(bzip2.data(), bzip2.size()), probe::KnownFormat::BZIP2);
+    EXPECT_EQ(probe::detectFormat(xz.data(), xz.size()), probe::KnownFormat::XZ);
+}
+
+// Test that plain text and truncated signatures are not mistaken for containers
+TEST_F(ContentProbeTest, PlainTextIsUnknownFormat) {
+    auto text = logText(1);
+    EXPECT_EQ(probe::detectFormat(text.data(), text.size()), probe::KnownFormat::UNKNOWN);
+
+    const std::vector<uint8_t> truncated = {0x28, 0xB5};
+    EXPECT_EQ(probe::detectFormat(truncated.data(), truncated.size()), probe::KnownFormat::UNKNOWN);
+    EXPECT_EQ(probe::detectFormat(nullptr, 0), probe::KnownFormat::UNKNOWN);
+}
+
+// Test entropy estimates at both ends of the scale
+TEST_F(ContentProbeTest, EntropyEstimate) {
+    std::vector<uint8_t> constant(4096, 'a');
+    EXPECT_DOUBLE_EQ(probe::estimateEntropy(constant.data(), constant.size()), 0.0);
+
+    auto random = randomBytes(probe::SAMPLE_SIZE);
+    EXPECT_GT(probe::estimateEntropy(random.data(), random.size()), probe::ENTROPY_THRESHOLD);
+
+    auto text = logText(200);
+    EXPECT_LT(probe::estimateEntropy(text.data(), text.size()), probe::ENTROPY_THRESHOLD);
+}
+
+// Test the file level check used by the compressor
+TEST_F(ContentProbeTest, IncompressibleFileDetection) {
+    auto randomPath = writeFile("random.bin", randomBytes(probe::SAMPLE_SIZE * 2));
+    auto textPath = writeFile("app.log", logText(500));
+
+    std::vector<uint8_t> gzipHeader = {0x1F, 0x8B, 0x08, 0x00, 'x', 'y'};
+    auto gzipPath = writeFile("app.log.1.gz", gzipHeader);
+
+    EXPECT_TRUE(probe::isIncompressibleFile(randomPath.string()));
+    EXPECT_TRUE(probe::isIncompressibleFile(gzipPath.string()));
+    EXPECT_FALSE(probe::isIncompressibleFile(textPath.string()));
+}
+
+// Test that log text is told apart from binary and UTF-16 data
+TEST_F(ContentProbeTest, TextDetection) {
+    auto text = logText(100);
+    EXPECT_TRUE(probe::isText(text.data(), text.size()));
+
+    std::vector<uint8_t> utf16 = {0xFF, 0xFE, 'l', 0x00, 'o', 0x00, 'g', 0x00, '\n', 0x00};
+    EXPECT_FALSE(probe::isText(utf16.data(), utf16.size()));
+
+    auto random = randomBytes(4096);
+    EXPECT_FALSE(probe::isText(random.data(), random.size()));
+
+    auto textPath = writeFile("app.log", text);
+    auto profile = probe::probeFile(textPath.string());
+    EXPECT_TRUE(profile.text);
+    EXPECT_FALSE(profile.incompressible);
+}
+
+// Test error handling when probing a non-existent file
+TEST_F(ContentProbeTest, NonExistentFileError) {
+    EXPECT_THROW(probe::isIncompressibleFile((tempDir / "missing.log").string()), std::runtime_error);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
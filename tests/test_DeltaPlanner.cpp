@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "DeltaPlanner.h"
+
+namespace compression {
+
+class DeltaPlannerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tempDir = std::filesystem::temp_directory_path() / "deltaplanner_test";
+        std::filesystem::create_directories(tempDir);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(tempDir);
+    }
+
+    std::pair<std::filesystem::path, std::string> createFile(const std::string& name, const std::string& content) {
+        std::ofstream file(tempDir / name, std::ios::binary);
+        file << content;
+        return {tempDir / name, name};
+    }
+
+    // Log lines from a fixed seed, so different seeds share no content
+    std::string logLines(size_t count, unsigned seed) {
+        std::mt19937 generator(seed);
+        std::string content;
+        for (size_t i = 0; i < count; i++) {
+            content += "INFO [Worker] - Request " + std::to_string(generator()) + " served\n";
+        }
+        return content;
+    }
+
+    std::filesystem::path tempDir;
+};
+
+// Test that numeric suffixes are split off as the generation
+TEST_F(DeltaPlannerTest, RotationFamilyParsesGenerations) {
+    EXPECT_EQ(rotationFamily("var/app.log.12"), std::make_pair(std::string("var/app.log"), 12u));
+    EXPECT_EQ(rotationFamily("var/app.log"), std::make_pair(std::string("var/app.log"), 0u));
+    EXPECT_EQ(rotationFamily("v1.2/app"), std::make_pair(std::string("v1.2/app"), 0u));
+}
+
+// Test that overlapping rotations are chained against their newer neighbour up to the depth limit
+TEST_F(DeltaPlannerTest, ChainsOverlappingRotations) {
+    std::string content = logLines(20000, 1);
+    std::vector<std::pair<std::filesystem::path, std::string>> files;
+    for (int generation = 0; generation < 5; generation++) {
+        std::string name = generation == 0 ? "app.log" : "app.log." + std::to_string(generation);
+        files.push_back(createFile(name, content.substr(0, content.size() - generation * 20000)));
+    }
+
+    auto references = planDeltaChains(files, 2);
+    EXPECT_EQ(references.count("app.log"), 0);  // The live log stays a plain stream
+    EXPECT_EQ(references["app.log.1"], "app.log");
+    EXPECT_EQ(references["app.log.2"], "app.log.1");
+    EXPECT_EQ(references.count("app.log.3"), 0);  // Depth limit reached, starts a new chain
+    EXPECT_EQ(references["app.log.4"], "app.log.3");
+}
+
+// Test that rotations without shared content are left alone
+TEST_F(DeltaPlannerTest, SkipsUnrelatedContent) {
+    std::vector<std::pair<std::filesystem::path, std::string>> files = {
+        createFile("app.log", logLines(5000, 1)),
+        createFile("app.log.1", logLines(5000, 2)),
+    };
+    EXPECT_LT(contentOverlap(files[1].first, files[0].first), MIN_DELTA_OVERLAP);
+    EXPECT_TRUE(planDeltaChains(files, DEFAULT_DELTA_DEPTH).empty());
+}
+
+}  // End of compression namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,15 +1,21 @@
 #include <gtest/gtest.h>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <random>
+#include <sstream>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "Chunker.h"
+#include "CompressionOptions.h"
 #include "CompressorFactory.h"
 #include "FileCompressor.h"
 #include "FileMeta.h"
 #include "HashUtils.h"
 #include "IO.h"
+#include "LineStore.h"
 #include "ThreadPool.h"
 
 namespace compression {
@@ -187,18 +193,63 @@ TEST_P(FileCompressorParameterizedTest, EmptyFileHandling) {
     EXPECT_FALSE(std::filesystem::exists(outputDir / emptyFileName));
 }
 
+TEST_P(FileCompressorParameterizedTest, IncompressibleFilesAreStored) {
+    // Random bytes and a gzip signature should both be routed to store mode
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::string randomContent(128 * 1024, '\0');
+    for (auto& c : randomContent) {
+        c = static_cast<char>(distribution(generator));
+    }
+    std::string gzipContent = std::string("\x1f\x8b\x08\x00", 4) + "already compressed";
+    {
+        std::ofstream randomFile(tempDir / "random.bin", std::ios::binary);
+        randomFile.write(randomContent.data(), randomContent.size());
+        std::ofstream gzipFile(tempDir / "rotated.log.1.gz", std::ios::binary);
+        gzipFile.write(gzipContent.data(), gzipContent.size());
+    }
+
+    FileCompressor::compress(tempDir.string(), (tempDir / "archive.bin").string(), GetCompressionType());
+
+    std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+    CompressionType archiveType;
+    auto metadata = io::readMetadata(archive, archiveType);
+    for (const auto& meta : metadata) {
+        if (meta.isDuplicate()) {
+            continue;
+        }
+        bool incompressible = meta.relativePath == "random.bin" || meta.relativePath == "rotated.log.1.gz";
+        EXPECT_EQ(meta.codec, incompressible ? CompressionType::NONE : GetCompressionType()) << meta.relativePath;
+    }
+
+    // Stored files must still round-trip byte for byte
+    std::filesystem::path outputDir = tempDir / "output";
+    FileCompressor::decompress((tempDir / "archive.bin").string(), outputDir.string());
+
+    std::ifstream randomOut(outputDir / "random.bin", std::ios::binary);
+    std::string randomRestored((std::istreambuf_iterator<char>(randomOut)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(randomRestored, randomContent);
+
+    std::ifstream gzipOut(outputDir / "rotated.log.1.gz", std::ios::binary);
+    std::string gzipRestored((std::istreambuf_iterator<char>(gzipOut)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(gzipRestored, gzipContent);
+}
+
+// Builds one parameter set per test set for every codec compiled into this build
+std::vector<FileCompressorParameterizedTest::ParamType> availableTestParams() {
+    std::vector<FileCompressorParameterizedTest::ParamType> params;
+    for (auto type : availableCompressionTypes()) {
+        params.emplace_back(type, baseTestSet);
+        params.emplace_back(type, extendedTestSet);
+    }
+    return params;
+}
+
 // Instantiate the parameterized tests for each compression type
 INSTANTIATE_TEST_SUITE_P(
     AllCompressionTypes,
     FileCompressorParameterizedTest,
-    ::testing::Values(
-        std::make_tuple(CompressionType::ZLIB, baseTestSet),
-        std::make_tuple(CompressionType::ZLIB, extendedTestSet),
-        std::make_tuple(CompressionType::BROTLI, baseTestSet),
-        std::make_tuple(CompressionType::BROTLI, extendedTestSet),
-        std::make_tuple(CompressionType::ZSTD, baseTestSet),
-        std::make_tuple(CompressionType::ZSTD, extendedTestSet)
-    ),
+    ::testing::ValuesIn(availableTestParams()),
     [](const ::testing::TestParamInfo<FileCompressorParameterizedTest::ParamType>& info) {
         const auto& compression = std::get<0>(info.param);
         const auto& files = std::get<1>(info.param);
@@ -207,6 +258,1003 @@ INSTANTIATE_TEST_SUITE_P(
     }
 );
 
+class AdaptiveCompressionTest : public FileCompressorTest {
+protected:
+    void SetUp() override {
+        tempDir = std::filesystem::temp_directory_path() / "filecompressor_adaptive_test";
+        std::filesystem::create_directories(tempDir / "input");
+    }
+};
+
+TEST_F(AdaptiveCompressionTest, PerFileCodecAndLevelRoundTrip) {
+    std::string logText;
+    for (int i = 0; i < 2000; i++) {
+        logText += "[2105-05-13 03:49:27.000] INFO [Database] [READ] - Request " + std::to_string(i) + " processed\n";
+    }
+    createTestFile("input/service.log", logText);
+    createTestFile("input/small.txt", "tiny");
+
+    CompressionOptions options;
+    options.adaptive = true;
+    options.throughputTarget = 0.0;  // Every candidate qualifies, so the best ratio must win
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+    CompressionType archiveType;
+    auto metadata = io::readMetadata(archive, archiveType);
+    ASSERT_EQ(metadata.size(), 2);
+    for (const auto& meta : metadata) {
+        if (meta.relativePath == "service.log") {
+            EXPECT_NE(meta.codec, CompressionType::NONE);
+            EXPECT_EQ(meta.originalSize, logText.size());
+            auto [minLevel, maxLevel] = compressionLevelRange(meta.codec);
+            EXPECT_GE(meta.level, minLevel);
+            EXPECT_LE(meta.level, maxLevel);
+        }
+    }
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    std::ifstream restored(tempDir / "output" / "service.log");
+    std::string content((std::istreambuf_iterator<char>(restored)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(content, logText);
+}
+
+TEST_F(AdaptiveCompressionTest, ExplicitLevelIsRecorded) {
+    createTestFile("input/app.log", "Error: System failure\nError: System failure\n");
+
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.level = compressionLevelRange(options.compType).first + 1;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+    CompressionType archiveType;
+    auto metadata = io::readMetadata(archive, archiveType);
+    ASSERT_EQ(metadata.size(), 1);
+    EXPECT_EQ(metadata[0].codec, options.compType);
+    EXPECT_EQ(metadata[0].level, options.level);
+}
+
+// Test that codec workers are sized to the thread pool unless set explicitly
+TEST(CodecSettingsTest, WorkersFollowThreadPool) {
+    CompressionOptions options;
+    EXPECT_EQ(FileCompressor::codecSettings(options, 4).workers, 4);
+    EXPECT_EQ(FileCompressor::codecSettings(options, 1).workers, 0);  // No spare cores to hand out
+
+    options.workers = 0;
+    options.longDistance = true;
+    options.windowLog = 30;
+    auto settings = FileCompressor::codecSettings(options, 8);
+    EXPECT_EQ(settings.workers, 0);
+    EXPECT_TRUE(settings.longDistance);
+    EXPECT_EQ(settings.windowLog, 30);
+}
+
+class SolidCompressionTest : public FileCompressorTest {
+protected:
+    void SetUp() override {
+        tempDir = std::filesystem::temp_directory_path() / "filecompressor_solid_test";
+        std::filesystem::create_directories(tempDir / "input" / "host01");
+        std::filesystem::create_directories(tempDir / "input" / "host02");
+    }
+
+    std::string readFile(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+};
+
+// Test that small files share blocks, record their position and extract completely
+TEST_F(SolidCompressionTest, SmallFilesShareBlocks) {
+    std::unordered_map<std::string, std::string> files;
+    for (int i = 0; i < 6; i++) {
+        std::string host = i % 2 == 0 ? "host01" : "host02";
+        files[host + "/app.log." + std::to_string(i)] = "INFO [Worker] - Job " + std::to_string(i) + " finished\n";
+    }
+    files["host02/copy.log"] = files["host01/app.log.0"];  // Duplicate of a solid file
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.solidBlockSize = 64;  // Fits two or three of the small files per block
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+    CompressionType archiveType;
+    auto metadata = io::readMetadata(archive, archiveType);
+    size_t solidFiles = 0;
+    for (const auto& meta : metadata) {
+        if (!meta.isDuplicate() && meta.isSolid()) {
+            solidFiles++;
+            EXPECT_EQ(meta.originalSize, files[meta.relativePath].size());
+        }
+    }
+    EXPECT_GT(solidFiles, 1);
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+}
+
+// Test that single files, including duplicates of solid files, are extracted on their own
+TEST_F(SolidCompressionTest, ExtractSingleFiles) {
+    createTestFile("input/host01/a.log", "first file in the block\n");
+    createTestFile("input/host01/b.log", "second file in the block\n");
+    createTestFile("input/host02/c.log", "third file in the block\n");
+    createTestFile("input/host02/a.log", "first file in the block\n");
+
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.solidBlockSize = DEFAULT_SOLID_BLOCK_SIZE;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    FileCompressor::extract((tempDir / "archive.bin").string(), (tempDir / "output").string(),
+                            {"host01/b.log", "host02/a.log"});
+    EXPECT_EQ(readFile(tempDir / "output" / "host01" / "b.log"), "second file in the block\n");
+    EXPECT_EQ(readFile(tempDir / "output" / "host02" / "a.log"), "first file in the block\n");
+    EXPECT_FALSE(std::filesystem::exists(tempDir / "output" / "host02" / "c.log"));
+
+    EXPECT_THROW(FileCompressor::extract((tempDir / "archive.bin").string(), (tempDir / "output").string(),
+                                         {"missing.log"}), std::runtime_error);
+}
+
+// Content of the i-th file of a family of similar job logs
+std::string jobLog(int i) {
+    std::string content;
+    for (int line = 0; line < 200; line++) {
+        content += "[2105-05-13 03:49:" + std::to_string(10 + line % 50) + ".000] INFO [Scheduler] [RUN] - Job " +
+                   std::to_string(i * 100 + line) + " completed on worker pool\n";
+    }
+    return content;
+}
+
+// First available codec that uses dictionaries, else the first available codec
+CompressionType dictionaryCodec() {
+    for (auto type : availableCompressionTypes()) {
+        if (supportsDictionary(type)) {
+            return type;
+        }
+    }
+    return availableCompressionTypes().front();
+}
+
+// Test that families of small files are compressed against an embedded dictionary and still extract
+TEST_F(SolidCompressionTest, DictionaryFamiliesRoundTrip) {
+    std::unordered_map<std::string, std::string> files;
+    for (int i = 0; i < 12; i++) {
+        files["host01/job.log." + std::to_string(i)] = jobLog(i);
+    }
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+
+    CompressionOptions options;
+    options.compType = dictionaryCodec();
+    options.dictionarySize = 4 << 10;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    {
+        std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+        CompressionType archiveType;
+        std::vector<io::Attribute> sections;
+        auto metadata = io::readMetadata(archive, archiveType, &sections);
+        for (const auto& meta : metadata) {
+            if (supportsDictionary(options.compType)) {
+                EXPECT_NE(meta.dictionaryId, 0) << meta.relativePath;
+            } else {
+                EXPECT_EQ(meta.dictionaryId, 0) << meta.relativePath;
+            }
+        }
+        EXPECT_EQ(sections.size(), supportsDictionary(options.compType) ? 1 : 0);
+    }
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+    FileCompressor::extract((tempDir / "archive.bin").string(), (tempDir / "single").string(), {"host01/job.log.7"});
+    EXPECT_EQ(readFile(tempDir / "single" / "host01" / "job.log.7"), files["host01/job.log.7"]);
+}
+
+// Test that a registry dictionary is referenced rather than embedded and reused by later runs
+TEST_F(SolidCompressionTest, DictionaryRegistryReuse) {
+    if (!supportsDictionary(dictionaryCodec())) {
+        GTEST_SKIP() << "No available codec uses dictionaries";
+    }
+    std::filesystem::create_directories(tempDir / "week");
+    std::filesystem::create_directories(tempDir / "hour");
+    for (int i = 0; i < 12; i++) {
+        createTestFile("week/job.log." + std::to_string(i), jobLog(i));
+    }
+    createTestFile("hour/job.log.100", jobLog(100));  // Too few files to train on their own
+    createTestFile("hour/job.log.101", jobLog(101));
+
+    CompressionOptions options;
+    options.compType = dictionaryCodec();
+    options.dictionarySize = 4 << 10;
+    options.dictionaryRegistry = (tempDir / "registry").string();
+    FileCompressor::compress((tempDir / "week").string(), (tempDir / "week.bin").string(), options);
+    FileCompressor::compress((tempDir / "hour").string(), (tempDir / "hour.bin").string(), options);
+
+    auto readEntries = [&](const std::string& archiveName, std::vector<io::Attribute>& sections) {
+        std::ifstream archive(tempDir / archiveName, std::ios::binary);
+        CompressionType archiveType;
+        return io::readMetadata(archive, archiveType, &sections);
+    };
+    std::vector<io::Attribute> weekSections, hourSections;
+    auto weekEntries = readEntries("week.bin", weekSections);
+    auto hourEntries = readEntries("hour.bin", hourSections);
+    ASSERT_EQ(hourSections.size(), 1);
+    EXPECT_EQ(hourSections[0].first, io::TAG_DICTIONARY_REF);  // Only the id is stored
+    ASSERT_FALSE(hourEntries.empty());
+    EXPECT_EQ(hourEntries[0].dictionaryId, weekEntries[0].dictionaryId);  // Last week's dictionary, no training
+
+    EXPECT_THROW(FileCompressor::decompress((tempDir / "hour.bin").string(), (tempDir / "output").string()),
+                 std::runtime_error);
+    FileCompressor::decompress((tempDir / "hour.bin").string(), (tempDir / "output").string(), options.dictionaryRegistry);
+    EXPECT_EQ(readFile(tempDir / "output" / "job.log.101"), jobLog(101));
+}
+
+// Test that rotations sharing a prefix store the prefix once and extract completely
+TEST_F(SolidCompressionTest, ChunkedRotationsRoundTrip) {
+    std::string log;
+    for (int i = 0; log.size() < (600 << 10); i++) {
+        log += "[2105-05-13 03:49:27.000] INFO [Gateway] [REQ] - Request " + std::to_string(i * 7919 % 100003) + " served\n";
+    }
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/app.log.1", log.substr(0, 200 << 10)},
+        {"host01/app.log.2", log.substr(0, 400 << 10)},
+        {"host01/app.log.3", log},
+        {"host02/app.log.3", log},  // Whole-file duplicate of a chunked file
+    };
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.chunkSize = 4096;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    {
+        std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+        CompressionType archiveType;
+        auto metadata = io::readMetadata(archive, archiveType);
+        size_t chunkedFiles = 0;
+        for (const auto& meta : metadata) {
+            chunkedFiles += meta.isChunked();
+        }
+        EXPECT_EQ(chunkedFiles, 3);
+    }
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+    FileCompressor::extract((tempDir / "archive.bin").string(), (tempDir / "single").string(),
+                            {"host01/app.log.2", "host02/app.log.3"});
+    EXPECT_EQ(readFile(tempDir / "single" / "host01" / "app.log.2"), files["host01/app.log.2"]);
+    EXPECT_EQ(readFile(tempDir / "single" / "host02" / "app.log.3"), log);
+}
+
+// Test that files sharing no chunks keep their other modes and incompressible chunk blocks are stored raw
+TEST_F(SolidCompressionTest, ChunkingLeavesUnsharedFilesToOtherModes) {
+    auto randomData = [](size_t size, unsigned seed) {
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<int> distribution(0, 255);
+        std::string data(size, '\0');
+        for (auto& c : data) {
+            c = static_cast<char>(distribution(generator));
+        }
+        return data;
+    };
+    std::string blob = randomData(300 << 10, 1);
+    std::string log;
+    for (int i = 0; log.size() < (100 << 10); i++) {
+        log += "[2105-05-13 03:49:" + std::to_string(10 + i % 50) + ".000] INFO [Gateway] - Request " +
+               std::to_string(i * 7919 % 100003) + " served\n";
+    }
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/blob.bin.1", blob},
+        {"host01/blob.bin.2", blob + randomData(100 << 10, 2)},  // Grew by a random tail
+        {"host01/other.bin", randomData(200 << 10, 3)},          // Shares nothing
+        {"host01/service.log", log},                              // Shares nothing
+    };
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.chunkSize = 4096;
+    options.timestampColumns = true;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    {
+        std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+        CompressionType archiveType;
+        std::vector<io::Attribute> sections;
+        std::unordered_map<std::string, meta::FileMeta> entries;
+        for (auto& meta : io::readMetadata(archive, archiveType, &sections)) {
+            entries.emplace(meta.relativePath, std::move(meta));
+        }
+        EXPECT_TRUE(entries.at("host01/blob.bin.1").isChunked());
+        EXPECT_TRUE(entries.at("host01/blob.bin.2").isChunked());
+        EXPECT_FALSE(entries.at("host01/other.bin").isChunked());
+        EXPECT_EQ(entries.at("host01/other.bin").codec, CompressionType::NONE);
+        EXPECT_FALSE(entries.at("host01/service.log").isChunked());
+        EXPECT_TRUE(entries.at("host01/service.log").isTimestampEncoded());
+        EXPECT_EQ(chunking::readRawBlockSections(sections).size(), 1);  // The random chunks fit one block
+    }
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+    FileCompressor::extract((tempDir / "archive.bin").string(), (tempDir / "single").string(), {"host01/blob.bin.2"});
+    EXPECT_EQ(readFile(tempDir / "single" / "host01" / "blob.bin.2"), files["host01/blob.bin.2"]);
+}
+
+// Test that clustering packs near-duplicate content into one block even when names sort apart
+TEST_F(SolidCompressionTest, ClusteredFilesShareBlocks) {
+    auto componentLog = [](const std::string& component, int seed) {
+        std::string content;
+        for (int line = 0; line < 100; line++) {
+            content += "[2105-05-13 03:49:" + std::to_string(10 + line % 50) + ".000] INFO [" + component + "] - Task " +
+                       std::to_string(seed * 1000 + line) + (line % 3 == 0 ? " queued\n" : line % 3 == 1 ? " started\n" : " done\n");
+        }
+        return content;
+    };
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/alpha.log", componentLog("Scheduler", 1)},
+        {"host01/bravo.log", componentLog("Database", 2)},
+        {"host01/charlie.log", componentLog("Scheduler", 3)},
+        {"host01/delta.log", componentLog("Database", 4)},
+    };
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.solidBlockSize = files["host01/alpha.log"].size() * 5 / 2;  // Two files per block
+    options.clusterSimilar = true;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    {
+        std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+        CompressionType archiveType;
+        std::unordered_map<std::string, int64_t> blocks;
+        for (const auto& meta : io::readMetadata(archive, archiveType)) {
+            blocks[meta.relativePath] = meta.blockId;
+        }
+        EXPECT_EQ(blocks["host01/alpha.log"], blocks["host01/charlie.log"]);
+        EXPECT_EQ(blocks["host01/bravo.log"], blocks["host01/delta.log"]);
+        EXPECT_NE(blocks["host01/alpha.log"], blocks["host01/bravo.log"]);
+    }
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+}
+
+// Test that lines repeated across files go through the line store and extract completely
+TEST_F(SolidCompressionTest, LineStoreRoundTrip) {
+    std::string trace;
+    for (int frame = 0; frame < 20; frame++) {
+        trace += "    at com.example.service.Handler" + std::to_string(frame) + ".handle(Handler.java:" + std::to_string(frame * 7) + ")\n";
+    }
+    std::unordered_map<std::string, std::string> files;
+    for (int i = 0; i < 4; i++) {
+        std::string content;
+        for (int request = 0; request < 50; request++) {
+            content += "ERROR request " + std::to_string(i * 1000 + request) + " failed\n" + trace;
+        }
+        files["host0" + std::to_string(i % 2 + 1) + "/app" + std::to_string(i) + ".log"] = content + "no newline at the end";
+    }
+    files["host02/copy.log"] = files["host01/app0.log"];  // Duplicate of a line-encoded file
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.lineMemory = 1 << 20;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    {
+        std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+        CompressionType archiveType;
+        std::vector<io::Attribute> sections;
+        size_t lineEncodedFiles = 0;
+        for (const auto& meta : io::readMetadata(archive, archiveType, &sections)) {
+            lineEncodedFiles += meta.isLineEncoded();
+        }
+        EXPECT_EQ(lineEncodedFiles, 4);
+        EXPECT_TRUE(lines::readLineStoreSection(sections).has_value());
+    }
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+    FileCompressor::extract((tempDir / "archive.bin").string(), (tempDir / "single").string(),
+                            {"host02/app1.log", "host02/copy.log"});
+    EXPECT_EQ(readFile(tempDir / "single" / "host02" / "app1.log"), files["host02/app1.log"]);
+    EXPECT_EQ(readFile(tempDir / "single" / "host02" / "copy.log"), files["host01/app0.log"]);
+}
+
+// Test that UTF-16 files are compressed as UTF-8, also through the line store, and restore byte for byte
+TEST_F(SolidCompressionTest, Utf16FilesRoundTrip) {
+    auto utf16 = [](const std::string& text, bool bigEndian) {
+        std::string bytes = bigEndian ? "\xFE\xFF" : "\xFF\xFE";
+        for (char c : text) {
+            bytes += bigEndian ? std::string{'\0', c} : std::string{c, '\0'};
+        }
+        return bytes;
+    };
+    std::string log;
+    for (int i = 0; i < 300; i++) {
+        log += "[2105-05-13 03:49:27.000] INFO [Service] - Request " + std::to_string(i) + " completed\r\n";
+        log += "    at Service.Handler.Process(RequestContext context) in C:\\src\\Handler.cs:line 42\r\n";
+    }
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/service.log", utf16(log, false)},
+        {"host01/legacy.log", utf16(log.substr(0, log.size() / 2), true)},
+        {"host02/service.log", log},  // Plain text is left alone
+    };
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.lineMemory = 1 << 20;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    {
+        std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+        CompressionType archiveType;
+        std::unordered_map<std::string, uint8_t> encodings;
+        for (const auto& meta : io::readMetadata(archive, archiveType)) {
+            encodings[meta.relativePath] = meta.textEncoding;
+        }
+        EXPECT_EQ(encodings["host01/service.log"], 1);  // UTF-16LE
+        EXPECT_EQ(encodings["host01/legacy.log"], 2);   // UTF-16BE
+        EXPECT_EQ(encodings["host02/service.log"], 0);
+    }
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+    FileCompressor::extract((tempDir / "archive.bin").string(), (tempDir / "single").string(), {"host01/legacy.log"});
+    EXPECT_EQ(readFile(tempDir / "single" / "host01" / "legacy.log"), files["host01/legacy.log"]);
+}
+
+// Test that timestamp columns round-trip alongside UTF-16 transcoding and the line store, and that
+// files without leading timestamps are left alone
+TEST_F(SolidCompressionTest, TimestampColumnsRoundTrip) {
+    std::string log;
+    for (int i = 0; i < 2000; i++) {
+        log += "[2105-05-13 03:" + std::string(i % 60 < 10 ? "0" : "") + std::to_string(i % 60) + ":27." +
+               std::to_string(100 + i % 900) + "] INFO [Service] - Request " + std::to_string(i) + " completed\r\n";
+        if (i % 10 == 0) {
+            log += "    at Service.Handler.Process(RequestContext context) in C:\\src\\Handler.cs:line 42\r\n";
+        }
+    }
+    std::string utf16 = "\xFF\xFE";
+    for (char c : log) {
+        utf16 += std::string{c, '\0'};
+    }
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/service.log", log},
+        {"host01/windows.log", utf16},
+        {"host01/tail.log", log.substr(7, log.size() / 3) + "[2105-02-30 00:00:00.000]"},  // Cut timestamps and a bad date
+        {"host02/plain.txt", "no timestamps here\n" + std::string(3000, 'x')},
+    };
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.timestampColumns = true;
+    options.lineMemory = 1 << 20;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    {
+        std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+        CompressionType archiveType;
+        std::unordered_map<std::string, bool> stamped;
+        for (const auto& meta : io::readMetadata(archive, archiveType)) {
+            stamped[meta.relativePath] = meta.isTimestampEncoded();
+        }
+        EXPECT_TRUE(stamped["host01/service.log"]);
+        EXPECT_TRUE(stamped["host01/windows.log"]);  // Detected on the transcoded text
+        EXPECT_TRUE(stamped["host01/tail.log"]);
+        EXPECT_FALSE(stamped["host02/plain.txt"]);
+    }
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+    FileCompressor::extract((tempDir / "archive.bin").string(), (tempDir / "single").string(), {"host01/windows.log"});
+    EXPECT_EQ(readFile(tempDir / "single" / "host01" / "windows.log"), utf16);
+}
+
+// Test that the time index records each file's range, UTF-16 files included, and that time-bounded
+// extraction takes only the files overlapping the window
+TEST_F(SolidCompressionTest, TimeBoundedExtraction) {
+    auto hourLog = [](int hour) {
+        std::string log;
+        for (int minute = 0; minute < 60; minute++) {
+            log += "[2105-05-13 " + std::string(hour < 10 ? "0" : "") + std::to_string(hour) + ":" +
+                   std::string(minute < 10 ? "0" : "") + std::to_string(minute) + ":00.000] INFO tick\n  detail\n";
+        }
+        return log;
+    };
+    std::string utf16 = "\xFF\xFE";
+    for (char c : hourLog(3)) {
+        utf16 += std::string{c, '\0'};
+    }
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/app.log.2", hourLog(2)},
+        {"host01/app.log.1", hourLog(3)},
+        {"host01/app.log", hourLog(4)},
+        {"host02/windows.log", utf16},
+        {"host02/copy.log", hourLog(2)},  // Duplicate of host01/app.log.2
+        {"host02/notes.txt", "no timestamps here\n"},
+    };
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.solidBlockSize = 1 << 12;
+    options.timeIndex = true;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    {
+        std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+        CompressionType archiveType;
+        std::unordered_map<std::string, std::pair<int64_t, int64_t>> ranges;
+        for (const auto& meta : io::readMetadata(archive, archiveType)) {
+            if (meta.hasTimeRange()) {
+                ranges[meta.relativePath] = {meta.minTimestamp, meta.maxTimestamp};
+            }
+        }
+        EXPECT_EQ(ranges.count("host02/notes.txt"), 0u);
+        EXPECT_EQ(ranges["host01/app.log.1"].first, timestamps::parseTimeBound("2105-05-13 03:00", false));
+        EXPECT_EQ(ranges["host01/app.log.1"].second, timestamps::parseTimeBound("2105-05-13 03:59", false));
+        EXPECT_EQ(ranges["host02/windows.log"], ranges["host01/app.log.1"]);  // Scanned as UTF-8
+    }
+
+    timestamps::TimeWindow window;
+    window.since = timestamps::parseTimeBound("2105-05-13 03:00", false);
+    window.until = timestamps::parseTimeBound("2105-05-13 03:15", true);
+    std::string archiveFile = (tempDir / "archive.bin").string();
+    EXPECT_EQ(FileCompressor::extract(archiveFile, (tempDir / "window").string(), {}, "", window), 3u);
+    EXPECT_EQ(readFile(tempDir / "window" / "host01" / "app.log.1"), files["host01/app.log.1"]);
+    EXPECT_EQ(readFile(tempDir / "window" / "host02" / "windows.log"), utf16);
+    EXPECT_EQ(readFile(tempDir / "window" / "host02" / "notes.txt"), files["host02/notes.txt"]);  // No range to rule it out
+    EXPECT_FALSE(std::filesystem::exists(tempDir / "window" / "host01" / "app.log"));
+    EXPECT_FALSE(std::filesystem::exists(tempDir / "window" / "host02" / "copy.log"));
+
+    window.since = timestamps::parseTimeBound("2105-05-13 02:30", false);
+    EXPECT_EQ(FileCompressor::extract(archiveFile, (tempDir / "named").string(), {"host02/copy.log", "host01/app.log"},
+                                      "", window), 1u);
+    EXPECT_EQ(readFile(tempDir / "named" / "host02" / "copy.log"), files["host02/copy.log"]);
+}
+
+// Test that template columns round-trip alongside UTF-16 transcoding and the line store, that they take
+// precedence over timestamp columns and that files without templates are left alone
+TEST_F(SolidCompressionTest, TemplateColumnsRoundTrip) {
+    std::string log;
+    for (int i = 0; i < 2000; i++) {
+        log += "[2105-05-13 03:" + std::string(i % 60 < 10 ? "0" : "") + std::to_string(i % 60) + ":27." +
+               std::to_string(100 + i % 900) + "] INFO [Scheduler] [RUN] - Batch job " + std::to_string(i * 7) +
+               " on unit node-" + std::to_string(i % 12) + "\n";
+    }
+    std::string utf16 = "\xFF\xFE";
+    for (char c : log) {
+        utf16 += std::string{c, '\0'};
+    }
+    std::string prose;
+    for (int i = 0; i < 200; i++) {
+        prose += std::string(i % 50 + 1, 'w') + " and " + std::string(i % 37 + 1, 'v') + "\n";
+    }
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/batch.log", log},
+        {"host01/windows.log", utf16},
+        {"host02/prose.txt", prose},
+    };
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.templateColumns = true;
+    options.timestampColumns = true;
+    options.lineMemory = 1 << 20;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    {
+        std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+        CompressionType archiveType;
+        std::unordered_map<std::string, const meta::FileMeta*> entries;
+        auto metadata = io::readMetadata(archive, archiveType);
+        for (const auto& meta : metadata) {
+            entries[meta.relativePath] = &meta;
+        }
+        EXPECT_TRUE(entries["host01/batch.log"]->isTemplateEncoded());
+        EXPECT_FALSE(entries["host01/batch.log"]->isTimestampEncoded());
+        EXPECT_FALSE(entries["host01/batch.log"]->isLineEncoded());
+        EXPECT_TRUE(entries["host01/windows.log"]->isTemplateEncoded());  // Detected on the transcoded text
+        EXPECT_FALSE(entries["host02/prose.txt"]->isTemplateEncoded());
+    }
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+    FileCompressor::extract((tempDir / "archive.bin").string(), (tempDir / "single").string(), {"host01/windows.log"});
+    EXPECT_EQ(readFile(tempDir / "single" / "host01" / "windows.log"), utf16);
+}
+
+// Test that JSON-lines columns round-trip byte for byte, take precedence over template columns and leave
+// other files alone
+TEST_F(SolidCompressionTest, JsonColumnsRoundTrip) {
+    std::string records;
+    for (int i = 0; i < 2000; i++) {
+        records += "{\"ts\":" + std::to_string(1700000000000 + i * 250) + ",\"level\":\"" +
+                   (i % 9 == 0 ? "ERROR" : "INFO") + "\",\"component\":\"Scheduler\",\"job\":" + std::to_string(i) +
+                   (i % 4 == 0 ? ",\"retry\":true" : "") + ",\"msg\":\"Batch job on unit node-" +
+                   std::to_string(i % 12) + "\"}\n";
+        if (i % 100 == 0) {
+            records += "panic: worker crashed\n";
+        }
+    }
+    std::string log;
+    for (int i = 0; i < 500; i++) {
+        log += "[2105-05-13 03:49:27.000] INFO [Scheduler] - Batch job " + std::to_string(i) + " done\n";
+    }
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/events.jsonl", records},
+        {"host01/batch.log", log},
+    };
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.jsonColumns = true;
+    options.templateColumns = true;
+    options.lineMemory = 1 << 20;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    {
+        std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+        CompressionType archiveType;
+        std::unordered_map<std::string, const meta::FileMeta*> entries;
+        auto metadata = io::readMetadata(archive, archiveType);
+        for (const auto& meta : metadata) {
+            entries[meta.relativePath] = &meta;
+        }
+        EXPECT_TRUE(entries["host01/events.jsonl"]->isJsonEncoded());
+        EXPECT_FALSE(entries["host01/events.jsonl"]->isTemplateEncoded());
+        EXPECT_FALSE(entries["host01/events.jsonl"]->isLineEncoded());
+        EXPECT_FALSE(entries["host01/batch.log"]->isJsonEncoded());
+        EXPECT_TRUE(entries["host01/batch.log"]->isTemplateEncoded());
+    }
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+}
+
+#ifdef HAVE_ZSTD
+// Test that rotations are stored as delta chains and restore through the whole chain
+TEST_F(SolidCompressionTest, DeltaRotationsRoundTrip) {
+    std::string log;
+    for (int i = 0; log.size() < (300 << 10); i++) {
+        log += "[2105-05-13 03:49:27.000] INFO [Gateway] [REQ] - Request " + std::to_string(i * 7919 % 100003) + " served\n";
+    }
+    std::unordered_map<std::string, std::string> files;
+    for (int generation = 0; generation < 4; generation++) {
+        std::string name = generation == 0 ? "app.log" : "app.log." + std::to_string(generation);
+        files["host01/" + name] = log.substr(0, log.size() - generation * (50 << 10));
+    }
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+
+    CompressionOptions options;
+    options.compType = CompressionType::ZSTD;
+    options.deltaDepth = 2;
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    {
+        std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+        CompressionType archiveType;
+        size_t deltaFiles = 0;
+        for (const auto& meta : io::readMetadata(archive, archiveType)) {
+            deltaFiles += meta.isDelta();
+        }
+        EXPECT_EQ(deltaFiles, 2);  // app.log.1 and app.log.2; app.log.3 starts a new chain
+    }
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+    FileCompressor::extract((tempDir / "archive.bin").string(), (tempDir / "single").string(), {"host01/app.log.2"});
+    EXPECT_EQ(readFile(tempDir / "single" / "host01" / "app.log.2"), files["host01/app.log.2"]);
+}
+#endif
+
+// Test that an append keeps the archive's bytes, stores only new content and restores every file
+TEST_F(SolidCompressionTest, AppendAddsOnlyNewData) {
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/app.log.1", jobLog(1)},
+        {"host01/small.log", "first small file\n"},
+        {"host02/small.log", "second small file\n"},
+        {"host02/copy.log", jobLog(1)},  // Takes over the data of app.log.1 once that is replaced
+    };
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    options.solidBlockSize = 64;
+    std::string archivePath = (tempDir / "archive.bin").string();
+    FileCompressor::compress((tempDir / "input").string(), archivePath, options);
+    std::string before = readFile(archivePath);
+
+    std::filesystem::create_directories(tempDir / "input" / "host03");
+    files["host01/app.log.1"] = jobLog(2);  // Changed
+    files["host03/app.log"] = jobLog(3);  // New
+    files["host03/small.log"] = "third small file\n";  // New, packed in a new block
+    files["host03/tiny.log"] = "fourth small file\n";
+    files["host03/again.log"] = "first small file\n";  // Content the archive already holds
+    for (const auto& path : {"host01/app.log.1", "host03/app.log", "host03/small.log", "host03/tiny.log", "host03/again.log"}) {
+        createTestFile("input/" + std::string(path), files[path]);
+    }
+    FileCompressor::append((tempDir / "input").string(), archivePath, options);
+
+    std::string after = readFile(archivePath);
+    ASSERT_GT(after.size(), before.size());
+    EXPECT_EQ(after.substr(0, before.size()), before);  // Nothing rewritten
+    EXPECT_FALSE(std::filesystem::exists(io::journalPath(archivePath)));
+
+    std::ifstream archive(archivePath, std::ios::binary);
+    CompressionType archiveType;
+    auto metadata = io::readMetadata(archive, archiveType);
+    ASSERT_EQ(metadata.size(), files.size());
+    std::unordered_map<int64_t, int64_t> blockStreams;  // Block id to its stream, which must be unique
+    for (const auto& meta : metadata) {
+        if (meta.relativePath == "host03/again.log") {
+            EXPECT_TRUE(meta.isDuplicate());
+            EXPECT_LT(meta.dataOffset, static_cast<int64_t>(before.size()));  // Points at the original data
+        }
+        if (meta.relativePath == "host02/copy.log") {
+            EXPECT_FALSE(meta.isDuplicate());
+            EXPECT_LT(meta.dataOffset, static_cast<int64_t>(before.size()));
+        }
+        if (meta.isSolid() && !meta.isDuplicate()) {
+            auto [it, added] = blockStreams.emplace(meta.blockId, meta.dataOffset);
+            EXPECT_EQ(it->second, meta.dataOffset) << "block " << meta.blockId << " reused";
+        }
+    }
+    EXPECT_EQ(blockStreams.size(), 2);
+
+    FileCompressor::decompress(archivePath, (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+}
+
+#ifdef HAVE_ZSTD
+// Test that appends replace a live log its rotations are delta encoded against, keeping its stream for them
+TEST_F(SolidCompressionTest, AppendKeepsDeltaReferences) {
+    std::string log;
+    for (int i = 0; log.size() < (200 << 10); i++) {
+        log += "[2105-05-13 03:49:27.000] INFO [Gateway] [REQ] - Request " + std::to_string(i * 7919 % 100003) + " served\n";
+    }
+    std::unordered_map<std::string, std::string> files;
+    for (int generation = 0; generation < 3; generation++) {
+        std::string name = generation == 0 ? "app.log" : "app.log." + std::to_string(generation);
+        files["host01/" + name] = log.substr(0, log.size() - generation * (50 << 10));
+    }
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+    CompressionOptions options;
+    options.compType = CompressionType::ZSTD;
+    options.deltaDepth = 4;
+    std::string archivePath = (tempDir / "archive.bin").string();
+    FileCompressor::compress((tempDir / "input").string(), archivePath, options);
+
+    for (int hour = 4; hour < 6; hour++) {  // The live log grows every hour
+        files["host01/app.log"] += "[2105-05-13 0" + std::to_string(hour) + ":00:00.000] INFO [Gateway] - Hour begins\n";
+        createTestFile("input/host01/app.log", files["host01/app.log"]);
+        FileCompressor::append((tempDir / "input").string(), archivePath, options);
+    }
+
+    std::ifstream archive(archivePath, std::ios::binary);
+    CompressionType archiveType;
+    std::vector<io::Attribute> sections;
+    auto metadata = io::readMetadata(archive, archiveType, &sections);
+    EXPECT_EQ(metadata.size(), files.size());
+    EXPECT_EQ(io::readRetainedEntries(sections).size(), 1u);  // Only the first app.log has deltas against it
+
+    FileCompressor::decompress(archivePath, (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+    FileCompressor::extract(archivePath, (tempDir / "single").string(), {"host01/app.log.2"});
+    EXPECT_EQ(readFile(tempDir / "single" / "host01" / "app.log.2"), files["host01/app.log.2"]);
+}
+#endif
+
+// Test that readers ignore an append cut short by a crash and that the next append rolls it back
+TEST_F(SolidCompressionTest, InterruptedAppendRollsBack) {
+    createTestFile("input/host01/app.log", jobLog(1));
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    std::string archivePath = (tempDir / "archive.bin").string();
+    FileCompressor::compress((tempDir / "input").string(), archivePath, options);
+    uint64_t committed = std::filesystem::file_size(archivePath);
+
+    io::writeJournal(archivePath, committed);
+    {
+        std::ofstream archive(archivePath, std::ios::binary | std::ios::app);
+        archive << "partial data of an append that never wrote its footer";
+    }
+    EXPECT_EQ(io::committedSize(archivePath), committed);
+    FileCompressor::extract(archivePath, (tempDir / "output").string(), {"host01/app.log"});
+    EXPECT_EQ(readFile(tempDir / "output" / "host01" / "app.log"), jobLog(1));
+
+    createTestFile("input/host01/app.log.1", jobLog(2));
+    FileCompressor::append((tempDir / "input").string(), archivePath, options);
+    EXPECT_FALSE(std::filesystem::exists(io::journalPath(archivePath)));
+    FileCompressor::decompress(archivePath, (tempDir / "restored").string());
+    EXPECT_EQ(readFile(tempDir / "restored" / "host01" / "app.log"), jobLog(1));
+    EXPECT_EQ(readFile(tempDir / "restored" / "host01" / "app.log.1"), jobLog(2));
+}
+
+// Test that incremental archives store only new content, restore through their base and bound chains
+TEST_F(SolidCompressionTest, IncrementalSnapshotsReferenceBase) {
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/app.log", jobLog(1)},
+        {"host01/app.log.1", jobLog(2)},
+        {"host02/app.log", jobLog(3)},
+    };
+    for (const auto& [path, content] : files) {
+        createTestFile("input/" + path, content);
+    }
+    CompressionOptions options;
+    options.compType = availableCompressionTypes().front();
+    std::string fullPath = (tempDir / "full.bin").string();
+    FileCompressor::compress((tempDir / "input").string(), fullPath, options);
+
+    files["host01/app.log"] = jobLog(4);  // Changed
+    files["host02/moved.log"] = jobLog(2);  // Content the base holds under another path
+    createTestFile("input/host01/app.log", files["host01/app.log"]);
+    createTestFile("input/host02/moved.log", files["host02/moved.log"]);
+    std::filesystem::last_write_time(tempDir / "input" / "host02" / "app.log",  // Touched, so found by its hash
+                                     std::filesystem::file_time_type::clock::now() + std::chrono::hours(1));
+    options.baseArchive = fullPath;
+    options.baseDepth = 1;
+    std::string incrementalPath = (tempDir / "incremental.bin").string();
+    FileCompressor::compress((tempDir / "input").string(), incrementalPath, options);
+
+    auto readEntries = [](const std::string& path) {
+        std::ifstream archive(path, std::ios::binary);
+        CompressionType archiveType;
+        std::unordered_map<std::string, std::string> baseEntries;  // Path to the base entry it points at, "" when stored
+        for (const auto& meta : io::readMetadata(archive, archiveType)) {
+            baseEntries[meta.relativePath] = meta.baseEntry;
+        }
+        return baseEntries;
+    };
+    auto incremental = readEntries(incrementalPath);
+    EXPECT_EQ(incremental["host01/app.log"], "");
+    EXPECT_EQ(incremental["host01/app.log.1"], "host01/app.log.1");
+    EXPECT_EQ(incremental["host02/app.log"], "host02/app.log");
+    EXPECT_EQ(incremental["host02/moved.log"], "host01/app.log.1");
+    EXPECT_LT(std::filesystem::file_size(incrementalPath), std::filesystem::file_size(fullPath));
+
+    FileCompressor::decompress(incrementalPath, (tempDir / "output").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "output" / path), content) << path;
+    }
+    FileCompressor::extract(incrementalPath, (tempDir / "single").string(), {"host02/moved.log"});
+    EXPECT_EQ(readFile(tempDir / "single" / "host02" / "moved.log"), jobLog(2));
+
+    // Files only the full archive holds would be two bases away, so the next snapshot stores them again
+    options.baseArchive = incrementalPath;
+    std::string nextPath = (tempDir / "next.bin").string();
+    FileCompressor::compress((tempDir / "input").string(), nextPath, options);
+    auto next = readEntries(nextPath);
+    EXPECT_EQ(next["host01/app.log"], "host01/app.log");
+    EXPECT_EQ(next["host01/app.log.1"], "");
+    EXPECT_EQ(next["host02/app.log"], "");
+    FileCompressor::decompress(nextPath, (tempDir / "restored").string());
+    for (const auto& [path, content] : files) {
+        EXPECT_EQ(readFile(tempDir / "restored" / path), content) << path;
+    }
+}
+
+#ifdef HAVE_BROTLI
+// Test that large-window Brotli entries record their window and extract with a matching decoder
+TEST_F(AdaptiveCompressionTest, BrotliLargeWindowRoundTrip) {
+    std::string content;
+    for (int i = 0; i < 2000; i++) {
+        content += "[2105-05-13 03:49:27.000] INFO [Database] [READ] - Request " + std::to_string(i) + " processed\n";
+    }
+    createTestFile("input/app.log", content);
+
+    CompressionOptions options;
+    options.compType = CompressionType::BROTLI;
+    options.level = 5;
+    options.windowLog = 26;  // Beyond BROTLI_MAX_WINDOW_BITS
+    FileCompressor::compress((tempDir / "input").string(), (tempDir / "archive.bin").string(), options);
+
+    {
+        std::ifstream archive(tempDir / "archive.bin", std::ios::binary);
+        CompressionType archiveType;
+        auto metadata = io::readMetadata(archive, archiveType);
+        ASSERT_EQ(metadata.size(), 1);
+        EXPECT_EQ(metadata[0].windowLog, 26);
+    }
+
+    FileCompressor::decompress((tempDir / "archive.bin").string(), (tempDir / "output").string());
+    std::ifstream extracted(tempDir / "output" / "app.log", std::ios::binary);
+    std::string extractedContent((std::istreambuf_iterator<char>(extracted)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(extractedContent, content);
+}
+#endif
+
+#ifdef HAVE_ZSTD
+// Test that multithreaded long-distance zstd frames round-trip and find repeats beyond the default window
+TEST(CodecSettingsTest, ZstdLongDistanceRoundTrip) {
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::string block(4 << 20, '\0');
+    for (auto& c : block) {
+        c = static_cast<char>(distribution(generator));
+    }
+    std::string data = block + block;  // Repeat 4MB apart, outside the level 1 window
+
+    CompressorSettings settings;
+    settings.workers = 2;
+    settings.longDistance = true;
+    settings.windowLog = 24;
+    auto compressor = createCompressor(CompressionType::ZSTD, 1, settings);
+
+    for (int run = 0; run < 2; run++) {  // Second run reuses the pooled context
+        std::istringstream input(data);
+        std::stringstream compressed;
+        compressor->compressStream(input, compressed);
+        EXPECT_LT(compressed.str().size(), data.size() * 6 / 10);  // Second copy costs next to nothing
+
+        std::ostringstream output;
+        EXPECT_EQ(compressor->decompressStream(compressed, output), data.size());
+        EXPECT_EQ(output.str(), data);
+    }
+}
+#endif
+
 }  // namespace compression
 
 int main(int argc, char **argv) {
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "GramFilter.h"
+
+namespace grams {
+
+std::string filterOf(const std::string& text, size_t pieceSize) {
+    GramSet set;
+    for (size_t i = 0; i < text.size(); i += pieceSize) {
+        set.add(text.data() + i, std::min(pieceSize, text.size() - i));
+    }
+    return buildFilter(set);
+}
+
+// Test that every substring of a line passes the filter, in any case, however the text was fed in
+TEST(GramFilterTest, AcceptsEverySubstringOfALine) {
+    std::string text = "INFO request 7f3a9c2e served\nWARN Disk nearly full\n";
+    for (size_t pieceSize : {text.size(), size_t(1), size_t(5)}) {
+        std::string filter = filterOf(text, pieceSize);
+        EXPECT_TRUE(mayContain(filter, "request 7f3a9c2e"));
+        EXPECT_TRUE(mayContain(filter, "REQUEST 7F3A"));
+        EXPECT_TRUE(mayContain(filter, "disk nearly"));
+        EXPECT_TRUE(mayContain(filter, "ed"));  // Too short to check
+        EXPECT_FALSE(mayContain(filter, "request 5b1d0e77"));
+        EXPECT_TRUE(mayContain(filter, "served\nWARN"));  // Grams across the break are not checked
+        EXPECT_FALSE(mayContain(filter, "served\nERROR"));
+    }
+    EXPECT_TRUE(mayContain("", "anything"));  // No filter
+}
+
+// Test that false positives stay rare and that huge texts are capped at the largest filter
+TEST(GramFilterTest, KeepsFalsePositivesRare) {
+    GramSet set;
+    std::string text;
+    for (int i = 0; i < 20000; i++) {
+        text += "job " + std::to_string(i * 7919 % 1000003) + " done\n";
+    }
+    set.add(text.data(), text.size());
+    std::string filter = buildFilter(set);
+    EXPECT_EQ(filter.size(), 1 + std::max(MIN_FILTER_SIZE, (set.count() * BITS_PER_GRAM + 7) / 8));
+
+    int passed = 0;
+    for (int i = 0; i < 1000; i++) {
+        passed += mayContain(filter, "id=" + std::to_string(1000000 + i * 13) + "#x") ? 1 : 0;
+    }
+    EXPECT_LT(passed, 50);
+
+    GramSet everything;
+    std::string bytes(4 << 20, '\0');
+    uint32_t state = 1;
+    for (char& byte : bytes) {
+        state = state * 1103515245 + 12345;
+        byte = static_cast<char>(state >> 24);
+    }
+    everything.add(bytes.data(), bytes.size());
+    EXPECT_EQ(buildFilter(everything).size(), 1 + MAX_FILTER_SIZE);
+}
+
+}  // namespace grams
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
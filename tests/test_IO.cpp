@@ -1,5 +1,6 @@
 #include <filesystem>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -302,6 +303,108 @@ TEST_F(IOTest, FooterReadWrite) {
     }
 }
 
+TEST_F(IOTest, FooterRejectsForeignFiles) {
+    std::string testFilePath = (tempDir / "not_an_archive.dat").string();
+    {
+        std::ofstream outFile(testFilePath, std::ios::binary);
+        std::string text(64, 'x');
+        outFile.write(text.c_str(), text.size());
+    }
+
+    std::ifstream inFile(testFilePath, std::ios::binary);
+    compression::CompressionType compType;
+    uint64_t uniqueCount, duplicateCount, metaOffset;
+    EXPECT_THROW(io::readFooter(inFile, compType, uniqueCount, duplicateCount, metaOffset), std::runtime_error);
+}
+
+TEST_F(IOTest, CompressionTypeIdsAreStable) {
+    // Codec ids are persisted in archives and must not depend on the build configuration
+    EXPECT_EQ(static_cast<int>(compression::CompressionType::NONE), 0);
+    EXPECT_EQ(static_cast<int>(compression::CompressionType::ZLIB), 1);
+    EXPECT_EQ(static_cast<int>(compression::CompressionType::BROTLI), 2);
+    EXPECT_EQ(static_cast<int>(compression::CompressionType::ZSTD), 3);
+    EXPECT_EQ(static_cast<int>(compression::CompressionType::LZ4), 4);
+}
+
+TEST_F(IOTest, MetadataCodecAndLevelRoundTrip) {
+    std::string testFilePath = (tempDir / "test_metadata_codec.dat").string();
+    std::vector<meta::FileMeta> testMetadata;
+    testMetadata.emplace_back(0, "hash1", "a.log", compression::CompressionType::ZLIB, 9, 1234);
+    testMetadata.emplace_back(100, "hash2", "b.gz", compression::CompressionType::NONE, 0, 99);
+
+    {
+        std::ofstream outFile(testFilePath, std::ios::binary);
+        io::writeMetadata(outFile, testMetadata, compression::CompressionType::ZLIB);
+    }
+
+    std::ifstream inFile(testFilePath, std::ios::binary);
+    compression::CompressionType compType;
+    auto readMetadata = io::readMetadata(inFile, compType);
+    ASSERT_EQ(readMetadata.size(), 2);
+    EXPECT_EQ(readMetadata[0].codec, compression::CompressionType::ZLIB);
+    EXPECT_EQ(readMetadata[0].level, 9);
+    EXPECT_EQ(readMetadata[0].originalSize, 1234);
+    EXPECT_EQ(readMetadata[1].codec, compression::CompressionType::NONE);
+    EXPECT_EQ(readMetadata[1].originalSize, 99);
+}
+
+// Test that optional entry fields survive as attributes and default when absent
+TEST_F(IOTest, MetadataAttributesRoundTrip) {
+    std::string testFilePath = (tempDir / "test_metadata_attributes.dat").string();
+    std::vector<meta::FileMeta> testMetadata;
+    testMetadata.emplace_back(0, "hash1", "big.log", compression::CompressionType::BROTLI, 11, 1 << 30);
+    testMetadata.back().windowLog = 28;
+    testMetadata.emplace_back(100, "hash2", "small.log", compression::CompressionType::BROTLI, 11, 10);
+    testMetadata.back().blockId = 3;
+    testMetadata.back().blockOffset = 4096;
+    testMetadata.emplace_back(100, "", "copy.log");
+    testMetadata.back().blockId = 3;
+    testMetadata.back().blockOffset = 4096;
+
+    {
+        std::ofstream outFile(testFilePath, std::ios::binary);
+        io::writeMetadata(outFile, testMetadata, compression::CompressionType::BROTLI);
+    }
+
+    std::ifstream inFile(testFilePath, std::ios::binary);
+    compression::CompressionType compType;
+    auto readMetadata = io::readMetadata(inFile, compType);
+    ASSERT_EQ(readMetadata.size(), 3);
+    EXPECT_EQ(readMetadata[0].windowLog, 28);
+    EXPECT_FALSE(readMetadata[0].isSolid());
+    EXPECT_EQ(readMetadata[1].windowLog, 0);
+    EXPECT_EQ(readMetadata[1].blockId, 3);
+    EXPECT_EQ(readMetadata[1].blockOffset, 4096);
+    EXPECT_TRUE(readMetadata[2].isDuplicate());
+    EXPECT_EQ(readMetadata[2].blockOffset, 4096);  // Duplicates keep the block position of their original
+}
+
+// Test that unknown records are skipped unless marked must-understand, and known tags read back plain
+TEST_F(IOTest, AttributesRejectUnknownMustUnderstandTags) {
+    std::stringstream known;
+    io::writeAttributes(known, {{io::TAG_LINE_ENCODED, ""}, {io::TAG_TIME_RANGE, "range"}});
+    auto attributes = io::readAttributes(known);
+    ASSERT_EQ(attributes.size(), 2);
+    EXPECT_EQ(attributes[0].first, io::TAG_LINE_ENCODED);
+    EXPECT_EQ(attributes[1].first, io::TAG_TIME_RANGE);
+
+    // Written by a newer version: an optional record is skipped, a decode-affecting one is refused
+    auto writeUnknown = [](std::ostream& stream, uint16_t tag) {
+        io::write(stream, uint16_t{1});
+        io::write(stream, tag);
+        io::write(stream, std::string("payload"));
+    };
+    std::stringstream optional;
+    writeUnknown(optional, 999);
+    attributes = io::readAttributes(optional);
+    ASSERT_EQ(attributes.size(), 1);
+    EXPECT_EQ(attributes[0].first, 999);
+
+    std::stringstream required;
+    writeUnknown(required, 999 | io::TAG_MUST_UNDERSTAND);
+    EXPECT_THROW(io::readAttributes(required), std::runtime_error);
+}
+
 TEST_F(IOTest, ErrorChecking) {
     // Test error handling
     std::string nonExistentFile = (tempDir / "non_existent.dat").string();
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+#include "JsonLinesCodec.h"
+
+namespace jsonlines {
+
+// Encodes content into shape and key columns and returns the blocks
+std::string encode(const std::string& content) {
+    std::istringstream input(content);
+    EncodingBuffer encoder(input);
+    std::istream encodedInput(&encoder);
+    return std::string((std::istreambuf_iterator<char>(encodedInput)), std::istreambuf_iterator<char>());
+}
+
+// Joins columns back into lines, feeding them in pieces of pieceSize bytes
+std::string decode(const std::string& encoded, size_t pieceSize) {
+    std::ostringstream output;
+    DecodingBuffer decoder(output);
+    std::ostream decodedOutput(&decoder);
+    decodedOutput.exceptions(std::ios::badbit);
+    for (size_t i = 0; i < encoded.size(); i += pieceSize) {
+        decodedOutput.write(encoded.data() + i, std::min(pieceSize, encoded.size() - i));
+    }
+    decoder.finish();
+    EXPECT_EQ(decoder.written(), output.str().size());
+    return output.str();
+}
+
+// Test that a record splits into its shape and typed values
+TEST(JsonLinesCodecTest, ParsesRecords) {
+    ParsedRecord parsed;
+    ASSERT_TRUE(parseRecord("{\"ts\":1700000000123, \"level\" : \"INFO\",\"msg\":\"a \\\"b\\\"\",\"ok\":true,"
+                            "\"ctx\":{\"ids\":[1,2]},\"lat\":0.25,\"n\":-7,\"z\":007}\r\n", parsed));
+    EXPECT_EQ(parsed.shape, std::string("{\"ts\":") + INTEGER_PLACEHOLDER + ", \"level\" : \"" + STRING_PLACEHOLDER +
+                                "\",\"msg\":\"" + STRING_PLACEHOLDER + "\",\"ok\":" + LITERAL_PLACEHOLDER +
+                                ",\"ctx\":" + LITERAL_PLACEHOLDER + ",\"lat\":" + LITERAL_PLACEHOLDER +
+                                ",\"n\":" + INTEGER_PLACEHOLDER + ",\"z\":" + LITERAL_PLACEHOLDER + "}\r\n");
+    ASSERT_EQ(parsed.fields.size(), 8u);
+    EXPECT_EQ(parsed.fields[0].key, "ts");
+    EXPECT_EQ(parsed.fields[0].integer, 1700000000123);
+    EXPECT_EQ(parsed.fields[2].text, "a \\\"b\\\"");
+    EXPECT_EQ(parsed.fields[4].text, "{\"ids\":[1,2]}");
+    EXPECT_EQ(parsed.fields[6].integer, -7);
+
+    for (const char* line : {"plain text\n", "{\"a\":1\n", "{\"a\":1,}\n", "{\"a\" 1}\n", "{\"a\":1 \"b\":2}\n",
+                             "{\"a\":1} trailing\n", "{\"a\":\"\x01\"}\n", "[1,2]\n", "{\"a\":}\n"}) {
+        EXPECT_FALSE(parseRecord(line, parsed)) << line;
+    }
+}
+
+// Test that a sample must mostly consist of records of a few shapes
+TEST(JsonLinesCodecTest, DetectsJsonLines) {
+    std::string records;
+    for (int i = 0; i < 40; i++) {
+        records += "{\"ts\":" + std::to_string(1700000000000 + i) + ",\"level\":\"INFO\",\"msg\":\"done\"}\n";
+    }
+    records += "not a record\n";
+    EXPECT_TRUE(hasJsonLines(records.data(), records.size()));
+    std::string text = "[2105-05-13 03:49:27.000] INFO start\n{\"a\":1}\nplain\n";
+    EXPECT_FALSE(hasJsonLines(text.data(), text.size()));
+    EXPECT_FALSE(hasJsonLines("", 0));
+}
+
+// Test that records shrink, other lines are stored raw and everything restores exactly
+TEST(JsonLinesCodecTest, RoundTripsExactly) {
+    std::string content;
+    for (int i = 0; i < 5000; i++) {
+        content += "{\"ts\":" + std::to_string(1700000000000 + i * 1537 - (i % 7 == 0 ? 90000 : 0)) +
+                   ",\"level\":\"" + (i % 5 == 0 ? "WARN" : "INFO") + "\",\"service\":\"billing\",\"request\":" +
+                   std::to_string(i * 31) + ",\"latency\":" + std::to_string(i % 100) + ".5";
+        if (i % 3 == 0) {
+            content += ",\"tags\":[\"a\",\"b\"],\"user\":null";  // Optional keys make a second shape
+        }
+        content += i % 11 == 0 ? "}\r\n" : "}\n";
+        if (i % 13 == 0) {
+            content += "panic: not json\n\n  {\"spaced\" :  -9223372036854775807 , \"big\":99999999999999999999}\n";
+        }
+    }
+    content += "{\"last\":\"line without a newline\"}";
+
+    std::string encoded = encode(content);
+    EXPECT_LT(encoded.size(), content.size() / 2);
+    EXPECT_EQ(decode(encoded, encoded.size()), content);
+    EXPECT_EQ(decode(encoded, 1), content);  // Blocks split across writes
+    EXPECT_EQ(decode(encode(""), 1), "");
+}
+
+// Test that content spanning several blocks, including a line longer than a block, restores exactly
+TEST(JsonLinesCodecTest, RoundTripsAcrossBlocks) {
+    std::string content;
+    for (int i = 0; content.size() < 3 * JSON_BLOCK_SIZE; i++) {
+        content += "{\"id\":" + std::to_string(i) + ",\"payload\":\"" + std::string(content.size() % 300, 'p') + "\"}\n";
+    }
+    content += "{\"id\":1,\"payload\":\"" + std::string(JSON_BLOCK_SIZE + 100, 'l') + "\"}\n";
+    content += "{\"id\":2,\"payload\":\"after the long line\"}\n";
+    std::string encoded = encode(content);
+    EXPECT_EQ(decode(encoded, 4096), content);
+}
+
+// Test that malformed blocks are rejected
+TEST(JsonLinesCodecTest, RejectsMalformedBlocks) {
+    std::string encoded = encode("{\"id\":1}\n");
+    EXPECT_THROW(decode(encoded.substr(0, encoded.size() - 1), 4096), std::runtime_error);  // Cut short
+    std::string extraLine = encoded;
+    extraLine[0] = 2;  // Claims a line the columns do not hold
+    EXPECT_THROW(decode(extraLine, 4096), std::runtime_error);
+    std::string unknownShape = encoded;
+    unknownShape[unknownShape.size() - 2] = 5;  // Shape id no block defined
+    EXPECT_THROW(decode(unknownShape, 4096), std::runtime_error);
+}
+
+}  // namespace jsonlines
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "LineStore.h"
+
+namespace lines {
+
+// Encodes content through a store and returns the records
+std::string encode(const std::string& content, const LineStore& store) {
+    std::istringstream input(content);
+    EncodingBuffer encoder(input, store);
+    std::istream encodedInput(&encoder);
+    return std::string((std::istreambuf_iterator<char>(encodedInput)), std::istreambuf_iterator<char>());
+}
+
+// Expands records through a dictionary, feeding them in pieces of pieceSize bytes
+std::string decode(const std::string& encoded, const LineDictionary& dictionary, size_t pieceSize) {
+    std::ostringstream output;
+    DecodingBuffer decoder(output, dictionary);
+    std::ostream decodedOutput(&decoder);
+    decodedOutput.exceptions(std::ios::badbit);
+    for (size_t i = 0; i < encoded.size(); i += pieceSize) {
+        decodedOutput.write(encoded.data() + i, std::min(pieceSize, encoded.size() - i));
+    }
+    decoder.finish();
+    EXPECT_EQ(decoder.written(), output.str().size());
+    return output.str();
+}
+
+const std::string TRACE = "    at com.example.service.RequestHandler.handle(RequestHandler.java:42)\n";
+const std::string BANNER = "==================== service started, version 2.4.1 ====================\n";
+
+// Test that lines keep their newline, overlong lines come in pieces and the last line may lack one
+TEST(LineStoreTest, ReaderSplitsLines) {
+    std::string longLine(MAX_LINE_LENGTH + 10, 'x');
+    std::istringstream input("short\n" + longLine + "\nlast");
+    LineReader reader(input);
+    std::vector<std::string> lines;
+    std::string_view line;
+    while (reader.next(line)) {
+        lines.emplace_back(line);
+    }
+    ASSERT_EQ(lines.size(), 4);
+    EXPECT_EQ(lines[0], "short\n");
+    EXPECT_EQ(lines[1].size(), MAX_LINE_LENGTH);
+    EXPECT_EQ(lines[2], std::string(10, 'x') + "\n");
+    EXPECT_EQ(lines[3], "last");
+}
+
+// Test that the table stays within its memory budget and refuses new hashes once three quarters full
+TEST(LineStoreTest, TableIsBounded) {
+    LineTable table(64 << 10);
+    EXPECT_EQ(table.capacity(), 4096);  // 16-byte slots
+    size_t inserted = 0;
+    for (uint64_t hash = 1; hash <= table.capacity(); hash++) {
+        inserted += table.insert(hash * 0x9E3779B97F4A7C15ULL) != nullptr;
+    }
+    EXPECT_EQ(inserted, table.capacity() / 4 * 3);
+    EXPECT_NE(table.find(0x9E3779B97F4A7C15ULL), nullptr);
+    EXPECT_EQ(table.find(12345), nullptr);
+}
+
+// Test that only long lines seen twice are stored, and that files encode them as references
+TEST(LineStoreTest, StoresRepeatedLines) {
+    LineStore store(1 << 20);
+    std::istringstream first("ERROR request failed\n" + TRACE + BANNER);
+    std::istringstream second(TRACE + "ERROR request failed\n" + "a line that occurs only once in all the files\n");
+    store.scan(first);
+    store.scan(second);
+
+    ASSERT_EQ(store.size(), 1);  // The short error line is left to the codec
+    EXPECT_EQ(store.line(0), TRACE);
+    EXPECT_EQ(store.find(TRACE), 0);
+    EXPECT_EQ(store.find(BANNER), LineTable::NO_LINE);
+
+    std::string content = "start\n" + TRACE + TRACE + "end";
+    std::string encoded = encode(content, store);
+    EXPECT_LT(encoded.size(), content.size());
+    EXPECT_EQ(decode(encoded, store, encoded.size()), content);
+    EXPECT_EQ(decode(encoded, store, 1), content);  // Records split across writes
+}
+
+// Test that the store gives up on new lines once its memory is spent, without breaking the encoding
+TEST(LineStoreTest, StoreIsBounded) {
+    std::string content;
+    for (int i = 0; i < 20000; i++) {
+        content += "repeated line number " + std::to_string(i) + " padded to a long line\n";
+    }
+    LineStore store(256 << 10);
+    std::istringstream first(content), second(content);
+    store.scan(first);
+    store.scan(second);
+    EXPECT_GT(store.size(), 0);
+    EXPECT_LT(store.size(), 20000);
+    EXPECT_LE(store.table().size(), store.table().capacity() / 4 * 3);
+
+    std::string encoded = encode(content, store);
+    EXPECT_EQ(decode(encoded, LineDictionary(store.data()), 4096), content);
+}
+
+// Test that malformed records are rejected
+TEST(LineStoreTest, RejectsMalformedRecords) {
+    LineDictionary dictionary(TRACE);
+    ASSERT_EQ(dictionary.size(), 1);
+    EXPECT_THROW(decode(std::string("\x01\x05\x00\x00\x00", 5), dictionary, 5), std::runtime_error);  // No line 5
+    EXPECT_THROW(decode(std::string("\x07\x00\x00\x00\x00", 5), dictionary, 5), std::runtime_error);  // Unknown kind
+    EXPECT_THROW(decode(std::string("\x00\x09\x00\x00\x00" "abc", 8), dictionary, 8), std::runtime_error);  // Cut short
+    EXPECT_THROW(LineDictionary("no newline"), std::runtime_error);
+}
+
+// Test that the section locating the store round-trips
+TEST(LineStoreTest, SectionRoundTrip) {
+    LineStoreLocation location{4096, 123456, compression::CompressionType::BROTLI, 24};
+    std::vector<io::Attribute> sections = {{io::TAG_DICTIONARY_REF, io::encodeValue(uint32_t(7))}, lineStoreSection(location)};
+    auto read = readLineStoreSection(sections);
+    ASSERT_TRUE(read.has_value());
+    EXPECT_EQ(read->dataOffset, 4096);
+    EXPECT_EQ(read->size, 123456);
+    EXPECT_EQ(read->codec, compression::CompressionType::BROTLI);
+    EXPECT_EQ(read->windowLog, 24);
+    EXPECT_FALSE(readLineStoreSection({}).has_value());
+}
+
+}  // namespace lines
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CompressionOptions.h"
+#include "CompressorFactory.h"
+#include "FileCompressor.h"
+#include "LogMerger.h"
+
+namespace merge {
+
+class LogMergerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tempDir = std::filesystem::temp_directory_path() / "logmerger_test";
+        std::filesystem::remove_all(tempDir);
+        std::filesystem::create_directories(tempDir / "input");
+        std::filesystem::create_directories(tempDir / "runs");
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(tempDir);
+    }
+
+    // Writes the files and compresses them into archive.bin
+    std::string createArchive(const std::unordered_map<std::string, std::string>& files, bool timeIndex) {
+        for (const auto& [path, content] : files) {
+            std::filesystem::path filePath = tempDir / "input" / path;
+            std::filesystem::create_directories(filePath.parent_path());
+            std::ofstream file(filePath, std::ios::binary);
+            file << content;
+        }
+        compression::CompressionOptions options;
+        options.compType = compression::availableCompressionTypes().front();
+        options.solidBlockSize = 1 << 12;
+        options.timeIndex = timeIndex;
+        std::string archive = (tempDir / "archive.bin").string();
+        compression::FileCompressor::compress((tempDir / "input").string(), archive, options);
+        return archive;
+    }
+
+    std::string merged(const std::string& archive, MergeOptions options, MergeStats* stats = nullptr) {
+        options.tempDir = tempDir / "runs";
+        std::ostringstream output;
+        MergeStats result = mergeArchive(archive, output, options);
+        if (stats) {
+            *stats = result;
+        }
+        EXPECT_TRUE(std::filesystem::is_empty(tempDir / "runs"));  // Runs are removed
+        return output.str();
+    }
+
+    std::filesystem::path tempDir;
+};
+
+// Timestamp of second s after 03:00
+std::string at(int s) {
+    auto two = [](int value) { return std::string(value < 10 ? "0" : "") + std::to_string(value); };
+    return "[2105-05-13 03:" + two(s / 60) + ":" + two(s % 60) + ".000]";
+}
+
+// Test that records interleave by time with their continuation lines, UTF-16 files (without their byte
+// order mark) and labels included
+TEST_F(LogMergerTest, InterleavesRecordsByTime) {
+    std::string windows = "\xFF\xFE";
+    for (char c : at(2) + " win two\r\n" + at(5) + " win five\r\n") {
+        windows += std::string{c, '\0'};
+    }
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/app.log", at(1) + " app one\n" + at(4) + " app four\n  at frame\n  at frame\n" + at(6) + " app six"},
+        {"host02/app.log", "preamble\n" + at(3) + " other three\n" + at(4) + " other four\n"},
+        {"host03/windows.log", windows},
+    };
+    std::string archive = createArchive(files, true);
+
+    MergeStats stats;
+    EXPECT_EQ(merged(archive, MergeOptions(), &stats),
+              at(1) + " app one\n" +
+              at(2) + " win two\r\n" +
+              "preamble\n" + at(3) + " other three\n" +  // Leading lines go with the start of the file's range
+              at(4) + " app four\n  at frame\n  at frame\n" +  // Ties keep archive order
+              at(4) + " other four\n" +
+              at(5) + " win five\r\n" +
+              at(6) + " app six\n");
+    EXPECT_EQ(stats.files, 3u);
+    EXPECT_EQ(stats.records, 8u);
+
+    MergeOptions options;
+    options.labelLines = true;
+    options.relativePaths = {"host02/app.log"};
+    EXPECT_EQ(merged(archive, options),
+              "host02/app.log:preamble\nhost02/app.log:" + at(3) + " other three\nhost02/app.log:" + at(4) + " other four\n");
+
+    options.labelLines = false;
+    options.relativePaths.clear();
+    options.window.since = timestamps::parseTimeBound("2105-05-13 03:00:04", false);
+    options.window.until = timestamps::parseTimeBound("2105-05-13 03:00:05", true);
+    EXPECT_EQ(merged(archive, options),
+              at(4) + " app four\n  at frame\n  at frame\n" + at(4) + " other four\n" + at(5) + " win five\r\n");
+}
+
+// Test that overlapping inputs beyond the fan-in are merged through runs with the same result, and that
+// rotated files the time index shows apart are merged in one round whatever the fan-in
+TEST_F(LogMergerTest, MergesThroughRunsBeyondFanIn) {
+    std::unordered_map<std::string, std::string> files;
+    for (int f = 0; f < 9; f++) {
+        std::string content;
+        for (int s = f; s < 1800; s += 9) {
+            content += at(s) + " host " + std::to_string(f) + " record " + std::to_string(s) + "\n  detail\n";
+        }
+        files["host" + std::to_string(f) + "/app.log"] = content;
+    }
+    std::string archive = createArchive(files, false);  // No ranges, so all files overlap
+
+    MergeStats stats;
+    std::string expected = merged(archive, MergeOptions(), &stats);
+    EXPECT_EQ(stats.runs, 0u);
+    EXPECT_EQ(stats.records, 1800u);
+    MergeOptions narrow;
+    narrow.fanIn = 2;
+    EXPECT_EQ(merged(archive, narrow, &stats), expected);
+    EXPECT_EQ(stats.runs, 5u + 3u + 2u);  // Rounds of 9, 5 and 3 inputs
+
+    std::filesystem::remove_all(tempDir / "input");
+    files.clear();
+    for (int f = 0; f < 9; f++) {
+        std::string content;
+        for (int s = f * 200; s < f * 200 + 200; s++) {
+            content += at(s) + " rotation " + std::to_string(f) + "\n";
+        }
+        files["host01/app.log." + std::to_string(9 - f)] = content;
+    }
+    archive = createArchive(files, true);
+    std::string chronological = merged(archive, narrow, &stats);
+    EXPECT_EQ(stats.runs, 0u);
+    EXPECT_EQ(stats.records, 1800u);
+    EXPECT_EQ(chronological.substr(0, 25), at(0));
+    EXPECT_EQ(chronological.substr(chronological.size() - 37, 25), at(1799));
+}
+
+// Test that records of equal time keep archive order even when later files start earlier, through runs too
+TEST_F(LogMergerTest, TiesKeepArchiveOrder) {
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/app.log", at(5) + " first\n" + at(9) + " first end\n"},
+        {"host02/app.log", at(1) + " second start\n" + at(5) + " second\n" + at(9) + " second end\n"},
+        {"host03/app.log", at(3) + " third start\n" + at(5) + " third\n" + at(9) + " third end\n"},
+    };
+    std::string archive = createArchive(files, true);
+
+    std::string expected = at(1) + " second start\n" + at(3) + " third start\n" +
+                           at(5) + " first\n" + at(5) + " second\n" + at(5) + " third\n" +
+                           at(9) + " first end\n" + at(9) + " second end\n" + at(9) + " third end\n";
+    EXPECT_EQ(merged(archive, MergeOptions()), expected);
+    MergeOptions narrow;
+    narrow.fanIn = 2;
+    MergeStats stats;
+    EXPECT_EQ(merged(archive, narrow, &stats), expected);
+    EXPECT_GT(stats.runs, 0u);
+}
+
+}  // namespace merge
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
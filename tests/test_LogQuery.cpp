@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CompressionOptions.h"
+#include "CompressorFactory.h"
+#include "FileCompressor.h"
+#include "LogQuery.h"
+
+namespace query {
+
+class LogQueryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tempDir = std::filesystem::temp_directory_path() / "logquery_test";
+        std::filesystem::remove_all(tempDir);
+        std::filesystem::create_directories(tempDir / "input");
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(tempDir);
+    }
+
+    // Writes the files and compresses them into archive.bin
+    std::string createArchive(const std::unordered_map<std::string, std::string>& files,
+                              const compression::CompressionOptions& options) {
+        for (const auto& [path, content] : files) {
+            std::filesystem::path filePath = tempDir / "input" / path;
+            std::filesystem::create_directories(filePath.parent_path());
+            std::ofstream file(filePath, std::ios::binary);
+            file << content;
+        }
+        std::string archive = (tempDir / "archive.bin").string();
+        compression::FileCompressor::compress((tempDir / "input").string(), archive, options);
+        return archive;
+    }
+
+    std::filesystem::path tempDir;
+};
+
+// A service log of the given hour: one entry per minute, every tenth a CRITICAL one with a stack trace
+std::string serviceLog(int hour, const std::string& component) {
+    std::string log;
+    for (int minute = 0; minute < 60; minute++) {
+        std::string mm = (minute < 10 ? "0" : "") + std::to_string(minute);
+        std::string time = "[2105-05-13 0" + std::to_string(hour) + ":" + mm + ":00.000]";
+        if (minute % 10 == 0) {
+            log += time + " CRITICAL [" + component + "] - Request " + std::to_string(minute) + " failed\n";
+            log += "  at frame one\n  at frame two\n";
+        } else {
+            log += time + " INFO [" + component + "] - Request " + std::to_string(minute) + " served\n";
+        }
+    }
+    return log;
+}
+
+// Test describing lines by level, component and template
+TEST(LineFieldsTest, DescribesLines) {
+    LineFields fields = describeLine("[2105-05-13 03:49:27.000] <x> ERROR [Batch] - Job \x12 failed\r\n");  // Raw
+    EXPECT_EQ(fields.level, "ERROR");
+    EXPECT_EQ(fields.component, "Batch");
+    EXPECT_EQ(fields.templateText, "(raw)");
+
+    // The component keeps the line's variables, the template does not
+    fields = describeLine("[2105-05-13 03:49:27.000] [worker-3] WARN retry 7\n");
+    EXPECT_EQ(fields.level, "WARN");
+    EXPECT_EQ(fields.component, "worker-3");
+    EXPECT_EQ(fields.templateText, "<time> [<var>] WARN retry <int>");
+    fields = describeLine("[2105-05-13 03:49:27.000] 5 [node 12] up\n");
+    EXPECT_EQ(fields.component, "node 12");
+
+    fields = describeLine("starting up with an Error count\n");
+    EXPECT_EQ(fields.level, NO_VALUE);
+    EXPECT_EQ(fields.component, NO_VALUE);
+    EXPECT_THROW(parseField("host"), std::invalid_argument);
+}
+
+// Test that counts by component and level per hour come out the same whether files are read from
+// template columns, restored from other streams or packed in solid blocks, and that components sharing
+// a template are told apart
+TEST_F(LogQueryTest, CountsByFieldsAndHour) {
+    std::unordered_map<std::string, std::string> files = {
+        {"host01/api.log", serviceLog(1, "Api1") + serviceLog(2, "Api1")},
+        {"host01/db.log", serviceLog(2, "Db2")},
+        {"host02/api.log", serviceLog(1, "Api1") + serviceLog(2, "Api1")},  // Duplicate, counted under both paths
+        {"host02/boot.log", "booting\nloaded 12 modules\n"},
+    };
+    QueryOptions options;
+    options.groupBy = {Field::COMPONENT, Field::LEVEL};
+    options.bucketMillis = HOUR_MILLIS;
+
+    std::vector<QueryResult> results;
+    for (int mode = 0; mode < 3; mode++) {
+        compression::CompressionOptions compression;
+        compression.compType = compression::availableCompressionTypes().front();
+        compression.templateColumns = mode == 0;
+        compression.solidBlockSize = mode == 2 ? 1 << 20 : 0;
+        std::string archive = createArchive(files, compression);
+        QueryStats stats;
+        results.push_back(queryArchive(archive, options, &stats));
+        EXPECT_EQ(stats.queried, 3u);
+        EXPECT_EQ(stats.columnar, mode == 0 ? 2u : 0u);  // The boot log has too few lines per template
+        std::filesystem::remove(archive);
+    }
+    EXPECT_EQ(results[1].counts, results[0].counts);
+    EXPECT_EQ(results[2].counts, results[0].counts);
+
+    const QueryResult& result = results[0];
+    EXPECT_EQ(result.columns, (std::vector<std::string>{"hour", "component", "level"}));
+    EXPECT_EQ(result.counts.size(), 7u);
+    EXPECT_EQ(result.counts.at({"2105-05-13 01:00", "Api1", "CRITICAL"}), 12u);
+    EXPECT_EQ(result.counts.at({"2105-05-13 02:00", "Api1", "INFO"}), 108u);
+    EXPECT_EQ(result.counts.at({"2105-05-13 02:00", "Db2", "CRITICAL"}), 6u);
+    EXPECT_EQ(result.counts.at({NO_VALUE, NO_VALUE, NO_VALUE}), 2u);  // Lines without any timestamp
+}
+
+// Test the level filter, the time window and template grouping
+TEST_F(LogQueryTest, FiltersAndGroupsByTemplate) {
+    std::unordered_map<std::string, std::string> files;
+    for (int hour = 1; hour <= 4; hour++) {
+        files["host01/api.log." + std::to_string(hour)] = serviceLog(hour, "Api");
+    }
+    compression::CompressionOptions compression;
+    compression.compType = compression::availableCompressionTypes().front();
+    compression.templateColumns = true;
+    compression.timeIndex = true;
+    std::string archive = createArchive(files, compression);
+
+    QueryOptions options;
+    QueryStats stats;
+    EXPECT_EQ(queryArchive(archive, options, &stats).counts.at({}), 240u);  // Stack frames continue their entry
+    EXPECT_EQ(stats.columnar, 4u);
+
+    options.groupBy = {Field::TEMPLATE};
+    options.levels = {"CRITICAL"};
+    options.window.since = timestamps::parseTimeBound("2105-05-13 02:30", false);
+    options.window.until = timestamps::parseTimeBound("2105-05-13 03:15", true);
+    QueryResult result = queryArchive(archive, options, &stats);
+    EXPECT_EQ(stats.queried, 2u);
+    EXPECT_EQ(stats.skipped, 2u);
+    ASSERT_EQ(result.counts.size(), 1u);
+    EXPECT_EQ(result.counts.begin()->first[0], "<time> CRITICAL [Api] - Request <int> failed");
+    EXPECT_EQ(result.counts.begin()->second, 5u);  // 02:30, 02:40, 02:50, 03:00 and 03:10
+
+    options.bucketMillis = 1000;
+    EXPECT_THROW(queryArchive(archive, options), std::invalid_argument);
+}
+
+}  // namespace query
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
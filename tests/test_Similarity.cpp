@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "Similarity.h"
+
+namespace similarity {
+
+// Log lines of one component; lines differ in their numbers and in which of the actions they name
+std::string componentLog(const std::string& component, size_t count, size_t offset = 0) {
+    static const std::vector<std::string> actions = {"started", "finished", "retried", "queued", "skipped",
+                                                     "cancelled", "timed out", "resumed"};
+    std::string content;
+    for (size_t i = offset; i < offset + count; i++) {
+        content += "[2105-05-13 03:49:" + std::to_string(i % 60) + "] INFO [" + component + "] - Task " +
+                   std::to_string(i) + " " + actions[i % actions.size()] + " step " + std::to_string(i % 37) + "\n";
+    }
+    return content;
+}
+
+Sketch sketchString(const std::string& content) {
+    return sketchBuffer(content.data(), content.size());
+}
+
+// Test that logs differing only in numbers sketch alike and unrelated logs do not
+TEST(SimilarityTest, EstimatesSimilarity) {
+    Sketch first = sketchString(componentLog("Scheduler", 500));
+    Sketch shifted = sketchString(componentLog("Scheduler", 500, 1000));
+    Sketch other = sketchString(componentLog("Database", 500));
+
+    EXPECT_DOUBLE_EQ(estimateSimilarity(first, first), 1.0);
+    EXPECT_GT(estimateSimilarity(first, shifted), 0.9);
+    EXPECT_LT(estimateSimilarity(first, other), 0.1);
+}
+
+// Test that content without newlines still produces a usable sketch
+TEST(SimilarityTest, SketchesLongLines) {
+    std::string line(4096, 'a');
+    for (size_t i = 0; i < line.size(); i += 7) {
+        line[i] = static_cast<char>('a' + i % 26);
+    }
+    EXPECT_DOUBLE_EQ(estimateSimilarity(sketchString(line), sketchString(line + line)), 1.0);
+    EXPECT_LT(estimateSimilarity(sketchString(line), sketchString(std::string(4096, 'z'))), 0.1);
+}
+
+// Test that near-duplicates share a cluster id, the index of the cluster's first member
+TEST(SimilarityTest, ClustersNearDuplicates) {
+    std::vector<Sketch> sketches = {
+        sketchString(componentLog("Scheduler", 300)),
+        sketchString(componentLog("Database", 300)),
+        sketchString(componentLog("Scheduler", 300, 5000)),
+        sketchString(componentLog("Gateway", 300)),
+        sketchString(componentLog("Database", 280, 20)),
+    };
+
+    auto clusters = clusterSketches(sketches);
+    ASSERT_EQ(clusters.size(), sketches.size());
+    EXPECT_EQ(clusters[0], 0);
+    EXPECT_EQ(clusters[1], 1);
+    EXPECT_EQ(clusters[2], 0);
+    EXPECT_EQ(clusters[3], 3);
+    EXPECT_EQ(clusters[4], 1);
+    EXPECT_TRUE(clusterSketches({}).empty());
+}
+
+}  // namespace similarity
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
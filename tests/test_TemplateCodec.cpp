@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+#include "TemplateCodec.h"
+#include "TimestampCodec.h"
+
+namespace templates {
+
+// Encodes content into template columns and returns the blocks
+std::string encode(const std::string& content) {
+    std::istringstream input(content);
+    EncodingBuffer encoder(input);
+    std::istream encodedInput(&encoder);
+    return std::string((std::istreambuf_iterator<char>(encodedInput)), std::istreambuf_iterator<char>());
+}
+
+// Joins columns back into lines, feeding them in pieces of pieceSize bytes
+std::string decode(const std::string& encoded, size_t pieceSize) {
+    std::ostringstream output;
+    DecodingBuffer decoder(output);
+    std::ostream decodedOutput(&decoder);
+    decodedOutput.exceptions(std::ios::badbit);
+    for (size_t i = 0; i < encoded.size(); i += pieceSize) {
+        decodedOutput.write(encoded.data() + i, std::min(pieceSize, encoded.size() - i));
+    }
+    decoder.finish();
+    EXPECT_EQ(decoder.written(), output.str().size());
+    return output.str();
+}
+
+// Test that lines split into a template and typed variables
+TEST(TemplateCodecTest, ParsesLines) {
+    ParsedLine parsed;
+    ASSERT_TRUE(parseLine("[2105-05-13 03:49:27.000] INFO [Batch] - Job 42 on unit-7 took 0.5s\n", parsed));
+    EXPECT_TRUE(parsed.timestamped);
+    EXPECT_EQ(parsed.text, std::string{TIMESTAMP_PLACEHOLDER} + " INFO [Batch] - Job " + INTEGER_PLACEHOLDER +
+                               " on " + VARIABLE_PLACEHOLDER + " took " + VARIABLE_PLACEHOLDER + "\n");
+    EXPECT_EQ(parsed.integers, std::vector<uint64_t>{42});
+    ASSERT_EQ(parsed.variables.size(), 2u);
+    EXPECT_EQ(parsed.variables[0], "unit-7");
+    EXPECT_EQ(parsed.variables[1], "0.5s");
+
+    ASSERT_TRUE(parseLine("id=007 count=0\n", parsed));  // Leading zeros would not print back as an integer
+    EXPECT_FALSE(parsed.timestamped);
+    EXPECT_EQ(parsed.integers, std::vector<uint64_t>{0});
+    ASSERT_EQ(parsed.variables.size(), 1u);
+    EXPECT_EQ(parsed.variables[0], "007");
+
+    EXPECT_FALSE(parseLine(std::string("bad \x12 byte\n"), parsed));
+    EXPECT_FALSE(parseLine(std::string(MAX_TEMPLATE_LENGTH + 1, 'a'), parsed));
+}
+
+// Test that a sample must mostly consist of lines sharing templates
+TEST(TemplateCodecTest, DetectsTemplatedText) {
+    std::string templated;
+    for (int i = 0; i < 40; i++) {
+        templated += "[2105-05-13 03:49:27.000] INFO [Batch] - Job " + std::to_string(i) + " on unit " +
+                     std::to_string(i % 5) + "\n";
+    }
+    EXPECT_TRUE(hasTemplates(templated.data(), templated.size()));
+    std::string varied;
+    for (int i = 0; i < 40; i++) {
+        varied += "line " + std::string(i + 1, 'w') + "\n";  // Every line its own template
+    }
+    EXPECT_FALSE(hasTemplates(varied.data(), varied.size()));
+    EXPECT_FALSE(hasTemplates("", 0));
+}
+
+// Test that templated lines shrink, other lines are stored raw and everything restores exactly
+TEST(TemplateCodecTest, RoundTripsExactly) {
+    std::string content;
+    for (int i = 0; i < 5000; i++) {
+        char stamp[timestamps::TIMESTAMP_LENGTH];
+        timestamps::formatTimestamp(4294967296000 + i * 1537 - (i % 7 == 0 ? 90000 : 0), stamp);  // Some go backwards
+        content.append(stamp, timestamps::TIMESTAMP_LENGTH);
+        content += " INFO [Batch] [RUN] - Batch job " + std::to_string(i * 31) + " on unit u" +
+                   std::to_string(i % 17) + "\r\n";
+        if (i % 13 == 0) {
+            content += "    at handler 0x" + std::to_string(i) + "ff\n\nid=00" + std::to_string(i) + "\n" +
+                       std::string("raw \x13 line\n");
+        }
+    }
+    content += "trailing 18446744073709551615 and 999999999999999999";  // Last line without a newline
+
+    std::string encoded = encode(content);
+    EXPECT_LT(encoded.size(), content.size() / 3);
+    EXPECT_EQ(decode(encoded, encoded.size()), content);
+    EXPECT_EQ(decode(encoded, 1), content);  // Blocks split across writes
+    EXPECT_EQ(decode(encode(""), 1), "");
+}
+
+// Test that content spanning several blocks, including a line longer than a block, restores exactly
+TEST(TemplateCodecTest, RoundTripsAcrossBlocks) {
+    std::string content;
+    for (int i = 0; content.size() < 3 * TEMPLATE_BLOCK_SIZE; i++) {
+        content += "[2105-05-13 03:49:27.000] DEBUG payload " + std::to_string(i) + " " +
+                   std::string(content.size() % 300, 'p') + "\n";
+    }
+    content += "[2105-05-13 03:49:28.000] " + std::string(TEMPLATE_BLOCK_SIZE + 100, 'l') + "\n";
+    content += "[2105-05-13 03:49:29.000] after the long line\n";
+    std::string encoded = encode(content);
+    EXPECT_EQ(decode(encoded, 4096), content);
+}
+
+// Test that malformed blocks are rejected
+TEST(TemplateCodecTest, RejectsMalformedBlocks) {
+    std::string encoded = encode("[2105-05-13 03:49:27.000] job 1 done\n");
+    EXPECT_THROW(decode(encoded.substr(0, encoded.size() - 1), 4096), std::runtime_error);  // Cut short
+    std::string extraLine = encoded;
+    extraLine[0] = 2;  // Claims a line the columns do not hold
+    EXPECT_THROW(decode(extraLine, 4096), std::runtime_error);
+    std::string unknownTemplate = encode("job 1 done\n");
+    unknownTemplate[unknownTemplate.size() - 2] = 5;  // Template id no block defined
+    EXPECT_THROW(decode(unknownTemplate, 4096), std::runtime_error);
+}
+
+// Test that the column reader hands out each line's template and timestamp without restoring it
+TEST(TemplateCodecTest, ReadsColumnsWithoutRestoringLines) {
+    std::string content;
+    for (int i = 0; content.size() < 2 * TEMPLATE_BLOCK_SIZE; i++) {
+        content += "[2105-05-13 03:49:27.000] INFO [Batch] - Job " + std::to_string(i) + " finished\n";
+    }
+    content += "  at frame\n";
+    content += std::string("[2105-05-13 03:49:28.000] odd \x12 byte\n");  // Raw
+    std::string encoded = encode(content);
+
+    std::vector<ColumnLine> lines;
+    std::vector<std::string> texts;
+    ColumnReader reader([&](const ColumnLine& line) {
+        lines.push_back(line);
+        texts.emplace_back(line.text);
+    });
+    std::ostream read(&reader);
+    read.exceptions(std::ios::badbit);
+    for (size_t i = 0; i < encoded.size(); i += 5000) {
+        read.write(encoded.data() + i, std::min<size_t>(5000, encoded.size() - i));
+    }
+    reader.finish();
+
+    ASSERT_GT(lines.size(), 3u);
+    int64_t expected;
+    timestamps::parseTimestamp("[2105-05-13 03:49:27.000]", timestamps::TIMESTAMP_LENGTH, expected);
+    EXPECT_EQ(lines.front().templateId, 1u);
+    EXPECT_TRUE(lines.front().timestamped);
+    EXPECT_EQ(lines.front().timestamp, expected);
+    EXPECT_EQ(texts.front(), std::string{TIMESTAMP_PLACEHOLDER} + " INFO [Batch] - Job " + INTEGER_PLACEHOLDER + " finished\n");
+    EXPECT_EQ(texts[lines.size() - 3], texts.front());  // Same template in the last block
+    EXPECT_EQ(lines[lines.size() - 3].timestamp, expected);
+    EXPECT_FALSE(lines[lines.size() - 2].timestamped);
+    EXPECT_EQ(lines.back().templateId, RAW_LINE);
+    EXPECT_EQ(texts.back(), std::string("[2105-05-13 03:49:28.000] odd \x12 byte\n"));
+    EXPECT_TRUE(lines.back().timestamped);
+    EXPECT_EQ(lines.back().timestamp, expected + 1000);
+}
+
+// Test that the column reader hands out the variables of templated lines when asked for them
+TEST(TemplateCodecTest, ReadsVariablesWhenAsked) {
+    std::string encoded = encode("[2105-05-13 03:49:27.000] [worker-3] WARN retry 7\n"
+                                 "[2105-05-13 03:49:28.000] [worker-12] WARN retry 8\n"
+                                 "odd \x12 byte\n");
+    std::vector<std::vector<uint64_t>> integers;
+    std::vector<std::vector<std::string>> variables;
+    ColumnReader reader([&](const ColumnLine& line) {
+        integers.push_back(line.integers);
+        variables.emplace_back(line.variables.begin(), line.variables.end());
+    }, true);
+    std::ostream read(&reader);
+    read.exceptions(std::ios::badbit);
+    read.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+    reader.finish();
+
+    ASSERT_EQ(integers.size(), 3u);
+    EXPECT_EQ(integers[0], std::vector<uint64_t>{7});
+    EXPECT_EQ(variables[0], std::vector<std::string>{"worker-3"});
+    EXPECT_EQ(integers[1], std::vector<uint64_t>{8});
+    EXPECT_EQ(variables[1], std::vector<std::string>{"worker-12"});
+    EXPECT_TRUE(integers[2].empty());  // Raw
+    EXPECT_TRUE(variables[2].empty());
+}
+
+}  // namespace templates
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
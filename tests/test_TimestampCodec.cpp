@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "TimestampCodec.h"
+
+namespace timestamps {
+
+// Encodes content through the timestamp stage and returns the blocks
+std::string encode(const std::string& content) {
+    std::istringstream input(content);
+    EncodingBuffer encoder(input);
+    std::istream encodedInput(&encoder);
+    return std::string((std::istreambuf_iterator<char>(encodedInput)), std::istreambuf_iterator<char>());
+}
+
+// Joins blocks back into lines, feeding them in pieces of pieceSize bytes
+std::string decode(const std::string& encoded, size_t pieceSize) {
+    std::ostringstream output;
+    DecodingBuffer decoder(output);
+    std::ostream decodedOutput(&decoder);
+    decodedOutput.exceptions(std::ios::badbit);
+    for (size_t i = 0; i < encoded.size(); i += pieceSize) {
+        decodedOutput.write(encoded.data() + i, std::min(pieceSize, encoded.size() - i));
+    }
+    decoder.finish();
+    EXPECT_EQ(decoder.written(), output.str().size());
+    return output.str();
+}
+
+// Test that timestamps parse to milliseconds and format back to the same bytes
+TEST(TimestampCodecTest, ParsesAndFormats) {
+    int64_t millis;
+    ASSERT_TRUE(parseTimestamp("[1970-01-01 00:00:00.001]", TIMESTAMP_LENGTH, millis));
+    EXPECT_EQ(millis, 1);
+    ASSERT_TRUE(parseTimestamp("[2000-03-01 12:34:56.789] rest", 30, millis));
+    EXPECT_EQ(millis, 951914096789);
+
+    for (const char* stamp : {"[2105-05-13 03:49:27.000]", "[0000-01-01 00:00:00.000]", "[9999-12-31 23:59:59.999]",
+                              "[1969-12-31 23:59:59.999]", "[2024-02-29 08:00:00.500]"}) {
+        ASSERT_TRUE(parseTimestamp(stamp, TIMESTAMP_LENGTH, millis)) << stamp;
+        char formatted[TIMESTAMP_LENGTH];
+        formatTimestamp(millis, formatted);
+        EXPECT_EQ(std::string(formatted, TIMESTAMP_LENGTH), stamp);
+    }
+}
+
+// Test that anything that would not format back to the same bytes is rejected
+TEST(TimestampCodecTest, RejectsNonCanonicalTimestamps) {
+    int64_t millis;
+    for (const char* stamp : {"[2023-02-29 00:00:00.000]", "[2105-13-01 00:00:00.000]", "[2105-05-13 24:00:00.000]",
+                              "[2105-05-13 23:59:60.000]", "[2105-05-13T03:49:27.000]", "[2105-05-13 03:49:27,000]",
+                              "(2105-05-13 03:49:27.000)", "[2105-05-1a 03:49:27.000]", "[2105-05-13 03:49:27.000"}) {
+        EXPECT_FALSE(parseTimestamp(stamp, std::strlen(stamp), millis)) << stamp;
+    }
+    EXPECT_FALSE(parseTimestamp("[2105-05-13 03:49:27.000]", TIMESTAMP_LENGTH - 1, millis));
+}
+
+// Test that window bounds fill missing fields from the start or the end of the period
+TEST(TimestampCodecTest, ParsesTimeBounds) {
+    int64_t day;
+    ASSERT_TRUE(parseTimestamp("[2105-05-13 00:00:00.000]", TIMESTAMP_LENGTH, day));
+    EXPECT_EQ(parseTimeBound("2105-05-13", false), day);
+    EXPECT_EQ(parseTimeBound("2105-05-13", true), day + 86400000 - 1);
+    EXPECT_EQ(parseTimeBound("2105-05-13 03:15", false), day + 195 * 60000);
+    EXPECT_EQ(parseTimeBound("2105-05-13T03:15", true), day + 196 * 60000 - 1);
+    EXPECT_EQ(parseTimeBound("2105-05-13 03:15:07", true), day + (195 * 60 + 7) * 1000 + 999);
+    EXPECT_EQ(parseTimeBound("2105-05-13 03:15:07.250", false), day + (195 * 60 + 7) * 1000 + 250);
+    for (const char* text : {"", "2105-05", "2105-05-13 03", "2105-05-13 03:1", "2105-05-13 03:15:0",
+                             "2105-02-30", "2105-05-13 25:00", "2105-05-13 03:15:07.2500"}) {
+        EXPECT_THROW(parseTimeBound(text, false), std::invalid_argument) << text;
+    }
+}
+
+// Test that the range covers every line's leading timestamp, however the text is split
+TEST(TimestampCodecTest, ScansTimeRange) {
+    std::string text = "[2105-05-13 03:49:27.000] b\n  continued [2200-01-01 00:00:00.000]\n"
+                       "[2105-05-13 03:00:00.000] a\nshort\n[2105-05-13 04:00:00.000] c";
+    int64_t first, last;
+    ASSERT_TRUE(parseTimestamp("[2105-05-13 03:00:00.000]", TIMESTAMP_LENGTH, first));
+    ASSERT_TRUE(parseTimestamp("[2105-05-13 04:00:00.000]", TIMESTAMP_LENGTH, last));
+    for (size_t pieceSize : {text.size(), size_t(1), size_t(7)}) {
+        TimeRangeScanner scanner;
+        for (size_t i = 0; i < text.size(); i += pieceSize) {
+            scanner.add(text.data() + i, std::min(pieceSize, text.size() - i));
+        }
+        ASSERT_TRUE(scanner.found());
+        EXPECT_EQ(scanner.minTimestamp(), first);
+        EXPECT_EQ(scanner.maxTimestamp(), last);
+    }
+    TimeRangeScanner none;
+    none.add("no timestamps\n", 14);
+    EXPECT_FALSE(none.found());
+}
+
+// Test that a sample must mostly consist of timestamped lines
+TEST(TimestampCodecTest, DetectsTimestampedText) {
+    std::string stamped = "[2105-05-13 03:49:27.000] INFO start\n    at frame\n[2105-05-13 03:49:28.000] INFO done\n";
+    EXPECT_TRUE(hasTimestamps(stamped.data(), stamped.size()));
+    std::string plain = "INFO start\n    at frame\n[2105-05-13 03:49:28.000] INFO done\n";
+    EXPECT_FALSE(hasTimestamps(plain.data(), plain.size()));
+    EXPECT_FALSE(hasTimestamps("", 0));
+}
+
+// Test that timestamped lines shrink, other lines pass through and everything restores exactly
+TEST(TimestampCodecTest, RoundTripsExactly) {
+    std::string content;
+    for (int i = 0; i < 5000; i++) {
+        char stamp[TIMESTAMP_LENGTH];
+        formatTimestamp(4294967296000 + i * 1537 - (i % 7 == 0 ? 90000 : 0), stamp);  // Some go backwards
+        content.append(stamp, TIMESTAMP_LENGTH);
+        content += " INFO request " + std::to_string(i) + "\n";
+        if (i % 13 == 0) {
+            content += "    at handler\n\n[not a timestamp] line\n";
+        }
+    }
+    content += "[2105-05-13 03:49:27.000]";  // Last line holds only a timestamp
+
+    std::string encoded = encode(content);
+    EXPECT_LT(encoded.size(), content.size() * 2 / 3);
+    EXPECT_EQ(decode(encoded, encoded.size()), content);
+    EXPECT_EQ(decode(encoded, 1), content);  // Blocks split across writes
+    EXPECT_EQ(decode(encode(""), 1), "");
+}
+
+// Test that content spanning several blocks, including a line longer than a block, restores exactly
+TEST(TimestampCodecTest, RoundTripsAcrossBlocks) {
+    std::string content;
+    while (content.size() < 3 * TIMESTAMP_BLOCK_SIZE) {
+        content += "[2105-05-13 03:49:27.000] DEBUG payload " + std::string(content.size() % 300, 'p') + "\n";
+    }
+    content += "[2105-05-13 03:49:28.000] " + std::string(TIMESTAMP_BLOCK_SIZE + 100, 'l') + "\n";
+    content += "[2105-05-13 03:49:29.000] after the long line\n";
+    std::string encoded = encode(content);
+    EXPECT_EQ(decode(encoded, 4096), content);
+}
+
+// Test that malformed blocks are rejected
+TEST(TimestampCodecTest, RejectsMalformedBlocks) {
+    std::string encoded = encode("[2105-05-13 03:49:27.000] line\n");
+    EXPECT_THROW(decode(encoded.substr(0, encoded.size() - 1), 4096), std::runtime_error);  // Cut short
+    std::string extraLine = encoded;
+    extraLine[0] = 2;  // Claims a line the columns do not hold
+    EXPECT_THROW(decode(extraLine, 4096), std::runtime_error);
+    std::string openVarint = encoded;
+    openVarint.back() = '\xFF';  // Varint that never ends
+    EXPECT_THROW(decode(openVarint, 4096), std::runtime_error);
+}
+
+}  // namespace timestamps
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "Transcoder.h"
+
+namespace transcoding {
+
+// UTF-16 bytes of a list of code units
+std::string utf16(const std::u16string& units, Encoding encoding, bool byteOrderMark = true) {
+    std::string bytes;
+    auto append = [&](char16_t unit) {
+        char low = static_cast<char>(unit & 0xFF);
+        char high = static_cast<char>(unit >> 8);
+        bytes += encoding == Encoding::UTF16LE ? std::string{low, high} : std::string{high, low};
+    };
+    if (byteOrderMark) {
+        append(0xFEFF);
+    }
+    for (char16_t unit : units) {
+        append(unit);
+    }
+    return bytes;
+}
+
+const uint8_t* bytesOf(const std::string& data) {
+    return reinterpret_cast<const uint8_t*>(data.data());
+}
+
+// Transcodes through both stream buffers, writing the UTF-8 back in pieces of pieceSize bytes
+std::string roundTrip(const std::string& original, Encoding encoding, size_t pieceSize, std::string* utf8 = nullptr) {
+    std::istringstream source(original);
+    ToUtf8Buffer toUtf8(source, encoding, original.size());
+    std::istream converted(&toUtf8);
+    converted.exceptions(std::ios::badbit);
+    std::string text((std::istreambuf_iterator<char>(converted)), std::istreambuf_iterator<char>());
+    if (utf8) {
+        *utf8 = text;
+    }
+
+    std::ostringstream target;
+    FromUtf8Buffer fromUtf8(target, encoding);
+    std::ostream restored(&fromUtf8);
+    restored.exceptions(std::ios::badbit);
+    for (size_t i = 0; i < text.size(); i += pieceSize) {
+        restored.write(text.data() + i, std::min(pieceSize, text.size() - i));
+    }
+    fromUtf8.finish();
+    EXPECT_EQ(fromUtf8.written(), target.str().size());
+    return target.str();
+}
+
+// Test that UTF-16 is detected by its byte order mark or its zero bytes, and only when UTF-8 is smaller
+TEST(TranscoderTest, DetectsUtf16) {
+    std::u16string ascii = u"[2105-05-13 03:49:27.000] INFO [Worker] - Job finished\r\n";
+    EXPECT_EQ(detectUtf16(bytesOf(utf16(ascii, Encoding::UTF16LE)), ascii.size() * 2 + 2), Encoding::UTF16LE);
+    EXPECT_EQ(detectUtf16(bytesOf(utf16(ascii, Encoding::UTF16BE)), ascii.size() * 2 + 2), Encoding::UTF16BE);
+    EXPECT_EQ(detectUtf16(bytesOf(utf16(ascii, Encoding::UTF16LE, false)), ascii.size() * 2), Encoding::UTF16LE);
+
+    std::string plain = "[2105-05-13 03:49:27.000] INFO [Worker] - Job finished\n";
+    EXPECT_EQ(detectUtf16(bytesOf(plain), plain.size()), Encoding::NONE);
+
+    std::u16string cjk = u"日志記録エラー発生";  // Three bytes each in UTF-8
+    EXPECT_EQ(detectUtf16(bytesOf(utf16(cjk, Encoding::UTF16LE)), cjk.size() * 2 + 2), Encoding::NONE);
+}
+
+// Test that files of odd size are never taken for UTF-16
+TEST(TranscoderTest, OddSizedFilesStayRaw) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "transcoder_test.log";
+    std::string content = utf16(u"odd sized log line\n", Encoding::UTF16LE);
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << content;
+    }
+    EXPECT_EQ(detectFileEncoding(path), Encoding::UTF16LE);
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file << 'x';
+    }
+    EXPECT_EQ(detectFileEncoding(path), Encoding::NONE);
+    std::filesystem::remove(path);
+}
+
+// Test that text of every UTF-8 length, surrogate pairs and unpaired surrogates restore exactly
+TEST(TranscoderTest, RoundTripsExactly) {
+    std::u16string units;
+    for (int i = 0; i < 2000; i++) {
+        units += u"INFO café € \U0001F600 line ";
+        units += static_cast<char16_t>(u'0' + i % 10);
+        units += i % 97 == 0 ? u"\xD800 lone high" : i % 89 == 0 ? u"\xDC00 lone low" : u"";
+        units += u"\r\n";
+    }
+    units += u'\xD801';  // Unpaired high surrogate at the very end
+
+    for (Encoding encoding : {Encoding::UTF16LE, Encoding::UTF16BE}) {
+        std::string original = utf16(units, encoding);
+        std::string utf8;
+        EXPECT_EQ(roundTrip(original, encoding, original.size(), &utf8), original);
+        EXPECT_LT(utf8.size(), original.size());
+        EXPECT_EQ(utf8.substr(0, 3), "\xEF\xBB\xBF");  // The byte order mark is kept as U+FEFF
+        EXPECT_EQ(roundTrip(original, encoding, 1), original);  // Sequences split across writes
+        EXPECT_EQ(roundTrip(original, encoding, 7), original);
+    }
+}
+
+// Test that a stream ending inside a code unit, or bytes that never come out of transcoding, are rejected
+TEST(TranscoderTest, RejectsBrokenInput) {
+    EXPECT_THROW(roundTrip("abc", Encoding::UTF16LE, 1), std::runtime_error);
+
+    std::string output;
+    EXPECT_THROW(utf8ToUtf16(bytesOf("\xC0\x80"), 2, Encoding::UTF16LE, output), std::runtime_error);  // Overlong
+    EXPECT_THROW(utf8ToUtf16(bytesOf("\x80"), 1, Encoding::UTF16LE, output), std::runtime_error);
+    EXPECT_EQ(utf8ToUtf16(bytesOf("a\xE2\x82"), 3, Encoding::UTF16LE, output), 1);  // Waits for the rest
+
+    std::ostringstream target;
+    FromUtf8Buffer fromUtf8(target, Encoding::UTF16LE);
+    std::ostream restored(&fromUtf8);
+    restored.write("\xE2\x82", 2);
+    EXPECT_THROW(fromUtf8.finish(), std::runtime_error);
+}
+
+}  // namespace transcoding
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "ArchiveReader.h"
+#include "CompressionOptions.h"
+#include "CompressorFactory.h"
+#include "FileCompressor.h"
+#include "TimestampCodec.h"
+#include "Watcher.h"
+
+namespace watch {
+
+class WatcherTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tempDir = std::filesystem::temp_directory_path() / "watcher_test";
+        std::filesystem::remove_all(tempDir);
+        std::filesystem::create_directories(tempDir / "logs" / "app");
+        std::filesystem::create_directories(tempDir / "archives");
+        std::filesystem::create_directories(tempDir / "staging");
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(tempDir);
+    }
+
+    static void writeFile(const std::filesystem::path& path, const std::string& content) {
+        std::ofstream file(path, std::ios::binary);
+        file << content;
+    }
+
+    // Paths archived so far across the segment archives, skipping ones still being written
+    std::set<std::string> archivedPaths() {
+        std::set<std::string> paths;
+        for (const auto& entry : std::filesystem::directory_iterator(tempDir / "archives")) {
+            std::string name = entry.path().filename().string();
+            if (name.find('.') != std::string::npos) {
+                continue;  // Journals and partial archives
+            }
+            compression::ArchiveReader reader(entry.path().string());
+            for (const auto& meta : reader.entries()) {
+                paths.insert(meta.relativePath);
+            }
+        }
+        return paths;
+    }
+
+    // Waits until the archives hold count paths, or a few seconds have passed
+    std::set<std::string> waitForPaths(size_t count) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        std::set<std::string> paths = archivedPaths();
+        while (paths.size() < count && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            paths = archivedPaths();
+        }
+        return paths;
+    }
+
+    std::filesystem::path tempDir;
+};
+
+// Test that segment archives are named after the UTC hour or day of a time
+TEST_F(WatcherTest, NamesSegmentArchives) {
+    int64_t time = timestamps::parseTimeBound("2105-05-13 03:04:05", false);
+    EXPECT_EQ(segmentArchive("logs", time, Segment::DAY), "logs-2105-05-13");
+    EXPECT_EQ(segmentArchive("logs", time, Segment::HOUR), "logs-2105-05-13-03");
+    EXPECT_EQ(parseSegment("hour"), Segment::HOUR);
+    EXPECT_THROW(parseSegment("week"), std::invalid_argument);
+}
+
+// Test that closed, rotated and new-directory files are archived in batches, and files present at the
+// start are left alone
+TEST_F(WatcherTest, ArchivesFinishedFiles) {
+    writeFile(tempDir / "logs" / "old.log", "there before the watch\n");
+
+    WatchOptions options;
+    options.compression.compType = compression::availableCompressionTypes().front();
+    options.latencyMillis = 100;
+    options.segment = Segment::HOUR;
+    Watcher watcher((tempDir / "logs").string(), (tempDir / "archives" / "logs").string(), options);
+    std::thread running([&watcher] { watcher.run(); });
+
+    writeFile(tempDir / "logs" / "app" / "service.log", "[2105-05-13 03:00:00.000] INFO started\n");
+    writeFile(tempDir / "staging" / "service.log.1", "[2105-05-13 02:00:00.000] INFO rotated\n");
+    std::filesystem::rename(tempDir / "staging" / "service.log.1", tempDir / "logs" / "app" / "service.log.1");
+    std::set<std::string> paths = waitForPaths(2);
+    EXPECT_EQ(paths, (std::set<std::string>{"app/service.log", "app/service.log.1"}));
+
+    // A later batch is appended, and a directory created meanwhile is watched too
+    std::filesystem::create_directories(tempDir / "logs" / "web" / "access");
+    writeFile(tempDir / "logs" / "web" / "access" / "today.log", "GET /index.html 200\n");
+    writeFile(tempDir / "logs" / "app" / "service.log", "[2105-05-13 03:00:00.000] INFO started\nrewritten\n");
+    paths = waitForPaths(3);
+
+    // Files finished just before the stop are archived by it
+    writeFile(tempDir / "logs" / "app" / "worker.log", "last words\n");
+    watcher.stop();
+    running.join();
+    paths = archivedPaths();
+    EXPECT_EQ(paths, (std::set<std::string>{"app/service.log", "app/service.log.1", "app/worker.log",
+                                            "web/access/today.log"}));
+    EXPECT_GE(watcher.stats().batches, 3u);
+    EXPECT_GE(watcher.stats().archives, 1u);
+    EXPECT_EQ(watcher.stats().failures, 0u);
+
+    // The rewritten file replaced its entry
+    for (const auto& entry : std::filesystem::directory_iterator(tempDir / "archives")) {
+        compression::ArchiveReader reader(entry.path().string());
+        const meta::FileMeta* service = reader.find("app/service.log");
+        if (service) {
+            std::ostringstream content;
+            reader.read(*service, content);
+            EXPECT_EQ(content.str(), "[2105-05-13 03:00:00.000] INFO started\nrewritten\n");
+        }
+    }
+}
+
+// Test that only the watch's own segment archives and catalog files are left out when they sit inside
+// the watched tree, not files that merely share the archive prefix
+TEST_F(WatcherTest, SkipsOnlyItsOwnFiles) {
+    WatchOptions options;
+    options.compression.compType = compression::availableCompressionTypes().front();
+    options.compression.catalogFile = (tempDir / "logs" / "fleet.catalog").string();
+    options.latencyMillis = 50;
+    std::string prefix = (tempDir / "logs" / "app").string();
+    Watcher watcher((tempDir / "logs").string(), prefix, options);
+    std::thread running([&watcher] { watcher.run(); });
+
+    std::filesystem::create_directories(tempDir / "logs" / "application");
+    writeFile(tempDir / "logs" / "app.log", "started\n");
+    writeFile(tempDir / "logs" / "application" / "x.log", "ready\n");
+    writeFile(tempDir / "logs" / "app-notes.txt", "not a segment\n");
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (watcher.stats().files < 3 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));  // Catalog updates would be batches of their own
+    watcher.stop();
+    running.join();
+
+    std::set<std::string> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(tempDir / "logs")) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("app-2", 0) == 0 && name.find('.') == std::string::npos) {
+            compression::ArchiveReader reader(entry.path().string());
+            for (const auto& meta : reader.entries()) {
+                paths.insert(meta.relativePath);
+            }
+        }
+    }
+    EXPECT_EQ(paths, (std::set<std::string>{"app-notes.txt", "app.log", "application/x.log"}));
+    EXPECT_EQ(watcher.stats().files, 3u);
+    EXPECT_EQ(watcher.stats().failures, 0u);
+}
+
+}  // namespace watch